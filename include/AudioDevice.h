@@ -0,0 +1,61 @@
+#ifndef AUDIO_DEVICE_H
+#define AUDIO_DEVICE_H
+
+#include <SDL2/SDL.h>
+#include <chrono>
+#include <cstdint>
+
+// Where the mixer's output goes: interleaved stereo float frames, pushed by
+// the mixer thread, which keeps the device's queue a little ahead of
+// playback. Nothing here calls back into the game.
+class AudioDevice {
+public:
+    virtual ~AudioDevice() {}
+
+    // sampleRate is what's asked for and comes back as what the device
+    // gives; false if there's no device to open
+    virtual bool open(int& sampleRate) = 0;
+    virtual void close() = 0;
+
+    // Frames submitted but not yet played
+    virtual int getQueuedFrames() = 0;
+    virtual void submit(const float* frames, int count) = 0;
+
+    virtual const char* getName() const = 0;
+};
+
+// Plays nothing, but takes frames at the rate a real device would, so the
+// mixer runs the same way headless as with a sound card
+class NullAudioDevice : public AudioDevice {
+public:
+    NullAudioDevice();
+
+    bool open(int& sampleRate) override;
+    void close() override {}
+    int getQueuedFrames() override;
+    void submit(const float*, int count) override { submitted += count; }
+    const char* getName() const override { return "null"; }
+
+private:
+    std::chrono::steady_clock::time_point start;
+    uint64_t submitted;
+    int rate;
+};
+
+// The default SDL output, fed through SDL_QueueAudio rather than a callback
+class SDLAudioDevice : public AudioDevice {
+public:
+    SDLAudioDevice();
+    ~SDLAudioDevice();
+
+    bool open(int& sampleRate) override;
+    void close() override;
+    int getQueuedFrames() override;
+    void submit(const float* frames, int count) override;
+    const char* getName() const override { return "sdl"; }
+
+private:
+    SDL_AudioDeviceID device;
+};
+
+#endif // AUDIO_DEVICE_H
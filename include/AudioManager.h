@@ -3,35 +3,67 @@
 
 #include <string>
 #include <map>
+#include <memory>
 #include "Game.h"
+#include "SpatialAudio.h"
 
-// Simple audio manager - in full implementation would use SDL_mixer or similar
+class AudioMixer;
+class MusicStreamer;
+struct SoundData;
+
+// Game-facing audio. Sounds are loaded once at startup from
+// assets/sounds/<name>.wav, or synthesized when the file isn't there, and
+// handed to the mixer, which runs on its own thread. Everything after that
+// is a command push, so nothing here waits on audio. Music is streamed
+// from assets/music/<name>.wav rather than loaded.
 class AudioManager {
 public:
     AudioManager();
     ~AudioManager();
-    
-    void initialize();
+
+    // deviceName is "sdl" or "null"; SDL falls back to null if it won't open
+    void initialize(const std::string& deviceName = "sdl");
     void cleanup();
-    
+
     void playSound(const std::string& soundName);
+    // Crossfades from the current track; asking for the one already playing
+    // does nothing, so it can be called every frame
     void playMusic(const std::string& musicName, bool loop = true);
     void stopMusic();
-    
+
     void setMusicVolume(float volume);
     void setSoundVolume(float volume);
-    
-    void update();
-    
-    // Placeholder for 3D audio positioning
-    void playSound3D(const std::string& soundName, const Vector3& position, const Vector3& listenerPos);
-    
+
+    // Positional sound belongs to the world, so it only runs while playing
+    // is true; under a menu it's paused where it was and picks up after
+    void update(float deltaTime, bool playing);
+
+    // Positional sound, heard from wherever setListener last put the player
+    void setListener(const Vector3& position, float yaw, const Vector3& velocity);
+    void playSound3D(const std::string& soundName, const Vector3& position, float gain = 1.0f,
+                     AudioPriority priority = AudioPriority::NORMAL);
+    // Looping positional sound that follows whatever moves it; doppler bends
+    // its pitch as it closes in or pulls away
+    uint32_t addEmitter(const std::string& soundName, const Vector3& position, float gain,
+                        AudioPriority priority, bool doppler);
+    void moveEmitter(uint32_t id, const Vector3& position, const Vector3& velocity);
+    void removeEmitter(uint32_t id);
+
+    AudioMixer* getMixer() { return mixer.get(); }
+
 private:
+    int findSound(const std::string& name) const;
+
     float musicVolume;
     float soundVolume;
     bool initialized;
-    
-    // In full implementation, would store audio buffers/sources
+
+    std::unique_ptr<AudioMixer> mixer;
+    std::unique_ptr<MusicStreamer> music;
+    std::unique_ptr<SpatialAudio> spatial;
+    std::string currentMusic;
+    bool stopPending;           // A fade out the streamer's queue dropped
+    // Name to the mixer's sound id
     std::map<std::string, int> soundBuffers;
 };
 
@@ -0,0 +1,164 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include "AudioDevice.h"
+#include "SpscQueue.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class MusicStreamer;
+
+const int AUDIO_MAX_VOICES = 32;
+// Frames mixed at a time, about 5 ms at 48 kHz
+const int AUDIO_BLOCK_FRAMES = 256;
+const int AUDIO_SAMPLE_RATE = 48000;
+
+// Each bus has its own volume on top of every voice's gain
+enum class AudioBus : uint8_t {
+    SOUND,
+    MUSIC,
+    COUNT
+};
+
+// What became of a play, as the game thread sees it
+enum class VoiceState : uint8_t {
+    PENDING,        // Still in the queue
+    PLAYING,
+    GONE            // Finished, stopped, stolen or never found a voice
+};
+
+// One mono sound at its own rate; the mixer resamples on the fly
+struct SoundData {
+    std::vector<float> samples;
+    int sampleRate;
+};
+
+// Software mixer on its own thread. The game thread never touches mixer
+// state: play, setVoice, stopVoice and setBusVolume each push one small
+// command onto a lock-free single-producer queue, and the mixer drains it at
+// the start of every block. Voices come from a fixed pool; each is
+// resampled by linear interpolation and panned into float left and right
+// buffers, four frames per SSE op, with gains ramped across the block so
+// changes don't click. The sum is clipped and interleaved into the
+// device's queue, which the thread keeps a few blocks ahead of playback.
+class AudioMixer {
+public:
+    AudioMixer();
+    ~AudioMixer();
+
+    // Sounds are read without locking, so the bank is fixed before start;
+    // returns the new sound's id
+    int addSound(SoundData sound);
+    // Streamed music mixed into the music bus; set before start
+    void setMusic(MusicStreamer* streamer) { music = streamer; }
+
+    // Takes the device and starts mixing for it; false if it won't open
+    bool start(std::unique_ptr<AudioDevice> device);
+    void stop();
+    bool isRunning() const { return thread.joinable(); }
+    int getSampleRate() const { return sampleRate; }
+    const char* getDeviceName() const { return device ? device->getName() : "none"; }
+    // Length of a sound at its own rate; any thread, since the bank is fixed
+    float getSoundSeconds(int sound) const;
+
+    // Game thread only, and never blocking: a full queue drops the command
+    // and counts it. Handles aren't reused, so commands for a voice that has
+    // finished or been stolen do nothing. Pan runs from -1 left to 1 right;
+    // pitch scales the playback rate; offset starts that many seconds in.
+    uint32_t play(int sound, float gain, float pan, float pitch, bool loop, AudioBus bus, float offset = 0.0f);
+    void setVoice(uint32_t handle, float gain, float pan, float pitch);
+    // Fades out over one block
+    void stopVoice(uint32_t handle);
+    void setBusVolume(AudioBus bus, float volume);
+    // Any thread; a play that's GONE without being stopped lost its voice,
+    // so the caller can ask again
+    VoiceState getVoiceState(uint32_t handle) const;
+
+    // Drains the queue and mixes frames, at most AUDIO_BLOCK_FRAMES, of
+    // interleaved stereo into out. The thread calls it for every block; with
+    // no thread running, a benchmark can call it directly.
+    void mix(float* out, int frames);
+
+    uint64_t getDroppedCommands() const { return droppedCommands; }
+    int getActiveVoices() const { return activeVoices.load(std::memory_order_relaxed); }
+    uint64_t getVoicesStolen() const { return voicesStolen.load(std::memory_order_relaxed); }
+    uint64_t getBlocksMixed() const { return blocksMixed.load(std::memory_order_relaxed); }
+    uint64_t getMixNanoseconds() const { return mixNanoseconds.load(std::memory_order_relaxed); }
+
+private:
+    enum class CommandType : uint8_t {
+        PLAY,
+        SET,
+        STOP,
+        BUS_VOLUME
+    };
+
+    struct Command {
+        CommandType type;
+        AudioBus bus;
+        bool loop;
+        uint32_t handle;
+        int sound;
+        float gain;
+        float pan;
+        float pitch;
+        float offset;
+    };
+
+    struct Voice {
+        uint32_t handle;        // 0 when free
+        int sound;
+        AudioBus bus;
+        bool loop;
+        bool stopping;          // Fading out this block, then freed
+        double position;        // In source samples
+        float gain;
+        float pan;
+        float pitch;
+        float left;             // Gains reached at the end of the last block
+        float right;
+        uint64_t started;       // Play order, so the oldest is stolen first
+    };
+
+    void run();
+    void apply(const Command& command);
+    Voice* findVoice(uint32_t handle);
+    // Adds frames of the voice into left and right; false once it's done
+    bool mixVoice(Voice& voice, float* left, float* right, int frames);
+
+    SpscQueue<Command, 1024> commands;
+    std::vector<SoundData> sounds;
+    MusicStreamer* music;
+
+    std::unique_ptr<AudioDevice> device;
+    std::thread thread;
+    std::atomic<bool> running;
+    int sampleRate;
+
+    // Game thread
+    uint32_t nextHandle;
+    uint64_t droppedCommands;
+
+    // Mixer thread
+    Voice voices[AUDIO_MAX_VOICES];
+    float busVolume[(int)AudioBus::COUNT];
+    uint64_t playCount;
+    std::vector<float> mixLeft;
+    std::vector<float> mixRight;
+    std::vector<float> output;
+
+    // Written by the mixer thread so getVoiceState can read them: the
+    // handle in each voice, and the last play taken off the queue
+    std::atomic<uint32_t> voiceHandles[AUDIO_MAX_VOICES];
+    std::atomic<uint32_t> lastPlayApplied;
+
+    std::atomic<int> activeVoices;
+    std::atomic<uint64_t> voicesStolen;
+    std::atomic<uint64_t> blocksMixed;
+    std::atomic<uint64_t> mixNanoseconds;
+};
+
+#endif // AUDIO_MIXER_H
@@ -0,0 +1,69 @@
+#ifndef BATCH_2D_H
+#define BATCH_2D_H
+
+#include <SDL2/SDL_opengl.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Color2D {
+    float r, g, b, a;
+};
+
+struct Vertex2D {
+    float position[2];
+    float texCoord[2];
+    uint8_t color[4];
+};
+
+// Screen-space quads and lines in one vertex stream, drawn with one call.
+// The stream is retained between frames: owners rebuild it only when their
+// layout changes and patch elements in place for anything that animates.
+// Only vertices that actually changed are uploaded again. Untextured
+// elements sample texel (0, 0), which the glyph atlas keeps opaque, so text
+// and shapes go out together.
+class Batch2D {
+public:
+    // Vertices of one element, for later updates
+    struct Range {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    Batch2D();
+
+    // Drops every element; the next draw uploads the whole stream
+    void clear();
+    bool isEmpty() const { return vertices.empty(); }
+    size_t getVertexCount() const { return vertices.size(); }
+
+    Range addQuad(float x0, float y0, float x1, float y1, const Color2D& color);
+    Range addGradient(float x0, float y0, float x1, float y1, const Color2D& top, const Color2D& bottom);
+    Range addLine(float x0, float y0, float x1, float y1, float width, const Color2D& color);
+    Range addOutline(float x0, float y0, float x1, float y1, float width, const Color2D& color);
+    Range addTexturedQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, const Color2D& color);
+
+    // In-place updates; unchanged values don't mark anything dirty
+    void setColor(const Range& range, const Color2D& color);
+    void setGradient(const Range& quad, const Color2D& top, const Color2D& bottom);
+    void setQuad(const Range& quad, float x0, float y0, float x1, float y1);
+
+    // Expects the 2D projection and the atlas; see Renderer::drawBatch
+    void draw();
+
+    // Needs the context current
+    void release();
+
+private:
+    Range appendQuad(const float corners[4][2], const float texCoords[4][2], const uint8_t* colors[4]);
+    void markDirty(uint32_t first, uint32_t count);
+
+    std::vector<Vertex2D> vertices;
+    uint32_t dirtyBegin;
+    uint32_t dirtyEnd;
+
+    GLuint buffer;
+    size_t bufferCapacity;    // In vertices
+};
+
+#endif // BATCH_2D_H
@@ -0,0 +1,93 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <SDL2/SDL_opengl.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records the window to a Y4M video for QA and bug reports. Each captured
+// frame is read into one of a ring of pixel pack buffers and only mapped
+// a few frames later, once a fence (or the ring's length, without ARB_sync)
+// says the copy is done, so the render loop never waits on the GPU. The
+// writer thread converts straight out of the mapped buffer to 4:2:0 and
+// writes the file; the render loop unmaps the buffer once it's done. When
+// the GPU or the writer falls behind, frames are dropped rather than
+// waited for; their time goes to the next frame that makes it, so the
+// video keeps real-time length.
+class FrameCapture {
+public:
+    static const int RING_SIZE = 4;
+    static const int FRAME_RATE = 30;
+
+    FrameCapture(int width, int height);
+    ~FrameCapture();
+
+    // Needs the context current; false if pack buffers or the file aren't available
+    bool start(const std::string& path);
+    // Waits for frames still in flight and closes the file
+    void stop();
+    bool isRecording() const { return recording; }
+
+    // After the frame is drawn and before the swap; picks frames out of the
+    // game's at FRAME_RATE
+    void captureFrame(float deltaTime);
+
+    int getFramesWritten() const { return framesWritten.load(); }
+    int getFramesDropped() const { return framesDropped; }
+
+private:
+    enum class SlotState {
+        FREE,
+        READING,    // glReadPixels issued, the GPU may still be copying
+        MAPPED,     // With the writer
+        WRITTEN     // Writer done, waiting for the render loop to unmap
+    };
+
+    struct Slot {
+        GLuint buffer;
+        GLsync fence;
+        uint64_t frame;     // captureFrame call the read was issued in
+        int repeat;         // Video frames it stands for
+        const uint8_t* pixels;
+        SlotState state;
+    };
+
+    bool isReady(const Slot& slot) const;
+    // Unmaps what the writer has finished with and maps finished reads for
+    // it, oldest first; with wait set, blocks until every slot is free
+    void collect(bool wait);
+    void writerLoop();
+    void convert(const uint8_t* bgra);
+
+    int width;
+    int height;
+    bool recording;
+    std::string path;
+
+    Slot ring[RING_SIZE];
+    int next;
+    uint64_t frameCount;
+    float elapsed;
+    int owed;           // Repeats of dropped frames, added to the next kept one
+
+    // Slot states past READING change under the mutex; the writer owns yuv and file
+    std::deque<int> queued;
+    std::mutex slotMutex;
+    std::condition_variable slotCondition;
+    std::thread writer;
+    bool stopping;
+    FILE* file;
+    std::vector<uint8_t> yuv;
+
+    std::atomic<int> framesWritten;
+    int framesDropped;
+};
+
+#endif // FRAME_CAPTURE_H
@@ -0,0 +1,63 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "Game.h"
+#include <cstddef>
+#include <vector>
+
+struct AABB {
+    Vector3 min;
+    Vector3 max;
+};
+
+// Boxes stored as separate coordinate arrays so four can be tested with one
+// SIMD op per axis
+class BoundsSoA {
+public:
+    void clear();
+    int add(const AABB& box);
+    AABB get(int index) const;
+    int size() const { return count; }
+
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+
+private:
+    int count = 0;
+};
+
+// Distance at which GL_EXP2 fog is fully opaque at 8 bits per channel;
+// nothing past it can be told apart from the fog colour
+float getFogOpaqueDistance(float density);
+
+// Six inward-facing world-space planes for the camera Renderer::setCamera
+// builds. Boxes are tested against the corner furthest along each plane's
+// normal, so a box is only rejected when it's wholly outside one plane.
+class Frustum {
+public:
+    // Points inside have x, y, z dotted with the point plus d at or above zero
+    struct Plane {
+        float x, y, z, d;
+    };
+
+    Frustum();
+
+    void update(const Vector3& eye, float yaw, float pitch, float fovY, float aspect,
+                float nearPlane, float farPlane);
+
+    bool isVisible(const AABB& box) const;
+
+    // Filters indices into bounds down to the visible ones; returns the
+    // count written to visible (which may alias indices)
+    int cull(const BoundsSoA& bounds, const int* indices, int count, int* visible) const;
+
+    float getFarDistance() const { return farDistance; }
+    // Near, far, then the four sides
+    const Plane* getPlanes() const { return planes; }
+
+private:
+    Plane planes[6];
+    float farDistance;
+};
+
+#endif // FRUSTUM_H
@@ -0,0 +1,78 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <SDL2/SDL_opengl.h>
+
+// Older glext headers predate the parallel compile extensions
+typedef void (APIENTRYP PFNMANSIONMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+// Entry points beyond GL 1.1, fetched through SDL once a context exists.
+// Anything missing is left null and its feature flag false, so callers
+// check the flag and fall back to client-side arrays or immediate mode.
+struct GLExtensions {
+    bool vertexBuffers;
+    bool shaders;
+    bool instancing;    // ARB_instanced_arrays + ARB_draw_instanced (needs shaders)
+    bool framebuffers;  // ARB_framebuffer_object, or the EXT one it grew from
+    bool pixelBuffers;      // Buffer mapping, for reading pixels back without a stall
+    bool sync;              // ARB_sync fences
+    bool programBinaries;   // ARB_get_program_binary with at least one format
+    bool parallelCompile;   // KHR/ARB_parallel_shader_compile
+
+    PFNGLGENBUFFERSPROC genBuffers;
+    PFNGLDELETEBUFFERSPROC deleteBuffers;
+    PFNGLBINDBUFFERPROC bindBuffer;
+    PFNGLBUFFERDATAPROC bufferData;
+    PFNGLBUFFERSUBDATAPROC bufferSubData;
+    PFNGLMAPBUFFERPROC mapBuffer;
+    PFNGLUNMAPBUFFERPROC unmapBuffer;
+
+    PFNGLFENCESYNCPROC fenceSync;
+    PFNGLCLIENTWAITSYNCPROC clientWaitSync;
+    PFNGLDELETESYNCPROC deleteSync;
+
+    PFNGLCREATESHADERPROC createShader;
+    PFNGLDELETESHADERPROC deleteShader;
+    PFNGLSHADERSOURCEPROC shaderSource;
+    PFNGLCOMPILESHADERPROC compileShader;
+    PFNGLGETSHADERIVPROC getShaderiv;
+    PFNGLGETSHADERINFOLOGPROC getShaderInfoLog;
+    PFNGLCREATEPROGRAMPROC createProgram;
+    PFNGLDELETEPROGRAMPROC deleteProgram;
+    PFNGLATTACHSHADERPROC attachShader;
+    PFNGLBINDATTRIBLOCATIONPROC bindAttribLocation;
+    PFNGLLINKPROGRAMPROC linkProgram;
+    PFNGLGETPROGRAMIVPROC getProgramiv;
+    PFNGLGETPROGRAMINFOLOGPROC getProgramInfoLog;
+    PFNGLUSEPROGRAMPROC useProgram;
+    PFNGLGETUNIFORMLOCATIONPROC getUniformLocation;
+    PFNGLUNIFORM1FPROC uniform1f;
+    PFNGLENABLEVERTEXATTRIBARRAYPROC enableVertexAttribArray;
+    PFNGLDISABLEVERTEXATTRIBARRAYPROC disableVertexAttribArray;
+    PFNGLVERTEXATTRIBPOINTERPROC vertexAttribPointer;
+
+    PFNGLGETPROGRAMBINARYPROC getProgramBinary;
+    PFNGLPROGRAMBINARYPROC programBinary;
+    PFNGLPROGRAMPARAMETERIPROC programParameteri;
+    PFNMANSIONMAXSHADERCOMPILERTHREADSPROC maxShaderCompilerThreads;
+
+    PFNGLVERTEXATTRIBDIVISORARBPROC vertexAttribDivisor;
+    PFNGLDRAWELEMENTSINSTANCEDARBPROC drawElementsInstanced;
+
+    PFNGLGENFRAMEBUFFERSPROC genFramebuffers;
+    PFNGLDELETEFRAMEBUFFERSPROC deleteFramebuffers;
+    PFNGLBINDFRAMEBUFFERPROC bindFramebuffer;
+    PFNGLFRAMEBUFFERTEXTURE2DPROC framebufferTexture2D;
+    PFNGLCHECKFRAMEBUFFERSTATUSPROC checkFramebufferStatus;
+    PFNGLGENRENDERBUFFERSPROC genRenderbuffers;
+    PFNGLDELETERENDERBUFFERSPROC deleteRenderbuffers;
+    PFNGLBINDRENDERBUFFERPROC bindRenderbuffer;
+    PFNGLRENDERBUFFERSTORAGEPROC renderbufferStorage;
+    PFNGLFRAMEBUFFERRENDERBUFFERPROC framebufferRenderbuffer;
+};
+
+// Call with the context current; safe to call again after a context change
+bool loadGLExtensions();
+const GLExtensions& getGL();
+
+#endif // GL_EXTENSIONS_H
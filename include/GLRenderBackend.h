@@ -0,0 +1,83 @@
+#ifndef GL_RENDER_BACKEND_H
+#define GL_RENDER_BACKEND_H
+
+#include "RenderBackend.h"
+#include "GLStateCache.h"
+#include <SDL2/SDL_opengl.h>
+#include <memory>
+
+class StaticGeometry;
+class InstanceRenderer;
+class ShaderLibrary;
+
+// The OpenGL 2.1 path. 3D draws go through GLSL permutations from the
+// ShaderLibrary, falling back to fixed function for any it couldn't build;
+// 2D stays fixed function. Owns every GL object the renderer uses; needs
+// the context current from initialize to release.
+class GLRenderBackend : public RenderBackend {
+public:
+    GLRenderBackend();
+    ~GLRenderBackend();
+
+    void initialize(const RenderSettings& settings) override;
+    void release() override;
+
+    void releaseEvicted(const LevelStreamer& streamer) override;
+
+    void beginFrame(float animationTime) override;
+    void endFrame() override;
+    void setCamera(const CameraSetup& camera) override;
+
+    void beginScene(float scale) override;
+    void endScene() override;
+
+    void setMaterial(RenderMaterial material, bool lit, bool blended) override;
+    void setLights(const SceneLight* lights, int count) override;
+    void drawGround(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) override;
+    void beginChunks() override;
+    void drawChunkRange(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) override;
+    void endChunks() override;
+    void drawInstances(InstanceMesh mesh, const InstanceData* instances, size_t count, bool lit, bool animated) override;
+    void drawPoints(const ScenePoint* points, size_t count, float size) override;
+    void drawBillboards(const BillboardData* billboards, size_t count) override;
+    void drawSkinned(const SkinnedVertex* vertices, size_t count) override;
+    void drawBatch(Batch2D& batch) override;
+
+    const GLStateCache& getStateCache() const { return stateCache; }
+
+private:
+    void setupLighting();
+    void setBakedLighting(bool baked);
+    void setupPerspective(const CameraSetup& camera);
+    void setup2D();
+    bool createSceneTarget();
+    void releaseSceneTarget();
+
+    RenderSettings settings;
+    GLStateCache stateCache;
+    GLuint glyphTexture;
+
+    // Window-sized, so any scale fits in its corner without reallocating
+    GLuint sceneFramebuffer;
+    GLuint sceneColor;
+    GLuint sceneDepth;
+    int sceneWidth;
+    int sceneHeight;
+    bool sceneActive;
+
+    // Point lights start at GL_LIGHT1 while the flashlight has GL_LIGHT0,
+    // so the enabled lights are always the first few
+    int pointLightBase;
+    int activePointLights;
+
+    // Lightmapped chunks take their ambient from the bake
+    bool bakedLighting;
+    // Picks the permutation for the current material
+    bool materialLit;
+
+    std::unique_ptr<ShaderLibrary> shaders;
+    std::unique_ptr<StaticGeometry> staticGeometry;
+    std::unique_ptr<InstanceRenderer> instances;
+};
+
+#endif // GL_RENDER_BACKEND_H
@@ -0,0 +1,51 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <SDL2/SDL_opengl.h>
+
+enum class ProjectionMode {
+    UNKNOWN,
+    PERSPECTIVE,
+    ORTHO
+};
+
+// Shadows the fixed-function state the renderer flips most and drops calls
+// that wouldn't change anything. Code that touches this state behind the
+// cache's back has to restore it or call invalidate().
+class GLStateCache {
+public:
+    GLStateCache();
+
+    // Forget everything; the next call for each state always goes to GL
+    void invalidate();
+
+    void setCapability(GLenum cap, bool enabled);
+    void setDepthMask(bool enabled);
+
+    // True when the caller needs to load a new projection
+    bool setProjection(ProjectionMode mode);
+
+    void resetCounters();
+    int getStateChanges() const { return stateChanges; }
+    int getRedundantSkipped() const { return redundantSkipped; }
+
+private:
+    enum Tracked {
+        TRACK_LIGHTING,
+        TRACK_DEPTH_TEST,
+        TRACK_BLEND,
+        TRACK_COUNT
+    };
+
+    static int trackedIndex(GLenum cap);
+
+    // -1 unknown, 0 off, 1 on
+    int capabilities[TRACK_COUNT];
+    int depthMask;
+    ProjectionMode projection;
+
+    int stateChanges;
+    int redundantSkipped;
+};
+
+#endif // GL_STATE_CACHE_H
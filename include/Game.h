@@ -11,12 +11,18 @@
 // Forward declarations
 class Player;
 class Monster;
+class MonsterAnimation;
 class TaskSystem;
 class Renderer;
 class InputHandler;
 class Menu;
 class AudioManager;
 class Mansion;
+class LevelStreamer;
+class LightmapFile;
+class PortalCuller;
+class ParticleSystem;
+class FrameCapture;
 
 enum class GameState {
     MAIN_MENU,
@@ -64,6 +70,32 @@ struct Vector3 {
     }
 };
 
+// Command line settings, parsed in main()
+struct LaunchOptions {
+    std::string levelPath = "assets/levels/mansion.mhl";
+    
+    // Procedural mansion; zero rooms means load levelPath instead
+    int generateRooms = 0;
+    uint32_t seed = 1;
+    int floors = 1;
+    int wings = 4;
+    
+    // Baked lighting from mansion_bake; empty looks beside levelPath
+    std::string lightmapPath;
+    
+    // Log every backend call to this file as well as drawing; empty for none
+    std::string renderRecordPath;
+    
+    // 3D render scale; zero follows frame time, anything else is pinned
+    float resolutionScale = 0.0f;
+    
+    // Record the window to this Y4M file from the first frame; empty for none
+    std::string capturePath;
+    
+    // "sdl" or "null"; null mixes at real-time pace but plays nothing
+    std::string audioDevice = "sdl";
+};
+
 struct Task {
     std::string description;
     Vector3 location;
@@ -74,7 +106,7 @@ struct Task {
 
 class Game {
 public:
-    Game();
+    explicit Game(const LaunchOptions& options = LaunchOptions());
     ~Game();
     
     bool initialize();
@@ -95,6 +127,10 @@ private:
     void handleEvents();
     void update(float deltaTime);
     void render();
+    void setupMemoryBudgets();
+    void toggleCapture();
+    
+    LaunchOptions options;
     
     SDL_Window* window;
     SDL_GLContext glContext;
@@ -108,14 +144,29 @@ private:
     
     std::unique_ptr<Player> player;
     std::unique_ptr<Monster> monster;
+    std::unique_ptr<MonsterAnimation> monsterAnimation;
     std::unique_ptr<TaskSystem> taskSystem;
     std::unique_ptr<Renderer> renderer;
     std::unique_ptr<InputHandler> inputHandler;
     std::unique_ptr<Menu> menu;
     std::unique_ptr<AudioManager> audioManager;
     std::unique_ptr<Mansion> mansion;
+    std::unique_ptr<LightmapFile> lightmaps;
+    std::unique_ptr<LevelStreamer> streamer;
+    std::unique_ptr<PortalCuller> portalCuller;
+    std::unique_ptr<ParticleSystem> particles;
+    std::unique_ptr<FrameCapture> capture;
     
     Uint32 lastTime;
+    
+    // Previous frame, for the performance overlay and resolution scaling
+    Uint64 lastFrameStart;
+    float cpuFrameMs;
+    float simFrameMs;
+    
+    // The monster's breathing, and how far it has walked since its last footstep
+    uint32_t monsterBreath;
+    float monsterStride;
 };
 
 #endif // GAME_H
@@ -0,0 +1,88 @@
+#ifndef INSTANCE_RENDERER_H
+#define INSTANCE_RENDERER_H
+
+#include "Game.h"
+#include <SDL2/SDL_opengl.h>
+#include <cstdint>
+
+class ShaderLibrary;
+
+enum class InstanceMesh {
+    CUBE,           // Unit cube centred on the origin
+    OCTAHEDRON,     // Task marker, radius 0.4
+    QUAD,           // Unit square facing +z, for billboards
+    COUNT
+};
+
+// One copy of a shared mesh. Boxes are axis aligned, so a translation and
+// per-axis scale is the whole transform.
+struct InstanceData {
+    float position[3];
+    float scale[3];
+    uint8_t color[4];
+    float phase;        // Offset into the pulse animation, radians
+};
+
+// A round, soft-edged square that always faces the camera
+struct BillboardData {
+    float position[3];
+    float size;         // Width in metres
+    uint8_t color[4];
+};
+
+// Draws any number of copies of a shared unit mesh in one call. With
+// ARB_instanced_arrays the per-instance stream goes straight to the
+// library's instanced permutations; on plain GL 2.1 the instances are
+// expanded on the CPU into one vertex array and drawn with the plain ones.
+class InstanceRenderer {
+public:
+    InstanceRenderer();
+
+    // The library outlives the renderer and may hold no programs at all
+    void initialize(ShaderLibrary& shaders);
+    void release();
+
+    // Drives the pulse of expanded batches; the shaders take theirs from the library
+    void setTime(float seconds) { time = seconds; }
+
+    // Animated instances pulse in size and brightness like the task markers.
+    // Programs light by the lit flag; without one the fixed-function path
+    // uses GL_LIGHTING as the caller left it, so the two have to agree.
+    void draw(InstanceMesh mesh, const InstanceData* instances, size_t count, bool lit, bool animated);
+
+    // Unlit and unsorted, for blending with depth writes off. Without the
+    // billboard permutation the quads are expanded and come out square.
+    void drawBillboards(const BillboardData* billboards, size_t count);
+
+    bool isHardwareInstanced() const { return instanced; }
+    GLsizei getIndexCount(InstanceMesh mesh) const { return meshes[(int)mesh].indexCount; }
+
+private:
+    struct MeshVertex {
+        float position[3];
+        float normal[3];
+    };
+
+    struct Mesh {
+        const MeshVertex* vertices;
+        const uint16_t* indices;
+        GLsizei vertexCount;
+        GLsizei indexCount;
+        GLuint vertexBuffer;
+        GLuint indexBuffer;
+    };
+
+    void drawInstanced(const Mesh& mesh, const InstanceData* instances, size_t count);
+    void drawExpanded(const Mesh& mesh, const InstanceData* instances, size_t count, bool lit, bool animated);
+    void drawBillboardsExpanded(const BillboardData* billboards, size_t count);
+
+    Mesh meshes[(int)InstanceMesh::COUNT];
+
+    ShaderLibrary* shaders;
+    bool instanced;
+    GLuint instanceBuffer;
+
+    float time;
+};
+
+#endif // INSTANCE_RENDERER_H
@@ -0,0 +1,44 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads fed from one FIFO queue. Each job runs inside
+// a ScratchScope, so jobs can use getThreadScratch() freely without cleanup.
+class JobSystem {
+public:
+    // Zero workers means one per hardware thread, minus the calling thread
+    explicit JobSystem(int workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void submit(std::function<void()> job);
+
+    // Runs fn(0) .. fn(count - 1) across the workers and the calling thread,
+    // returning once every index has finished
+    void parallelFor(int count, const std::function<void(int)>& fn);
+
+    int getWorkerCount() const { return (int)workers.size(); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    bool stopping;
+};
+
+// Shared pool, created on first use
+JobSystem& getJobSystem();
+
+#endif // JOB_SYSTEM_H
@@ -0,0 +1,165 @@
+#ifndef LEVEL_FORMAT_H
+#define LEVEL_FORMAT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compiled level file (.mhl). The file is a header followed by flat arrays of
+// fixed-size records; every reference is an offset from the start of the file
+// or an index into another array, so it can be mapped and read in place with
+// no pointer fixups. Strings live in one table of NUL-terminated entries.
+// All values are little-endian. Bump LEVEL_VERSION on any layout change.
+// Deliberately free of SDL/GL includes so offline tools can share it.
+
+const uint32_t LEVEL_MAGIC = 0x564C484D; // "MHLV"
+const uint32_t LEVEL_VERSION = 1;
+
+enum LevelSectionId {
+    LEVEL_SECTION_ROOMS,
+    LEVEL_SECTION_DOORS,
+    LEVEL_SECTION_HIDING_SPOTS,
+    LEVEL_SECTION_TASKS,
+    LEVEL_SECTION_PATROL,
+    LEVEL_SECTION_NAV_NODES,
+    LEVEL_SECTION_NAV_EDGES,
+    LEVEL_SECTION_STRINGS,
+    LEVEL_SECTION_COUNT
+};
+
+const uint32_t LEVEL_DOOR_OPEN = 1 << 0;
+
+struct LevelVec3 {
+    float x, y, z;
+};
+
+struct LevelSection {
+    uint32_t offset;   // Bytes from start of file
+    uint32_t count;    // Records (bytes for the string table)
+};
+
+struct LevelHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t fileSize;
+    uint32_t sectionCount;
+    LevelSection sections[LEVEL_SECTION_COUNT];
+};
+
+struct LevelRoom {
+    LevelVec3 position;
+    LevelVec3 size;
+    uint32_t nameOffset;
+};
+
+struct LevelDoor {
+    LevelVec3 position;
+    uint32_t flags;
+    int32_t rooms[2];
+};
+
+struct LevelHidingSpot {
+    LevelVec3 position;
+    float radius;
+    uint32_t typeOffset;
+};
+
+struct LevelTask {
+    LevelVec3 location;
+    float radius;
+    int32_t id;
+    uint32_t descriptionOffset;
+};
+
+// Baked room graph in CSR form: node i owns edges [firstEdge, firstEdge + edgeCount)
+struct LevelNavNode {
+    uint32_t firstEdge;
+    uint32_t edgeCount;
+};
+
+struct LevelNavEdge {
+    uint32_t toRoom;
+    uint32_t door;
+    float cost;        // Centre to centre distance through the door
+};
+
+// Builds the nav arrays from door connectivity. Shared by the compiler and
+// by Mansion when it falls back to the built-in layout.
+void buildLevelNavGraph(const std::vector<LevelRoom>& rooms, const std::vector<LevelDoor>& doors,
+                        std::vector<LevelNavNode>& nodes, std::vector<LevelNavEdge>& edges);
+
+// Read-only view of a compiled level, memory-mapped where the platform allows
+class LevelFile {
+public:
+    LevelFile();
+    ~LevelFile();
+
+    LevelFile(const LevelFile&) = delete;
+    LevelFile& operator=(const LevelFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+
+    uint32_t getRoomCount() const { return count(LEVEL_SECTION_ROOMS); }
+    uint32_t getDoorCount() const { return count(LEVEL_SECTION_DOORS); }
+    uint32_t getHidingSpotCount() const { return count(LEVEL_SECTION_HIDING_SPOTS); }
+    uint32_t getTaskCount() const { return count(LEVEL_SECTION_TASKS); }
+    uint32_t getPatrolPointCount() const { return count(LEVEL_SECTION_PATROL); }
+    uint32_t getNavEdgeCount() const { return count(LEVEL_SECTION_NAV_EDGES); }
+
+    const LevelRoom* getRooms() const { return section<LevelRoom>(LEVEL_SECTION_ROOMS); }
+    const LevelDoor* getDoors() const { return section<LevelDoor>(LEVEL_SECTION_DOORS); }
+    const LevelHidingSpot* getHidingSpots() const { return section<LevelHidingSpot>(LEVEL_SECTION_HIDING_SPOTS); }
+    const LevelTask* getTasks() const { return section<LevelTask>(LEVEL_SECTION_TASKS); }
+    const LevelVec3* getPatrolPoints() const { return section<LevelVec3>(LEVEL_SECTION_PATROL); }
+    const LevelNavNode* getNavNodes() const { return section<LevelNavNode>(LEVEL_SECTION_NAV_NODES); }
+    const LevelNavEdge* getNavEdges() const { return section<LevelNavEdge>(LEVEL_SECTION_NAV_EDGES); }
+
+    const char* getString(uint32_t offset) const;
+
+private:
+    bool validate() const;
+
+    uint32_t count(LevelSectionId id) const { return header()->sections[id].count; }
+
+    template<typename T>
+    const T* section(LevelSectionId id) const {
+        return reinterpret_cast<const T*>(data + header()->sections[id].offset);
+    }
+
+    const LevelHeader* header() const { return reinterpret_cast<const LevelHeader*>(data); }
+
+    const uint8_t* data;
+    size_t size;
+    bool mapped;
+};
+
+// Accumulates records and serializes them into the file layout above
+class LevelBuilder {
+public:
+    LevelBuilder();
+
+    uint32_t addString(const std::string& str);
+
+    void addRoom(const LevelVec3& position, const LevelVec3& size, const std::string& name);
+    void addDoor(const LevelVec3& position, bool open, int roomA, int roomB);
+    void addHidingSpot(const LevelVec3& position, float radius, const std::string& type);
+    void addTask(int id, const LevelVec3& location, float radius, const std::string& description);
+    void addPatrolPoint(const LevelVec3& point);
+
+    size_t getRoomCount() const { return rooms.size(); }
+
+    std::vector<uint8_t> build() const;
+    bool write(const std::string& path) const;
+
+private:
+    std::vector<LevelRoom> rooms;
+    std::vector<LevelDoor> doors;
+    std::vector<LevelHidingSpot> hidingSpots;
+    std::vector<LevelTask> tasks;
+    std::vector<LevelVec3> patrolPoints;
+    std::string strings;
+};
+
+#endif // LEVEL_FORMAT_H
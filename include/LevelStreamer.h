@@ -0,0 +1,151 @@
+#ifndef LEVEL_STREAMER_H
+#define LEVEL_STREAMER_H
+
+#include "Game.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class Mansion;
+class LightmapFile;
+
+// Compact vertex for baked static geometry (24 bytes)
+struct StaticVertex {
+    float position[3];
+    int8_t normal[4];      // Unit normal scaled to +-127, w unused
+    uint8_t color[4];
+    int16_t lightmapUV[2]; // Texels on the chunk's lightmap page
+};
+
+// Surface colours of the chunk geometry; mansion_bake lights the same ones
+const uint8_t STATIC_WALL_COLOR[4] = {89, 71, 56, 255};
+const uint8_t STATIC_DOOR_COLOR[4] = {64, 38, 26, 255};
+
+// Geometry for one chunk, built on a worker thread. Only chunks near the
+// player have one of these, so memory tracks the view, not the map.
+struct ChunkPayload {
+    std::vector<StaticVertex> vertices;
+    std::vector<uint32_t> indices;      // Triangle list
+
+    // Walls of the room plus every door leading out of it
+    struct RoomRange {
+        int room;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+    };
+    std::vector<RoomRange> roomRanges;
+
+    // Checker floors under every room at its own height, after all the room
+    // ranges. They're textured rather than lightmapped, so they're drawn
+    // on their own. floorMin and floorMax bound them.
+    uint32_t floorFirstIndex;
+    uint32_t floorIndexCount;
+    Vector3 floorMin, floorMax;
+
+    // Baked lighting page (RGB8, owned by the LightmapFile); null when the
+    // chunk is lit by the runtime lights alone
+    const uint8_t* lightmap;
+    int lightmapWidth, lightmapHeight;
+
+    uint32_t generation;    // Unique per build so GPU copies can tell when they're stale
+    size_t bytes;
+};
+
+enum class ChunkState {
+    UNLOADED,
+    LOADING,
+    READY,      // Built on a worker, waiting for the main thread to adopt it
+    LOADED
+};
+
+// A group of rooms sharing an XZ grid cell and floor. Membership lists are
+// always resident (they're just indices); the payload is streamed.
+struct LevelChunk {
+    int cellX, cellZ, level;
+    Vector3 boundsMin, boundsMax;
+
+    std::vector<int> rooms;
+    std::vector<int> doors;
+    std::vector<int> hidingSpots;
+
+    std::atomic<ChunkState> state;
+    std::unique_ptr<ChunkPayload> payload;
+    std::unique_ptr<ChunkPayload> pending;   // Handed over from the worker
+    uint32_t lastWantedFrame;
+};
+
+// Partitions the mansion into chunks and keeps the ones around the player
+// loaded: everything within loadRadius cells on the player's floor and the
+// floors either side, plus any room reachable through doorDepth doors. Loads
+// run on the shared JobSystem; eviction is least-recently-wanted once the
+// resident payloads go over the memory budget.
+class LevelStreamer {
+public:
+    explicit LevelStreamer(const Mansion& mansion);
+    ~LevelStreamer();
+
+    // Baked lighting for the chunks; must match the level and outlive the
+    // streamer. Call before build(); a mismatched file is ignored.
+    bool setLightmaps(const LightmapFile* file);
+
+    void build();
+    void update(const Vector3& playerPos);
+
+    // Blocks until every requested load has landed (used at startup so the
+    // first frame isn't empty)
+    void flush();
+
+    bool isChunkLoaded(int chunkIndex) const;
+    bool isPositionLoaded(const Vector3& pos) const;
+    int getChunkIndexAt(const Vector3& pos) const;
+    int getRoomChunk(int roomIndex) const { return roomChunk[roomIndex]; }
+    // Position of the room in its chunk's rooms (and payload roomRanges)
+    int getRoomSlot(int roomIndex) const { return roomSlot[roomIndex]; }
+
+    const std::vector<std::unique_ptr<LevelChunk>>& getChunks() const { return chunks; }
+    // Indices of the LOADED chunks, in no particular order
+    const std::vector<int>& getResidentChunks() const { return residentChunks; }
+
+    void setMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+    size_t getResidentBytes() const { return residentBytes; }
+    int getLoadedChunkCount() const { return loadedChunks; }
+
+private:
+    uint64_t chunkKey(int cellX, int cellZ, int level) const;
+    void collectWanted(const Vector3& playerPos, std::vector<int>& wanted);
+    void requestLoad(int chunkIndex);
+    void adoptFinishedLoads();
+    void evictOverBudget(const std::vector<int>& wanted);
+    size_t estimateBytes(const LevelChunk& chunk) const;
+
+    static std::unique_ptr<ChunkPayload> buildPayload(const Mansion& mansion, const LevelChunk& chunk,
+                                                      const LightmapFile* lightmaps);
+
+    const Mansion& mansion;
+    const LightmapFile* lightmaps;
+
+    std::vector<std::unique_ptr<LevelChunk>> chunks;
+    std::unordered_map<uint64_t, int> chunkLookup;
+    std::vector<int> roomChunk;
+    std::vector<int> roomSlot;
+    std::vector<int> loadingChunks;
+    std::vector<int> residentChunks;
+
+    size_t memoryBudget;
+    size_t residentBytes;
+    int loadedChunks;
+    int loadRadius;
+    int doorDepth;
+    uint32_t frame;
+
+    // Loads still running on workers; the destructor waits for zero
+    std::atomic<int> inFlight;
+    std::mutex inFlightMutex;
+    std::condition_variable inFlightDone;
+};
+
+#endif // LEVEL_STREAMER_H
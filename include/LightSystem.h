@@ -0,0 +1,113 @@
+#ifndef LIGHT_SYSTEM_H
+#define LIGHT_SYSTEM_H
+
+#include "Game.h"
+#include "Frustum.h"
+#include "RenderBackend.h"
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Mansion;
+
+enum class LightFlicker : uint8_t {
+    STEADY,
+    CANDLE,     // Quick shallow wobble
+    BULB        // Steady with the odd brief drop-out
+};
+
+struct PointLight {
+    Vector3 position;
+    float color[3];
+    float radius;           // Lights nothing past this
+    LightFlicker flicker;
+    float phase;            // Keeps neighbouring flames out of step
+};
+
+// Candles, bulbs and anything that moves, clustered by room. Static lights
+// are bucketed once at load into every room their radius reaches; moving
+// ones are bucketed each frame into the room they're in and its neighbours.
+// A draw asks for its room's set and gets the few lights that reach that
+// room strongest, so what a draw costs doesn't grow with the level's lights.
+class LightSystem {
+public:
+    static const int MAX_LIGHTS_PER_SET = MAX_SCENE_LIGHTS;
+
+    LightSystem();
+
+    // Places the level's candles and bulbs; bounds are Renderer's room
+    // bounds. Drops the moving lights, so add those again after.
+    void build(const Mansion& mansion, const BoundsSoA& roomBounds);
+
+    // Moving lights start dark; move them before the frame is submitted
+    int addDynamicLight(const PointLight& light);
+    void moveDynamicLight(int id, const Vector3& position, float intensity);
+
+    // Flicker for this frame; sets are built as they're asked for, so only
+    // the rooms drawn this frame cost anything. Lights
+    // are picked for the part of each room within viewRange of the eye, so
+    // a long hallway isn't lit by candles at its far end.
+    void beginFrame(float seconds, const Vector3& eye, float viewRange);
+
+    // Set ids are room + 1, and 0 is the empty set for outside every room.
+    // Surfaces with the static lights baked in ask for dynamicOnly and get
+    // roomCount + room + 1, the same room without its candles and bulbs.
+    int getRoomSet(int room, bool dynamicOnly = false) const;
+    int getSetAt(const Vector3& position) const;
+    const SceneLight* getSet(int id, int& count);
+    // Whether two sets light the same this frame, so their draws can merge;
+    // most often two lightmapped rooms with no moving light in either
+    bool isSameSet(int first, int second);
+
+    // What mansion_bake lights with: the static lights reaching a room
+    const std::vector<PointLight>& getStaticLights() const { return staticLights; }
+    const uint32_t* getRoomLights(int room, int& count) const;
+
+    int getStaticLightCount() const { return (int)staticLights.size(); }
+    int getDynamicLightCount() const { return (int)dynamicLights.size(); }
+
+private:
+    struct DynamicLight {
+        PointLight light;
+        float intensity;
+    };
+
+    struct RoomSet {
+        int count;
+        SceneLight lights[MAX_LIGHTS_PER_SET];
+    };
+
+    void addStatic(const PointLight& light, int room);
+    void placeDynamic();
+    void addReach(std::vector<std::pair<int, int>>& pairs, const PointLight& light, int room, int index) const;
+    float flickerOf(const PointLight& light) const;
+    void consider(RoomSet& set, float* scores, const PointLight& light, float intensity, const AABB& box) const;
+    // This frame's set for id, built if it hasn't been yet; null for the empty set
+    const RoomSet* findSet(int id);
+
+    const Mansion* mansion;
+    BoundsSoA roomBounds;
+    int roomCount;
+
+    std::vector<PointLight> staticLights;
+    // Static lights reaching each room; flattened into roomStart/roomLights
+    // once everything is placed, roomLights[roomStart[r]..roomStart[r + 1])
+    std::vector<std::pair<int, int>> staticRooms;
+    std::vector<uint32_t> roomStart;
+    std::vector<uint32_t> roomLights;
+
+    std::vector<DynamicLight> dynamicLights;
+    // This frame's (room, dynamic light) pairs, sorted by room
+    std::vector<std::pair<int, int>> dynamicRooms;
+    bool dynamicPlaced;
+
+    // Sets built this frame, and where each id's is
+    std::vector<RoomSet> sets;
+    std::unordered_map<int, uint32_t> setIndex;
+    float time;
+    Vector3 eye;
+    float viewRange;
+};
+
+#endif // LIGHT_SYSTEM_H
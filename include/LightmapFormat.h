@@ -0,0 +1,129 @@
+#ifndef LIGHTMAP_FORMAT_H
+#define LIGHTMAP_FORMAT_H
+
+#include "LevelFormat.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Baked lighting for a level (.mhlm), written by mansion_bake next to the
+// .mhl it was baked from. Laid out like the level file: a header, flat
+// arrays of fixed-size records and raw RGB8 pages, all read in place.
+// There is one page per LevelStreamer chunk; each room has a rectangle on
+// its chunk's page for each of its four walls, and every page has a small
+// block the chunk's doors sample from. Texels hold the surface's final
+// colour under the baked lights, added on top of whatever moves at runtime.
+
+const uint32_t LIGHTMAP_MAGIC = 0x4D4C484D; // "MHLM"
+const uint32_t LIGHTMAP_VERSION = 1;
+
+enum LightmapSectionId {
+    LIGHTMAP_SECTION_ROOMS,
+    LIGHTMAP_SECTION_PAGES,
+    LIGHTMAP_SECTION_TEXELS,
+    LIGHTMAP_SECTION_COUNT
+};
+
+// Inner rectangle in texels; charts have a texel of padding on every side
+struct LightmapRect {
+    uint16_t x, y;
+    uint16_t width, height;
+};
+
+struct LightmapRoom {
+    uint32_t page;
+    LightmapRect walls[4];      // North, south, west, east
+};
+
+struct LightmapPage {
+    uint16_t width, height;
+    uint16_t doorX, doorY;      // Centre of the 2x2 door block
+    uint32_t texelOffset;       // Bytes into the texel section
+};
+
+struct LightmapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t fileSize;
+    uint32_t sectionCount;
+    uint32_t levelHash;         // Of the rooms it was baked for
+    float texelsPerUnit;
+    LevelSection sections[LIGHTMAP_SECTION_COUNT];
+};
+
+// A room's walls as LevelStreamer builds them, in LightmapRoom order.
+// Texel u runs from origin along the wall, v from the floor up; inward
+// points into the room, the only side that's baked.
+struct LightmapWall {
+    LevelVec3 origin;
+    LevelVec3 along;
+    LevelVec3 inward;
+    float length;
+    float height;
+};
+
+void getLightmapWalls(const LevelVec3& position, const LevelVec3& size, LightmapWall walls[4]);
+
+// Folds one room into a level hash; start from LIGHTMAP_HASH_SEED and add
+// every room in order. A lightmap only applies to the level it came from.
+const uint32_t LIGHTMAP_HASH_SEED = 2166136261u;
+uint32_t hashLightmapRoom(uint32_t hash, const LevelVec3& position, const LevelVec3& size);
+
+// The lightmap path that goes with a level path
+std::string getLightmapPath(const std::string& levelPath);
+
+// Read-only view of a baked lightmap file
+class LightmapFile {
+public:
+    LightmapFile();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return !data.empty(); }
+
+    uint32_t getLevelHash() const { return header()->levelHash; }
+    uint32_t getRoomCount() const { return header()->sections[LIGHTMAP_SECTION_ROOMS].count; }
+    uint32_t getPageCount() const { return header()->sections[LIGHTMAP_SECTION_PAGES].count; }
+
+    const LightmapRoom& getRoom(uint32_t index) const { return section<LightmapRoom>(LIGHTMAP_SECTION_ROOMS)[index]; }
+    const LightmapPage& getPage(uint32_t index) const { return section<LightmapPage>(LIGHTMAP_SECTION_PAGES)[index]; }
+    const uint8_t* getTexels(const LightmapPage& page) const {
+        return section<uint8_t>(LIGHTMAP_SECTION_TEXELS) + page.texelOffset;
+    }
+
+    size_t getSize() const { return data.size(); }
+
+private:
+    bool validate() const;
+
+    template<typename T>
+    const T* section(LightmapSectionId id) const {
+        return reinterpret_cast<const T*>(data.data() + header()->sections[id].offset);
+    }
+
+    const LightmapHeader* header() const { return reinterpret_cast<const LightmapHeader*>(data.data()); }
+
+    std::vector<uint8_t> data;
+};
+
+// Accumulates pages and rooms and serializes them into the layout above
+class LightmapBuilder {
+public:
+    LightmapBuilder(uint32_t levelHash, float texelsPerUnit, size_t roomCount);
+
+    // Texels are width * height RGB8, rows bottom up
+    uint32_t addPage(uint16_t width, uint16_t height, uint16_t doorX, uint16_t doorY, const std::vector<uint8_t>& texels);
+    void setRoom(size_t index, const LightmapRoom& room) { rooms[index] = room; }
+
+    std::vector<uint8_t> build() const;
+    bool write(const std::string& path) const;
+
+private:
+    uint32_t levelHash;
+    float texelsPerUnit;
+    std::vector<LightmapRoom> rooms;
+    std::vector<LightmapPage> pages;
+    std::vector<uint8_t> texels;
+};
+
+#endif // LIGHTMAP_FORMAT_H
@@ -3,19 +3,42 @@
 
 #include "Game.h"
 #include "Renderer.h"
+#include "LevelFormat.h"
+#include "MansionGenerator.h"
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 class Mansion {
 public:
     Mansion();
     
-    void initialize();
+    // Loads the compiled level if present, otherwise builds the built-in layout
+    void initialize(const std::string& levelPath);
+    bool loadLevel(const std::string& path);
     
-    std::vector<Room> getRooms() const { return rooms; }
-    std::vector<Door> getDoors() const { return doors; }
-    std::vector<HidingSpot> getHidingSpots() const { return hidingSpots; }
+    // Replaces the layout with a procedurally generated one
+    void generate(const MansionGenParams& params);
+    bool isGenerated() const { return generated; }
+    const std::vector<Task>& getGeneratedTasks() const { return generatedTasks; }
+    
+    Vector3 getPlayerStart() const { return playerStart; }
+    Vector3 getMonsterStart() const { return monsterStart; }
+    
+    const std::vector<Room>& getRooms() const { return rooms; }
+    const std::vector<Door>& getDoors() const { return doors; }
+    const std::vector<HidingSpot>& getHidingSpots() const { return hidingSpots; }
+    
+    // Open while the level came from a compiled file (tasks are read from it)
+    const LevelFile& getLevelFile() const { return levelFile; }
+    
+    // Baked room graph: doors leading out of a room and the rooms they reach
+    const LevelNavEdge* getNavEdges(int roomIndex, uint32_t& count) const;
     
     bool isPlayerInRoom(const Vector3& playerPos, int roomIndex) const;
+    
+    // Room containing a world position (eye height is fine), or -1
+    int findRoomAt(const Vector3& pos) const;
     bool canPlayerMoveTo(const Vector3& from, const Vector3& to) const;
     
     HidingSpot* getNearestHidingSpot(const Vector3& playerPos, float maxDistance);
@@ -27,12 +50,32 @@ private:
     void createRooms();
     void createDoors();
     void createHidingSpots();
+    void createPatrolPoints();
+    void buildNavGraph();
+    void buildRoomGrid();
     
     bool checkCollision(const Vector3& pos, const Vector3& roomPos, const Vector3& roomSize) const;
     
     std::vector<Room> rooms;
     std::vector<Door> doors;
     std::vector<HidingSpot> hidingSpots;
+    std::vector<Vector3> patrolPoints;
+    std::vector<Task> generatedTasks;
+    bool generated;
+    
+    Vector3 playerStart;
+    Vector3 monsterStart;
+    
+    // Nav data points into the mapped file, or into the built arrays below
+    LevelFile levelFile;
+    const LevelNavNode* navNodes;
+    const LevelNavEdge* navEdges;
+    std::vector<LevelNavNode> builtNavNodes;
+    std::vector<LevelNavEdge> builtNavEdges;
+    
+    // Uniform XZ grid over room footprints so position lookups stay cheap
+    // on large generated mansions
+    std::unordered_map<uint64_t, std::vector<int>> roomGrid;
     
     Vector3 mansionSize;
 };
@@ -0,0 +1,49 @@
+#ifndef MANSION_GENERATOR_H
+#define MANSION_GENERATOR_H
+
+#include "Game.h"
+#include "Renderer.h"
+#include <cstdint>
+#include <vector>
+
+struct MansionGenParams {
+    uint32_t seed = 1;
+    int roomCount = 40;   // Total across all wings and floors
+    int floors = 1;
+    int wings = 4;
+};
+
+// Same structures Mansion and TaskSystem use for the hand-built level
+struct GeneratedMansion {
+    std::vector<Room> rooms;
+    std::vector<Door> doors;
+    std::vector<HidingSpot> hidingSpots;
+    std::vector<Task> tasks;
+    std::vector<Vector3> patrolPoints;
+    Vector3 playerStart;
+    Vector3 monsterStart;
+};
+
+// Seeded procedural layout. Each wing is a grid of rooms per floor, built
+// on its own job with an RNG derived only from (seed, wing), then the wings
+// are stitched onto a front corridor in wing order. The same parameters
+// always give the same mansion, whatever the thread count.
+class MansionGenerator {
+public:
+    GeneratedMansion generate(const MansionGenParams& params);
+
+private:
+    struct Wing {
+        std::vector<Room> rooms;
+        std::vector<Door> doors;       // Room indices local to the wing
+        std::vector<HidingSpot> hidingSpots;
+        int entranceRoom;              // Ground floor room facing the corridor
+        float width;
+    };
+
+    Wing generateWing(const MansionGenParams& params, int wingIndex, int roomCount, float originX);
+    void stitch(const MansionGenParams& params, std::vector<Wing>& wings, GeneratedMansion& out);
+    void placeTasksAndPatrol(const MansionGenParams& params, GeneratedMansion& out);
+};
+
+#endif // MANSION_GENERATOR_H
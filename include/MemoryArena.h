@@ -0,0 +1,136 @@
+#ifndef MEMORY_ARENA_H
+#define MEMORY_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include "MemoryTracker.h"
+
+// Bump allocator over one fixed block. Allocation is a pointer bump and
+// reset() just rewinds the offset, so nothing allocated here is ever freed
+// individually. If the block runs out, requests spill to the heap and are
+// released on the next reset (with a one-time warning so the size can be tuned).
+class LinearArena {
+public:
+    explicit LinearArena(size_t capacity, MemTag tag = MemTag::ARENA);
+    ~LinearArena();
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template<typename T>
+    T* allocArray(size_t count) {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void reset();
+
+    // Markers let a caller free everything allocated after a point
+    size_t getMarker() const { return offset; }
+    void rewind(size_t marker);
+
+    size_t getUsed() const { return offset; }
+    size_t getCapacity() const { return capacity; }
+    size_t getPeak() const { return peak; }
+
+private:
+    void releaseOverflow();
+
+    uint8_t* buffer;
+    size_t capacity;
+    size_t offset;
+    size_t peak;
+
+    std::vector<void*> overflow;
+    bool overflowWarned;
+    MemTag tag;
+};
+
+// Double-buffered per-frame arena. Memory handed out during frame N stays
+// valid until beginFrame() is called for frame N+2, so a renderer that lags
+// one frame behind the simulation can still read last frame's data.
+// Main thread only - worker jobs use the thread-local scratch stack instead.
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacityPerFrame);
+
+    void beginFrame();
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        return arenas[current].allocate(size, alignment);
+    }
+
+    template<typename T>
+    T* allocArray(size_t count) { return arenas[current].allocArray<T>(count); }
+
+    LinearArena& getCurrent() { return arenas[current]; }
+    LinearArena& getPrevious() { return arenas[current ^ 1]; }
+
+private:
+    LinearArena arenas[2];
+    int current;
+};
+
+// Per-thread stack allocator for short-lived job data. Wrap use in a
+// ScratchScope so everything is popped when the job returns.
+LinearArena& getThreadScratch();
+
+class ScratchScope {
+public:
+    ScratchScope() : arena(getThreadScratch()), marker(arena.getMarker()) {}
+    ~ScratchScope() { arena.rewind(marker); }
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+
+    LinearArena& getArena() { return arena; }
+
+private:
+    LinearArena& arena;
+    size_t marker;
+};
+
+// Process-wide frame arena, reset by Game::run at the top of every frame
+FrameArena& getFrameArena();
+
+// STL adaptor so standard containers can live in an arena. deallocate() is a
+// no-op; the memory comes back when the arena is reset or rewound.
+template<typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.getArena()) {}
+
+    T* allocate(size_t count) { return arena->allocArray<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    LinearArena* getArena() const { return arena; }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.getArena(); }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.getArena(); }
+
+private:
+    LinearArena* arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Convenience for the common case of a vector that only lives for this frame
+template<typename T>
+ArenaVector<T> makeFrameVector(size_t reserve = 0) {
+    ArenaVector<T> vec{ArenaAllocator<T>(getFrameArena().getCurrent())};
+    if (reserve > 0) vec.reserve(reserve);
+    return vec;
+}
+
+#endif // MEMORY_ARENA_H
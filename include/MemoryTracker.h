@@ -0,0 +1,68 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Subsystems that memory is charged to. Keep getMemTagName() in sync.
+enum class MemTag : uint8_t {
+    GENERAL,
+    RENDERER,
+    MONSTER,
+    MANSION,
+    AUDIO,
+    MENU,
+    TASKS,
+    PLAYER,
+    INPUT,
+    PARTICLES,
+    ARENA,
+    COUNT
+};
+
+const char* getMemTagName(MemTag tag);
+
+// Per-subsystem memory accounting. With MANSION_MEMORY_TRACKING defined the
+// global operator new/delete are replaced, and every heap allocation is
+// charged to the tag of the innermost MemTagScope on the allocating thread.
+// Memory that doesn't go through operator new (GL buffers, audio device
+// buffers) can be charged by hand with recordAlloc/recordFree.
+class MemoryTracker {
+public:
+    void recordAlloc(MemTag tag, size_t bytes);
+    void recordFree(MemTag tag, size_t bytes);
+
+    // Zero means no budget
+    void setBudget(MemTag tag, size_t bytes);
+    size_t getBudget(MemTag tag) const;
+
+    size_t getLiveBytes(MemTag tag) const;
+    size_t getPeakBytes(MemTag tag) const;
+    size_t getTotalLiveBytes() const;
+    float getAllocRate(MemTag tag) const; // Allocations per second
+
+    // Call once per frame: refreshes allocation rates and warns on budgets
+    void update(float deltaTime);
+
+    void dumpReport(std::ostream& out) const;
+};
+
+MemoryTracker& getMemoryTracker();
+
+// Sets the tag charged by allocations on this thread until destroyed
+class MemTagScope {
+public:
+    explicit MemTagScope(MemTag tag);
+    ~MemTagScope();
+
+    MemTagScope(const MemTagScope&) = delete;
+    MemTagScope& operator=(const MemTagScope&) = delete;
+
+private:
+    MemTag previous;
+};
+
+MemTag getCurrentMemTag();
+
+#endif // MEMORY_TRACKER_H
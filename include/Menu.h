@@ -2,6 +2,7 @@
 #define MENU_H
 
 #include "Game.h"
+#include "Batch2D.h"
 #include <string>
 #include <vector>
 #include <functional>
@@ -29,6 +30,9 @@ public:
     void update(const InputHandler& input);
     void render(Renderer& renderer);
     
+    // Needs the context current
+    void cleanup();
+    
     void setMenuType(MenuType type);
     MenuType getMenuType() const { return currentMenu; }
     
@@ -42,7 +46,18 @@ private:
     void setupGameOverMenu();
     void setupVictoryMenu();
     
-    void renderButton(const MenuButton& button, float baseR, float baseG, float baseB);
+    // Button face with the hover highlight; the pulse comes from animateButtons
+    struct ButtonFace {
+        Batch2D::Range range;
+        Color2D color;
+        bool hovered;
+    };
+    
+    // The render* functions lay out the batch only when layoutDirty is set and
+    // otherwise just update what animates
+    void renderButton(Renderer& renderer, const MenuButton& button, float baseR, float baseG, float baseB);
+    void animateButtons();
+    Batch2D::Range addTitle(Renderer& renderer, const std::string& text, int y, const Color2D& color, int scale);
     void renderMainMenu(Renderer& renderer);
     void renderPauseMenu(Renderer& renderer);
     void renderControlSelect(Renderer& renderer);
@@ -57,6 +72,13 @@ private:
     
     int screenWidth;
     int screenHeight;
+    
+    // Retained between frames; rebuilt on menu or hover change
+    Batch2D batch;
+    bool layoutDirty;
+    Batch2D::Range backdrop;
+    Batch2D::Range titleText;
+    std::vector<ButtonFace> buttonFaces;
 };
 
 #endif // MENU_H
@@ -18,7 +18,12 @@ public:
     
     void update(float deltaTime, const Vector3& playerPos, bool playerHiding);
     
+    // Cheap stand-in while the monster is in a chunk that isn't streamed in:
+    // no perception, and movement is stepped a few times a second
+    void updateCoarse(float deltaTime);
+    
     Vector3 getPosition() const { return position; }
+    Vector3 getVelocity() const { return velocity; }
     MonsterState getState() const { return state; }
     
     bool canSeePlayer(const Vector3& playerPos, bool playerHiding);
@@ -60,6 +65,8 @@ private:
     float patrolWaitTime;
     float patrolWaitTimer;
     
+    float coarseAccumulator;
+    
     std::mt19937 rng;
 };
 
@@ -0,0 +1,119 @@
+#ifndef MONSTER_ANIMATION_H
+#define MONSTER_ANIMATION_H
+
+#include "Game.h"
+#include "Frustum.h"
+#include "Monster.h"
+#include <cstdint>
+#include <vector>
+
+struct SkinnedVertex;
+
+// Pelvis, spine, chest, head, then arms and legs; a multiple of four so the
+// pose is sampled four bones at a time
+const int MONSTER_BONE_COUNT = 12;
+const int MONSTER_HEAD_BONE = 3;
+
+enum class MonsterClip {
+    IDLE,
+    WALK,       // Patrolling and searching on the move
+    SEARCH,     // Standing and looking around
+    RUN,        // Chasing
+    ATTACK,
+    COUNT
+};
+
+// Skeletal animation for every monster in the level. Clips are baked once at
+// startup from the authored poses into int16 keys, 30 a second: each bone's
+// rotation is a unit quaternion with w kept positive, so only x, y and z are
+// stored, and the root's rise is one more key. Keys are laid out frame by
+// frame with each component's bones side by side, so sampling decodes,
+// interpolates and blends four bones per instruction. Each monster crossfades
+// from its last clip to the one its state and speed pick, and update walks
+// every instance in blocks across the JobSystem, leaving a matrix palette per
+// monster. skin applies a palette to the bind-pose mesh on the CPU, so
+// nothing here needs a GPU.
+class MonsterAnimation {
+public:
+    MonsterAnimation();
+
+    // Index of the new monster, in the bind pose at position until the next update
+    int addInstance(const Vector3& position);
+    void clear();
+    int getInstanceCount() const { return (int)instances.size(); }
+
+    // Where the monster is and what it's doing this frame; the clip follows
+    // the state and the speed, and the body turns towards where it's going
+    void setTarget(int instance, MonsterState state, const Vector3& position, const Vector3& velocity);
+
+    // Advances, samples and blends every monster and rebuilds its palette
+    void update(float deltaTime);
+
+    // World-space bone matrices times the inverse bind pose, column-major,
+    // MONSTER_BONE_COUNT of them
+    const float* getPalette(int instance) const { return &palettes[(size_t)instance * MONSTER_BONE_COUNT * 16]; }
+    // A point given in the bind pose, carried along by one bone
+    Vector3 transformPoint(int instance, int bone, const Vector3& bindPoint) const;
+    // Around the posed body as of the last update
+    const AABB& getBounds(int instance) const { return bounds[instance]; }
+    MonsterClip getClip(int instance) const { return instances[instance].clip; }
+
+    // Vertices per monster in the bind-pose mesh, as triangles
+    size_t getVertexCount() const { return mesh.size(); }
+    // Writes getVertexCount() world-space vertices posed by the palette
+    void skin(int instance, SkinnedVertex* out) const;
+
+    // Quantized key data for all clips
+    size_t getClipBytes() const;
+    static const char* getClipName(MonsterClip clip);
+
+private:
+    struct Clip {
+        float duration;     // Seconds a cycle takes at the natural speed
+        float stride;       // Metres a cycle covers, 0 for clips played in place
+        uint32_t frames;
+        // Frame by frame: x, y then z, each MONSTER_BONE_COUNT bones wide
+        std::vector<int16_t> rotations;
+        std::vector<int16_t> rise;
+    };
+
+    struct Instance {
+        MonsterState state;
+        Vector3 position;
+        Vector3 velocity;
+        float heading;      // Radians about y, 0 facing +z
+
+        MonsterClip clip;
+        MonsterClip previous;
+        float phase;        // Through the cycle, [0, 1)
+        float previousPhase;
+        float blend;        // Weight of clip, the rest is previous
+        float blendRate;
+    };
+
+    struct MeshVertex {
+        float position[4];  // w is 1
+        float normal[4];    // w is 0
+        // A bone's palette entry, or past MONSTER_BONE_COUNT, the blend of
+        // bone and parent its joint end uses
+        uint32_t matrix;
+        uint8_t color[4];
+    };
+
+    void bakeClips();
+    void buildMesh();
+    MonsterClip pickClip(const Instance& instance) const;
+    void advance(Instance& instance, float deltaTime);
+    // Adds the clip's rotations at phase, times weight, to the accumulators;
+    // returns its rise times weight
+    float sample(const Clip& clip, float phase, float weight, float* x, float* y, float* z, float* w) const;
+    void evaluate(int instance);
+
+    Clip clips[(int)MonsterClip::COUNT];
+    std::vector<Instance> instances;
+    std::vector<float> palettes;
+    std::vector<AABB> bounds;
+    std::vector<MeshVertex> mesh;
+};
+
+#endif // MONSTER_ANIMATION_H
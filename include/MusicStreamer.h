@@ -0,0 +1,170 @@
+#ifndef MUSIC_STREAMER_H
+#define MUSIC_STREAMER_H
+
+#include "SpscQueue.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pulls frames out of a RIFF WAVE file a chunk at a time, whatever its
+// layout: 8, 16, 24 or 32-bit PCM or 32-bit float, mono or more channels.
+// Output is always interleaved stereo float; mono is copied to both sides
+// and channels past the second are ignored.
+class WavReader {
+public:
+    WavReader();
+    ~WavReader();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    // Up to frames frames; fewer only at the end of the data
+    int read(float* out, int frames);
+    // Back to the first frame, for looping
+    bool rewind();
+
+    int getSampleRate() const { return sampleRate; }
+    uint32_t getFrameCount() const { return frameCount; }
+
+private:
+    FILE* file;
+    int channels;
+    int bits;
+    bool isFloat;
+    int sampleRate;
+    int blockAlign;
+    long dataOffset;
+    uint32_t frameCount;
+    uint32_t framesLeft;
+    std::vector<uint8_t> raw;
+};
+
+// Stereo float frames from one producer thread to one consumer thread, read
+// and written in bulk. reset is only safe while neither side is using it.
+class StreamRing {
+public:
+    StreamRing();
+
+    // Capacity in frames; has to be a power of two
+    void allocate(uint32_t frames);
+    void reset();
+
+    uint32_t getReadable() const;
+    uint32_t getWritable() const;
+
+    // Producer; count must fit in getWritable
+    void write(const float* frames, uint32_t count);
+    // Consumer; returns how many it got
+    uint32_t read(float* frames, uint32_t count);
+
+private:
+    std::vector<float> data;
+    uint32_t mask;
+    alignas(64) std::atomic<uint32_t> writeIndex;
+    alignas(64) std::atomic<uint32_t> readIndex;
+};
+
+const int MUSIC_DECKS = 2;
+
+// Music streamed from disk instead of decoded whole. A background I/O thread
+// decodes each playing track a chunk at a time, resamples it to the device
+// rate and keeps a fixed ring about a second and a half ahead of the mixer,
+// so memory is the same for a ten second sting or an hour of ambience.
+// Looping rewinds inside the chunk being decoded, so there's no gap. Two
+// decks let one track fade out while the next fades in. The game thread
+// only pushes commands; the mixer thread only reads the rings.
+class MusicStreamer {
+public:
+    MusicStreamer();
+    ~MusicStreamer();
+
+    // Starts the I/O thread, resampling everything to sampleRate
+    bool start(int sampleRate);
+    void stop();
+    // The device's rate once it's open; the streamer starts before the
+    // mixer, so it can't wait for it. Only safe before anything plays.
+    void setSampleRate(int rate) { sampleRate.store(rate, std::memory_order_relaxed); }
+
+    // Game thread. play crossfades from whatever is playing over
+    // fadeSeconds; a missing file is reported once and then stays silent.
+    // Both are false, and reported, if the command queue was full.
+    bool play(const std::string& path, bool loop, float fadeSeconds);
+    bool fadeOut(float fadeSeconds);
+
+    // Mixer thread: adds every playing deck into left and right
+    void mix(float* left, float* right, int frames, float volume);
+
+    uint64_t getUnderruns() const { return underruns.load(std::memory_order_relaxed); }
+    // Everything the streamer holds, which doesn't change with the tracks
+    size_t getBufferBytes() const;
+
+private:
+    enum DeckState {
+        DECK_IDLE,
+        DECK_PLAYING,
+        DECK_STOPPING
+    };
+
+    struct Deck {
+        StreamRing ring;
+        // Written by the I/O thread; the mixer moves STOPPING, or an
+        // ended track, back to IDLE once it's silent
+        std::atomic<int> state;
+        std::atomic<float> fadeSeconds;
+        std::atomic<bool> ended;
+
+        // I/O thread
+        WavReader reader;
+        bool loop;
+        double phase;
+        float previous[2];
+
+        // Mixer thread
+        bool active;
+        float gain;
+    };
+
+    enum class CommandType : uint8_t {
+        PLAY,
+        FADE_OUT
+    };
+
+    struct Command {
+        CommandType type;
+        bool loop;
+        float fadeSeconds;
+        char path[256];
+    };
+
+    void run();
+    void apply(const Command& command);
+    void openPending();
+    void fill(Deck& deck);
+    // Source frames into interleaved stereo, rewinding at the end if looping
+    int decode(Deck& deck, float* out, int frames);
+
+    SpscQueue<Command, 16> commands;
+    Deck decks[MUSIC_DECKS];
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<int> sampleRate;
+
+    // I/O thread
+    int current;                // Deck the latest play went to, -1 for none
+    bool hasPending;            // A play waiting for its deck to go idle
+    Command pending;
+    std::vector<float> decoded;
+    std::vector<float> resampled;
+    std::set<std::string> missing;
+
+    // Mixer thread
+    std::vector<float> block;
+    std::atomic<uint64_t> underruns;
+};
+
+#endif // MUSIC_STREAMER_H
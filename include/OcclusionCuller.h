@@ -0,0 +1,103 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include "Game.h"
+#include "Frustum.h"
+#include <vector>
+
+class Mansion;
+class LevelStreamer;
+class PortalCuller;
+
+// Software occlusion culling against the mansion's walls. Each frame the
+// nearest walls in view are rasterised into a small depth buffer that stores
+// 1 / view depth, nearest wins. The screen is split into tiles: triangles
+// are binned on the calling thread, then every tile is filled on the
+// JobSystem four pixels at a time. A box is hidden when every pixel its
+// screen rectangle touches holds a wall nearer than the box's nearest corner.
+class OcclusionCuller {
+public:
+    static const int WIDTH = 256;
+    static const int HEIGHT = 144;
+    static const int TILE_WIDTH = 64;
+    static const int TILE_HEIGHT = 48;
+    static const int TILES_X = WIDTH / TILE_WIDTH;
+    static const int TILES_Y = HEIGHT / TILE_HEIGHT;
+    static const int MAX_OCCLUDERS = 128;
+
+    struct Occluder {
+        Vector3 corners[4];
+    };
+
+    OcclusionCuller();
+
+    // Every wall of every room, with the doorways cut out so nothing seen
+    // through a door is ever hidden by the wall around it
+    void build(const Mansion& mansion);
+
+    void setEnabled(bool enable) { enabled = enable; }
+    bool isEnabled() const { return enabled; }
+
+    // Until the next render, everything is visible
+    void invalidate() { ready = false; }
+
+    // Rasterises walls of the rooms the portals see, or of every resident
+    // room when the camera is outside them all, that pass the frustum,
+    // nearest first; the camera is the one Renderer::setCamera sets up
+    void render(const Vector3& eye, float yaw, float pitch, float fovY, float aspect, float nearPlane,
+                const Frustum& frustum, const LevelStreamer& streamer, const PortalCuller& culler);
+
+    bool isVisible(const AABB& box);
+
+    // Filters indices into bounds down to the unoccluded ones; returns the
+    // count written to visible (which may alias indices)
+    int cull(const BoundsSoA& bounds, const int* indices, int count, int* visible);
+
+    int getOccluderCount() const { return (int)occluders.size(); }
+    // Wall pieces and the room each belongs to, for tools that trace against them
+    const Occluder& getOccluder(int index) const { return occluders[index]; }
+    int getOccluderRoom(int index) const { return occluderRooms[index]; }
+    int getRasterisedCount() const { return rasterised; }
+    int getTestedCount() const { return tested; }
+    int getCulledCount() const { return culled; }
+
+private:
+    // Screen-space triangle as three edge functions and a depth plane, all
+    // in pixels: inside where every edge is >= 0
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, minY, maxX, maxY;
+    };
+
+    void addWall(const Vector3& start, const Vector3& end, float bottom, float top,
+                 const std::vector<Vector3>& doorways, bool alongX);
+    Vector3 toView(const Vector3& p) const;
+    void project(const Vector3& view, float& x, float& y) const;
+    void setupTriangle(const Vector3& a, const Vector3& b, const Vector3& c);
+    void rasteriseTile(int tile);
+
+    std::vector<Occluder> occluders;
+    BoundsSoA occluderBounds;
+    std::vector<int> occluderRooms;
+    // Room r's walls are occluders roomFirstOccluder[r] up to roomFirstOccluder[r + 1]
+    std::vector<int> roomFirstOccluder;
+    std::vector<int> candidates;
+
+    std::vector<Triangle> triangles;
+    std::vector<int> bins[TILES_X * TILES_Y];
+    std::vector<float> depth;
+
+    Vector3 eye;
+    float cosYaw, sinYaw, cosPitch, sinPitch;
+    float projX, projY;
+    float nearPlane;
+
+    bool enabled;
+    bool ready;
+    int rasterised;
+    int tested;
+    int culled;
+};
+
+#endif // OCCLUSION_CULLER_H
@@ -0,0 +1,99 @@
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+#include "Game.h"
+#include <cstdint>
+#include <vector>
+
+struct AABB;
+struct BillboardData;
+class Frustum;
+
+enum class ParticleType {
+    DUST,       // Motes hanging in the air around the player
+    MIST,       // Slow, faint puffs along the floor
+    BREATH,     // The player's breath in the cold
+    BLOOD,      // Droplets that fall and stay where they land
+    COUNT
+};
+
+// Fixed behaviour and look of one type
+struct ParticleTypeDesc {
+    uint32_t capacity;      // Multiple of four
+    float gravity;          // Metres per second squared, up is positive
+    float drag;             // Velocity lost per second, exponential
+    float minLife;
+    float maxLife;
+    float startSize;        // Billboard width in metres, lerped over the life
+    float endSize;
+    uint8_t color[4];
+    float fadeIn;           // Fractions of the life spent fading in and out
+    float fadeOut;
+    bool landOnFloor;       // Stops dead at the floor it was emitted over
+};
+
+// Dust, mist, breath and blood for the whole game, up to 100k live at once.
+// Each type has its own pool: fixed-capacity structure-of-arrays storage,
+// so the per-frame kernels (integrate, then retire the dead, then cull and
+// expand to billboards) walk contiguous floats four lanes at a time. A full
+// pool turns emits away rather than growing, which keeps both memory and
+// frame cost flat however busy a scene gets.
+class ParticleSystem {
+public:
+    ParticleSystem();
+
+    // Keeps the ambient dust and mist topped up in the room around the eye
+    // (none outside), puffs breath ahead of it, then steps every particle.
+    // Breath comes quicker while the player is out of breath.
+    void update(float deltaTime, const Vector3& eye, float yaw, const AABB* room, bool exhausted);
+
+    // Count particles at position, each displaced up to jitter metres and
+    // sent off at velocity plus up to spread metres per second. Landing
+    // types stop at floorHeight. Returns how many the pool had room for.
+    int emit(ParticleType type, const Vector3& position, const Vector3& velocity, float spread, float jitter,
+             float floorHeight, int count);
+
+    void clear();
+
+    // Writes a billboard for every live particle inside the frustum, faded
+    // and sized by age; returns how many. Out needs room for getCapacity().
+    size_t buildBillboards(const Frustum& frustum, BillboardData* out) const;
+
+    size_t getLiveCount() const;
+    size_t getLiveCount(ParticleType type) const { return pools[(int)type].count; }
+    size_t getCapacity() const;
+    // Emits turned away by full pools since the last clear
+    size_t getDropped() const { return dropped; }
+
+    static const ParticleTypeDesc& getDesc(ParticleType type);
+
+private:
+    struct Pool {
+        std::vector<float> posX, posY, posZ;
+        std::vector<float> velX, velY, velZ;
+        std::vector<float> age, life;
+        std::vector<float> floor;
+        uint32_t count;
+    };
+
+    void integrate(Pool& pool, const ParticleTypeDesc& desc, float deltaTime);
+    void retire(Pool& pool);
+    size_t expand(const Pool& pool, const ParticleTypeDesc& desc, const Frustum& frustum, BillboardData* out) const;
+    // Indices in [first, end) within radius of the frustum, in order
+    uint32_t cull(const Pool& pool, uint32_t first, uint32_t end, float radius, const Frustum& frustum,
+                  uint32_t* visible) const;
+    void emitAmbient(float deltaTime, const Vector3& eye, const AABB& room);
+
+    float random();
+
+    Pool pools[(int)ParticleType::COUNT];
+    uint32_t seed;
+    size_t dropped;
+
+    // Fractional emits carried over so low rates still come out right
+    float dustOwed;
+    float mistOwed;
+    float breathTimer;
+};
+
+#endif // PARTICLE_SYSTEM_H
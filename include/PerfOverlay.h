@@ -0,0 +1,65 @@
+#ifndef PERF_OVERLAY_H
+#define PERF_OVERLAY_H
+
+#include "Batch2D.h"
+#include "RenderBackend.h"
+
+class TextRenderer;
+
+// CPU timings, sim time and GL counters for the last frames, in a panel at
+// the top right with a rolling frame-time graph. Numbers are averaged and
+// the text rebuilt a few times a second so it stays readable; in between
+// only the newest graph bar and the cursor are touched.
+class PerfOverlay {
+public:
+    static const int HISTORY = 120;
+    static const int REFRESH_FRAMES = 15;
+
+    PerfOverlay();
+
+    // Bars aren't kept up while hidden, so showing rebuilds the panel
+    void setVisible(bool show) { visible = show; dirty = true; }
+    void toggle() { setVisible(!visible); }
+    bool isVisible() const { return visible; }
+
+    // One finished frame: its CPU time, the simulation's share of it, the
+    // scale its 3D was drawn at, and what it sent to the backend
+    void addFrame(float cpuMs, float simMs, float resolutionScale, const RenderCounters& frame);
+
+    // Brings the batch up to date for a screen this wide
+    void update(TextRenderer& text, int screenWidth);
+
+    Batch2D& getBatch() { return batch; }
+    void release() { batch.release(); }
+
+private:
+    void build(TextRenderer& text);
+    void placeBar(int slot);
+
+    bool visible;
+
+    float frameTimes[HISTORY];
+    int cursor;
+    int filled;
+
+    // Sums since the last text refresh
+    int pendingFrames;
+    float cpuSum;
+    float simSum;
+    float scaleSum;
+    RenderCounters counterSum;
+
+    // Averages shown in the text
+    float shownCpu;
+    float shownSim;
+    float shownScale;
+    RenderCounters shown;
+
+    Batch2D batch;
+    bool dirty;
+    int panelX;
+    Batch2D::Range bars;
+    Batch2D::Range cursorBar;
+};
+
+#endif // PERF_OVERLAY_H
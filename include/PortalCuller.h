@@ -0,0 +1,68 @@
+#ifndef PORTAL_CULLER_H
+#define PORTAL_CULLER_H
+
+#include "Game.h"
+#include <cstdint>
+#include <vector>
+
+class Mansion;
+
+// Room visibility through door portals. Starting from the camera's room, each
+// open door is projected to a screen rectangle and clipped against the
+// rectangle it was seen through; rooms behind a non-empty rectangle are
+// visible and are walked in turn. Cost follows what can be seen, not how big
+// the mansion is.
+class PortalCuller {
+public:
+    explicit PortalCuller(const Mansion& mansion);
+
+    // Camera as set up by Renderer::setCamera and setupPerspective
+    void update(const Vector3& eye, float yaw, float pitch, float fovY, float aspect, float nearPlane, float farPlane);
+
+    bool isRoomVisible(int roomIndex) const;
+    bool isPointVisible(const Vector3& pos) const;
+
+    // Camera outside every room: nothing to cull against, draw everything
+    bool isEverythingVisible() const { return cameraRoom < 0; }
+
+    const std::vector<int>& getVisibleRooms() const { return visibleRooms; }
+    const std::vector<int>& getVisibleDoors() const { return visibleDoors; }
+    int getPortalsTested() const { return portalsTested; }
+
+private:
+    // Screen rectangle in normalised device coordinates
+    struct ScreenRect {
+        float minX, minY, maxX, maxY;
+
+        bool isEmpty() const { return minX >= maxX || minY >= maxY; }
+        bool contains(const ScreenRect& other) const {
+            return other.minX >= minX && other.minY >= minY && other.maxX <= maxX && other.maxY <= maxY;
+        }
+    };
+
+    void visit(int room, const ScreenRect& rect, int depth);
+    bool projectPortal(int door, int fromRoom, ScreenRect& out) const;
+    Vector3 toView(const Vector3& p) const;
+    void markRoom(int room);
+
+    const Mansion& mansion;
+
+    // Camera
+    Vector3 eye;
+    float cosYaw, sinYaw, cosPitch, sinPitch;
+    float projX, projY, nearPlane, farPlane;
+
+    int cameraRoom;
+    uint32_t frame;
+
+    std::vector<uint32_t> roomFrame;
+    std::vector<uint32_t> doorFrame;
+    std::vector<ScreenRect> roomRect;    // Union of rectangles a room was entered through
+    std::vector<uint8_t> onStack;
+
+    std::vector<int> visibleRooms;
+    std::vector<int> visibleDoors;
+    int portalsTested;
+};
+
+#endif // PORTAL_CULLER_H
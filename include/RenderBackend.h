@@ -0,0 +1,190 @@
+#ifndef RENDER_BACKEND_H
+#define RENDER_BACKEND_H
+
+#include "Game.h"
+#include "RenderQueue.h"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+
+class Batch2D;
+class LevelStreamer;
+
+// Fixed for the renderer's lifetime
+struct RenderSettings {
+    int screenWidth;
+    int screenHeight;
+    float ambientLight;
+    bool fogEnabled;
+    float fogDensity;
+    float fogColor[3];
+};
+
+struct CameraSetup {
+    Vector3 position;
+    float yaw;
+    float pitch;
+    float fieldOfView;
+    float aspect;
+    float nearPlane;
+    float farPlane;
+    bool flashlight;        // Spotlight along the view
+};
+
+// Point lights per lit draw: GL_LIGHT1 to 7, as GL_LIGHT0 is the flashlight
+const int MAX_SCENE_LIGHTS = 7;
+
+// Brightness at distance d is 1 / (1 + falloff * d^2 / radius^2), about
+// 1/16 at the radius
+const float SCENE_LIGHT_FALLOFF = 15.0f;
+
+// A point light as the backend sets it, colour already scaled by this
+// frame's flicker
+struct SceneLight {
+    float position[3];
+    float color[3];
+    float radius;
+};
+
+// Calls that reached the backend, summed since the last resetCounters
+struct RenderCounters {
+    int frames;
+    int materialChanges;
+    int lightChanges;       // Light sets switched between lit draws
+    int drawCalls;
+    int instances;          // Instanced copies, points and billboards
+    int stateChanges;       // Enables, depth mask and projection switches made
+    int programBinds;       // Shader permutations switched
+    int matrixLoads;        // Projection and modelview matrices replaced
+    int textureBinds;
+    uint64_t indices;       // Static geometry indices submitted
+    uint64_t vertices;      // Every vertex submitted, 3D and 2D
+};
+
+// What happened between two readings of the same counters
+RenderCounters operator-(const RenderCounters& end, const RenderCounters& start);
+
+// Everything the renderer asks of the graphics API, in renderer terms.
+// Renderer decides what is drawn and in which order; the backend turns that
+// into GL calls, a log of the calls, or just a count. The last two need no
+// context, so culling and submission can be timed without a display.
+class RenderBackend {
+public:
+    RenderBackend();
+    virtual ~RenderBackend() {}
+
+    virtual void initialize(const RenderSettings& settings) = 0;
+    virtual void release() = 0;
+
+    // Frees whatever the backend holds for chunks the streamer dropped
+    virtual void releaseEvicted(const LevelStreamer& streamer) = 0;
+
+    // Time drives the marker pulse, in radians
+    virtual void beginFrame(float animationTime) = 0;
+    virtual void endFrame() = 0;
+    virtual void setCamera(const CameraSetup& camera) = 0;
+
+    // The 3D drawn between these lands in a target scale times the window
+    // size, which endScene stretches over the whole window. A backend that
+    // can't render offscreen draws straight to the window at full size.
+    virtual void beginScene(float scale) = 0;
+    virtual void endScene() = 0;
+
+    virtual void setMaterial(RenderMaterial material, bool lit, bool blended) = 0;
+    // Point lights for the lit draws that follow, on top of the flashlight;
+    // at most MAX_SCENE_LIGHTS
+    virtual void setLights(const SceneLight* lights, int count) = 0;
+    // A chunk's floor range, in the ground's checker
+    virtual void drawGround(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) = 0;
+    virtual void beginChunks() = 0;
+    virtual void drawChunkRange(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) = 0;
+    virtual void endChunks() = 0;
+    virtual void drawInstances(InstanceMesh mesh, const InstanceData* instances, size_t count, bool lit, bool animated) = 0;
+    virtual void drawPoints(const ScenePoint* points, size_t count, float size) = 0;
+    // Camera-facing quads, two triangles each
+    virtual void drawBillboards(const BillboardData* billboards, size_t count) = 0;
+    // Triangles posed on the CPU, in the current material
+    virtual void drawSkinned(const SkinnedVertex* vertices, size_t count) = 0;
+
+    // Screen-space batch over whatever was drawn so far
+    virtual void drawBatch(Batch2D& batch) = 0;
+
+    virtual const RenderCounters& getCounters() const { return counters; }
+    virtual void resetCounters();
+
+protected:
+    RenderCounters counters;
+};
+
+// Draws nothing and only keeps the counters. Mesh sizes it can't see, like
+// the instanced meshes', count as zero vertices.
+class NullRenderBackend : public RenderBackend {
+public:
+    void initialize(const RenderSettings& settings) override {}
+    void release() override {}
+
+    void releaseEvicted(const LevelStreamer& streamer) override {}
+
+    void beginFrame(float animationTime) override { counters.frames++; }
+    void endFrame() override {}
+    void setCamera(const CameraSetup& camera) override { counters.matrixLoads++; }
+
+    void beginScene(float scale) override {}
+    void endScene() override {}
+
+    void setMaterial(RenderMaterial material, bool lit, bool blended) override { counters.materialChanges++; }
+    void setLights(const SceneLight* lights, int count) override { counters.lightChanges++; }
+    void drawGround(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) override;
+    void beginChunks() override {}
+    void drawChunkRange(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) override;
+    void endChunks() override {}
+    void drawInstances(InstanceMesh mesh, const InstanceData* instances, size_t count, bool lit, bool animated) override;
+    void drawPoints(const ScenePoint* points, size_t count, float size) override;
+    void drawBillboards(const BillboardData* billboards, size_t count) override;
+    void drawSkinned(const SkinnedVertex* vertices, size_t count) override;
+    void drawBatch(Batch2D& batch) override;
+};
+
+// Writes one text line per call to a file, then passes the call on to the
+// wrapped backend, or to a null one when nothing is wrapped. Logs of the same
+// run diff cleanly, so a change in draw count or order shows up line by line.
+class RecordingRenderBackend : public RenderBackend {
+public:
+    RecordingRenderBackend(const std::string& path, std::unique_ptr<RenderBackend> inner);
+
+    bool isOpen() const { return out.is_open(); }
+
+    void initialize(const RenderSettings& settings) override;
+    void release() override;
+
+    void releaseEvicted(const LevelStreamer& streamer) override;
+
+    void beginFrame(float animationTime) override;
+    void endFrame() override;
+    void setCamera(const CameraSetup& camera) override;
+
+    void beginScene(float scale) override;
+    void endScene() override;
+
+    void setMaterial(RenderMaterial material, bool lit, bool blended) override;
+    void setLights(const SceneLight* lights, int count) override;
+    void drawGround(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) override;
+    void beginChunks() override;
+    void drawChunkRange(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) override;
+    void endChunks() override;
+    void drawInstances(InstanceMesh mesh, const InstanceData* instances, size_t count, bool lit, bool animated) override;
+    void drawPoints(const ScenePoint* points, size_t count, float size) override;
+    void drawBillboards(const BillboardData* billboards, size_t count) override;
+    void drawSkinned(const SkinnedVertex* vertices, size_t count) override;
+    void drawBatch(Batch2D& batch) override;
+
+    const RenderCounters& getCounters() const override { return inner->getCounters(); }
+    void resetCounters() override { inner->resetCounters(); }
+
+private:
+    std::ofstream out;
+    std::unique_ptr<RenderBackend> inner;
+};
+
+#endif // RENDER_BACKEND_H
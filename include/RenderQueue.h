@@ -0,0 +1,118 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "InstanceRenderer.h"
+#include <cstdint>
+#include <vector>
+
+struct ChunkPayload;
+
+// Suffixed because wingdi.h defines OPAQUE and TRANSPARENT as macros
+enum class RenderPass : uint8_t {
+    OPAQUE_PASS,
+    TRANSPARENT_PASS
+};
+
+// What a command needs from the GL state; commands sharing one are drawn
+// without touching the state in between
+enum class RenderMaterial : uint8_t {
+    GROUND,
+    WALLS,
+    SOLID,           // Lit opaque boxes
+    EYES,            // Unlit points
+    GLASS,           // Lit translucent boxes
+    MARKER_PULSE,    // Unlit translucent, animated
+    MARKER_STILL,
+    PARTICLES,       // Unlit translucent billboards
+    COUNT
+};
+
+enum class RenderCommandType : uint8_t {
+    GROUND,
+    STATIC_RANGE,
+    INSTANCE,
+    POINT,
+    BILLBOARDS,
+    SKINNED
+};
+
+struct ScenePoint {
+    float position[3];
+    uint8_t color[4];
+};
+
+// A world-space vertex of a mesh already posed on the CPU, in triangles
+struct SkinnedVertex {
+    float position[3];
+    float normal[3];
+    uint8_t color[4];
+};
+
+struct RenderCommand {
+    RenderCommandType type;
+    RenderMaterial material;
+    uint32_t lightSet;      // LightSystem set for lit materials, 0 for none
+    InstanceMesh mesh;
+
+    union {
+        struct {
+            const ChunkPayload* payload;
+            int chunk;
+            uint32_t first;
+            uint32_t count;
+        } range;
+        InstanceData instance;
+        ScenePoint point;
+        struct {
+            const BillboardData* data;
+            uint32_t count;
+        } billboards;
+        struct {
+            const SkinnedVertex* vertices;
+            uint32_t count;
+        } skinned;
+    };
+};
+
+// Draw commands for one frame, recorded in any order and submitted by
+// 64-bit key:
+//
+//   opaque       pass:2 | material:8 | depth:24 | order:30
+//   transparent  pass:2 | ~depth:24 | material:8 | order:30
+//
+// Opaque work groups by material and then goes front to back; transparent
+// work goes back to front and only groups where depths tie. Only the keys
+// are sorted, the commands stay where they were recorded.
+class RenderQueue {
+public:
+    RenderQueue();
+
+    void clear();
+
+    // Distances at or beyond this sort as the farthest
+    void setDepthRange(float farDistance);
+
+    // Order breaks ties between equal depths; it has to fit in 30 bits
+    RenderCommand& push(RenderPass pass, RenderMaterial material, float depth, uint32_t order);
+
+    void sort();
+
+    size_t size() const { return entries.size(); }
+    const RenderCommand& operator[](size_t index) const { return commands[entries[index].command]; }
+
+    static uint64_t makeKey(RenderPass pass, RenderMaterial material, uint32_t depth, uint32_t order);
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t command;
+    };
+
+    uint32_t quantizeDepth(float depth) const;
+
+    std::vector<Entry> entries;
+    std::vector<RenderCommand> commands;
+    float depthScale;
+};
+
+#endif // RENDER_QUEUE_H
@@ -2,6 +2,15 @@
 #define RENDERER_H
 
 #include "Game.h"
+#include "Batch2D.h"
+#include "Frustum.h"
+#include "LightSystem.h"
+#include "OcclusionCuller.h"
+#include "PerfOverlay.h"
+#include "RenderBackend.h"
+#include "RenderQueue.h"
+#include "ResolutionScaler.h"
+#include <memory>
 #include <vector>
 
 struct Room {
@@ -22,44 +31,148 @@ struct HidingSpot {
     std::string type; // "closet", "under_bed", "cabinet"
 };
 
+class LevelStreamer;
+class MonsterAnimation;
+class ParticleSystem;
+class PortalCuller;
+class TextRenderer;
+class Mansion;
+
 class Renderer {
 public:
-    Renderer(int width, int height);
+    // Takes the backend every draw goes through
+    Renderer(int width, int height, std::unique_ptr<RenderBackend> backend);
+    ~Renderer();
     
     void initialize();
+    void cleanup();
+    
+    // Culling bounds, occluders and lights for the level; call after loading.
+    // Its geometry reaches the GPU chunk by chunk as the streamer loads it.
+    void bakeStaticGeometry(const Mansion& mansion);
     void beginFrame();
     void endFrame();
     
-    void renderMansion(const std::vector<Room>& rooms, const std::vector<Door>& doors);
+    // The render* calls below record into the scene queue; submitScene sorts
+    // it and draws. Call it once the scene is recorded, before the HUD.
+    
+    // Rooms the portal culler reached, from chunks the streamer has resident
+    void renderMansion(const LevelStreamer& streamer, const PortalCuller& culler);
     void renderPlayer(const Player& player);
-    void renderMonster(const Monster& monster, const Vector3& playerPos);
+    // Every monster in view, posed by the last update; the first carries the red glow
+    void renderMonsters(const MonsterAnimation& animation);
     void renderTasks(const std::vector<Task>& tasks);
-    void renderHidingSpots(const std::vector<HidingSpot>& spots);
+    void renderHidingSpots(const std::vector<HidingSpot>& spots, const LevelStreamer& streamer, const PortalCuller& culler);
+    // Whatever is in view, as one draw after the other translucent surfaces
+    void renderParticles(const ParticleSystem& particles);
+    void submitScene();
     
+    // HUD and crosshair in one draw; the layout is rebuilt only when the task
+    // count, hiding or danger state changes
     void renderHUD(const Player& player, const TaskSystem& taskSystem, const Monster& monster);
-    void renderCrosshair();
     
+    // Also starts the 3D scene, drawn at the current resolution scale until
+    // submitScene or the first 2D draw stretches it over the window
     void setCamera(const Vector3& position, float yaw, float pitch);
     
-    void renderText(const std::string& text, int x, int y, float r = 1.0f, float g = 1.0f, float b = 1.0f);
+    // Spotlight along the view, on by default
+    void setFlashlight(bool on) { flashlight = on; }
+    bool isFlashlightOn() const { return flashlight; }
+    LightSystem& getLights() { return lights; }
+    
+    // Whole previous frame, swap included; picks the next frame's scale
+    void updateResolution(float frameMs) { resolution.update(frameMs); }
+    ResolutionScaler& getResolutionScaler() { return resolution; }
+    
+    float getFieldOfView() const { return 75.0f; }
+    float getAspect() const { return (float)screenWidth / (float)screenHeight; }
+    float getNearPlane() const { return 0.1f; }
+    // Clamped to where the fog turns fully opaque
+    float getFarPlane() const;
+    
+    const RenderSettings& getSettings() const { return settings; }
+    RenderBackend& getBackend() { return *backend; }
+    const RenderCounters& getCounters() const { return backend->getCounters(); }
+    // Everything the previous frame sent to the backend, menus included
+    const RenderCounters& getLastFrameCounters() const { return lastFrame; }
+    
+    // Feeds the previous frame's timings to the overlay and draws it when
+    // it's shown; call last, after the HUD and menus
+    void renderPerfOverlay(float cpuMs, float simMs);
+    PerfOverlay& getPerfOverlay() { return perfOverlay; }
+    
+    // Walls hide what's behind them before it's queued; on by default
+    OcclusionCuller& getOcclusionCuller() { return occlusion; }
+    
+    // Text on a translucent backdrop; the returned range is the glyphs, for
+    // recolouring
+    Batch2D::Range renderText(Batch2D& batch, const std::string& text, int x, int y, const Color2D& color);
+    TextRenderer& getTextRenderer() { return *textRenderer; }
+    
+    // Screen-space with the glyph atlas bound, in one draw
+    void drawBatch(Batch2D& batch);
     
 private:
-    void drawCube(const Vector3& pos, const Vector3& size, float r, float g, float b, float a = 1.0f);
-    void drawFloor(float size);
-    void drawWalls(const Room& room);
-    void drawDoor(const Door& door);
-    void drawMonster(const Vector3& pos, float scale = 1.0f);
-    void drawTaskMarker(const Vector3& pos, bool completed);
+    struct HudLayout {
+        int tasksDone;
+        int tasksTotal;
+        bool hiding;
+        bool danger;
+        
+        bool operator==(const HudLayout& other) const {
+            return tasksDone == other.tasksDone && tasksTotal == other.tasksTotal &&
+                   hiding == other.hiding && danger == other.danger;
+        }
+    };
     
-    void setupLighting();
-    void setupPerspective();
-    void setup2D();
+    void buildHUD(const TaskSystem& taskSystem);
+    void queueMonster(const MonsterAnimation& animation, int instance, const SkinnedVertex* vertices);
+    // Lit materials take their lights from lightSet; unlit ones ignore it
+    RenderCommand& queueCommand(RenderMaterial material, const Vector3& center, uint32_t order, int lightSet = 0);
+    void queueInstance(RenderMaterial material, InstanceMesh mesh, const InstanceData& instance, uint32_t order,
+                       int lightSet = 0);
+    void applyMaterial(RenderMaterial material);
+    void endScene();
     
     int screenWidth;
     int screenHeight;
     
-    float ambientLight;
-    bool fogEnabled;
+    RenderSettings settings;
+    
+    // World-space bounds baked at level load; rooms include their doors
+    Frustum frustum;
+    OcclusionCuller occlusion;
+    BoundsSoA roomBounds;
+    BoundsSoA spotBounds;
+    
+    LightSystem lights;
+    int monsterGlow;
+    bool flashlight;
+    
+    Vector3 cameraPosition;
+    float cameraYaw;
+    float cameraPitch;
+    RenderQueue sceneQueue;
+    // This frame's particles, kept at the system's capacity
+    std::vector<BillboardData> billboards;
+    // This frame's visible monsters, posed
+    std::vector<SkinnedVertex> monsterVertices;
+    
+    ResolutionScaler resolution;
+    bool sceneOpen;
+    
+    Batch2D hudBatch;
+    HudLayout hudLayout;
+    Batch2D::Range healthBar;
+    Batch2D::Range staminaBar;
+    Batch2D::Range dangerText;
+    
+    RenderCounters frameStart;
+    RenderCounters lastFrame;
+    PerfOverlay perfOverlay;
+    
+    std::unique_ptr<RenderBackend> backend;
+    std::unique_ptr<TextRenderer> textRenderer;
 };
 
 #endif // RENDERER_H
@@ -0,0 +1,44 @@
+#ifndef RESOLUTION_SCALER_H
+#define RESOLUTION_SCALER_H
+
+// Picks the scale the 3D scene renders at from how long whole frames take,
+// swap included. Smoothed frame time over budget for a few frames drops a
+// step; under budget for a couple of seconds climbs one back. A step that
+// had to be dropped again right after climbing waits twice as long before
+// the next try, so a scene on the edge settles instead of flickering.
+class ResolutionScaler {
+public:
+    static constexpr float MIN_SCALE = 0.5f;
+    static constexpr float MAX_SCALE = 1.0f;
+    static constexpr float STEP = 0.1f;
+
+    explicit ResolutionScaler(float targetMs = 1000.0f / 60.0f);
+
+    // Disabling goes back to full size; a fixed scale is pinned by
+    // disabling and then setting it
+    void setEnabled(bool enable);
+    bool isEnabled() const { return enabled; }
+    void setScale(float value);
+
+    // One finished frame, start to start
+    void update(float frameMs);
+
+    float getScale() const { return scale; }
+    float getSmoothedMs() const { return smoothedMs; }
+
+private:
+    void changeScale(float value);
+
+    float targetMs;
+    float smoothedMs;
+    float scale;
+    bool enabled;
+
+    int overFrames;
+    int underFrames;
+    int cooldown;
+    int raiseDelay;
+    bool justRaised;
+};
+
+#endif // RESOLUTION_SCALER_H
@@ -0,0 +1,108 @@
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+#include <SDL2/SDL_opengl.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Switches compiled into a permutation of the one GLSL 1.20 source
+enum ShaderFeature : uint32_t {
+    SHADER_FOG = 1 << 0,            // EXP2 fog from gl_Fog, per fragment
+    SHADER_LIT = 1 << 1,            // The enabled gl_LightSource slots, both sides
+    SHADER_LIGHTMAP = 1 << 2,       // Baked light added from texture unit 0
+    SHADER_FLOOR_TEXTURE = 1 << 3,  // Checker from unit 0 through the object planes
+    SHADER_INSTANCED = 1 << 4,      // Per-instance offset, scale and colour attributes
+    SHADER_ANIMATED = 1 << 5,       // Instances pulse by u_time and their phase
+    SHADER_BILLBOARD = 1 << 6       // Instanced quads facing the view, round and soft-edged
+};
+
+const int SHADER_FEATURE_COUNT = 7;
+
+// Generic attribute slots shared by every permutation; position has to be 0
+// in a compatibility context, the rest just mustn't overlap
+enum ShaderAttribute {
+    SHADER_ATTRIB_POSITION = 0,
+    SHADER_ATTRIB_NORMAL,
+    SHADER_ATTRIB_OFFSET,
+    SHADER_ATTRIB_SCALE,
+    SHADER_ATTRIB_COLOR,
+    SHADER_ATTRIB_PHASE
+};
+
+// Every shader permutation the renderer draws with, built once at startup.
+// Sources are assembled, hashed and matched against cached program binaries
+// on the JobSystem; the GL work then issues every compile and link before
+// asking for any result, so drivers with parallel compile overlap them.
+// Linked programs are saved under the cache directory keyed by the driver
+// and source, and a warm start only hands the binaries back. A permutation
+// that fails to build is left out, and binding it reports false so the
+// caller keeps the fixed-function path.
+class ShaderLibrary {
+public:
+    ShaderLibrary();
+
+    // Needs the context current; fog is on or off for the whole run, so it's
+    // folded into every permutation here. An empty cache directory disables
+    // the binary cache.
+    void initialize(const std::vector<uint32_t>& permutations, bool fog, const std::string& cacheDirectory);
+    void release();
+
+    bool has(uint32_t features) const;
+    // Makes the permutation current and brings its uniforms up to date
+    bool bind(uint32_t features);
+    // Back to fixed function
+    void unbind();
+
+    // Lights the lit permutations evaluate, GL_LIGHT0 up
+    void setLightCount(int count) { lightCount = count; }
+    void setTime(float seconds) { time = seconds; }
+
+    int getProgramCount() const { return programCount; }
+    int getCachedCount() const { return cachedCount; }
+    int getProgramBinds() const { return programBinds; }
+    void resetCounters() { programBinds = 0; }
+
+private:
+    struct Program {
+        GLuint id;
+        GLint lightsUniform;
+        GLint timeUniform;
+        float lights;
+        float time;
+    };
+
+    // Startup state of one permutation while it's being built
+    struct Build {
+        uint32_t features;
+        std::string vertexSource;
+        std::string fragmentSource;
+        std::string cachePath;
+        std::vector<uint8_t> binary;
+        GLenum binaryFormat;
+        GLuint vertexShader;
+        GLuint fragmentShader;
+        GLuint program;
+        bool cached;
+    };
+
+    bool loadBinary(Build& build);
+    void compile(Build& build);
+    bool finishCompile(Build& build);
+    void saveBinary(Build& build);
+    void setupProgram(uint32_t features, GLuint id);
+
+    Program programs[1 << SHADER_FEATURE_COUNT];
+    uint32_t baseFeatures;
+    GLuint boundProgram;
+    uint32_t boundFeatures;
+
+    int lightCount;
+    float time;
+
+    int programCount;
+    int cachedCount;
+    int programBinds;
+};
+
+#endif // SHADER_LIBRARY_H
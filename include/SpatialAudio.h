@@ -0,0 +1,99 @@
+#ifndef SPATIAL_AUDIO_H
+#define SPATIAL_AUDIO_H
+
+#include "Game.h"
+#include <cstdint>
+#include <vector>
+
+class AudioMixer;
+
+// Mixer voices spatial sounds may take; the rest of the pool is left for
+// the HUD's 2D sounds
+const int SPATIAL_VOICE_BUDGET = 24;
+
+// Wins over loudness: a quiet HIGH source is mixed before a loud LOW one
+enum class AudioPriority : uint8_t {
+    LOW,
+    NORMAL,
+    HIGH
+};
+
+// Positional sound on the game thread. Every source is an emitter that's
+// tracked whether or not it can be heard: each update works out its gain
+// from distance, its pan from the listener's yaw and, for emitters that ask
+// for it, its doppler pitch. Only the SPATIAL_VOICE_BUDGET most important
+// audible emitters get a mixer voice; the others are virtual, keeping their
+// place in the sound without costing the mixer anything, and pick up from
+// there if they win a voice back. However many emitters there are, the
+// mixer never mixes more than the budget.
+class SpatialAudio {
+public:
+    explicit SpatialAudio(AudioMixer& mixer);
+    ~SpatialAudio();
+
+    // yaw in degrees, as Player keeps it
+    void setListener(const Vector3& position, float yaw, const Vector3& velocity);
+
+    // A looping source that lives until it's removed; 0 if sound is invalid
+    uint32_t addEmitter(int sound, const Vector3& position, float gain, AudioPriority priority, bool doppler);
+    void moveEmitter(uint32_t id, const Vector3& position, const Vector3& velocity);
+    void removeEmitter(uint32_t id);
+
+    // Plays once from position and then frees itself
+    void playOneShot(int sound, const Vector3& position, float gain, AudioPriority priority);
+
+    // Once a frame, after the listener and emitters have moved
+    void update(float deltaTime);
+    // Silences every voice and holds each emitter where it is; the next
+    // update picks them all up again
+    void pause();
+    void clear();
+
+    int getEmitterCount() const { return emitterCount; }
+    // Emitters the mixer is actually playing as of the last update; a voice
+    // asked for in that update counts once the mixer has taken it
+    int getRealCount() const { return realCount; }
+    // Gain after distance and head shadow as of the last update; 0 for a
+    // stale id
+    float getAudibleGain(uint32_t id) const;
+
+private:
+    struct Emitter {
+        uint32_t id;            // Slot and generation; 0 when free
+        int sound;
+        Vector3 position;
+        Vector3 velocity;
+        float gain;
+        AudioPriority priority;
+        bool loop;
+        bool doppler;
+        float time;             // Seconds into the sound, real or not
+        float duration;
+        // From the last update
+        float audible;
+        float pan;
+        float pitch;
+        uint32_t voice;         // Mixer voice, 0 while virtual
+    };
+
+    Emitter* find(uint32_t id);
+    uint32_t allocate();
+    void release(Emitter& emitter);
+    void spatialize(Emitter& emitter) const;
+
+    AudioMixer& mixer;
+    std::vector<Emitter> emitters;
+    std::vector<uint32_t> freeSlots;
+    // Indices of audible emitters, ranked each update
+    std::vector<uint32_t> ranked;
+    uint32_t generation;
+    int emitterCount;
+    int realCount;
+
+    Vector3 listenerPosition;
+    Vector3 listenerRight;
+    Vector3 listenerForward;
+    Vector3 listenerVelocity;
+};
+
+#endif // SPATIAL_AUDIO_H
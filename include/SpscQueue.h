@@ -0,0 +1,64 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-capacity ring for exactly one producer thread and one consumer
+// thread. Neither side locks, waits or allocates: push fails when the ring
+// is full and pop when it's empty. Each side keeps its own index on its own
+// cache line, with a copy of the other's that it only refreshes when the
+// ring looks full or empty. Capacity has to be a power of two.
+template <typename T, uint32_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    SpscQueue() : tail(0), cachedHead(0), head(0), cachedTail(0) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer only
+    bool push(const T& item) {
+        uint32_t position = tail.load(std::memory_order_relaxed);
+        if (position - cachedHead == Capacity) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (position - cachedHead == Capacity) return false;
+        }
+        items[position & (Capacity - 1)] = item;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    bool pop(T& item) {
+        uint32_t position = head.load(std::memory_order_relaxed);
+        if (position == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (position == cachedTail) return false;
+        }
+        item = items[position & (Capacity - 1)];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either side; already stale by the time it returns
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    static constexpr uint32_t capacity() { return Capacity; }
+
+private:
+    alignas(64) std::atomic<uint32_t> tail;
+    uint32_t cachedHead;
+
+    alignas(64) std::atomic<uint32_t> head;
+    uint32_t cachedTail;
+
+    alignas(64) T items[Capacity];
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,62 @@
+#ifndef STATIC_GEOMETRY_H
+#define STATIC_GEOMETRY_H
+
+#include "Game.h"
+#include "LevelStreamer.h"
+#include <SDL2/SDL_opengl.h>
+#include <vector>
+
+// GPU copies of the mansion's static geometry. Each streamed chunk's walls,
+// doors and floor are uploaded the first time it's drawn and released once
+// it's evicted, so a frame is one floor draw per chunk in view plus one per
+// run of visible rooms. Floors take the checker texture; chunks with a
+// baked lightmap page get it on their walls, added on top of the runtime
+// lighting.
+class StaticGeometry {
+public:
+    StaticGeometry();
+
+    // A chunk's floor range, checker textured from world position, so its
+    // cells can be any size
+    void drawGround(int chunkIndex, const ChunkPayload& payload, uint32_t firstIndex, uint32_t indexCount);
+
+    // Frees GPU copies of chunks the streamer has dropped
+    void releaseEvicted(const LevelStreamer& streamer);
+
+    // Wall/door draws: bind once, then any number of ranges from any chunk
+    void beginChunks();
+    void drawChunkRange(int chunkIndex, const ChunkPayload& payload, uint32_t firstIndex, uint32_t indexCount);
+    void endChunks();
+
+    // Needs the context current
+    void release();
+
+    size_t getGPUBytes() const { return gpuBytes; }
+
+private:
+    struct ChunkBuffers {
+        GLuint vertexBuffer;
+        GLuint indexBuffer;
+        GLuint lightmapTexture;
+        uint32_t generation;
+        size_t bytes;
+    };
+
+    void createCheckerTexture();
+    void upload(int chunkIndex, const ChunkPayload& payload);
+    void releaseChunks();
+    void releaseChunk(ChunkBuffers& buffers);
+    ChunkBuffers& bindChunk(int chunkIndex, const ChunkPayload& payload);
+    void bindVertices(const StaticVertex* base);
+    void bindLightmap(const ChunkBuffers& buffers, const ChunkPayload& payload);
+
+    std::vector<ChunkBuffers> chunkBuffers;
+    std::vector<int> uploadedChunks;
+    int boundChunk;
+
+    GLuint checkerTexture;
+
+    size_t gpuBytes;
+};
+
+#endif // STATIC_GEOMETRY_H
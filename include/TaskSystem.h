@@ -2,6 +2,7 @@
 #define TASK_SYSTEM_H
 
 #include "Game.h"
+#include "LevelFormat.h"
 #include <vector>
 #include <string>
 
@@ -10,6 +11,8 @@ public:
     TaskSystem();
     
     void initialize();
+    void loadFromLevel(const LevelFile& level);
+    void setTasks(const std::vector<Task>& newTasks);
     void update(const Vector3& playerPos);
     
     bool checkTaskCompletion(const Vector3& playerPos);
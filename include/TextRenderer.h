@@ -0,0 +1,57 @@
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#include "Batch2D.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Monospaced bitmap text. The embedded 8x16 glyphs are packed into one alpha
+// atlas, which the backend uploads at startup, with texel (0, 0) left opaque
+// so Batch2D's untextured quads share the texture and the draw. Each string is laid out once per
+// scale and the cached run is replayed into whichever batch asks for it.
+class TextRenderer {
+public:
+    static const int GLYPH_WIDTH = 8;
+    static const int GLYPH_HEIGHT = 16;
+    static const int ATLAS_SIZE = 128;      // 16 x 6 cells, with the solid cell
+
+    TextRenderer();
+
+    // ATLAS_SIZE squared alpha texels
+    static void buildAtlas(std::vector<uint8_t>& texels);
+
+    // Drops the cached runs
+    void clear();
+
+    // Glyph quads with the top-left corner at (x, y); the range is for
+    // recolouring the text later
+    Batch2D::Range addText(Batch2D& batch, const std::string& text, float x, float y,
+                           const Color2D& color, int scale = 1);
+
+    // Same, without caching the run; for numbers that change every refresh
+    // and would only push the static strings out of the cache
+    Batch2D::Range addDynamicText(Batch2D& batch, const std::string& text, float x, float y,
+                                  const Color2D& color, int scale = 1);
+
+    int measure(const std::string& text, int scale = 1) const { return (int)text.length() * GLYPH_WIDTH * scale; }
+    size_t getCachedRuns() const { return runs.size(); }
+
+private:
+    struct GlyphQuad {
+        float x0, y0, x1, y1;
+        float u0, v0, u1, v1;
+    };
+
+    const std::vector<GlyphQuad>& layout(const std::string& text, int scale);
+    void layoutInto(const std::string& text, int scale, std::vector<GlyphQuad>& quads) const;
+    Batch2D::Range emit(Batch2D& batch, const std::vector<GlyphQuad>& quads, float x, float y,
+                        const Color2D& color) const;
+
+    // Keyed by scale and string
+    std::unordered_map<std::string, std::vector<GlyphQuad>> runs;
+    std::vector<GlyphQuad> scratch;
+};
+
+#endif // TEXT_RENDERER_H
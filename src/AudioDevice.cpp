@@ -0,0 +1,78 @@
+#include "AudioDevice.h"
+#include <iostream>
+
+namespace {
+    // SDL's own buffer, on top of what the mixer keeps queued
+    const int SDL_BUFFER_FRAMES = 512;
+    const int FRAME_BYTES = 2 * sizeof(float);
+}
+
+NullAudioDevice::NullAudioDevice() : submitted(0), rate(0) {
+}
+
+bool NullAudioDevice::open(int& sampleRate) {
+    start = std::chrono::steady_clock::now();
+    submitted = 0;
+    rate = sampleRate;
+    return true;
+}
+
+int NullAudioDevice::getQueuedFrames() {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t played = (uint64_t)(std::chrono::duration<double>(now - start).count() * rate);
+    if (played > submitted) {
+        // Ran dry; a real device would have played silence, so the clock restarts from here
+        start = now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                          std::chrono::duration<double>((double)submitted / rate));
+        return 0;
+    }
+    return (int)(submitted - played);
+}
+
+SDLAudioDevice::SDLAudioDevice() : device(0) {
+}
+
+SDLAudioDevice::~SDLAudioDevice() {
+    close();
+}
+
+bool SDLAudioDevice::open(int& sampleRate) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+        std::cerr << "SDL audio initialization failed: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    SDL_AudioSpec want = {};
+    want.freq = sampleRate;
+    want.format = AUDIO_F32SYS;
+    want.channels = 2;
+    want.samples = SDL_BUFFER_FRAMES;
+    want.callback = nullptr;
+
+    SDL_AudioSpec have = {};
+    device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (device == 0) {
+        std::cerr << "Couldn't open an audio device: " << SDL_GetError() << std::endl;
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return false;
+    }
+
+    sampleRate = have.freq;
+    SDL_PauseAudioDevice(device, 0);
+    return true;
+}
+
+void SDLAudioDevice::close() {
+    if (device == 0) return;
+    SDL_CloseAudioDevice(device);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    device = 0;
+}
+
+int SDLAudioDevice::getQueuedFrames() {
+    return (int)(SDL_GetQueuedAudioSize(device) / FRAME_BYTES);
+}
+
+void SDLAudioDevice::submit(const float* frames, int count) {
+    SDL_QueueAudio(device, frames, (Uint32)(count * FRAME_BYTES));
+}
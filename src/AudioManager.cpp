@@ -1,64 +1,257 @@
 #include "AudioManager.h"
+#include "AudioMixer.h"
+#include "MusicStreamer.h"
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
+namespace {
+    const char* SOUND_NAMES[] = { "hide", "death", "task_complete", "victory", "footstep", "breath" };
+    const int SYNTH_RATE = 22050;
+    const float TWO_PI = 6.2831853f;
+    // Ambient to chase and back
+    const float MUSIC_CROSSFADE_SECONDS = 2.0f;
+    const float MUSIC_STOP_SECONDS = 0.5f;
+
+    // Any WAV SDL understands, converted to mono float at its own rate
+    bool loadWav(const std::string& path, SoundData& sound) {
+        SDL_AudioSpec spec;
+        Uint8* buffer = nullptr;
+        Uint32 length = 0;
+        if (!SDL_LoadWAV(path.c_str(), &spec, &buffer, &length)) return false;
+
+        SDL_AudioCVT cvt;
+        if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq, AUDIO_F32SYS, 1, spec.freq) < 0) {
+            std::cerr << "Can't convert " << path << ": " << SDL_GetError() << std::endl;
+            SDL_FreeWAV(buffer);
+            return false;
+        }
+
+        std::vector<Uint8> converted((size_t)length * std::max(1, cvt.len_mult));
+        std::memcpy(converted.data(), buffer, length);
+        SDL_FreeWAV(buffer);
+        cvt.buf = converted.data();
+        cvt.len = (int)length;
+        if (cvt.needed && SDL_ConvertAudio(&cvt) < 0) {
+            std::cerr << "Can't convert " << path << ": " << SDL_GetError() << std::endl;
+            return false;
+        }
+
+        int bytes = cvt.needed ? cvt.len_cvt : (int)length;
+        sound.samples.resize(bytes / sizeof(float));
+        std::memcpy(sound.samples.data(), converted.data(), sound.samples.size() * sizeof(float));
+        sound.sampleRate = spec.freq;
+        return true;
+    }
+
+    float noise(uint32_t& state) {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) / 8388608.0f - 1.0f;
+    }
+
+    // Stand-ins for when assets/sounds is empty, so every cue is audible
+    void synthesize(const std::string& name, SoundData& sound) {
+        sound.sampleRate = SYNTH_RATE;
+        uint32_t state = 0x5eed;
+
+        if (name == "hide") {
+            // Cloth rustle: noise swelling and fading
+            int count = SYNTH_RATE * 35 / 100;
+            sound.samples.resize(count);
+            float smooth = 0.0f;
+            for (int i = 0; i < count; i++) {
+                float t = (float)i / count;
+                smooth += (noise(state) - smooth) * 0.15f;
+                sound.samples[i] = smooth * std::sin(t * 3.1415927f) * 0.8f;
+            }
+        } else if (name == "death") {
+            // Falling groan under a burst of noise
+            int count = SYNTH_RATE * 16 / 10;
+            sound.samples.resize(count);
+            float phase = 0.0f;
+            for (int i = 0; i < count; i++) {
+                float t = (float)i / count;
+                phase += TWO_PI * (220.0f * std::pow(0.25f, t)) / SYNTH_RATE;
+                float envelope = std::min(1.0f, t * 40.0f) * (1.0f - t);
+                sound.samples[i] = (std::sin(phase) * 0.6f + noise(state) * 0.25f * (1.0f - t)) * envelope;
+            }
+        } else if (name == "task_complete") {
+            // Two-note chime
+            int count = SYNTH_RATE * 6 / 10;
+            sound.samples.resize(count);
+            for (int i = 0; i < count; i++) {
+                float seconds = (float)i / SYNTH_RATE;
+                float frequency = seconds < 0.15f ? 660.0f : 990.0f;
+                float local = seconds < 0.15f ? seconds : seconds - 0.15f;
+                sound.samples[i] = std::sin(TWO_PI * frequency * seconds) * std::exp(-local * 6.0f) * 0.5f;
+            }
+        } else if (name == "footstep") {
+            // Heavy thud with a scrape on top
+            int count = SYNTH_RATE / 4;
+            sound.samples.resize(count);
+            for (int i = 0; i < count; i++) {
+                float seconds = (float)i / SYNTH_RATE;
+                float thud = std::sin(TWO_PI * 70.0f * seconds) * std::exp(-seconds * 25.0f);
+                sound.samples[i] = thud * 0.8f + noise(state) * std::exp(-seconds * 60.0f) * 0.3f;
+            }
+        } else if (name == "breath") {
+            // Ragged in and out breaths, silent at both ends so it loops cleanly
+            int count = SYNTH_RATE * 24 / 10;
+            sound.samples.resize(count);
+            float smooth = 0.0f;
+            for (int i = 0; i < count; i++) {
+                float cycle = std::sin(TWO_PI * (float)i / count);
+                float envelope = cycle > 0.0f ? cycle * cycle * 0.5f : cycle * cycle * 0.35f;
+                smooth += (noise(state) - smooth) * (cycle > 0.0f ? 0.08f : 0.2f);
+                sound.samples[i] = smooth * envelope * 2.0f;
+            }
+        } else {
+            // Rising C major arpeggio
+            const float notes[] = { 261.63f, 329.63f, 392.0f, 523.25f };
+            int noteLength = SYNTH_RATE / 4;
+            int count = noteLength * 4 + SYNTH_RATE;
+            sound.samples.assign(count, 0.0f);
+            for (int n = 0; n < 4; n++) {
+                for (int i = n * noteLength; i < count; i++) {
+                    float local = (float)(i - n * noteLength) / SYNTH_RATE;
+                    sound.samples[i] += std::sin(TWO_PI * notes[n] * local) * std::exp(-local * 2.0f) * 0.2f;
+                }
+            }
+        }
+    }
+}
+
 AudioManager::AudioManager()
-    : musicVolume(0.7f), soundVolume(0.8f), initialized(false) {
+    : musicVolume(0.7f), soundVolume(0.8f), initialized(false), stopPending(false) {
 }
 
 AudioManager::~AudioManager() {
+    cleanup();
 }
 
-void AudioManager::initialize() {
-    // In a full implementation, would initialize SDL_mixer or similar
-    // For now, this is a placeholder
+void AudioManager::initialize(const std::string& deviceName) {
+    mixer = std::make_unique<AudioMixer>();
+
+    int loaded = 0;
+    for (const char* name : SOUND_NAMES) {
+        SoundData sound;
+        if (loadWav(std::string("assets/sounds/") + name + ".wav", sound)) {
+            loaded++;
+        } else {
+            synthesize(name, sound);
+        }
+        soundBuffers[name] = mixer->addSound(std::move(sound));
+    }
+
+    music = std::make_unique<MusicStreamer>();
+    mixer->setMusic(music.get());
+    mixer->setBusVolume(AudioBus::SOUND, soundVolume);
+    mixer->setBusVolume(AudioBus::MUSIC, musicVolume);
+
+    // The mixer thread calls into the streamer from its first block, so the
+    // streamer runs first and learns the device's rate once it's open
+    music->start(AUDIO_SAMPLE_RATE);
+    bool started = false;
+    if (deviceName != "null") {
+        started = mixer->start(std::make_unique<SDLAudioDevice>());
+        if (!started) std::cerr << "Falling back to silent audio" << std::endl;
+    }
+    if (!started) mixer->start(std::make_unique<NullAudioDevice>());
+    music->setSampleRate(mixer->getSampleRate());
+    spatial = std::make_unique<SpatialAudio>(*mixer);
+
     initialized = true;
-    std::cout << "Audio system initialized (placeholder)" << std::endl;
+    std::cout << "Audio: " << mixer->getDeviceName() << " at " << mixer->getSampleRate() << " Hz, "
+              << loaded << "/" << soundBuffers.size() << " sounds from disk" << std::endl;
 }
 
 void AudioManager::cleanup() {
+    // The mixer reads the music rings, so it stops first
+    spatial.reset();
+    if (mixer) mixer->stop();
+    if (music) music->stop();
+    mixer.reset();
+    music.reset();
     soundBuffers.clear();
+    currentMusic.clear();
+    stopPending = false;
     initialized = false;
 }
 
+int AudioManager::findSound(const std::string& name) const {
+    auto it = soundBuffers.find(name);
+    return it != soundBuffers.end() ? it->second : -1;
+}
+
 void AudioManager::playSound(const std::string& soundName) {
     if (!initialized) return;
-    
-    // Placeholder for sound playback
-    std::cout << "Playing sound: " << soundName << std::endl;
+    mixer->play(findSound(soundName), 1.0f, 0.0f, 1.0f, false, AudioBus::SOUND);
 }
 
 void AudioManager::playMusic(const std::string& musicName, bool loop) {
     if (!initialized) return;
-    
-    // Placeholder for music playback
-    std::cout << "Playing music: " << musicName << (loop ? " (looping)" : "") << std::endl;
+    if (musicName == currentMusic) return;
+    // Only remembered once the streamer has it, so a dropped play is asked
+    // for again on the next call
+    if (music->play("assets/music/" + musicName + ".wav", loop, MUSIC_CROSSFADE_SECONDS)) {
+        currentMusic = musicName;
+        stopPending = false;
+    }
 }
 
 void AudioManager::stopMusic() {
     if (!initialized) return;
-    
-    std::cout << "Stopping music" << std::endl;
+    if (currentMusic.empty()) return;
+    currentMusic.clear();
+    // Stops are one-off calls, so a dropped one is retried from update
+    stopPending = !music->fadeOut(MUSIC_STOP_SECONDS);
 }
 
 void AudioManager::setMusicVolume(float volume) {
     musicVolume = volume;
+    if (initialized) mixer->setBusVolume(AudioBus::MUSIC, volume);
 }
 
 void AudioManager::setSoundVolume(float volume) {
     soundVolume = volume;
+    if (initialized) mixer->setBusVolume(AudioBus::SOUND, volume);
+}
+
+void AudioManager::update(float deltaTime, bool playing) {
+    if (!initialized) return;
+    if (stopPending) stopPending = !music->fadeOut(MUSIC_STOP_SECONDS);
+    if (playing) {
+        spatial->update(deltaTime);
+    } else {
+        spatial->pause();
+    }
+}
+
+void AudioManager::setListener(const Vector3& position, float yaw, const Vector3& velocity) {
+    if (!initialized) return;
+    spatial->setListener(position, yaw, velocity);
 }
 
-void AudioManager::update() {
-    // Update any playing sounds/music
+void AudioManager::playSound3D(const std::string& soundName, const Vector3& position, float gain,
+                               AudioPriority priority) {
+    if (!initialized) return;
+    spatial->playOneShot(findSound(soundName), position, gain, priority);
+}
+
+uint32_t AudioManager::addEmitter(const std::string& soundName, const Vector3& position, float gain,
+                                  AudioPriority priority, bool doppler) {
+    if (!initialized) return 0;
+    return spatial->addEmitter(findSound(soundName), position, gain, priority, doppler);
+}
+
+void AudioManager::moveEmitter(uint32_t id, const Vector3& position, const Vector3& velocity) {
+    if (!initialized) return;
+    spatial->moveEmitter(id, position, velocity);
 }
 
-void AudioManager::playSound3D(const std::string& soundName, const Vector3& position, const Vector3& listenerPos) {
+void AudioManager::removeEmitter(uint32_t id) {
     if (!initialized) return;
-    
-    // Calculate distance for volume adjustment
-    Vector3 diff = position - listenerPos;
-    float distance = diff.length();
-    
-    // Placeholder for 3D sound playback
-    std::cout << "Playing 3D sound: " << soundName << " at distance " << distance << std::endl;
+    spatial->removeEmitter(id);
 }
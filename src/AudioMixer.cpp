@@ -0,0 +1,388 @@
+#include "AudioMixer.h"
+#include "MusicStreamer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MANSION_MIXER_SSE 1
+#endif
+
+namespace {
+    // How far ahead of playback the thread keeps the device, about 21 ms at 48 kHz
+    const int QUEUE_AHEAD_FRAMES = AUDIO_BLOCK_FRAMES * 4;
+    const float QUARTER_PI = 0.78539816f;
+
+    // Equal-power pan, so a sound keeps its loudness as it moves across
+    void panGains(float gain, float pan, float& left, float& right) {
+        float angle = (std::max(-1.0f, std::min(1.0f, pan)) + 1.0f) * QUARTER_PI;
+        left = gain * std::cos(angle);
+        right = gain * std::sin(angle);
+    }
+
+    // Resamples count frames starting at position, which must leave every
+    // frame's next sample inside the source, and adds them into left and
+    // right with gains ramping from gainLeft and gainRight by their steps
+    void mixSpan(const float* data, double position, float step,
+                 float gainLeft, float stepLeft, float gainRight, float stepRight,
+                 float* left, float* right, int count) {
+        int64_t base = (int64_t)position;
+        float frac = (float)(position - (double)base);
+        const float* source = data + base;
+        int i = 0;
+
+#ifdef MANSION_MIXER_SSE
+        const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        const __m128 fracs = _mm_set1_ps(frac);
+        const __m128 steps = _mm_set1_ps(step);
+        const __m128 gainsLeft = _mm_set1_ps(gainLeft);
+        const __m128 gainsRight = _mm_set1_ps(gainRight);
+        const __m128 stepsLeft = _mm_set1_ps(stepLeft);
+        const __m128 stepsRight = _mm_set1_ps(stepRight);
+        alignas(16) int32_t at[4];
+        for (; i + 4 <= count; i += 4) {
+            // Offsets come from the frame number rather than a running sum,
+            // so these lanes land exactly where the scalar tail would
+            __m128 frame = _mm_add_ps(_mm_set1_ps((float)i), lane);
+            __m128 offset = _mm_add_ps(fracs, _mm_mul_ps(frame, steps));
+            __m128i index = _mm_cvttps_epi32(offset);
+            __m128 t = _mm_sub_ps(offset, _mm_cvtepi32_ps(index));
+            _mm_store_si128((__m128i*)at, index);
+
+            __m128 a = _mm_set_ps(source[at[3]], source[at[2]], source[at[1]], source[at[0]]);
+            __m128 b = _mm_set_ps(source[at[3] + 1], source[at[2] + 1], source[at[1] + 1], source[at[0] + 1]);
+            __m128 sample = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+
+            __m128 gl = _mm_add_ps(gainsLeft, _mm_mul_ps(frame, stepsLeft));
+            __m128 gr = _mm_add_ps(gainsRight, _mm_mul_ps(frame, stepsRight));
+            _mm_storeu_ps(left + i, _mm_add_ps(_mm_loadu_ps(left + i), _mm_mul_ps(sample, gl)));
+            _mm_storeu_ps(right + i, _mm_add_ps(_mm_loadu_ps(right + i), _mm_mul_ps(sample, gr)));
+        }
+#endif
+
+        for (; i < count; i++) {
+            float offset = frac + (float)i * step;
+            int index = (int)offset;
+            float t = offset - (float)index;
+            float sample = source[index] + (source[index + 1] - source[index]) * t;
+            left[i] += sample * (gainLeft + stepLeft * (float)i);
+            right[i] += sample * (gainRight + stepRight * (float)i);
+        }
+    }
+}
+
+AudioMixer::AudioMixer()
+    : music(nullptr), running(false), sampleRate(AUDIO_SAMPLE_RATE), nextHandle(1), droppedCommands(0), playCount(0),
+      lastPlayApplied(0), activeVoices(0), voicesStolen(0), blocksMixed(0), mixNanoseconds(0) {
+    for (Voice& voice : voices) voice.handle = 0;
+    for (std::atomic<uint32_t>& handle : voiceHandles) handle.store(0, std::memory_order_relaxed);
+    for (float& volume : busVolume) volume = 1.0f;
+}
+
+AudioMixer::~AudioMixer() {
+    stop();
+}
+
+int AudioMixer::addSound(SoundData sound) {
+    // A trailing zero lets the resampler read one past the last sample
+    // without checking, even when float rounding lands it on the end
+    sound.samples.push_back(0.0f);
+    sounds.push_back(std::move(sound));
+    return (int)sounds.size() - 1;
+}
+
+bool AudioMixer::start(std::unique_ptr<AudioDevice> newDevice) {
+    stop();
+
+    int rate = AUDIO_SAMPLE_RATE;
+    if (!newDevice->open(rate)) return false;
+    device = std::move(newDevice);
+    sampleRate = rate;
+
+    mixLeft.assign(AUDIO_BLOCK_FRAMES, 0.0f);
+    mixRight.assign(AUDIO_BLOCK_FRAMES, 0.0f);
+    output.assign(AUDIO_BLOCK_FRAMES * 2, 0.0f);
+
+    running.store(true, std::memory_order_release);
+    thread = std::thread(&AudioMixer::run, this);
+    return true;
+}
+
+void AudioMixer::stop() {
+    if (thread.joinable()) {
+        running.store(false, std::memory_order_release);
+        thread.join();
+    }
+    if (device) device->close();
+
+    for (Voice& voice : voices) voice.handle = 0;
+    for (std::atomic<uint32_t>& handle : voiceHandles) handle.store(0, std::memory_order_relaxed);
+    activeVoices.store(0, std::memory_order_relaxed);
+}
+
+float AudioMixer::getSoundSeconds(int sound) const {
+    if (sound < 0 || sound >= (int)sounds.size()) return 0.0f;
+    const SoundData& data = sounds[sound];
+    return (float)(data.samples.size() - 1) / (float)data.sampleRate;
+}
+
+uint32_t AudioMixer::play(int sound, float gain, float pan, float pitch, bool loop, AudioBus bus, float offset) {
+    if (sound < 0 || sound >= (int)sounds.size()) return 0;
+
+    Command command = {};
+    command.type = CommandType::PLAY;
+    command.bus = bus;
+    command.loop = loop;
+    command.handle = nextHandle++;
+    if (nextHandle == 0) nextHandle = 1;
+    command.sound = sound;
+    command.gain = gain;
+    command.pan = pan;
+    command.pitch = pitch;
+    command.offset = offset;
+
+    if (!commands.push(command)) {
+        droppedCommands++;
+        return 0;
+    }
+    return command.handle;
+}
+
+void AudioMixer::setVoice(uint32_t handle, float gain, float pan, float pitch) {
+    if (handle == 0) return;
+
+    Command command = {};
+    command.type = CommandType::SET;
+    command.handle = handle;
+    command.gain = gain;
+    command.pan = pan;
+    command.pitch = pitch;
+    if (!commands.push(command)) droppedCommands++;
+}
+
+void AudioMixer::stopVoice(uint32_t handle) {
+    if (handle == 0) return;
+
+    Command command = {};
+    command.type = CommandType::STOP;
+    command.handle = handle;
+    if (!commands.push(command)) droppedCommands++;
+}
+
+void AudioMixer::setBusVolume(AudioBus bus, float volume) {
+    Command command = {};
+    command.type = CommandType::BUS_VOLUME;
+    command.bus = bus;
+    command.gain = volume;
+    if (!commands.push(command)) droppedCommands++;
+}
+
+VoiceState AudioMixer::getVoiceState(uint32_t handle) const {
+    if (handle == 0) return VoiceState::GONE;
+    // Handles are handed out in order, so one past the last play applied
+    // is still queued
+    uint32_t applied = lastPlayApplied.load(std::memory_order_acquire);
+    if ((int32_t)(handle - applied) > 0) return VoiceState::PENDING;
+    for (const std::atomic<uint32_t>& voiceHandle : voiceHandles) {
+        if (voiceHandle.load(std::memory_order_relaxed) == handle) return VoiceState::PLAYING;
+    }
+    return VoiceState::GONE;
+}
+
+void AudioMixer::run() {
+    while (running.load(std::memory_order_acquire)) {
+        while (device->getQueuedFrames() < QUEUE_AHEAD_FRAMES) {
+            mix(output.data(), AUDIO_BLOCK_FRAMES);
+            device->submit(output.data(), AUDIO_BLOCK_FRAMES);
+        }
+        // A block lasts about 5 ms, so this wakes at least twice per block
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+AudioMixer::Voice* AudioMixer::findVoice(uint32_t handle) {
+    for (Voice& voice : voices) {
+        if (voice.handle == handle) return &voice;
+    }
+    return nullptr;
+}
+
+void AudioMixer::apply(const Command& command) {
+    switch (command.type) {
+    case CommandType::PLAY: {
+        // Published however it goes, so a play that doesn't get a voice
+        // reads as GONE rather than PENDING forever. A voice that does is
+        // published first, or it would look GONE for a moment.
+        const SoundData& sound = sounds[command.sound];
+        double position = (double)command.offset * sound.sampleRate;
+        double length = (double)(sound.samples.size() - 1);
+        if (command.loop && length > 0.0) position = std::fmod(position, length);
+        if (position < 0.0 || position >= length) {
+            lastPlayApplied.store(command.handle, std::memory_order_release);
+            return;
+        }
+
+        Voice* voice = findVoice(0);
+        if (!voice) {
+            // A voice stopped earlier in this drain would only fade out over
+            // the block, so it goes first; swapping one loop for another
+            // mustn't need a spare voice
+            for (Voice& candidate : voices) {
+                if (!candidate.stopping) continue;
+                if (!voice || candidate.started < voice->started) voice = &candidate;
+            }
+        }
+        if (!voice) {
+            // Full: take the oldest one-shot sound, never music or a loop
+            for (Voice& candidate : voices) {
+                if (candidate.loop || candidate.bus != AudioBus::SOUND) continue;
+                if (!voice || candidate.started < voice->started) voice = &candidate;
+            }
+            if (!voice) {
+                lastPlayApplied.store(command.handle, std::memory_order_release);
+                return;
+            }
+            voicesStolen.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        voice->handle = command.handle;
+        voice->sound = command.sound;
+        voice->bus = command.bus;
+        voice->loop = command.loop;
+        voice->stopping = false;
+        voice->position = position;
+        voice->gain = command.gain;
+        voice->pan = command.pan;
+        voice->pitch = command.pitch;
+        voice->started = playCount++;
+        voiceHandles[voice - voices].store(command.handle, std::memory_order_relaxed);
+        lastPlayApplied.store(command.handle, std::memory_order_release);
+        // New voices start at full gain; the sound's own attack covers it
+        panGains(voice->gain * busVolume[(int)voice->bus], voice->pan, voice->left, voice->right);
+        break;
+    }
+    case CommandType::SET:
+        if (Voice* voice = findVoice(command.handle)) {
+            voice->gain = command.gain;
+            voice->pan = command.pan;
+            voice->pitch = command.pitch;
+        }
+        break;
+    case CommandType::STOP:
+        if (Voice* voice = findVoice(command.handle)) voice->stopping = true;
+        break;
+    case CommandType::BUS_VOLUME:
+        busVolume[(int)command.bus] = command.gain;
+        break;
+    }
+}
+
+bool AudioMixer::mixVoice(Voice& voice, float* left, float* right, int frames) {
+    const SoundData& sound = sounds[voice.sound];
+    const float* data = sound.samples.data();
+    // Without the guard sample
+    int64_t length = (int64_t)sound.samples.size() - 1;
+    if (length <= 0) return false;
+
+    float step = std::max(0.0f, voice.pitch) * (float)sound.sampleRate / (float)sampleRate;
+    if (step <= 0.0f) return !voice.stopping;
+
+    float targetLeft = 0.0f;
+    float targetRight = 0.0f;
+    if (!voice.stopping) panGains(voice.gain * busVolume[(int)voice.bus], voice.pan, targetLeft, targetRight);
+    float stepLeft = (targetLeft - voice.left) / (float)frames;
+    float stepRight = (targetRight - voice.right) / (float)frames;
+
+    int done = 0;
+    while (done < frames) {
+        // Frames that can interpolate entirely inside the sound
+        double room = (double)(length - 1) - voice.position;
+        if (room > 0.0) {
+            int count = (int)std::min<double>(frames - done, std::ceil(room / step));
+            mixSpan(data, voice.position, step,
+                    voice.left + stepLeft * (float)done, stepLeft,
+                    voice.right + stepRight * (float)done, stepRight,
+                    left + done, right + done, count);
+            voice.position += count * (double)step;
+            done += count;
+            continue;
+        }
+
+        if (!voice.loop) return false;
+
+        // Across the loop point the last sample blends into the first
+        while (done < frames && voice.position < (double)length) {
+            int64_t index = (int64_t)voice.position;
+            float t = (float)(voice.position - (double)index);
+            float next = index + 1 < length ? data[index + 1] : data[0];
+            float sample = data[index] + (next - data[index]) * t;
+            left[done] += sample * (voice.left + stepLeft * (float)done);
+            right[done] += sample * (voice.right + stepRight * (float)done);
+            voice.position += step;
+            done++;
+        }
+        if (voice.position >= (double)length) voice.position = std::fmod(voice.position, (double)length);
+    }
+
+    voice.left = targetLeft;
+    voice.right = targetRight;
+    return !voice.stopping;
+}
+
+void AudioMixer::mix(float* out, int frames) {
+    if (frames <= 0) return;
+    auto start = std::chrono::steady_clock::now();
+    frames = std::min(frames, AUDIO_BLOCK_FRAMES);
+    if (mixLeft.empty()) {
+        mixLeft.assign(AUDIO_BLOCK_FRAMES, 0.0f);
+        mixRight.assign(AUDIO_BLOCK_FRAMES, 0.0f);
+    }
+
+    Command command;
+    while (commands.pop(command)) apply(command);
+
+    float* left = mixLeft.data();
+    float* right = mixRight.data();
+    std::memset(left, 0, frames * sizeof(float));
+    std::memset(right, 0, frames * sizeof(float));
+
+    int active = 0;
+    for (int v = 0; v < AUDIO_MAX_VOICES; v++) {
+        Voice& voice = voices[v];
+        if (voice.handle == 0) continue;
+        if (mixVoice(voice, left, right, frames)) {
+            active++;
+        } else {
+            voice.handle = 0;
+            voiceHandles[v].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    if (music) music->mix(left, right, frames, busVolume[(int)AudioBus::MUSIC]);
+
+    // Clip to full scale and interleave
+    int i = 0;
+#ifdef MANSION_MIXER_SSE
+    const __m128 low = _mm_set1_ps(-1.0f);
+    const __m128 high = _mm_set1_ps(1.0f);
+    for (; i < (frames & ~3); i += 4) {
+        __m128 l = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(left + i), low), high);
+        __m128 r = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(right + i), low), high);
+        _mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(l, r));
+    }
+#endif
+    for (; i < frames; i++) {
+        out[i * 2] = std::max(-1.0f, std::min(1.0f, left[i]));
+        out[i * 2 + 1] = std::max(-1.0f, std::min(1.0f, right[i]));
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    activeVoices.store(active, std::memory_order_relaxed);
+    blocksMixed.fetch_add(1, std::memory_order_relaxed);
+    mixNanoseconds.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                             std::memory_order_relaxed);
+}
@@ -0,0 +1,201 @@
+#include "Batch2D.h"
+#include "GLExtensions.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+    // Corners of a quad as two triangles
+    const int QUAD_CORNERS[6] = {0, 1, 2, 0, 2, 3};
+
+    void packColor(const Color2D& color, uint8_t out[4]) {
+        const float channels[4] = {color.r, color.g, color.b, color.a};
+        for (int i = 0; i < 4; i++) {
+            out[i] = (uint8_t)(std::min(1.0f, std::max(0.0f, channels[i])) * 255.0f + 0.5f);
+        }
+    }
+
+    const float NO_TEX_COORDS[4][2] = {{0, 0}, {0, 0}, {0, 0}, {0, 0}};
+
+    const GLvoid* offsetPointer(const Vertex2D* base, size_t offset) {
+        return reinterpret_cast<const GLvoid*>(reinterpret_cast<const char*>(base) + offset);
+    }
+}
+
+Batch2D::Batch2D() : dirtyBegin(0), dirtyEnd(0), buffer(0), bufferCapacity(0) {
+}
+
+void Batch2D::clear() {
+    vertices.clear();
+    dirtyBegin = dirtyEnd = 0;
+}
+
+void Batch2D::markDirty(uint32_t first, uint32_t count) {
+    if (dirtyBegin >= dirtyEnd) {
+        dirtyBegin = first;
+        dirtyEnd = first + count;
+    } else {
+        dirtyBegin = std::min(dirtyBegin, first);
+        dirtyEnd = std::max(dirtyEnd, first + count);
+    }
+}
+
+Batch2D::Range Batch2D::appendQuad(const float corners[4][2], const float texCoords[4][2], const uint8_t* colors[4]) {
+    Range range = {(uint32_t)vertices.size(), 6};
+    for (int corner : QUAD_CORNERS) {
+        Vertex2D vertex;
+        vertex.position[0] = corners[corner][0];
+        vertex.position[1] = corners[corner][1];
+        vertex.texCoord[0] = texCoords[corner][0];
+        vertex.texCoord[1] = texCoords[corner][1];
+        memcpy(vertex.color, colors[corner], 4);
+        vertices.push_back(vertex);
+    }
+    markDirty(range.first, range.count);
+    return range;
+}
+
+Batch2D::Range Batch2D::addQuad(float x0, float y0, float x1, float y1, const Color2D& color) {
+    return addGradient(x0, y0, x1, y1, color, color);
+}
+
+Batch2D::Range Batch2D::addGradient(float x0, float y0, float x1, float y1, const Color2D& top, const Color2D& bottom) {
+    uint8_t topColor[4], bottomColor[4];
+    packColor(top, topColor);
+    packColor(bottom, bottomColor);
+
+    const float corners[4][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}};
+    const uint8_t* colors[4] = {topColor, topColor, bottomColor, bottomColor};
+    return appendQuad(corners, NO_TEX_COORDS, colors);
+}
+
+Batch2D::Range Batch2D::addLine(float x0, float y0, float x1, float y1, float width, const Color2D& color) {
+    uint8_t packed[4];
+    packColor(color, packed);
+
+    // Widened sideways into a quad so lines share the triangle stream
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    float length = std::sqrt(dx * dx + dy * dy);
+    float nx = 0.0f, ny = 0.0f;
+    if (length > 0.0f) {
+        nx = -dy / length * width * 0.5f;
+        ny = dx / length * width * 0.5f;
+    }
+
+    const float corners[4][2] = {{x0 + nx, y0 + ny}, {x1 + nx, y1 + ny}, {x1 - nx, y1 - ny}, {x0 - nx, y0 - ny}};
+    const uint8_t* colors[4] = {packed, packed, packed, packed};
+    return appendQuad(corners, NO_TEX_COORDS, colors);
+}
+
+Batch2D::Range Batch2D::addTexturedQuad(float x0, float y0, float x1, float y1,
+                                        float u0, float v0, float u1, float v1, const Color2D& color) {
+    uint8_t packed[4];
+    packColor(color, packed);
+
+    const float corners[4][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}};
+    const float texCoords[4][2] = {{u0, v0}, {u1, v0}, {u1, v1}, {u0, v1}};
+    const uint8_t* colors[4] = {packed, packed, packed, packed};
+    return appendQuad(corners, texCoords, colors);
+}
+
+Batch2D::Range Batch2D::addOutline(float x0, float y0, float x1, float y1, float width, const Color2D& color) {
+    Range range = addLine(x0, y0, x1, y0, width, color);
+    addLine(x1, y0, x1, y1, width, color);
+    addLine(x1, y1, x0, y1, width, color);
+    addLine(x0, y1, x0, y0, width, color);
+    range.count *= 4;
+    return range;
+}
+
+void Batch2D::setColor(const Range& range, const Color2D& color) {
+    uint8_t packed[4];
+    packColor(color, packed);
+
+    for (uint32_t i = range.first; i < range.first + range.count; i++) {
+        if (memcmp(vertices[i].color, packed, 4) != 0) {
+            memcpy(vertices[i].color, packed, 4);
+            markDirty(i, 1);
+        }
+    }
+}
+
+void Batch2D::setGradient(const Range& quad, const Color2D& top, const Color2D& bottom) {
+    uint8_t topColor[4], bottomColor[4];
+    packColor(top, topColor);
+    packColor(bottom, bottomColor);
+
+    for (int i = 0; i < 6; i++) {
+        const uint8_t* color = QUAD_CORNERS[i] < 2 ? topColor : bottomColor;
+        Vertex2D& vertex = vertices[quad.first + i];
+        if (memcmp(vertex.color, color, 4) != 0) {
+            memcpy(vertex.color, color, 4);
+            markDirty(quad.first + i, 1);
+        }
+    }
+}
+
+void Batch2D::setQuad(const Range& quad, float x0, float y0, float x1, float y1) {
+    const float corners[4][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}};
+
+    for (int i = 0; i < 6; i++) {
+        const float* corner = corners[QUAD_CORNERS[i]];
+        Vertex2D& vertex = vertices[quad.first + i];
+        if (vertex.position[0] != corner[0] || vertex.position[1] != corner[1]) {
+            vertex.position[0] = corner[0];
+            vertex.position[1] = corner[1];
+            markDirty(quad.first + i, 1);
+        }
+    }
+}
+
+void Batch2D::draw() {
+    if (vertices.empty()) return;
+
+    const GLExtensions& gl = getGL();
+    const Vertex2D* base = vertices.data();
+
+    if (gl.vertexBuffers) {
+        if (!buffer) {
+            gl.genBuffers(1, &buffer);
+        }
+        gl.bindBuffer(GL_ARRAY_BUFFER, buffer);
+
+        if (bufferCapacity < vertices.size()) {
+            bufferCapacity = vertices.capacity();
+            gl.bufferData(GL_ARRAY_BUFFER, bufferCapacity * sizeof(Vertex2D), nullptr, GL_DYNAMIC_DRAW);
+            markDirty(0, (uint32_t)vertices.size());
+        }
+        if (dirtyBegin < dirtyEnd) {
+            gl.bufferSubData(GL_ARRAY_BUFFER, dirtyBegin * sizeof(Vertex2D),
+                             (dirtyEnd - dirtyBegin) * sizeof(Vertex2D), &vertices[dirtyBegin]);
+        }
+        base = nullptr;
+    }
+    dirtyBegin = dirtyEnd = 0;
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(Vertex2D), offsetPointer(base, offsetof(Vertex2D, position)));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex2D), offsetPointer(base, offsetof(Vertex2D, texCoord)));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex2D), offsetPointer(base, offsetof(Vertex2D, color)));
+
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    if (gl.vertexBuffers) {
+        gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+void Batch2D::release() {
+    if (buffer) {
+        getGL().deleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+    bufferCapacity = 0;
+}
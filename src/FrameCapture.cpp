@@ -0,0 +1,243 @@
+#include "FrameCapture.h"
+#include "GLExtensions.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+FrameCapture::FrameCapture(int width, int height)
+    // 4:2:0 halves both axes, so the picture has to be even
+    : width(width & ~1), height(height & ~1), recording(false), ring{}, next(0), frameCount(0),
+      elapsed(0.0f), owed(0), stopping(false), file(nullptr), framesWritten(0), framesDropped(0) {
+}
+
+FrameCapture::~FrameCapture() {
+    stop();
+}
+
+bool FrameCapture::start(const std::string& outputPath) {
+    const GLExtensions& gl = getGL();
+    stop();
+
+    if (!gl.pixelBuffers) {
+        std::cerr << "Frame capture needs pixel buffer objects" << std::endl;
+        return false;
+    }
+
+    file = fopen(outputPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Couldn't open capture file " << outputPath << std::endl;
+        return false;
+    }
+    fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, FRAME_RATE);
+
+    size_t frameBytes = (size_t)width * height * 4;
+    for (auto& slot : ring) {
+        slot = Slot{0, nullptr, 0, 0, nullptr, SlotState::FREE};
+        gl.genBuffers(1, &slot.buffer);
+        gl.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        gl.bufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+    }
+    gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    yuv.resize((size_t)width * height * 3 / 2);
+
+    path = outputPath;
+    next = 0;
+    frameCount = 0;
+    elapsed = 1.0f / FRAME_RATE;    // The first frame goes in straight away
+    owed = 0;
+    stopping = false;
+    framesWritten = 0;
+    framesDropped = 0;
+    recording = true;
+    writer = std::thread(&FrameCapture::writerLoop, this);
+
+    std::cout << "Recording " << width << "x" << height << " to " << path << std::endl;
+    return true;
+}
+
+void FrameCapture::stop() {
+    if (!recording) return;
+    const GLExtensions& gl = getGL();
+
+    // Mapping waits for the GPU, which is fine once recording is over. The
+    // first pass hands every finished read to the writer, the second takes
+    // the buffers back.
+    collect(true);
+    collect(true);
+
+    {
+        std::lock_guard<std::mutex> lock(slotMutex);
+        stopping = true;
+    }
+    slotCondition.notify_all();
+    writer.join();
+
+    fclose(file);
+    file = nullptr;
+
+    for (auto& slot : ring) {
+        gl.deleteBuffers(1, &slot.buffer);
+        slot = Slot{0, nullptr, 0, 0, nullptr, SlotState::FREE};
+    }
+    std::vector<uint8_t>().swap(yuv);
+    recording = false;
+
+    std::cout << "Recorded " << framesWritten << " frames to " << path
+              << " (" << framesDropped << " dropped)" << std::endl;
+}
+
+void FrameCapture::captureFrame(float deltaTime) {
+    if (!recording) return;
+    const GLExtensions& gl = getGL();
+    frameCount++;
+    collect(false);
+
+    elapsed += deltaTime;
+    int repeat = (int)(elapsed * FRAME_RATE);
+    if (repeat == 0) return;
+    elapsed -= (float)repeat / FRAME_RATE;
+
+    // The GPU or the writer is a whole ring behind; waiting here is what the ring avoids
+    Slot& slot = ring[next];
+    {
+        std::lock_guard<std::mutex> lock(slotMutex);
+        if (slot.state != SlotState::FREE) {
+            owed += repeat;
+            framesDropped++;
+            return;
+        }
+    }
+
+    // Rows come bottom up; BGRA is the layout drivers copy without swizzling
+    gl.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+    gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (gl.sync) {
+        slot.fence = gl.fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    slot.frame = frameCount;
+    slot.repeat = repeat;
+    slot.state = SlotState::READING;
+    next = (next + 1) % RING_SIZE;
+}
+
+bool FrameCapture::isReady(const Slot& slot) const {
+    if (slot.fence) {
+        GLenum status = getGL().clientWaitSync(slot.fence, 0, 0);
+        return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+    }
+    // Without fences, trust that a read is done once the ring has nearly gone round
+    return frameCount - slot.frame >= RING_SIZE - 1;
+}
+
+void FrameCapture::collect(bool wait) {
+    const GLExtensions& gl = getGL();
+
+    // Oldest first from next: written, then with the writer, then still reading
+    for (int i = 0; i < RING_SIZE; i++) {
+        int index = (next + i) % RING_SIZE;
+        Slot& slot = ring[index];
+
+        SlotState state;
+        {
+            std::unique_lock<std::mutex> lock(slotMutex);
+            if (wait) {
+                slotCondition.wait(lock, [&slot] { return slot.state != SlotState::MAPPED; });
+            }
+            state = slot.state;
+        }
+
+        if (state == SlotState::WRITTEN) {
+            gl.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            gl.unmapBuffer(GL_PIXEL_PACK_BUFFER);
+            gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.pixels = nullptr;
+            std::lock_guard<std::mutex> lock(slotMutex);
+            slot.state = SlotState::FREE;
+        } else if (state == SlotState::READING) {
+            // Reads finish in the order they were issued, so stop at the first one still going
+            if (!wait && !isReady(slot)) break;
+
+            gl.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            slot.pixels = static_cast<const uint8_t*>(gl.mapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+            gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            if (slot.fence) {
+                gl.deleteSync(slot.fence);
+                slot.fence = nullptr;
+            }
+
+            std::lock_guard<std::mutex> lock(slotMutex);
+            if (slot.pixels) {
+                slot.repeat += owed;
+                owed = 0;
+                slot.state = SlotState::MAPPED;
+                queued.push_back(index);
+            } else {
+                // Lost the buffer's contents; its time goes to the next frame kept
+                owed += slot.repeat;
+                framesDropped++;
+                slot.state = SlotState::FREE;
+            }
+        }
+    }
+    slotCondition.notify_all();
+}
+
+void FrameCapture::writerLoop() {
+    for (;;) {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(slotMutex);
+            slotCondition.wait(lock, [this] { return !queued.empty() || stopping; });
+            if (queued.empty()) return;
+            index = queued.front();
+            queued.pop_front();
+        }
+
+        Slot& slot = ring[index];
+        convert(slot.pixels);
+        for (int i = 0; i < slot.repeat; i++) {
+            fwrite("FRAME\n", 1, 6, file);
+            fwrite(yuv.data(), 1, yuv.size(), file);
+        }
+        framesWritten += slot.repeat;
+
+        {
+            std::lock_guard<std::mutex> lock(slotMutex);
+            slot.state = SlotState::WRITTEN;
+        }
+        slotCondition.notify_all();
+    }
+}
+
+void FrameCapture::convert(const uint8_t* bgra) {
+    // Full-range BT.601 in 8.8 fixed point, chroma from each 2x2 block
+    uint8_t* lumaPlane = yuv.data();
+    uint8_t* bluePlane = lumaPlane + (size_t)width * height;
+    uint8_t* redPlane = bluePlane + (size_t)(width / 2) * (height / 2);
+    size_t stride = (size_t)width * 4;
+
+    for (int y = 0; y < height; y += 2) {
+        const uint8_t* rows[2] = {bgra + (height - 1 - y) * stride, bgra + (height - 2 - y) * stride};
+        uint8_t* luma[2] = {lumaPlane + (size_t)y * width, lumaPlane + (size_t)(y + 1) * width};
+        uint8_t* blue = bluePlane + (size_t)(y / 2) * (width / 2);
+        uint8_t* red = redPlane + (size_t)(y / 2) * (width / 2);
+
+        for (int x = 0; x < width; x += 2) {
+            int r = 0, g = 0, b = 0;
+            for (int row = 0; row < 2; row++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    const uint8_t* p = rows[row] + (x + dx) * 4;
+                    luma[row][x + dx] = (uint8_t)((77 * p[2] + 150 * p[1] + 29 * p[0] + 128) >> 8);
+                    r += p[2];
+                    g += p[1];
+                    b += p[0];
+                }
+            }
+            // Sums of four, so the shift is two more; the offset keeps them positive
+            blue[x / 2] = (uint8_t)std::min(255, (-43 * r - 85 * g + 128 * b + (128 << 10) + 512) >> 10);
+            red[x / 2] = (uint8_t)std::min(255, (128 * r - 107 * g - 21 * b + (128 << 10) + 512) >> 10);
+        }
+    }
+}
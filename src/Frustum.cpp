@@ -0,0 +1,126 @@
+#include "Frustum.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MANSION_FRUSTUM_SSE 1
+#endif
+
+namespace {
+    const float DEG_TO_RAD = 3.14159265f / 180.0f;
+
+    // Fog factor below which a channel can't change by a whole 8-bit step
+    const float FOG_OPAQUE_FACTOR = 1.0f / 255.0f;
+}
+
+void BoundsSoA::clear() {
+    minX.clear(); minY.clear(); minZ.clear();
+    maxX.clear(); maxY.clear(); maxZ.clear();
+    count = 0;
+}
+
+int BoundsSoA::add(const AABB& box) {
+    minX.push_back(box.min.x); minY.push_back(box.min.y); minZ.push_back(box.min.z);
+    maxX.push_back(box.max.x); maxY.push_back(box.max.y); maxZ.push_back(box.max.z);
+    return count++;
+}
+
+AABB BoundsSoA::get(int index) const {
+    return AABB{Vector3(minX[index], minY[index], minZ[index]), Vector3(maxX[index], maxY[index], maxZ[index])};
+}
+
+float getFogOpaqueDistance(float density) {
+    // exp(-(density * z)^2) = factor
+    return sqrt(-log(FOG_OPAQUE_FACTOR)) / density;
+}
+
+Frustum::Frustum() : farDistance(0.0f) {
+    for (auto& plane : planes) {
+        plane = Plane{0.0f, 0.0f, 0.0f, 1.0f};
+    }
+}
+
+void Frustum::update(const Vector3& eye, float yaw, float pitch, float fovY, float aspect,
+                     float nearPlane, float farPlane) {
+    float cy = cos(yaw * DEG_TO_RAD), sy = sin(yaw * DEG_TO_RAD);
+    float cp = cos(pitch * DEG_TO_RAD), sp = sin(pitch * DEG_TO_RAD);
+
+    // Camera basis in world space, the inverse of setCamera's rotations
+    Vector3 forward(-sy * cp, sp, -cy * cp);
+    Vector3 right(cy, 0.0f, -sy);
+    Vector3 up(sy * sp, cp, cy * sp);
+
+    float tanV = tan(fovY * 0.5f * DEG_TO_RAD);
+    float tanH = tanV * aspect;
+
+    auto makePlane = [&](const Vector3& normal, float offset) {
+        return Plane{normal.x, normal.y, normal.z, offset - normal.dot(eye)};
+    };
+
+    farDistance = farPlane;
+    planes[0] = makePlane(forward, -nearPlane);
+    planes[1] = makePlane(forward * -1.0f, farPlane);
+    planes[2] = makePlane(right + forward * tanH, 0.0f);
+    planes[3] = makePlane(right * -1.0f + forward * tanH, 0.0f);
+    planes[4] = makePlane(up + forward * tanV, 0.0f);
+    planes[5] = makePlane(up * -1.0f + forward * tanV, 0.0f);
+}
+
+bool Frustum::isVisible(const AABB& box) const {
+    for (const auto& plane : planes) {
+        float px = plane.x > 0.0f ? box.max.x : box.min.x;
+        float py = plane.y > 0.0f ? box.max.y : box.min.y;
+        float pz = plane.z > 0.0f ? box.max.z : box.min.z;
+        if (plane.x * px + plane.y * py + plane.z * pz + plane.d < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int Frustum::cull(const BoundsSoA& bounds, const int* indices, int count, int* visible) const {
+    int written = 0;
+    int i = 0;
+
+#ifdef MANSION_FRUSTUM_SSE
+    // Four boxes per pass; each plane picks min or max per axis once for
+    // all four lanes since the normal is shared
+    for (; i + 4 <= count; i += 4) {
+        int a = indices[i], b = indices[i + 1], c = indices[i + 2], d = indices[i + 3];
+        __m128 minX = _mm_setr_ps(bounds.minX[a], bounds.minX[b], bounds.minX[c], bounds.minX[d]);
+        __m128 minY = _mm_setr_ps(bounds.minY[a], bounds.minY[b], bounds.minY[c], bounds.minY[d]);
+        __m128 minZ = _mm_setr_ps(bounds.minZ[a], bounds.minZ[b], bounds.minZ[c], bounds.minZ[d]);
+        __m128 maxX = _mm_setr_ps(bounds.maxX[a], bounds.maxX[b], bounds.maxX[c], bounds.maxX[d]);
+        __m128 maxY = _mm_setr_ps(bounds.maxY[a], bounds.maxY[b], bounds.maxY[c], bounds.maxY[d]);
+        __m128 maxZ = _mm_setr_ps(bounds.maxZ[a], bounds.maxZ[b], bounds.maxZ[c], bounds.maxZ[d]);
+
+        __m128 outside = _mm_setzero_ps();
+        for (const auto& plane : planes) {
+            __m128 px = plane.x > 0.0f ? maxX : minX;
+            __m128 py = plane.y > 0.0f ? maxY : minY;
+            __m128 pz = plane.z > 0.0f ? maxZ : minZ;
+
+            __m128 dist = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(plane.x)), _mm_mul_ps(py, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.d)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        if (!(mask & 1)) visible[written++] = a;
+        if (!(mask & 2)) visible[written++] = b;
+        if (!(mask & 4)) visible[written++] = c;
+        if (!(mask & 8)) visible[written++] = d;
+    }
+#endif
+
+    for (; i < count; i++) {
+        int index = indices[i];
+        if (isVisible(bounds.get(index))) {
+            visible[written++] = index;
+        }
+    }
+
+    return written;
+}
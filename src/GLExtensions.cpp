@@ -0,0 +1,115 @@
+#include "GLExtensions.h"
+#include <SDL2/SDL.h>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+    GLExtensions extensions;
+
+    template <typename T>
+    bool load(T& fn, const char* name) {
+        fn = reinterpret_cast<T>(SDL_GL_GetProcAddress(name));
+        return fn != nullptr;
+    }
+}
+
+bool loadGLExtensions() {
+    memset(&extensions, 0, sizeof(extensions));
+
+    // Buffer objects are core since 1.5, so a 2.1 context always has them
+    bool buffers = load(extensions.genBuffers, "glGenBuffers");
+    buffers = load(extensions.deleteBuffers, "glDeleteBuffers") && buffers;
+    buffers = load(extensions.bindBuffer, "glBindBuffer") && buffers;
+    buffers = load(extensions.bufferData, "glBufferData") && buffers;
+    buffers = load(extensions.bufferSubData, "glBufferSubData") && buffers;
+    extensions.vertexBuffers = buffers;
+
+    if (!extensions.vertexBuffers) {
+        std::cerr << "Vertex buffer objects unavailable, using client-side arrays" << std::endl;
+    }
+
+    // Pack buffers are core in 2.1; mapping is all they add to the above
+    bool pixelBuffers = buffers && load(extensions.mapBuffer, "glMapBuffer");
+    pixelBuffers = load(extensions.unmapBuffer, "glUnmapBuffer") && pixelBuffers;
+    extensions.pixelBuffers = pixelBuffers;
+
+    bool sync = SDL_GL_ExtensionSupported("GL_ARB_sync") && load(extensions.fenceSync, "glFenceSync");
+    sync = sync && load(extensions.clientWaitSync, "glClientWaitSync");
+    sync = sync && load(extensions.deleteSync, "glDeleteSync");
+    extensions.sync = sync;
+
+    bool shaders = load(extensions.createShader, "glCreateShader");
+    shaders = load(extensions.deleteShader, "glDeleteShader") && shaders;
+    shaders = load(extensions.shaderSource, "glShaderSource") && shaders;
+    shaders = load(extensions.compileShader, "glCompileShader") && shaders;
+    shaders = load(extensions.getShaderiv, "glGetShaderiv") && shaders;
+    shaders = load(extensions.getShaderInfoLog, "glGetShaderInfoLog") && shaders;
+    shaders = load(extensions.createProgram, "glCreateProgram") && shaders;
+    shaders = load(extensions.deleteProgram, "glDeleteProgram") && shaders;
+    shaders = load(extensions.attachShader, "glAttachShader") && shaders;
+    shaders = load(extensions.bindAttribLocation, "glBindAttribLocation") && shaders;
+    shaders = load(extensions.linkProgram, "glLinkProgram") && shaders;
+    shaders = load(extensions.getProgramiv, "glGetProgramiv") && shaders;
+    shaders = load(extensions.getProgramInfoLog, "glGetProgramInfoLog") && shaders;
+    shaders = load(extensions.useProgram, "glUseProgram") && shaders;
+    shaders = load(extensions.getUniformLocation, "glGetUniformLocation") && shaders;
+    shaders = load(extensions.uniform1f, "glUniform1f") && shaders;
+    shaders = load(extensions.enableVertexAttribArray, "glEnableVertexAttribArray") && shaders;
+    shaders = load(extensions.disableVertexAttribArray, "glDisableVertexAttribArray") && shaders;
+    shaders = load(extensions.vertexAttribPointer, "glVertexAttribPointer") && shaders;
+    extensions.shaders = shaders;
+
+    // Drivers may offer the extension yet accept no formats, which makes it useless
+    bool binaries = shaders && SDL_GL_ExtensionSupported("GL_ARB_get_program_binary");
+    binaries = binaries && load(extensions.getProgramBinary, "glGetProgramBinary");
+    binaries = binaries && load(extensions.programBinary, "glProgramBinary");
+    binaries = binaries && load(extensions.programParameteri, "glProgramParameteri");
+    if (binaries) {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        binaries = formats > 0;
+    }
+    extensions.programBinaries = binaries;
+
+    if (shaders && SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile")) {
+        extensions.parallelCompile = load(extensions.maxShaderCompilerThreads, "glMaxShaderCompilerThreadsKHR");
+    } else if (shaders && SDL_GL_ExtensionSupported("GL_ARB_parallel_shader_compile")) {
+        extensions.parallelCompile = load(extensions.maxShaderCompilerThreads, "glMaxShaderCompilerThreadsARB");
+    }
+
+    // Instancing is core in 3.3 but a 2.1 context only has it via the ARB pair
+    bool instancing = SDL_GL_ExtensionSupported("GL_ARB_instanced_arrays") &&
+                      SDL_GL_ExtensionSupported("GL_ARB_draw_instanced");
+    instancing = instancing && load(extensions.vertexAttribDivisor, "glVertexAttribDivisorARB");
+    instancing = instancing && load(extensions.drawElementsInstanced, "glDrawElementsInstancedARB");
+    extensions.instancing = instancing && shaders && extensions.vertexBuffers;
+
+    // Same entry points and enums either way; only the EXT names carry a suffix
+    const char* suffix = nullptr;
+    if (SDL_GL_ExtensionSupported("GL_ARB_framebuffer_object")) {
+        suffix = "";
+    } else if (SDL_GL_ExtensionSupported("GL_EXT_framebuffer_object")) {
+        suffix = "EXT";
+    }
+    if (suffix) {
+        auto named = [&](const char* name) { return std::string(name) + suffix; };
+        bool framebuffers = load(extensions.genFramebuffers, named("glGenFramebuffers").c_str());
+        framebuffers = load(extensions.deleteFramebuffers, named("glDeleteFramebuffers").c_str()) && framebuffers;
+        framebuffers = load(extensions.bindFramebuffer, named("glBindFramebuffer").c_str()) && framebuffers;
+        framebuffers = load(extensions.framebufferTexture2D, named("glFramebufferTexture2D").c_str()) && framebuffers;
+        framebuffers = load(extensions.checkFramebufferStatus, named("glCheckFramebufferStatus").c_str()) && framebuffers;
+        framebuffers = load(extensions.genRenderbuffers, named("glGenRenderbuffers").c_str()) && framebuffers;
+        framebuffers = load(extensions.deleteRenderbuffers, named("glDeleteRenderbuffers").c_str()) && framebuffers;
+        framebuffers = load(extensions.bindRenderbuffer, named("glBindRenderbuffer").c_str()) && framebuffers;
+        framebuffers = load(extensions.renderbufferStorage, named("glRenderbufferStorage").c_str()) && framebuffers;
+        framebuffers = load(extensions.framebufferRenderbuffer, named("glFramebufferRenderbuffer").c_str()) && framebuffers;
+        extensions.framebuffers = framebuffers;
+    }
+
+    return extensions.vertexBuffers;
+}
+
+const GLExtensions& getGL() {
+    return extensions;
+}
@@ -0,0 +1,475 @@
+#include "GLRenderBackend.h"
+#include "StaticGeometry.h"
+#include "InstanceRenderer.h"
+#include "ShaderLibrary.h"
+#include "TextRenderer.h"
+#include "Batch2D.h"
+#include "GLExtensions.h"
+#include <GL/gl.h>
+#include <GL/glu.h>
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace {
+    // Everything the scene draws with; fog is added to all of them when it's on
+    const uint32_t SHADER_PERMUTATIONS[] = {
+        0,                                      // Points
+        SHADER_LIT,                             // Walls without a bake, expanded instances
+        SHADER_LIT | SHADER_LIGHTMAP,
+        SHADER_LIT | SHADER_FLOOR_TEXTURE,
+        SHADER_INSTANCED,
+        SHADER_INSTANCED | SHADER_ANIMATED,
+        SHADER_INSTANCED | SHADER_LIT,
+        SHADER_INSTANCED | SHADER_LIT | SHADER_ANIMATED,
+        SHADER_INSTANCED | SHADER_BILLBOARD     // Particles
+    };
+
+    // Per-user and writable, unlike the install directory
+    std::string getShaderCacheDirectory() {
+        char* path = SDL_GetPrefPath("MansionHorror", "ShaderCache");
+        if (!path) return std::string();
+        std::string directory = path;
+        SDL_free(path);
+        return directory;
+    }
+}
+
+GLRenderBackend::GLRenderBackend()
+    : settings{}, glyphTexture(0), sceneFramebuffer(0), sceneColor(0), sceneDepth(0),
+      sceneWidth(0), sceneHeight(0), sceneActive(false), pointLightBase(0), activePointLights(0),
+      bakedLighting(false), materialLit(false) {
+}
+
+GLRenderBackend::~GLRenderBackend() {
+}
+
+void GLRenderBackend::initialize(const RenderSettings& renderSettings) {
+    settings = renderSettings;
+
+    loadGLExtensions();
+    shaders = std::make_unique<ShaderLibrary>();
+    shaders->initialize(std::vector<uint32_t>(std::begin(SHADER_PERMUTATIONS), std::end(SHADER_PERMUTATIONS)),
+                        settings.fogEnabled, getShaderCacheDirectory());
+    staticGeometry = std::make_unique<StaticGeometry>();
+    instances = std::make_unique<InstanceRenderer>();
+    instances->initialize(*shaders);
+
+    std::vector<uint8_t> atlas;
+    TextRenderer::buildAtlas(atlas);
+    glGenTextures(1, &glyphTexture);
+    glBindTexture(GL_TEXTURE_2D, glyphTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, TextRenderer::ATLAS_SIZE, TextRenderer::ATLAS_SIZE, 0,
+                 GL_ALPHA, GL_UNSIGNED_BYTE, atlas.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (!createSceneTarget()) {
+        std::cerr << "Offscreen rendering unavailable, scene stays at native resolution" << std::endl;
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    setupLighting();
+
+    // Enhanced fog settings
+    if (settings.fogEnabled) {
+        glEnable(GL_FOG);
+        glFogi(GL_FOG_MODE, GL_EXP2);
+        float fogColor[4] = {settings.fogColor[0], settings.fogColor[1], settings.fogColor[2], 1.0f};
+        glFogfv(GL_FOG_COLOR, fogColor);
+        glFogf(GL_FOG_DENSITY, settings.fogDensity);
+        glHint(GL_FOG_HINT, GL_NICEST);
+    }
+
+    // Everything above went around the cache
+    stateCache.invalidate();
+}
+
+void GLRenderBackend::release() {
+    if (staticGeometry) {
+        staticGeometry->release();
+    }
+    if (instances) {
+        instances->release();
+    }
+    if (shaders) {
+        shaders->release();
+    }
+    if (glyphTexture) {
+        glDeleteTextures(1, &glyphTexture);
+        glyphTexture = 0;
+    }
+    releaseSceneTarget();
+}
+
+bool GLRenderBackend::createSceneTarget() {
+    const GLExtensions& gl = getGL();
+    if (!gl.framebuffers) return false;
+
+    glGenTextures(1, &sceneColor);
+    glBindTexture(GL_TEXTURE_2D, sceneColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, settings.screenWidth, settings.screenHeight, 0,
+                 GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    gl.genRenderbuffers(1, &sceneDepth);
+    gl.bindRenderbuffer(GL_RENDERBUFFER, sceneDepth);
+    gl.renderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, settings.screenWidth, settings.screenHeight);
+    gl.bindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    gl.genFramebuffers(1, &sceneFramebuffer);
+    gl.bindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    gl.framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+    gl.framebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, sceneDepth);
+    GLenum status = gl.checkFramebufferStatus(GL_FRAMEBUFFER);
+    gl.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        releaseSceneTarget();
+        return false;
+    }
+    return true;
+}
+
+void GLRenderBackend::releaseSceneTarget() {
+    const GLExtensions& gl = getGL();
+    if (sceneFramebuffer) {
+        gl.deleteFramebuffers(1, &sceneFramebuffer);
+        sceneFramebuffer = 0;
+    }
+    if (sceneDepth) {
+        gl.deleteRenderbuffers(1, &sceneDepth);
+        sceneDepth = 0;
+    }
+    if (sceneColor) {
+        glDeleteTextures(1, &sceneColor);
+        sceneColor = 0;
+    }
+}
+
+void GLRenderBackend::setupLighting() {
+    glEnable(GL_LIGHTING);
+    glEnable(GL_COLOR_MATERIAL);
+    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+
+    // The base level the old overhead light gave every surface, now from
+    // the light model so it doesn't fade with the flashlight's falloff
+    float ambient[] = {0.2f + settings.ambientLight, 0.2f + settings.ambientLight, 0.2f + settings.ambientLight, 1.0f};
+    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambient);
+    bakedLighting = false;
+    // Room walls face outwards but are mostly seen, and lit, from inside
+    glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE);
+    if (getGL().shaders) {
+        glEnable(GL_VERTEX_PROGRAM_TWO_SIDE);
+    }
+
+    float black[] = {0.0f, 0.0f, 0.0f, 1.0f};
+    for (int i = 0; i <= MAX_SCENE_LIGHTS; i++) {
+        glLightfv(GL_LIGHT0 + i, GL_AMBIENT, black);
+        glLightfv(GL_LIGHT0 + i, GL_SPECULAR, black);
+        glDisable(GL_LIGHT0 + i);
+    }
+
+    // Flashlight: a narrow warm beam that carries about a room's length
+    float beam[] = {1.0f, 0.95f, 0.8f, 1.0f};
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, beam);
+    glLightf(GL_LIGHT0, GL_SPOT_CUTOFF, 28.0f);
+    glLightf(GL_LIGHT0, GL_SPOT_EXPONENT, 12.0f);
+    glLightf(GL_LIGHT0, GL_CONSTANT_ATTENUATION, 1.0f);
+    glLightf(GL_LIGHT0, GL_LINEAR_ATTENUATION, 0.02f);
+    glLightf(GL_LIGHT0, GL_QUADRATIC_ATTENUATION, 0.01f);
+
+    glEnable(GL_NORMALIZE);
+}
+
+void GLRenderBackend::setupPerspective(const CameraSetup& camera) {
+    if (!stateCache.setProjection(ProjectionMode::PERSPECTIVE)) return;
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(camera.fieldOfView, camera.aspect, camera.nearPlane, camera.farPlane);
+    glMatrixMode(GL_MODELVIEW);
+    counters.matrixLoads++;
+}
+
+void GLRenderBackend::setup2D() {
+    shaders->unbind();
+    if (stateCache.setProjection(ProjectionMode::ORTHO)) {
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        glOrtho(0, settings.screenWidth, settings.screenHeight, 0, -1, 1);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        counters.matrixLoads += 2;
+    }
+
+    stateCache.setCapability(GL_DEPTH_TEST, false);
+    stateCache.setCapability(GL_LIGHTING, false);
+    stateCache.setCapability(GL_BLEND, true);
+}
+
+void GLRenderBackend::releaseEvicted(const LevelStreamer& streamer) {
+    staticGeometry->releaseEvicted(streamer);
+}
+
+void GLRenderBackend::beginFrame(float animationTime) {
+    counters.frames++;
+    instances->setTime(animationTime);
+    shaders->setTime(animationTime);
+
+    // Fog colour, so nothing pops where the far plane cuts fully fogged geometry.
+    // The transparent pass may have left depth writes off, which clear obeys.
+    stateCache.setDepthMask(true);
+    glClearColor(settings.fogColor[0], settings.fogColor[1], settings.fogColor[2], 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GLRenderBackend::endFrame() {
+    // Swap is handled by SDL; the cache keeps its own tally between frames
+    counters.stateChanges += stateCache.getStateChanges();
+    stateCache.resetCounters();
+    counters.programBinds += shaders->getProgramBinds();
+    shaders->resetCounters();
+}
+
+void GLRenderBackend::setCamera(const CameraSetup& camera) {
+    setupPerspective(camera);
+    glLoadIdentity();
+    counters.matrixLoads++;
+
+    glRotatef(-camera.pitch, 1.0f, 0.0f, 0.0f);
+    glRotatef(-camera.yaw, 0.0f, 1.0f, 0.0f);
+    glTranslatef(-camera.position.x, -camera.position.y, -camera.position.z);
+
+    // Point lights shift down a slot when the flashlight goes off and up when
+    // it comes on; the renderer sets them again before its next lit draw
+    int base = camera.flashlight ? 1 : 0;
+    if (base != pointLightBase) {
+        for (int i = 0; i < activePointLights; i++) {
+            glDisable(GL_LIGHT0 + pointLightBase + i);
+        }
+        activePointLights = 0;
+        pointLightBase = base;
+    }
+
+    if (camera.flashlight) {
+        // Positions and directions go through the view just loaded
+        float yaw = camera.yaw * (float)M_PI / 180.0f;
+        float pitch = camera.pitch * (float)M_PI / 180.0f;
+        float position[] = {camera.position.x, camera.position.y, camera.position.z, 1.0f};
+        float direction[] = {-std::sin(yaw) * std::cos(pitch), std::sin(pitch), -std::cos(yaw) * std::cos(pitch)};
+        glLightfv(GL_LIGHT0, GL_POSITION, position);
+        glLightfv(GL_LIGHT0, GL_SPOT_DIRECTION, direction);
+        glEnable(GL_LIGHT0);
+    } else {
+        glDisable(GL_LIGHT0);
+    }
+    shaders->setLightCount(pointLightBase + activePointLights);
+}
+
+void GLRenderBackend::beginScene(float scale) {
+    // Full size goes straight to the window, which beginFrame already cleared
+    if (!sceneFramebuffer || scale >= 1.0f) return;
+
+    sceneWidth = std::max(1, (int)std::lround(settings.screenWidth * scale));
+    sceneHeight = std::max(1, (int)std::lround(settings.screenHeight * scale));
+    sceneActive = true;
+
+    // Same aspect as the window, so the projection doesn't change
+    getGL().bindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glViewport(0, 0, sceneWidth, sceneHeight);
+    stateCache.setDepthMask(true);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GLRenderBackend::endScene() {
+    if (!sceneActive) return;
+    sceneActive = false;
+
+    getGL().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, settings.screenWidth, settings.screenHeight);
+
+    counters.drawCalls++;
+    counters.textureBinds++;
+    counters.vertices += 4;
+
+    // Opaque, filtered stretch of the used corner; texture rows run bottom up
+    setup2D();
+    stateCache.setCapability(GL_BLEND, false);
+    float u = (float)sceneWidth / settings.screenWidth;
+    float v = (float)sceneHeight / settings.screenHeight;
+    float w = (float)settings.screenWidth;
+    float h = (float)settings.screenHeight;
+
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, sceneColor);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, v); glVertex2f(0.0f, 0.0f);
+    glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, h);
+    glTexCoord2f(u, 0.0f); glVertex2f(w, h);
+    glTexCoord2f(u, v); glVertex2f(w, 0.0f);
+    glEnd();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+}
+
+void GLRenderBackend::setMaterial(RenderMaterial material, bool lit, bool blended) {
+    counters.materialChanges++;
+    materialLit = lit;
+
+    stateCache.setCapability(GL_DEPTH_TEST, true);
+    stateCache.setCapability(GL_LIGHTING, lit);
+    stateCache.setCapability(GL_BLEND, blended);
+    // Translucent surfaces test against depth but don't hide what's behind them
+    stateCache.setDepthMask(!blended);
+}
+
+void GLRenderBackend::setLights(const SceneLight* lights, int count) {
+    counters.lightChanges++;
+
+    for (int i = 0; i < MAX_SCENE_LIGHTS; i++) {
+        GLenum light = GL_LIGHT0 + pointLightBase + i;
+        if (light > GL_LIGHT7) break;
+
+        if (i >= count) {
+            if (i < activePointLights) glDisable(light);
+            continue;
+        }
+
+        const SceneLight& source = lights[i];
+        float position[] = {source.position[0], source.position[1], source.position[2], 1.0f};
+        float color[] = {source.color[0], source.color[1], source.color[2], 1.0f};
+        glLightfv(light, GL_POSITION, position);
+        glLightfv(light, GL_DIFFUSE, color);
+        glLightf(light, GL_CONSTANT_ATTENUATION, 1.0f);
+        glLightf(light, GL_QUADRATIC_ATTENUATION, SCENE_LIGHT_FALLOFF / (source.radius * source.radius));
+        if (i >= activePointLights) glEnable(light);
+    }
+
+    activePointLights = std::min(count, MAX_SCENE_LIGHTS + 1 - pointLightBase);
+    shaders->setLightCount(pointLightBase + activePointLights);
+}
+
+void GLRenderBackend::drawGround(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) {
+    counters.drawCalls++;
+    counters.textureBinds++;
+    counters.indices += count;
+    counters.vertices += count;
+    shaders->bind(SHADER_FLOOR_TEXTURE | (materialLit ? SHADER_LIT : 0));
+    staticGeometry->drawGround(chunk, payload, first, count);
+}
+
+void GLRenderBackend::setBakedLighting(bool baked) {
+    if (baked == bakedLighting) return;
+    bakedLighting = baked;
+
+    // Lightmaps already hold the ambient term, occlusion included
+    float level = baked ? 0.0f : 0.2f + settings.ambientLight;
+    float ambient[] = {level, level, level, 1.0f};
+    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambient);
+}
+
+void GLRenderBackend::beginChunks() {
+    staticGeometry->beginChunks();
+}
+
+void GLRenderBackend::drawChunkRange(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) {
+    counters.drawCalls++;
+    counters.indices += count;
+    counters.vertices += count;
+    setBakedLighting(payload.lightmap != nullptr);
+    shaders->bind((payload.lightmap ? SHADER_LIGHTMAP : 0) | (materialLit ? SHADER_LIT : 0));
+    staticGeometry->drawChunkRange(chunk, payload, first, count);
+}
+
+void GLRenderBackend::endChunks() {
+    staticGeometry->endChunks();
+    setBakedLighting(false);
+}
+
+void GLRenderBackend::drawInstances(InstanceMesh mesh, const InstanceData* data, size_t count, bool lit, bool animated) {
+    if (count == 0) return;
+    counters.drawCalls++;
+    counters.instances += (int)count;
+    counters.vertices += count * instances->getIndexCount(mesh);
+    instances->draw(mesh, data, count, lit, animated);
+}
+
+void GLRenderBackend::drawPoints(const ScenePoint* points, size_t count, float size) {
+    counters.drawCalls++;
+    counters.instances += (int)count;
+    counters.vertices += count;
+
+    // Points are sized in target pixels, so keep them the same on screen
+    if (sceneActive) {
+        size = std::max(1.0f, size * sceneWidth / settings.screenWidth);
+    }
+    glPointSize(size);
+    shaders->bind(0);
+    glBegin(GL_POINTS);
+    for (size_t i = 0; i < count; i++) {
+        glColor4ubv(points[i].color);
+        glVertex3fv(points[i].position);
+    }
+    glEnd();
+}
+
+void GLRenderBackend::drawBillboards(const BillboardData* billboards, size_t count) {
+    if (count == 0) return;
+    counters.drawCalls++;
+    counters.instances += (int)count;
+    counters.vertices += count * instances->getIndexCount(InstanceMesh::QUAD);
+    instances->drawBillboards(billboards, count);
+}
+
+void GLRenderBackend::drawSkinned(const SkinnedVertex* vertices, size_t count) {
+    if (count == 0) return;
+    counters.drawCalls++;
+    counters.vertices += count;
+
+    // Already posed, so the plain permutation lights it like any other mesh
+    shaders->bind(materialLit ? SHADER_LIT : 0);
+
+    GLsizei stride = sizeof(SkinnedVertex);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, vertices->position);
+    glNormalPointer(GL_FLOAT, stride, vertices->normal);
+    glColorPointer(4, GL_UNSIGNED_BYTE, stride, vertices->color);
+
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)count);
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void GLRenderBackend::drawBatch(Batch2D& batch) {
+    if (batch.isEmpty()) return;
+    counters.drawCalls++;
+    counters.textureBinds++;
+    counters.vertices += batch.getVertexCount();
+
+    setup2D();
+
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, glyphTexture);
+    batch.draw();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+}
@@ -0,0 +1,64 @@
+#include "GLStateCache.h"
+
+GLStateCache::GLStateCache() : stateChanges(0), redundantSkipped(0) {
+    invalidate();
+}
+
+void GLStateCache::invalidate() {
+    for (int& state : capabilities) {
+        state = -1;
+    }
+    depthMask = -1;
+    projection = ProjectionMode::UNKNOWN;
+}
+
+int GLStateCache::trackedIndex(GLenum cap) {
+    switch (cap) {
+        case GL_LIGHTING: return TRACK_LIGHTING;
+        case GL_DEPTH_TEST: return TRACK_DEPTH_TEST;
+        case GL_BLEND: return TRACK_BLEND;
+        default: return -1;
+    }
+}
+
+void GLStateCache::setCapability(GLenum cap, bool enabled) {
+    int index = trackedIndex(cap);
+    int wanted = enabled ? 1 : 0;
+
+    if (index >= 0 && capabilities[index] == wanted) {
+        redundantSkipped++;
+        return;
+    }
+
+    if (enabled) glEnable(cap); else glDisable(cap);
+    stateChanges++;
+    if (index >= 0) capabilities[index] = wanted;
+}
+
+void GLStateCache::setDepthMask(bool enabled) {
+    int wanted = enabled ? 1 : 0;
+    if (depthMask == wanted) {
+        redundantSkipped++;
+        return;
+    }
+
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    stateChanges++;
+    depthMask = wanted;
+}
+
+bool GLStateCache::setProjection(ProjectionMode mode) {
+    if (projection == mode) {
+        redundantSkipped++;
+        return false;
+    }
+
+    stateChanges++;
+    projection = mode;
+    return true;
+}
+
+void GLStateCache::resetCounters() {
+    stateChanges = 0;
+    redundantSkipped = 0;
+}
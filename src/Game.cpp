@@ -1,19 +1,30 @@
 #include "Game.h"
 #include "Player.h"
 #include "Monster.h"
+#include "MonsterAnimation.h"
 #include "TaskSystem.h"
 #include "Renderer.h"
+#include "GLRenderBackend.h"
 #include "InputHandler.h"
 #include "Menu.h"
 #include "AudioManager.h"
 #include "Mansion.h"
+#include "LevelStreamer.h"
+#include "LightmapFormat.h"
+#include "PortalCuller.h"
+#include "ParticleSystem.h"
+#include "FrameCapture.h"
+#include "MemoryArena.h"
+#include "MemoryTracker.h"
+#include <ctime>
 #include <iostream>
 
-Game::Game() 
-    : window(nullptr), glContext(nullptr), 
+Game::Game(const LaunchOptions& options)
+    : options(options), window(nullptr), glContext(nullptr),
       screenWidth(1280), screenHeight(720),
       running(false), currentState(GameState::PLAYING),
-      controlMode(ControlMode::DESKTOP), lastTime(0) {
+      controlMode(ControlMode::DESKTOP), lastTime(0), lastFrameStart(0), cpuFrameMs(0.0f), simFrameMs(0.0f),
+      monsterBreath(0), monsterStride(0.0f) {
 }
 
 Game::~Game() {
@@ -65,25 +76,121 @@ bool Game::initialize() {
     // Enable VSync
     SDL_GL_SetSwapInterval(1);
     
-    // Initialize game systems
-    renderer = std::make_unique<Renderer>(screenWidth, screenHeight);
-    renderer->initialize();
+    setupMemoryBudgets();
     
-    inputHandler = std::make_unique<InputHandler>();
-    inputHandler->setMouseGrabbed(true);
-    menu = std::make_unique<Menu>(this);
-    audioManager = std::make_unique<AudioManager>();
-    audioManager->initialize();
+    // Initialize game systems, charging each one's memory to its own tag
+    {
+        MemTagScope memScope(MemTag::RENDERER);
+        std::unique_ptr<RenderBackend> backend = std::make_unique<GLRenderBackend>();
+        if (!options.renderRecordPath.empty()) {
+            backend = std::make_unique<RecordingRenderBackend>(options.renderRecordPath, std::move(backend));
+        }
+        renderer = std::make_unique<Renderer>(screenWidth, screenHeight, std::move(backend));
+        renderer->initialize();
+        if (options.resolutionScale > 0.0f) {
+            renderer->getResolutionScaler().setEnabled(false);
+            renderer->getResolutionScaler().setScale(options.resolutionScale);
+        }
+        
+        capture = std::make_unique<FrameCapture>(screenWidth, screenHeight);
+        if (!options.capturePath.empty()) {
+            capture->start(options.capturePath);
+        }
+    }
+    
+    {
+        MemTagScope memScope(MemTag::INPUT);
+        inputHandler = std::make_unique<InputHandler>();
+        inputHandler->setMouseGrabbed(true);
+    }
+    
+    {
+        MemTagScope memScope(MemTag::MENU);
+        menu = std::make_unique<Menu>(this);
+    }
     
-    mansion = std::make_unique<Mansion>();
-    mansion->initialize();
+    {
+        MemTagScope memScope(MemTag::AUDIO);
+        audioManager = std::make_unique<AudioManager>();
+        audioManager->initialize(options.audioDevice);
+    }
     
-    player = std::make_unique<Player>(Vector3(5.0f, 0.0f, 5.0f));
-    monster = std::make_unique<Monster>(Vector3(50.0f, 0.0f, 50.0f));
-    monster->setPatrolPoints(mansion->getMonsterPatrolPoints());
+    {
+        MemTagScope memScope(MemTag::MANSION);
+        mansion = std::make_unique<Mansion>();
+        if (options.generateRooms > 0) {
+            MansionGenParams params;
+            params.seed = options.seed;
+            params.roomCount = options.generateRooms;
+            params.floors = options.floors;
+            params.wings = options.wings;
+            mansion->generate(params);
+        } else {
+            mansion->initialize(options.levelPath);
+        }
+    }
     
-    taskSystem = std::make_unique<TaskSystem>();
-    taskSystem->initialize();
+    {
+        MemTagScope memScope(MemTag::PLAYER);
+        player = std::make_unique<Player>(mansion->getPlayerStart());
+    }
+    
+    {
+        // Bring in the chunks around the start before the first frame
+        MemTagScope memScope(MemTag::MANSION);
+        streamer = std::make_unique<LevelStreamer>(*mansion);
+        
+        // Generated mansions have no file to sit beside, so only an explicit path
+        std::string lightmapPath = options.lightmapPath;
+        if (lightmapPath.empty() && options.generateRooms == 0) {
+            lightmapPath = getLightmapPath(options.levelPath);
+        }
+        lightmaps = std::make_unique<LightmapFile>();
+        if (!lightmapPath.empty() && lightmaps->open(lightmapPath) && streamer->setLightmaps(lightmaps.get())) {
+            std::cout << "Loaded lightmaps: " << lightmapPath << " (" << lightmaps->getPageCount() << " pages)" << std::endl;
+        }
+        
+        streamer->build();
+        streamer->update(player->getPosition());
+        streamer->flush();
+        
+        portalCuller = std::make_unique<PortalCuller>(*mansion);
+    }
+    
+    {
+        MemTagScope memScope(MemTag::RENDERER);
+        renderer->bakeStaticGeometry(*mansion);
+    }
+    
+    {
+        MemTagScope memScope(MemTag::MONSTER);
+        monster = std::make_unique<Monster>(mansion->getMonsterStart());
+        monster->setPatrolPoints(mansion->getMonsterPatrolPoints());
+        monsterAnimation = std::make_unique<MonsterAnimation>();
+        monsterAnimation->addInstance(monster->getPosition());
+    }
+    
+    {
+        MemTagScope memScope(MemTag::AUDIO);
+        monsterBreath = audioManager->addEmitter("breath", monster->getPosition(), 0.8f, AudioPriority::HIGH, true);
+    }
+    
+    {
+        MemTagScope memScope(MemTag::TASKS);
+        taskSystem = std::make_unique<TaskSystem>();
+        if (mansion->isGenerated()) {
+            taskSystem->setTasks(mansion->getGeneratedTasks());
+        } else if (mansion->getLevelFile().isOpen()) {
+            taskSystem->loadFromLevel(mansion->getLevelFile());
+        } else {
+            taskSystem->initialize();
+        }
+    }
+    
+    {
+        MemTagScope memScope(MemTag::PARTICLES);
+        particles = std::make_unique<ParticleSystem>();
+    }
     
     running = true;
     lastTime = SDL_GetTicks();
@@ -92,8 +199,26 @@ bool Game::initialize() {
     return true;
 }
 
+void Game::setupMemoryBudgets() {
+    // Fixed RAM envelope per subsystem; exceeding one only warns
+    MemoryTracker& tracker = getMemoryTracker();
+    tracker.setBudget(MemTag::RENDERER, 64 * 1024 * 1024);
+    tracker.setBudget(MemTag::MANSION, 32 * 1024 * 1024);
+    tracker.setBudget(MemTag::MONSTER, 8 * 1024 * 1024);
+    tracker.setBudget(MemTag::AUDIO, 64 * 1024 * 1024);
+    tracker.setBudget(MemTag::MENU, 2 * 1024 * 1024);
+    tracker.setBudget(MemTag::TASKS, 1 * 1024 * 1024);
+    tracker.setBudget(MemTag::PLAYER, 1 * 1024 * 1024);
+    tracker.setBudget(MemTag::INPUT, 1 * 1024 * 1024);
+    tracker.setBudget(MemTag::PARTICLES, 4 * 1024 * 1024);
+    tracker.setBudget(MemTag::ARENA, 8 * 1024 * 1024);
+}
+
 void Game::run() {
     while (running) {
+        // Transient allocations from two frames ago are no longer referenced
+        getFrameArena().beginFrame();
+        
         Uint32 currentTime = SDL_GetTicks();
         float deltaTime = (currentTime - lastTime) / 1000.0f;
         lastTime = currentTime;
@@ -101,9 +226,25 @@ void Game::run() {
         // Cap delta time to prevent large jumps
         if (deltaTime > 0.1f) deltaTime = 0.1f;
         
+        // CPU time up to the swap; the swap itself waits on vsync
+        double msPerTick = 1000.0 / SDL_GetPerformanceFrequency();
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+        
+        // Start to start does include the swap, and with it the GPU's share
+        if (lastFrameStart) {
+            renderer->updateResolution((float)((frameStart - lastFrameStart) * msPerTick));
+        }
+        lastFrameStart = frameStart;
+        
         handleEvents();
         update(deltaTime);
+        Uint64 simEnd = SDL_GetPerformanceCounter();
         render();
+        capture->captureFrame(deltaTime);
+        Uint64 frameEnd = SDL_GetPerformanceCounter();
+        
+        cpuFrameMs = (float)((frameEnd - frameStart) * msPerTick);
+        simFrameMs = (float)((simEnd - frameStart) * msPerTick);
         
         SDL_GL_SwapWindow(window);
     }
@@ -133,6 +274,18 @@ void Game::handleEvents() {
             running = false;
         }
         
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3) {
+            renderer->getPerfOverlay().toggle();
+        }
+        
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F9) {
+            getMemoryTracker().dumpReport(std::cout);
+        }
+        
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F10) {
+            toggleCapture();
+        }
+        
         if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
             if (currentState == GameState::MAIN_MENU || currentState == GameState::PAUSED ||
                 currentState == GameState::GAME_OVER || currentState == GameState::VICTORY) {
@@ -150,13 +303,29 @@ void Game::handleEvents() {
 }
 
 void Game::update(float deltaTime) {
-    inputHandler->update();
-    audioManager->update();
+    getMemoryTracker().update(deltaTime);
+    
+    {
+        MemTagScope memScope(MemTag::INPUT);
+        inputHandler->update();
+    }
+    {
+        MemTagScope memScope(MemTag::AUDIO);
+        audioManager->update(deltaTime, currentState == GameState::PLAYING);
+    }
     
     if (currentState == GameState::PLAYING) {
         // Update player
-        player->handleInput(*inputHandler, deltaTime, controlMode);
-        player->update(deltaTime);
+        {
+            MemTagScope memScope(MemTag::PLAYER);
+            player->handleInput(*inputHandler, deltaTime, controlMode);
+            player->update(deltaTime);
+        }
+        
+        {
+            MemTagScope memScope(MemTag::MANSION);
+            streamer->update(player->getPosition());
+        }
         
         // Check hiding spots
         HidingSpot* nearestSpot = mansion->getNearestHidingSpot(player->getPosition(), 2.0f);
@@ -168,12 +337,62 @@ void Game::update(float deltaTime) {
         }
         
         // Update monster
-        monster->update(deltaTime, player->getPosition(), player->isHiding());
+        {
+            MemTagScope memScope(MemTag::MONSTER);
+            if (streamer->isPositionLoaded(monster->getPosition())) {
+                monster->update(deltaTime, player->getPosition(), player->isHiding());
+            } else {
+                monster->updateCoarse(deltaTime);
+            }
+            monsterAnimation->setTarget(0, monster->getState(), monster->getPosition(), monster->getVelocity());
+            monsterAnimation->update(deltaTime);
+        }
+        
+        // Chase music while the monster is on the player, ambience otherwise,
+        // and the monster heard from where it is
+        {
+            MemTagScope memScope(MemTag::AUDIO);
+            audioManager->setListener(player->getPosition(), player->getYaw(), player->getVelocity());
+            
+            Vector3 monsterVelocity = monster->getVelocity();
+            audioManager->moveEmitter(monsterBreath, monster->getPosition(), monsterVelocity);
+            monsterStride += Vector3(monsterVelocity.x, 0.0f, monsterVelocity.z).length() * deltaTime;
+            if (monsterStride > 1.6f) {
+                monsterStride = 0.0f;
+                audioManager->playSound3D("footstep", monster->getPosition(), 1.0f, AudioPriority::HIGH);
+            }
+            
+            MonsterState monsterState = monster->getState();
+            bool chasing = monsterState == MonsterState::CHASE || monsterState == MonsterState::ATTACK;
+            audioManager->playMusic(chasing ? "chase" : "ambient");
+        }
+        
+        // Room around the player, for the particles that stay inside it
+        int roomIndex = mansion->findRoomAt(player->getPosition());
+        AABB roomBox;
+        if (roomIndex >= 0) {
+            const Room& room = mansion->getRooms()[roomIndex];
+            Vector3 half(room.size.x / 2.0f, 0.0f, room.size.z / 2.0f);
+            roomBox = AABB{room.position - half, room.position + half + Vector3(0.0f, room.size.y, 0.0f)};
+        }
         
         // Check if monster caught player
         float distToMonster = monster->getDistanceToPlayer(player->getPosition());
         if (distToMonster < 2.0f && !player->isHiding()) {
             player->takeDamage(30.0f * deltaTime);
+            
+            // Blood sprays from where the monster strikes, away from it, and a
+            // lot more of it for the killing blow
+            Vector3 away = player->getPosition() - monster->getPosition();
+            away = Vector3(away.x, 0.0f, away.z).normalize();
+            Vector3 hit = player->getPosition() + away * -0.5f + Vector3(0.0f, -0.6f, 0.0f);
+            float floorHeight = roomIndex >= 0 ? roomBox.min.y : 0.0f;
+            {
+                MemTagScope memScope(MemTag::PARTICLES);
+                particles->emit(ParticleType::BLOOD, hit, away * 1.5f + Vector3(0.0f, 1.0f, 0.0f), 1.2f, 0.1f,
+                                floorHeight, player->isAlive() ? 6 : 1500);
+            }
+            
             if (!player->isAlive()) {
                 currentState = GameState::GAME_OVER;
                 menu->setMenuType(MenuType::GAME_OVER_MENU);
@@ -182,8 +401,21 @@ void Game::update(float deltaTime) {
             }
         }
         
+        {
+            MemTagScope memScope(MemTag::PARTICLES);
+            particles->update(deltaTime, player->getPosition(), player->getYaw(), roomIndex >= 0 ? &roomBox : nullptr,
+                              player->getStamina() < 30.0f);
+        }
+        
         // Update tasks
-        taskSystem->update(player->getPosition());
+        {
+            MemTagScope memScope(MemTag::TASKS);
+            taskSystem->update(player->getPosition());
+        }
+        
+        if (inputHandler->isKeyJustPressed(SDLK_l)) {
+            renderer->setFlashlight(!renderer->isFlashlightOn());
+        }
         
         // Check for task interaction
         if (inputHandler->isKeyJustPressed(SDLK_f)) {
@@ -201,41 +433,72 @@ void Game::update(float deltaTime) {
         }
     } else if (currentState == GameState::MAIN_MENU || currentState == GameState::PAUSED ||
                currentState == GameState::GAME_OVER || currentState == GameState::VICTORY) {
+        MemTagScope memScope(MemTag::MENU);
         menu->update(*inputHandler);
     }
 }
 
 void Game::render() {
+    MemTagScope memScope(MemTag::RENDERER);
     renderer->beginFrame();
     
     if (currentState == GameState::PLAYING || currentState == GameState::PAUSED) {
         // Set camera
         renderer->setCamera(player->getPosition(), player->getYaw(), player->getPitch());
         
+        // Rooms visible from here through open doors
+        portalCuller->update(player->getPosition(), player->getYaw(), player->getPitch(),
+                             renderer->getFieldOfView(), renderer->getAspect(),
+                             renderer->getNearPlane(), renderer->getFarPlane());
+        
         // Render 3D scene
-        renderer->renderMansion(mansion->getRooms(), mansion->getDoors());
-        renderer->renderHidingSpots(mansion->getHidingSpots());
+        renderer->renderMansion(*streamer, *portalCuller);
+        renderer->renderHidingSpots(mansion->getHidingSpots(), *streamer, *portalCuller);
         renderer->renderTasks(taskSystem->getTasks());
-        renderer->renderMonster(*monster, player->getPosition());
+        renderer->renderMonsters(*monsterAnimation);
+        renderer->renderParticles(*particles);
+        renderer->submitScene();
         
         // Render HUD
         if (currentState == GameState::PLAYING) {
             renderer->renderHUD(*player, *taskSystem, *monster);
-            renderer->renderCrosshair();
         }
     }
     
     // Render menu overlay
     if (currentState != GameState::PLAYING) {
+        MemTagScope menuScope(MemTag::MENU);
         menu->render(*renderer);
     }
     
+    renderer->renderPerfOverlay(cpuFrameMs, simFrameMs);
     renderer->endFrame();
 }
 
+void Game::toggleCapture() {
+    if (capture->isRecording()) {
+        capture->stop();
+        return;
+    }
+    
+    // Named by wall-clock time so repeated takes don't overwrite each other
+    char name[64];
+    time_t now = time(nullptr);
+    strftime(name, sizeof(name), "capture_%Y%m%d_%H%M%S.y4m", localtime(&now));
+    MemTagScope memScope(MemTag::RENDERER);
+    capture->start(name);
+}
+
 void Game::cleanup() {
+    getMemoryTracker().dumpReport(std::cout);
+    
     audioManager->cleanup();
     
+    // GL objects have to go before the context does
+    capture->stop();
+    menu->cleanup();
+    renderer->cleanup();
+    
     if (glContext) {
         SDL_GL_DeleteContext(glContext);
     }
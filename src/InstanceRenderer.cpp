@@ -0,0 +1,314 @@
+#include "InstanceRenderer.h"
+#include "GLExtensions.h"
+#include "MemoryArena.h"
+#include "ShaderLibrary.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+namespace {
+    // Unit cube, four vertices and one normal per face
+    const float CUBE_VERTICES[24][6] = {
+        {-0.5f, -0.5f,  0.5f,  0, 0, 1}, { 0.5f, -0.5f,  0.5f,  0, 0, 1}, { 0.5f,  0.5f,  0.5f,  0, 0, 1}, {-0.5f,  0.5f,  0.5f,  0, 0, 1},
+        {-0.5f, -0.5f, -0.5f,  0, 0,-1}, {-0.5f,  0.5f, -0.5f,  0, 0,-1}, { 0.5f,  0.5f, -0.5f,  0, 0,-1}, { 0.5f, -0.5f, -0.5f,  0, 0,-1},
+        {-0.5f,  0.5f, -0.5f,  0, 1, 0}, {-0.5f,  0.5f,  0.5f,  0, 1, 0}, { 0.5f,  0.5f,  0.5f,  0, 1, 0}, { 0.5f,  0.5f, -0.5f,  0, 1, 0},
+        {-0.5f, -0.5f, -0.5f,  0,-1, 0}, { 0.5f, -0.5f, -0.5f,  0,-1, 0}, { 0.5f, -0.5f,  0.5f,  0,-1, 0}, {-0.5f, -0.5f,  0.5f,  0,-1, 0},
+        { 0.5f, -0.5f, -0.5f,  1, 0, 0}, { 0.5f,  0.5f, -0.5f,  1, 0, 0}, { 0.5f,  0.5f,  0.5f,  1, 0, 0}, { 0.5f, -0.5f,  0.5f,  1, 0, 0},
+        {-0.5f, -0.5f, -0.5f, -1, 0, 0}, {-0.5f, -0.5f,  0.5f, -1, 0, 0}, {-0.5f,  0.5f,  0.5f, -1, 0, 0}, {-0.5f,  0.5f, -0.5f, -1, 0, 0}
+    };
+
+    const uint16_t CUBE_INDICES[36] = {
+        0, 1, 2, 0, 2, 3,      4, 5, 6, 4, 6, 7,      8, 9, 10, 8, 10, 11,
+        12, 13, 14, 12, 14, 15, 16, 17, 18, 16, 18, 19, 20, 21, 22, 20, 22, 23
+    };
+
+    // Task marker octahedron, flat shaded
+    const float S = 0.4f;
+    const float N = 0.57735f;
+    const float OCTAHEDRON_VERTICES[24][6] = {
+        {0, S, 0,  N, N, N}, {S, 0, 0,  N, N, N}, {0, 0, S,  N, N, N},
+        {0, S, 0, -N, N, N}, {0, 0, S, -N, N, N}, {-S, 0, 0, -N, N, N},
+        {0, S, 0, -N, N,-N}, {-S, 0, 0, -N, N,-N}, {0, 0,-S, -N, N,-N},
+        {0, S, 0,  N, N,-N}, {0, 0,-S,  N, N,-N}, {S, 0, 0,  N, N,-N},
+        {0,-S, 0,  N,-N, N}, {0, 0, S,  N,-N, N}, {S, 0, 0,  N,-N, N},
+        {0,-S, 0, -N,-N, N}, {-S, 0, 0, -N,-N, N}, {0, 0, S, -N,-N, N},
+        {0,-S, 0, -N,-N,-N}, {0, 0,-S, -N,-N,-N}, {-S, 0, 0, -N,-N,-N},
+        {0,-S, 0,  N,-N,-N}, {S, 0, 0,  N,-N,-N}, {0, 0,-S,  N,-N,-N}
+    };
+
+    const uint16_t OCTAHEDRON_INDICES[24] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23
+    };
+
+    // Billboard quad; the normal is unused but keeps the layout of the others
+    const float QUAD_VERTICES[4][6] = {
+        {-0.5f, -0.5f, 0, 0, 0, 1}, {0.5f, -0.5f, 0, 0, 0, 1}, {0.5f, 0.5f, 0, 0, 0, 1}, {-0.5f, 0.5f, 0, 0, 0, 1}
+    };
+
+    const uint16_t QUAD_INDICES[6] = {0, 1, 2, 0, 2, 3};
+
+    // Expanded billboards per draw, sized to fit the thread scratch
+    const size_t BILLBOARD_BATCH = 2048;
+
+    const float PULSE_SCALE = 0.15f;
+    const float PULSE_GLOW = 0.2f;
+}
+
+InstanceRenderer::InstanceRenderer()
+    : shaders(nullptr), instanced(false), instanceBuffer(0), time(0.0f) {
+    meshes[(int)InstanceMesh::CUBE] = Mesh{
+        reinterpret_cast<const MeshVertex*>(CUBE_VERTICES), CUBE_INDICES, 24, 36, 0, 0};
+    meshes[(int)InstanceMesh::OCTAHEDRON] = Mesh{
+        reinterpret_cast<const MeshVertex*>(OCTAHEDRON_VERTICES), OCTAHEDRON_INDICES, 24, 24, 0, 0};
+    meshes[(int)InstanceMesh::QUAD] = Mesh{
+        reinterpret_cast<const MeshVertex*>(QUAD_VERTICES), QUAD_INDICES, 4, 6, 0, 0};
+}
+
+void InstanceRenderer::initialize(ShaderLibrary& library) {
+    const GLExtensions& gl = getGL();
+    shaders = &library;
+
+    // A batch whose permutation failed to build is expanded instead
+    instanced = gl.instancing && shaders->has(SHADER_INSTANCED);
+    if (!instanced) {
+        std::cout << "Instancing unavailable, expanding instances on the CPU" << std::endl;
+        return;
+    }
+
+    for (auto& mesh : meshes) {
+        gl.genBuffers(1, &mesh.vertexBuffer);
+        gl.bindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+        gl.bufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(MeshVertex), mesh.vertices, GL_STATIC_DRAW);
+
+        gl.genBuffers(1, &mesh.indexBuffer);
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+        gl.bufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexCount * sizeof(uint16_t), mesh.indices, GL_STATIC_DRAW);
+    }
+
+    gl.genBuffers(1, &instanceBuffer);
+    gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void InstanceRenderer::release() {
+    const GLExtensions& gl = getGL();
+    if (!instanced) return;
+
+    for (auto& mesh : meshes) {
+        gl.deleteBuffers(1, &mesh.vertexBuffer);
+        gl.deleteBuffers(1, &mesh.indexBuffer);
+        mesh.vertexBuffer = mesh.indexBuffer = 0;
+    }
+    gl.deleteBuffers(1, &instanceBuffer);
+    instanceBuffer = 0;
+    instanced = false;
+}
+
+void InstanceRenderer::draw(InstanceMesh meshType, const InstanceData* instances, size_t count, bool lit, bool animated) {
+    if (count == 0) return;
+
+    const Mesh& mesh = meshes[(int)meshType];
+
+    uint32_t features = (lit ? SHADER_LIT : 0) | (animated ? SHADER_ANIMATED : 0);
+    if (instanced && shaders->bind(SHADER_INSTANCED | features)) {
+        drawInstanced(mesh, instances, count);
+    } else {
+        drawExpanded(mesh, instances, count, lit, animated);
+    }
+}
+
+void InstanceRenderer::drawInstanced(const Mesh& mesh, const InstanceData* instances, size_t count) {
+    const GLExtensions& gl = getGL();
+
+    gl.bindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+    gl.enableVertexAttribArray(SHADER_ATTRIB_POSITION);
+    gl.enableVertexAttribArray(SHADER_ATTRIB_NORMAL);
+    gl.vertexAttribPointer(SHADER_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                           reinterpret_cast<const GLvoid*>(offsetof(MeshVertex, position)));
+    gl.vertexAttribPointer(SHADER_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                           reinterpret_cast<const GLvoid*>(offsetof(MeshVertex, normal)));
+
+    // Orphan the stream buffer so we never wait on the previous draw's copy
+    gl.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    gl.bufferData(GL_ARRAY_BUFFER, count * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    gl.bufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances);
+
+    struct InstanceAttribute {
+        GLuint slot;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        size_t offset;
+    };
+    const InstanceAttribute attributes[4] = {
+        {SHADER_ATTRIB_OFFSET, 3, GL_FLOAT, GL_FALSE, offsetof(InstanceData, position)},
+        {SHADER_ATTRIB_SCALE, 3, GL_FLOAT, GL_FALSE, offsetof(InstanceData, scale)},
+        {SHADER_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(InstanceData, color)},
+        {SHADER_ATTRIB_PHASE, 1, GL_FLOAT, GL_FALSE, offsetof(InstanceData, phase)}
+    };
+    for (const auto& attribute : attributes) {
+        gl.enableVertexAttribArray(attribute.slot);
+        gl.vertexAttribPointer(attribute.slot, attribute.size, attribute.type, attribute.normalized,
+                               sizeof(InstanceData), reinterpret_cast<const GLvoid*>(attribute.offset));
+        gl.vertexAttribDivisor(attribute.slot, 1);
+    }
+
+    gl.drawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT, nullptr, (GLsizei)count);
+
+    for (const auto& attribute : attributes) {
+        gl.vertexAttribDivisor(attribute.slot, 0);
+        gl.disableVertexAttribArray(attribute.slot);
+    }
+    gl.disableVertexAttribArray(SHADER_ATTRIB_NORMAL);
+    gl.disableVertexAttribArray(SHADER_ATTRIB_POSITION);
+    gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void InstanceRenderer::drawExpanded(const Mesh& mesh, const InstanceData* instances, size_t count, bool lit, bool animated) {
+    struct ExpandedVertex {
+        float position[3];
+        float normal[3];
+        uint8_t color[4];
+    };
+
+    // Pseudo-instancing: bake every copy into one frame-lifetime array
+    auto vertices = makeFrameVector<ExpandedVertex>(count * mesh.indexCount);
+    for (size_t i = 0; i < count; i++) {
+        const InstanceData& instance = instances[i];
+
+        float pulse = animated ? sin(time + instance.phase) : 0.0f;
+        float grow = 1.0f + PULSE_SCALE * pulse;
+        float glow = animated ? (1.0f - PULSE_GLOW) + PULSE_GLOW * pulse : 1.0f;
+
+        ExpandedVertex v;
+        for (int c = 0; c < 3; c++) {
+            v.color[c] = (uint8_t)std::min(255.0f, instance.color[c] * glow);
+        }
+        v.color[3] = instance.color[3];
+
+        for (GLsizei k = 0; k < mesh.indexCount; k++) {
+            const MeshVertex& source = mesh.vertices[mesh.indices[k]];
+            for (int c = 0; c < 3; c++) {
+                float scale = instance.scale[c] * grow;
+                v.position[c] = source.position[c] * scale + instance.position[c];
+                v.normal[c] = source.normal[c] / scale;    // GL_NORMALIZE fixes the length
+            }
+            vertices.push_back(v);
+        }
+    }
+
+    // The pulse is already baked in, so only the plain permutation is needed
+    shaders->bind(lit ? SHADER_LIT : 0);
+
+    GLsizei stride = sizeof(ExpandedVertex);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, vertices.data()->position);
+    glNormalPointer(GL_FLOAT, stride, vertices.data()->normal);
+    glColorPointer(4, GL_UNSIGNED_BYTE, stride, vertices.data()->color);
+
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void InstanceRenderer::drawBillboards(const BillboardData* billboards, size_t count) {
+    if (count == 0) return;
+    if (!instanced || !shaders->bind(SHADER_INSTANCED | SHADER_BILLBOARD)) {
+        drawBillboardsExpanded(billboards, count);
+        return;
+    }
+
+    const GLExtensions& gl = getGL();
+    const Mesh& mesh = meshes[(int)InstanceMesh::QUAD];
+
+    gl.bindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+    gl.enableVertexAttribArray(SHADER_ATTRIB_POSITION);
+    gl.vertexAttribPointer(SHADER_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                           reinterpret_cast<const GLvoid*>(offsetof(MeshVertex, position)));
+
+    gl.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    gl.bufferData(GL_ARRAY_BUFFER, count * sizeof(BillboardData), nullptr, GL_STREAM_DRAW);
+    gl.bufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(BillboardData), billboards);
+
+    // The size goes in the scale's first component
+    const struct {
+        GLuint slot;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        size_t offset;
+    } attributes[3] = {
+        {SHADER_ATTRIB_OFFSET, 3, GL_FLOAT, GL_FALSE, offsetof(BillboardData, position)},
+        {SHADER_ATTRIB_SCALE, 1, GL_FLOAT, GL_FALSE, offsetof(BillboardData, size)},
+        {SHADER_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(BillboardData, color)}
+    };
+    for (const auto& attribute : attributes) {
+        gl.enableVertexAttribArray(attribute.slot);
+        gl.vertexAttribPointer(attribute.slot, attribute.size, attribute.type, attribute.normalized,
+                               sizeof(BillboardData), reinterpret_cast<const GLvoid*>(attribute.offset));
+        gl.vertexAttribDivisor(attribute.slot, 1);
+    }
+
+    gl.drawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT, nullptr, (GLsizei)count);
+
+    for (const auto& attribute : attributes) {
+        gl.vertexAttribDivisor(attribute.slot, 0);
+        gl.disableVertexAttribArray(attribute.slot);
+    }
+    gl.disableVertexAttribArray(SHADER_ATTRIB_POSITION);
+    gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void InstanceRenderer::drawBillboardsExpanded(const BillboardData* billboards, size_t count) {
+    struct ExpandedVertex {
+        float position[3];
+        uint8_t color[4];
+    };
+
+    // The view's right and up axes are the first two rows of the modelview rotation
+    float view[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, view);
+    const float right[3] = {view[0], view[4], view[8]};
+    const float up[3] = {view[1], view[5], view[9]};
+
+    shaders->bind(0);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    // A full pool expanded is megabytes, so it goes out a scratch-sized batch at a time
+    for (size_t first = 0; first < count; first += BILLBOARD_BATCH) {
+        size_t batch = std::min(BILLBOARD_BATCH, count - first);
+        ScratchScope scratch;
+        ExpandedVertex* vertices = scratch.getArena().allocArray<ExpandedVertex>(batch * 6);
+
+        ExpandedVertex* v = vertices;
+        for (size_t i = first; i < first + batch; i++) {
+            const BillboardData& billboard = billboards[i];
+            for (uint16_t index : QUAD_INDICES) {
+                const float* corner = QUAD_VERTICES[index];
+                for (int c = 0; c < 3; c++) {
+                    v->position[c] = billboard.position[c] + (corner[0] * right[c] + corner[1] * up[c]) * billboard.size;
+                }
+                std::copy(billboard.color, billboard.color + 4, v->color);
+                v++;
+            }
+        }
+
+        GLsizei stride = sizeof(ExpandedVertex);
+        glVertexPointer(3, GL_FLOAT, stride, vertices->position);
+        glColorPointer(4, GL_UNSIGNED_BYTE, stride, vertices->color);
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(batch * 6));
+    }
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
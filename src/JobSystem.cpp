@@ -0,0 +1,99 @@
+#include "JobSystem.h"
+#include "MemoryArena.h"
+#include <algorithm>
+#include <memory>
+
+JobSystem::JobSystem(int workerCount) : stopping(false) {
+    if (workerCount <= 0) {
+        int hardware = (int)std::thread::hardware_concurrency();
+        workerCount = std::max(1, hardware - 1);
+    }
+
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(std::move(job));
+    }
+    queueCondition.notify_one();
+}
+
+void JobSystem::parallelFor(int count, const std::function<void(int)>& fn) {
+    if (count <= 0) return;
+    if (count == 1) {
+        ScratchScope scratch;
+        fn(0);
+        return;
+    }
+
+    // Indices are claimed dynamically so uneven work still balances
+    struct Batch {
+        std::atomic<int> next{0};
+        std::atomic<int> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto batch = std::make_shared<Batch>();
+
+    auto drain = [batch, count, &fn]() {
+        ScratchScope scratch;
+        int index;
+        while ((index = batch->next.fetch_add(1)) < count) {
+            fn(index);
+            if (batch->done.fetch_add(1) + 1 == count) {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                batch->finished.notify_all();
+            }
+        }
+    };
+
+    int helpers = std::min(getWorkerCount(), count - 1);
+    for (int i = 0; i < helpers; i++) {
+        submit(drain);
+    }
+
+    // The caller works too, then waits for stragglers. fn stays alive until
+    // done == count, after which helpers never touch it again.
+    drain();
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->finished.wait(lock, [&]() { return batch->done.load() == count; });
+}
+
+void JobSystem::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (stopping && queue.empty()) return;
+
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        ScratchScope scratch;
+        job();
+    }
+}
+
+JobSystem& getJobSystem() {
+    static JobSystem jobSystem;
+    return jobSystem;
+}
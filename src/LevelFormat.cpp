@@ -0,0 +1,290 @@
+#include "LevelFormat.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const uint32_t RECORD_SIZES[LEVEL_SECTION_COUNT] = {
+        sizeof(LevelRoom),
+        sizeof(LevelDoor),
+        sizeof(LevelHidingSpot),
+        sizeof(LevelTask),
+        sizeof(LevelVec3),
+        sizeof(LevelNavNode),
+        sizeof(LevelNavEdge),
+        1 // String table is counted in bytes
+    };
+
+    float distance(const LevelVec3& a, const LevelVec3& b) {
+        float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    size_t alignTo4(size_t value) {
+        return (value + 3) & ~(size_t)3;
+    }
+}
+
+void buildLevelNavGraph(const std::vector<LevelRoom>& rooms, const std::vector<LevelDoor>& doors,
+                        std::vector<LevelNavNode>& nodes, std::vector<LevelNavEdge>& edges) {
+    nodes.assign(rooms.size(), LevelNavNode{0, 0});
+    edges.clear();
+
+    // Count first so each room's edges end up contiguous
+    for (const auto& door : doors) {
+        for (int side = 0; side < 2; side++) {
+            int room = door.rooms[side];
+            if (room >= 0 && room < (int)rooms.size()) nodes[room].edgeCount++;
+        }
+    }
+
+    uint32_t next = 0;
+    for (auto& node : nodes) {
+        node.firstEdge = next;
+        next += node.edgeCount;
+        node.edgeCount = 0;
+    }
+    edges.resize(next);
+
+    for (uint32_t d = 0; d < doors.size(); d++) {
+        const LevelDoor& door = doors[d];
+        int a = door.rooms[0];
+        int b = door.rooms[1];
+        if (a < 0 || b < 0 || a >= (int)rooms.size() || b >= (int)rooms.size()) continue;
+
+        float cost = distance(rooms[a].position, door.position) + distance(door.position, rooms[b].position);
+        edges[nodes[a].firstEdge + nodes[a].edgeCount++] = LevelNavEdge{(uint32_t)b, d, cost};
+        edges[nodes[b].firstEdge + nodes[b].edgeCount++] = LevelNavEdge{(uint32_t)a, d, cost};
+    }
+}
+
+LevelFile::LevelFile() : data(nullptr), size(0), mapped(false) {
+}
+
+LevelFile::~LevelFile() {
+    close();
+}
+
+bool LevelFile::open(const std::string& path) {
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(LevelHeader)) {
+        ::close(fd);
+        std::cerr << "Level file too small: " << path << std::endl;
+        return false;
+    }
+
+    void* mem = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        std::cerr << "Failed to map level file: " << path << std::endl;
+        return false;
+    }
+
+    data = static_cast<const uint8_t*>(mem);
+    size = info.st_size;
+    mapped = true;
+#else
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length < (long)sizeof(LevelHeader)) {
+        fclose(file);
+        std::cerr << "Level file too small: " << path << std::endl;
+        return false;
+    }
+
+    uint8_t* buffer = new uint8_t[length];
+    size_t read = fread(buffer, 1, length, file);
+    fclose(file);
+    if (read != (size_t)length) {
+        delete[] buffer;
+        return false;
+    }
+
+    data = buffer;
+    size = length;
+    mapped = false;
+#endif
+
+    if (!validate()) {
+        std::cerr << "Invalid or incompatible level file: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void LevelFile::close() {
+    if (!data) return;
+
+#ifndef _WIN32
+    if (mapped) {
+        munmap(const_cast<uint8_t*>(data), size);
+    } else {
+        delete[] data;
+    }
+#else
+    delete[] data;
+#endif
+
+    data = nullptr;
+    size = 0;
+    mapped = false;
+}
+
+const char* LevelFile::getString(uint32_t offset) const {
+    const LevelSection& strings = header()->sections[LEVEL_SECTION_STRINGS];
+    if (offset >= strings.count) return "";
+    return reinterpret_cast<const char*>(data + strings.offset + offset);
+}
+
+bool LevelFile::validate() const {
+    const LevelHeader* h = header();
+    if (h->magic != LEVEL_MAGIC || h->version != LEVEL_VERSION) return false;
+    if (h->fileSize != size || h->sectionCount != LEVEL_SECTION_COUNT) return false;
+
+    // Every section must fit in the file, so nothing below can read out of bounds
+    for (int i = 0; i < LEVEL_SECTION_COUNT; i++) {
+        const LevelSection& s = h->sections[i];
+        if (s.offset % 4 != 0 || s.offset < sizeof(LevelHeader)) return false;
+        if ((uint64_t)s.offset + (uint64_t)s.count * RECORD_SIZES[i] > size) return false;
+    }
+
+    const LevelSection& strings = h->sections[LEVEL_SECTION_STRINGS];
+    if (strings.count > 0 && data[strings.offset + strings.count - 1] != '\0') return false;
+
+    uint32_t roomCount = getRoomCount();
+    if (count(LEVEL_SECTION_NAV_NODES) != roomCount) return false;
+
+    const LevelDoor* doors = getDoors();
+    for (uint32_t i = 0; i < getDoorCount(); i++) {
+        for (int side = 0; side < 2; side++) {
+            if (doors[i].rooms[side] < -1 || doors[i].rooms[side] >= (int32_t)roomCount) return false;
+        }
+    }
+
+    const LevelNavNode* nodes = getNavNodes();
+    const LevelNavEdge* edges = getNavEdges();
+    uint32_t edgeCount = getNavEdgeCount();
+    for (uint32_t i = 0; i < roomCount; i++) {
+        if ((uint64_t)nodes[i].firstEdge + nodes[i].edgeCount > edgeCount) return false;
+    }
+    for (uint32_t i = 0; i < edgeCount; i++) {
+        if (edges[i].toRoom >= roomCount || edges[i].door >= getDoorCount()) return false;
+    }
+
+    return true;
+}
+
+LevelBuilder::LevelBuilder() {
+    // Offset 0 is always the empty string
+    strings.push_back('\0');
+}
+
+uint32_t LevelBuilder::addString(const std::string& str) {
+    if (str.empty()) return 0;
+
+    uint32_t offset = (uint32_t)strings.size();
+    strings.append(str);
+    strings.push_back('\0');
+    return offset;
+}
+
+void LevelBuilder::addRoom(const LevelVec3& position, const LevelVec3& size, const std::string& name) {
+    rooms.push_back(LevelRoom{position, size, addString(name)});
+}
+
+void LevelBuilder::addDoor(const LevelVec3& position, bool open, int roomA, int roomB) {
+    doors.push_back(LevelDoor{position, open ? LEVEL_DOOR_OPEN : 0u, {roomA, roomB}});
+}
+
+void LevelBuilder::addHidingSpot(const LevelVec3& position, float radius, const std::string& type) {
+    hidingSpots.push_back(LevelHidingSpot{position, radius, addString(type)});
+}
+
+void LevelBuilder::addTask(int id, const LevelVec3& location, float radius, const std::string& description) {
+    tasks.push_back(LevelTask{location, radius, id, addString(description)});
+}
+
+void LevelBuilder::addPatrolPoint(const LevelVec3& point) {
+    patrolPoints.push_back(point);
+}
+
+std::vector<uint8_t> LevelBuilder::build() const {
+    std::vector<LevelNavNode> navNodes;
+    std::vector<LevelNavEdge> navEdges;
+    buildLevelNavGraph(rooms, doors, navNodes, navEdges);
+
+    LevelHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LEVEL_MAGIC;
+    header.version = LEVEL_VERSION;
+    header.sectionCount = LEVEL_SECTION_COUNT;
+
+    const void* sources[LEVEL_SECTION_COUNT] = {
+        rooms.data(), doors.data(), hidingSpots.data(), tasks.data(),
+        patrolPoints.data(), navNodes.data(), navEdges.data(), strings.data()
+    };
+    const size_t counts[LEVEL_SECTION_COUNT] = {
+        rooms.size(), doors.size(), hidingSpots.size(), tasks.size(),
+        patrolPoints.size(), navNodes.size(), navEdges.size(), strings.size()
+    };
+
+    // Lay sections out back to back, 4-byte aligned
+    size_t offset = alignTo4(sizeof(LevelHeader));
+    for (int i = 0; i < LEVEL_SECTION_COUNT; i++) {
+        header.sections[i].offset = (uint32_t)offset;
+        header.sections[i].count = (uint32_t)counts[i];
+        offset = alignTo4(offset + counts[i] * RECORD_SIZES[i]);
+    }
+    header.fileSize = (uint32_t)offset;
+
+    std::vector<uint8_t> bytes(offset, 0);
+    memcpy(bytes.data(), &header, sizeof(header));
+    for (int i = 0; i < LEVEL_SECTION_COUNT; i++) {
+        if (counts[i] > 0) {
+            memcpy(bytes.data() + header.sections[i].offset, sources[i], counts[i] * RECORD_SIZES[i]);
+        }
+    }
+
+    return bytes;
+}
+
+bool LevelBuilder::write(const std::string& path) const {
+    std::vector<uint8_t> bytes = build();
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        std::cerr << "Failed writing " << path << std::endl;
+    }
+    return ok;
+}
@@ -0,0 +1,520 @@
+#include "LevelStreamer.h"
+#include "LightmapFormat.h"
+#include "Mansion.h"
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    const float CHUNK_SIZE = 64.0f;
+    const float FLOOR_HEIGHT = 6.0f;
+    const size_t DEFAULT_BUDGET = 16 * 1024 * 1024;
+    const int DEFAULT_LOAD_RADIUS = 1;     // Cells either side of the player
+    const int DEFAULT_DOOR_DEPTH = 3;      // Doors away from the player's room
+    const uint32_t UNLOAD_DELAY = 120;     // Frames a chunk stays after it's no longer wanted
+    const int VERTICES_PER_WALLS = 16;
+    const int INDICES_PER_WALLS = 24;
+    const int VERTICES_PER_DOOR = 24;
+    const int INDICES_PER_DOOR = 36;
+    const float FLOOR_CELL = 8.0f;         // Floor grid spacing; keeps per-vertex lighting reasonable
+
+    std::atomic<uint32_t> nextGeneration(1);
+
+    int cellOf(float v) {
+        return (int)std::floor(v / CHUNK_SIZE);
+    }
+
+    int levelOf(float y) {
+        return (int)std::floor((y + 1.0f) / FLOOR_HEIGHT);
+    }
+
+    int floorCells(float extent) {
+        return std::max(1, (int)std::ceil(extent / FLOOR_CELL));
+    }
+
+    // Grid under a room at its own floor height, in cells of at most
+    // FLOOR_CELL that share corners. The colour is plain white so the
+    // checker texture shows as it is.
+    void addFloor(ChunkPayload& payload, const Room& room) {
+        int cellsX = floorCells(room.size.x);
+        int cellsZ = floorCells(room.size.z);
+        float x0 = room.position.x - room.size.x / 2.0f;
+        float z0 = room.position.z - room.size.z / 2.0f;
+        float stepX = room.size.x / cellsX;
+        float stepZ = room.size.z / cellsZ;
+
+        uint32_t base = (uint32_t)payload.vertices.size();
+        for (int iz = 0; iz <= cellsZ; iz++) {
+            for (int ix = 0; ix <= cellsX; ix++) {
+                StaticVertex v;
+                v.position[0] = x0 + ix * stepX;
+                v.position[1] = room.position.y;
+                v.position[2] = z0 + iz * stepZ;
+                v.normal[0] = 0; v.normal[1] = 127; v.normal[2] = 0; v.normal[3] = 0;
+                v.color[0] = v.color[1] = v.color[2] = v.color[3] = 255;
+                v.lightmapUV[0] = v.lightmapUV[1] = 0;
+                payload.vertices.push_back(v);
+            }
+        }
+
+        uint32_t row = (uint32_t)cellsX + 1;
+        for (int iz = 0; iz < cellsZ; iz++) {
+            for (int ix = 0; ix < cellsX; ix++) {
+                uint32_t a = base + iz * row + ix;
+                uint32_t b = a + 1;
+                uint32_t c = a + row + 1;
+                uint32_t d = a + row;
+                const uint32_t quad[6] = {a, b, c, a, c, d};
+                payload.indices.insert(payload.indices.end(), quad, quad + 6);
+            }
+        }
+    }
+
+    // Two triangles over four corners given counter-clockwise from outside
+    void addQuad(ChunkPayload& payload, const Vector3 corners[4], const Vector3& normal, const uint8_t color[4]) {
+        uint32_t base = (uint32_t)payload.vertices.size();
+        for (int i = 0; i < 4; i++) {
+            StaticVertex v;
+            v.position[0] = corners[i].x;
+            v.position[1] = corners[i].y;
+            v.position[2] = corners[i].z;
+            v.normal[0] = (int8_t)(normal.x * 127.0f);
+            v.normal[1] = (int8_t)(normal.y * 127.0f);
+            v.normal[2] = (int8_t)(normal.z * 127.0f);
+            v.normal[3] = 0;
+            memcpy(v.color, color, 4);
+            v.lightmapUV[0] = v.lightmapUV[1] = 0;
+            payload.vertices.push_back(v);
+        }
+
+        const uint32_t order[6] = {0, 1, 2, 0, 2, 3};
+        for (uint32_t i : order) {
+            payload.indices.push_back(base + i);
+        }
+    }
+
+    // Box centred on pos, the same shape as InstanceMesh::CUBE scaled by size
+    void addBox(ChunkPayload& payload, const Vector3& pos, const Vector3& size, const uint8_t color[4]) {
+        float w = size.x / 2.0f, h = size.y / 2.0f, d = size.z / 2.0f;
+        auto at = [&](float x, float y, float z) { return pos + Vector3(x, y, z); };
+
+        const Vector3 front[4] = {at(-w, -h, d), at(w, -h, d), at(w, h, d), at(-w, h, d)};
+        const Vector3 back[4] = {at(-w, -h, -d), at(-w, h, -d), at(w, h, -d), at(w, -h, -d)};
+        const Vector3 top[4] = {at(-w, h, -d), at(-w, h, d), at(w, h, d), at(w, h, -d)};
+        const Vector3 bottom[4] = {at(-w, -h, -d), at(w, -h, -d), at(w, -h, d), at(-w, -h, d)};
+        const Vector3 right[4] = {at(w, -h, -d), at(w, h, -d), at(w, h, d), at(w, -h, d)};
+        const Vector3 left[4] = {at(-w, -h, -d), at(-w, -h, d), at(-w, h, d), at(-w, h, -d)};
+
+        addQuad(payload, front, Vector3(0, 0, 1), color);
+        addQuad(payload, back, Vector3(0, 0, -1), color);
+        addQuad(payload, top, Vector3(0, 1, 0), color);
+        addQuad(payload, bottom, Vector3(0, -1, 0), color);
+        addQuad(payload, right, Vector3(1, 0, 0), color);
+        addQuad(payload, left, Vector3(-1, 0, 0), color);
+    }
+
+    LevelVec3 toLevel(const Vector3& v) {
+        return LevelVec3{v.x, v.y, v.z};
+    }
+
+    // Maps the quad just added onto its wall's rectangle of the page
+    void mapWall(ChunkPayload& payload, const LightmapWall& wall, const LightmapRect& rect) {
+        for (size_t i = payload.vertices.size() - 4; i < payload.vertices.size(); i++) {
+            StaticVertex& v = payload.vertices[i];
+            float u = ((v.position[0] - wall.origin.x) * wall.along.x + (v.position[2] - wall.origin.z) * wall.along.z) /
+                      wall.length;
+            float t = (v.position[1] - wall.origin.y) / wall.height;
+            v.lightmapUV[0] = (int16_t)std::lround(rect.x + u * rect.width);
+            v.lightmapUV[1] = (int16_t)std::lround(rect.y + t * rect.height);
+        }
+    }
+}
+
+LevelStreamer::LevelStreamer(const Mansion& mansion)
+    : mansion(mansion), lightmaps(nullptr), memoryBudget(DEFAULT_BUDGET), residentBytes(0), loadedChunks(0),
+      loadRadius(DEFAULT_LOAD_RADIUS), doorDepth(DEFAULT_DOOR_DEPTH), frame(0), inFlight(0) {
+}
+
+LevelStreamer::~LevelStreamer() {
+    // Workers hold raw chunk pointers, so they must finish first
+    std::unique_lock<std::mutex> lock(inFlightMutex);
+    inFlightDone.wait(lock, [this]() { return inFlight.load() == 0; });
+}
+
+uint64_t LevelStreamer::chunkKey(int cellX, int cellZ, int level) const {
+    return ((uint64_t)(uint16_t)level << 48) | ((uint64_t)(uint32_t)(cellX & 0xFFFFFF) << 24) |
+           (uint64_t)(uint32_t)(cellZ & 0xFFFFFF);
+}
+
+bool LevelStreamer::setLightmaps(const LightmapFile* file) {
+    lightmaps = nullptr;
+    if (!file || !file->isOpen()) return false;
+
+    const std::vector<Room>& rooms = mansion.getRooms();
+    uint32_t hash = LIGHTMAP_HASH_SEED;
+    for (const Room& room : rooms) {
+        hash = hashLightmapRoom(hash, toLevel(room.position), toLevel(room.size));
+    }
+    if (file->getRoomCount() != rooms.size() || file->getLevelHash() != hash) {
+        std::cerr << "Lightmaps were baked for a different level; ignoring them" << std::endl;
+        return false;
+    }
+
+    lightmaps = file;
+    return true;
+}
+
+void LevelStreamer::build() {
+    chunks.clear();
+    chunkLookup.clear();
+    loadingChunks.clear();
+    residentChunks.clear();
+    residentBytes = 0;
+    loadedChunks = 0;
+
+    auto chunkFor = [this](const Vector3& pos) {
+        int cx = cellOf(pos.x), cz = cellOf(pos.z), level = levelOf(pos.y);
+        uint64_t key = chunkKey(cx, cz, level);
+
+        auto it = chunkLookup.find(key);
+        if (it != chunkLookup.end()) return it->second;
+
+        auto chunk = std::make_unique<LevelChunk>();
+        chunk->cellX = cx;
+        chunk->cellZ = cz;
+        chunk->level = level;
+        chunk->boundsMin = pos;
+        chunk->boundsMax = pos;
+        chunk->state = ChunkState::UNLOADED;
+        chunk->lastWantedFrame = 0;
+
+        int index = (int)chunks.size();
+        chunks.push_back(std::move(chunk));
+        chunkLookup[key] = index;
+        return index;
+    };
+
+    auto grow = [](LevelChunk& chunk, const Vector3& lo, const Vector3& hi) {
+        chunk.boundsMin = Vector3(std::min(chunk.boundsMin.x, lo.x), std::min(chunk.boundsMin.y, lo.y),
+                                  std::min(chunk.boundsMin.z, lo.z));
+        chunk.boundsMax = Vector3(std::max(chunk.boundsMax.x, hi.x), std::max(chunk.boundsMax.y, hi.y),
+                                  std::max(chunk.boundsMax.z, hi.z));
+    };
+
+    const std::vector<Room>& rooms = mansion.getRooms();
+    roomChunk.assign(rooms.size(), -1);
+    roomSlot.assign(rooms.size(), -1);
+    for (int i = 0; i < (int)rooms.size(); i++) {
+        const Room& room = rooms[i];
+        int index = chunkFor(room.position);
+        roomChunk[i] = index;
+        roomSlot[i] = (int)chunks[index]->rooms.size();
+        chunks[index]->rooms.push_back(i);
+
+        Vector3 half(room.size.x / 2.0f, 0.0f, room.size.z / 2.0f);
+        grow(*chunks[index], room.position - half, room.position + half + Vector3(0.0f, room.size.y, 0.0f));
+    }
+
+    // Doors and props follow the room they belong to, falling back to position
+    const std::vector<Door>& doors = mansion.getDoors();
+    for (int i = 0; i < (int)doors.size(); i++) {
+        int room = doors[i].connectsRooms[0];
+        int index = (room >= 0 && room < (int)rooms.size()) ? roomChunk[room] : chunkFor(doors[i].position);
+        chunks[index]->doors.push_back(i);
+    }
+
+    const std::vector<HidingSpot>& spots = mansion.getHidingSpots();
+    for (int i = 0; i < (int)spots.size(); i++) {
+        int room = mansion.findRoomAt(spots[i].position);
+        int index = room >= 0 ? roomChunk[room] : chunkFor(spots[i].position);
+        chunks[index]->hidingSpots.push_back(i);
+        grow(*chunks[index], spots[i].position, spots[i].position);
+    }
+
+    std::cout << "Level streamer: " << chunks.size() << " chunks for " << rooms.size() << " rooms" << std::endl;
+}
+
+void LevelStreamer::update(const Vector3& playerPos) {
+    frame++;
+    adoptFinishedLoads();
+
+    std::vector<int> wanted;
+    collectWanted(playerPos, wanted);
+
+    // Nearest first, so a tight budget keeps what's closest
+    std::sort(wanted.begin(), wanted.end(), [&](int a, int b) {
+        Vector3 ca = (chunks[a]->boundsMin + chunks[a]->boundsMax) * 0.5f;
+        Vector3 cb = (chunks[b]->boundsMin + chunks[b]->boundsMax) * 0.5f;
+        return (ca - playerPos).length() < (cb - playerPos).length();
+    });
+
+    size_t committed = residentBytes;
+    for (int index : loadingChunks) {
+        committed += estimateBytes(*chunks[index]);
+    }
+
+    for (size_t i = 0; i < wanted.size(); i++) {
+        LevelChunk& chunk = *chunks[wanted[i]];
+        if (chunk.state.load() != ChunkState::UNLOADED) continue;
+
+        size_t estimate = estimateBytes(chunk);
+        if (i > 0 && committed + estimate > memoryBudget) continue;
+
+        committed += estimate;
+        requestLoad(wanted[i]);
+    }
+
+    evictOverBudget(wanted);
+}
+
+void LevelStreamer::collectWanted(const Vector3& playerPos, std::vector<int>& wanted) {
+    auto want = [&](int index) {
+        if (index < 0 || chunks[index]->lastWantedFrame == frame) return;
+        chunks[index]->lastWantedFrame = frame;
+        wanted.push_back(index);
+    };
+
+    int cx = cellOf(playerPos.x), cz = cellOf(playerPos.z), level = levelOf(playerPos.y);
+    for (int dl = -1; dl <= 1; dl++) {
+        for (int dx = -loadRadius; dx <= loadRadius; dx++) {
+            for (int dz = -loadRadius; dz <= loadRadius; dz++) {
+                auto it = chunkLookup.find(chunkKey(cx + dx, cz + dz, level + dl));
+                if (it != chunkLookup.end()) want(it->second);
+            }
+        }
+    }
+
+    // Walk the door graph so long corridors and stairwells stream ahead
+    int startRoom = mansion.findRoomAt(playerPos);
+    if (startRoom < 0) return;
+
+    std::vector<std::pair<int, int>> queue;
+    std::unordered_map<int, bool> visited;
+    queue.push_back(std::make_pair(startRoom, 0));
+    visited[startRoom] = true;
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        int room = queue[head].first;
+        int depth = queue[head].second;
+        want(roomChunk[room]);
+        if (depth >= doorDepth) continue;
+
+        uint32_t count = 0;
+        const LevelNavEdge* edges = mansion.getNavEdges(room, count);
+        for (uint32_t e = 0; e < count; e++) {
+            int next = (int)edges[e].toRoom;
+            if (visited[next]) continue;
+            visited[next] = true;
+            queue.push_back(std::make_pair(next, depth + 1));
+        }
+    }
+}
+
+void LevelStreamer::requestLoad(int chunkIndex) {
+    LevelChunk* chunk = chunks[chunkIndex].get();
+    chunk->state = ChunkState::LOADING;
+    loadingChunks.push_back(chunkIndex);
+    inFlight++;
+
+    const Mansion* source = &mansion;
+    const LightmapFile* baked = lightmaps;
+    getJobSystem().submit([this, chunk, source, baked]() {
+        {
+            MemTagScope memScope(MemTag::MANSION);
+            chunk->pending = buildPayload(*source, *chunk, baked);
+        }
+        chunk->state.store(ChunkState::READY, std::memory_order_release);
+
+        // Decrement under the lock so a waiter can't wake and destroy us
+        // between the count reaching zero and the notify
+        std::lock_guard<std::mutex> lock(inFlightMutex);
+        if (--inFlight == 0) {
+            inFlightDone.notify_all();
+        }
+    });
+}
+
+void LevelStreamer::adoptFinishedLoads() {
+    for (size_t i = 0; i < loadingChunks.size();) {
+        LevelChunk& chunk = *chunks[loadingChunks[i]];
+        if (chunk.state.load(std::memory_order_acquire) != ChunkState::READY) {
+            i++;
+            continue;
+        }
+
+        chunk.payload = std::move(chunk.pending);
+        chunk.state = ChunkState::LOADED;
+        residentBytes += chunk.payload->bytes;
+        loadedChunks++;
+        residentChunks.push_back(loadingChunks[i]);
+
+        loadingChunks[i] = loadingChunks.back();
+        loadingChunks.pop_back();
+    }
+}
+
+void LevelStreamer::evictOverBudget(const std::vector<int>& wanted) {
+    // Drop anything that hasn't been wanted for a while regardless of budget,
+    // then the stalest chunks until we fit
+    std::sort(residentChunks.begin(), residentChunks.end(), [this](int a, int b) {
+        return chunks[a]->lastWantedFrame < chunks[b]->lastWantedFrame;
+    });
+
+    size_t evicted = 0;
+    for (int index : residentChunks) {
+        LevelChunk& chunk = *chunks[index];
+        if (chunk.lastWantedFrame == frame) break;
+
+        bool stale = frame - chunk.lastWantedFrame > UNLOAD_DELAY;
+        if (!stale && residentBytes <= memoryBudget) break;
+
+        residentBytes -= chunk.payload->bytes;
+        chunk.payload.reset();
+        chunk.state = ChunkState::UNLOADED;
+        loadedChunks--;
+        evicted++;
+    }
+
+    residentChunks.erase(residentChunks.begin(), residentChunks.begin() + evicted);
+}
+
+void LevelStreamer::flush() {
+    {
+        std::unique_lock<std::mutex> lock(inFlightMutex);
+        inFlightDone.wait(lock, [this]() { return inFlight.load() == 0; });
+    }
+    adoptFinishedLoads();
+}
+
+bool LevelStreamer::isChunkLoaded(int chunkIndex) const {
+    return chunkIndex >= 0 && chunks[chunkIndex]->state.load() == ChunkState::LOADED;
+}
+
+int LevelStreamer::getChunkIndexAt(const Vector3& pos) const {
+    auto it = chunkLookup.find(chunkKey(cellOf(pos.x), cellOf(pos.z), levelOf(pos.y)));
+    return it != chunkLookup.end() ? it->second : -1;
+}
+
+bool LevelStreamer::isPositionLoaded(const Vector3& pos) const {
+    // Outside every chunk there is nothing to stream, so count it as loaded
+    int index = getChunkIndexAt(pos);
+    return index < 0 || isChunkLoaded(index);
+}
+
+size_t LevelStreamer::estimateBytes(const LevelChunk& chunk) const {
+    size_t vertices = chunk.rooms.size() * VERTICES_PER_WALLS;
+    size_t indices = chunk.rooms.size() * INDICES_PER_WALLS;
+    for (int room : chunk.rooms) {
+        uint32_t doorCount = 0;
+        mansion.getNavEdges(room, doorCount);
+        vertices += doorCount * VERTICES_PER_DOOR;
+        indices += doorCount * INDICES_PER_DOOR;
+
+        const Vector3& size = mansion.getRooms()[room].size;
+        int cellsX = floorCells(size.x), cellsZ = floorCells(size.z);
+        vertices += (cellsX + 1) * (cellsZ + 1);
+        indices += cellsX * cellsZ * 6;
+    }
+
+
+    return sizeof(ChunkPayload) + vertices * sizeof(StaticVertex) + indices * sizeof(uint32_t) +
+           chunk.rooms.size() * sizeof(ChunkPayload::RoomRange);
+}
+
+std::unique_ptr<ChunkPayload> LevelStreamer::buildPayload(const Mansion& mansion, const LevelChunk& chunk,
+                                                          const LightmapFile* lightmaps) {
+    auto payload = std::make_unique<ChunkPayload>();
+    const std::vector<Room>& rooms = mansion.getRooms();
+    const std::vector<Door>& doors = mansion.getDoors();
+
+    // The bake gives every chunk its own page; anything else isn't ours
+    const LightmapPage* page = nullptr;
+    if (lightmaps && !chunk.rooms.empty()) {
+        uint32_t pageIndex = lightmaps->getRoom(chunk.rooms[0]).page;
+        page = &lightmaps->getPage(pageIndex);
+        for (int index : chunk.rooms) {
+            if (lightmaps->getRoom(index).page != pageIndex) page = nullptr;
+        }
+    }
+    payload->lightmap = page ? lightmaps->getTexels(*page) : nullptr;
+    payload->lightmapWidth = page ? page->width : 0;
+    payload->lightmapHeight = page ? page->height : 0;
+
+    payload->vertices.reserve(chunk.rooms.size() * VERTICES_PER_WALLS);
+    payload->indices.reserve(chunk.rooms.size() * INDICES_PER_WALLS);
+    payload->roomRanges.reserve(chunk.rooms.size());
+
+    for (int index : chunk.rooms) {
+        const Room& room = rooms[index];
+        float x = room.position.x, z = room.position.z;
+        float w = room.size.x / 2.0f, d = room.size.z / 2.0f;
+        float y0 = room.position.y, y1 = room.position.y + room.size.y;
+
+        ChunkPayload::RoomRange range;
+        range.room = index;
+        range.firstIndex = (uint32_t)payload->indices.size();
+
+        // Four walls standing on the room's own floor height
+        const Vector3 north[4] = {Vector3(x - w, y0, z + d), Vector3(x + w, y0, z + d),
+                                  Vector3(x + w, y1, z + d), Vector3(x - w, y1, z + d)};
+        const Vector3 south[4] = {Vector3(x - w, y0, z - d), Vector3(x - w, y1, z - d),
+                                  Vector3(x + w, y1, z - d), Vector3(x + w, y0, z - d)};
+        const Vector3 west[4] = {Vector3(x - w, y0, z - d), Vector3(x - w, y0, z + d),
+                                 Vector3(x - w, y1, z + d), Vector3(x - w, y1, z - d)};
+        const Vector3 east[4] = {Vector3(x + w, y0, z - d), Vector3(x + w, y1, z - d),
+                                 Vector3(x + w, y1, z + d), Vector3(x + w, y0, z + d)};
+        const Vector3* walls[4] = {north, south, west, east};
+        const Vector3 normals[4] = {Vector3(0, 0, 1), Vector3(0, 0, -1), Vector3(-1, 0, 0), Vector3(1, 0, 0)};
+        LightmapWall wallCharts[4];
+        getLightmapWalls(toLevel(room.position), toLevel(room.size), wallCharts);
+        for (int wall = 0; wall < 4; wall++) {
+            addQuad(*payload, walls[wall], normals[wall], STATIC_WALL_COLOR);
+            if (page) mapWall(*payload, wallCharts[wall], lightmaps->getRoom(index).walls[wall]);
+        }
+
+        // Doors go in both rooms' ranges so either side can draw them alone
+        uint32_t doorCount = 0;
+        const LevelNavEdge* edges = mansion.getNavEdges(index, doorCount);
+        for (uint32_t e = 0; e < doorCount; e++) {
+            size_t firstVertex = payload->vertices.size();
+            addBox(*payload, doors[edges[e].door].position, Vector3(2.0f, 3.0f, 0.2f), STATIC_DOOR_COLOR);
+            for (size_t i = firstVertex; page && i < payload->vertices.size(); i++) {
+                payload->vertices[i].lightmapUV[0] = (int16_t)page->doorX;
+                payload->vertices[i].lightmapUV[1] = (int16_t)page->doorY;
+            }
+        }
+
+        range.indexCount = (uint32_t)payload->indices.size() - range.firstIndex;
+        payload->roomRanges.push_back(range);
+    }
+
+    // Every room's floor at its own storey's height, together after the
+    // walls so the chunk's floor is one draw
+    payload->floorFirstIndex = (uint32_t)payload->indices.size();
+    payload->floorMin = payload->floorMax = chunk.boundsMin;
+    for (size_t i = 0; i < chunk.rooms.size(); i++) {
+        const Room& room = rooms[chunk.rooms[i]];
+        Vector3 half(room.size.x / 2.0f, 0.0f, room.size.z / 2.0f);
+        Vector3 lo = room.position - half, hi = room.position + half;
+        if (i > 0) {
+            lo = Vector3(std::min(payload->floorMin.x, lo.x), std::min(payload->floorMin.y, lo.y),
+                         std::min(payload->floorMin.z, lo.z));
+            hi = Vector3(std::max(payload->floorMax.x, hi.x), std::max(payload->floorMax.y, hi.y),
+                         std::max(payload->floorMax.z, hi.z));
+        }
+        payload->floorMin = lo;
+        payload->floorMax = hi;
+        addFloor(*payload, room);
+    }
+    payload->floorIndexCount = (uint32_t)payload->indices.size() - payload->floorFirstIndex;
+
+    payload->generation = nextGeneration++;
+    payload->bytes = sizeof(ChunkPayload) +
+                     payload->vertices.capacity() * sizeof(StaticVertex) +
+                     payload->indices.capacity() * sizeof(uint32_t) +
+                     payload->roomRanges.capacity() * sizeof(ChunkPayload::RoomRange);
+    return payload;
+}
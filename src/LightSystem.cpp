@@ -0,0 +1,276 @@
+#include "LightSystem.h"
+#include "Mansion.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    const float WARM_BULB[3] = {1.0f, 0.85f, 0.6f};
+    const float CANDLE_FLAME[3] = {1.0f, 0.6f, 0.25f};
+
+    const float BULB_INTENSITY = 0.6f;
+    const float CANDLE_INTENSITY = 0.45f;
+    const float CANDLE_RADIUS = 3.5f;
+    const float SQUARE_UNITS_PER_CANDLE = 20.0f;
+    const int MAX_CANDLES_PER_ROOM = 4;
+
+    uint32_t hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    float distanceToBox(const Vector3& p, const AABB& box) {
+        float dx = std::max(std::max(box.min.x - p.x, 0.0f), p.x - box.max.x);
+        float dy = std::max(std::max(box.min.y - p.y, 0.0f), p.y - box.max.y);
+        float dz = std::max(std::max(box.min.z - p.z, 0.0f), p.z - box.max.z);
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+}
+
+LightSystem::LightSystem()
+    : mansion(nullptr), roomCount(0), dynamicPlaced(false), time(0.0f), viewRange(0.0f) {
+}
+
+void LightSystem::build(const Mansion& source, const BoundsSoA& bounds) {
+    mansion = &source;
+    roomBounds = bounds;
+    roomCount = (int)source.getRooms().size();
+    staticLights.clear();
+    staticRooms.clear();
+    dynamicLights.clear();
+    dynamicRooms.clear();
+
+    // The level format has no lights, so every room is dressed the same way
+    // from its index: runs with the same level always look the same
+    const std::vector<Room>& rooms = source.getRooms();
+    for (int r = 0; r < (int)rooms.size(); r++) {
+        const Room& room = rooms[r];
+        uint32_t seed = hash((uint32_t)r);
+        float phase = (seed & 0xFFFF) / 65536.0f * 6.2831853f;
+
+        // A ceiling bulb, dead in one room in five and failing in one in three
+        if (seed % 5 != 0) {
+            PointLight bulb;
+            bulb.position = room.position + Vector3(0.0f, room.size.y - 0.3f, 0.0f);
+            for (int c = 0; c < 3; c++) bulb.color[c] = WARM_BULB[c] * BULB_INTENSITY;
+            bulb.radius = std::min(std::max(std::max(room.size.x, room.size.z) * 0.75f, 4.0f), 12.0f);
+            bulb.flicker = (seed >> 8) % 3 == 0 ? LightFlicker::BULB : LightFlicker::STEADY;
+            bulb.phase = phase;
+            addStatic(bulb, r);
+        }
+
+        // Candles in the corners, more in bigger rooms
+        int candles = std::min((int)(room.size.x * room.size.z / SQUARE_UNITS_PER_CANDLE), MAX_CANDLES_PER_ROOM);
+        float insetX = std::max(room.size.x / 2.0f - 0.6f, 0.0f);
+        float insetZ = std::max(room.size.z / 2.0f - 0.6f, 0.0f);
+        const float CORNERS[4][2] = {{-1.0f, -1.0f}, {1.0f, 1.0f}, {1.0f, -1.0f}, {-1.0f, 1.0f}};
+        for (int i = 0; i < candles; i++) {
+            PointLight candle;
+            candle.position = room.position + Vector3(CORNERS[i][0] * insetX, 1.0f, CORNERS[i][1] * insetZ);
+            for (int c = 0; c < 3; c++) candle.color[c] = CANDLE_FLAME[c] * CANDLE_INTENSITY;
+            candle.radius = CANDLE_RADIUS;
+            candle.flicker = LightFlicker::CANDLE;
+            candle.phase = phase + i * 1.7f;
+            addStatic(candle, r);
+        }
+    }
+
+    std::sort(staticRooms.begin(), staticRooms.end());
+    roomStart.assign(rooms.size() + 1, 0);
+    roomLights.clear();
+    roomLights.reserve(staticRooms.size());
+    for (const auto& pair : staticRooms) {
+        roomStart[pair.first + 1]++;
+        roomLights.push_back((uint32_t)pair.second);
+    }
+    for (size_t r = 0; r < rooms.size(); r++) {
+        roomStart[r + 1] += roomStart[r];
+    }
+    staticRooms.clear();
+    staticRooms.shrink_to_fit();
+
+    sets.clear();
+    setIndex.clear();
+}
+
+void LightSystem::addStatic(const PointLight& light, int room) {
+    int index = (int)staticLights.size();
+    staticLights.push_back(light);
+    addReach(staticRooms, light, room, index);
+}
+
+void LightSystem::addReach(std::vector<std::pair<int, int>>& pairs, const PointLight& light, int room, int index) const {
+    pairs.push_back({room, index});
+
+    // Light spills through doors into the next room; further than that it's
+    // too faint to pick over the next room's own lights
+    uint32_t edgeCount = 0;
+    const LevelNavEdge* edges = mansion->getNavEdges(room, edgeCount);
+    for (uint32_t e = 0; e < edgeCount; e++) {
+        int next = (int)edges[e].toRoom;
+        if (distanceToBox(light.position, roomBounds.get(next)) < light.radius) {
+            pairs.push_back({next, index});
+        }
+    }
+}
+
+int LightSystem::addDynamicLight(const PointLight& light) {
+    dynamicLights.push_back(DynamicLight{light, 0.0f});
+    dynamicPlaced = false;
+    return (int)dynamicLights.size() - 1;
+}
+
+void LightSystem::moveDynamicLight(int id, const Vector3& position, float intensity) {
+    dynamicLights[id].light.position = position;
+    dynamicLights[id].intensity = intensity;
+    dynamicPlaced = false;
+}
+
+void LightSystem::beginFrame(float seconds, const Vector3& viewer, float range) {
+    time = seconds;
+    eye = viewer;
+    viewRange = range;
+    dynamicPlaced = false;
+    // Both keep their capacity, so a steady view allocates nothing
+    sets.clear();
+    setIndex.clear();
+}
+
+void LightSystem::placeDynamic() {
+    dynamicRooms.clear();
+    for (int i = 0; i < (int)dynamicLights.size(); i++) {
+        const DynamicLight& dynamic = dynamicLights[i];
+        if (dynamic.intensity <= 0.0f) continue;
+
+        int room = mansion ? mansion->findRoomAt(dynamic.light.position) : -1;
+        if (room >= 0) {
+            addReach(dynamicRooms, dynamic.light, room, i);
+        }
+    }
+    std::sort(dynamicRooms.begin(), dynamicRooms.end());
+    dynamicPlaced = true;
+}
+
+float LightSystem::flickerOf(const PointLight& light) const {
+    switch (light.flicker) {
+        case LightFlicker::CANDLE:
+            return 0.85f + 0.1f * std::sin(time * 9.0f + light.phase) +
+                   0.05f * std::sin(time * 23.7f + light.phase * 2.1f);
+        case LightFlicker::BULB: {
+            // Twelfths of a second; about one in thirty goes nearly dark
+            uint32_t tick = (uint32_t)(time * 12.0f + light.phase * 10.0f);
+            return hash(tick ^ (uint32_t)(light.phase * 1000.0f)) % 30 == 0 ? 0.15f : 1.0f;
+        }
+        case LightFlicker::STEADY:
+        default:
+            return 1.0f;
+    }
+}
+
+int LightSystem::getRoomSet(int room, bool dynamicOnly) const {
+    if (room < 0 || room >= roomCount) return 0;
+    return dynamicOnly ? roomCount + room + 1 : room + 1;
+}
+
+const uint32_t* LightSystem::getRoomLights(int room, int& count) const {
+    count = (int)(roomStart[room + 1] - roomStart[room]);
+    return roomLights.data() + roomStart[room];
+}
+
+int LightSystem::getSetAt(const Vector3& position) const {
+    return mansion ? getRoomSet(mansion->findRoomAt(position)) : 0;
+}
+
+void LightSystem::consider(RoomSet& set, float* scores, const PointLight& light, float intensity,
+                           const AABB& box) const {
+    float distance = distanceToBox(light.position, box);
+    if (distance >= light.radius || intensity <= 0.0f) return;
+
+    float brightest = std::max(light.color[0], std::max(light.color[1], light.color[2]));
+    float score = brightest * intensity / (1.0f + SCENE_LIGHT_FALLOFF * distance * distance / (light.radius * light.radius));
+
+    // Insertion into a short list kept strongest first
+    int slot = set.count;
+    if (slot == MAX_LIGHTS_PER_SET) {
+        if (score <= scores[slot - 1]) return;
+        slot--;
+    } else {
+        set.count++;
+    }
+    while (slot > 0 && scores[slot - 1] < score) {
+        scores[slot] = scores[slot - 1];
+        set.lights[slot] = set.lights[slot - 1];
+        slot--;
+    }
+
+    scores[slot] = score;
+    SceneLight& out = set.lights[slot];
+    out.position[0] = light.position.x;
+    out.position[1] = light.position.y;
+    out.position[2] = light.position.z;
+    for (int c = 0; c < 3; c++) out.color[c] = light.color[c] * intensity;
+    out.radius = light.radius;
+}
+
+const LightSystem::RoomSet* LightSystem::findSet(int id) {
+    if (id < 1 || id > roomCount * 2) return nullptr;
+
+    auto found = setIndex.find(id);
+    if (found != setIndex.end()) return &sets[found->second];
+
+    bool dynamicOnly = id > roomCount;
+    int room = dynamicOnly ? id - roomCount - 1 : id - 1;
+
+    if (!dynamicPlaced) placeDynamic();
+    setIndex[id] = (uint32_t)sets.size();
+    sets.emplace_back();
+    RoomSet& set = sets.back();
+    set.count = 0;
+    float scores[MAX_LIGHTS_PER_SET];
+    AABB box = roomBounds.get(room);
+    AABB seen = {Vector3(std::max(box.min.x, eye.x - viewRange), std::max(box.min.y, eye.y - viewRange),
+                         std::max(box.min.z, eye.z - viewRange)),
+                 Vector3(std::min(box.max.x, eye.x + viewRange), std::min(box.max.y, eye.y + viewRange),
+                         std::min(box.max.z, eye.z + viewRange))};
+    if (seen.min.x <= seen.max.x && seen.min.y <= seen.max.y && seen.min.z <= seen.max.z) {
+        box = seen;
+    }
+
+    for (uint32_t i = roomStart[room]; i < roomStart[room + 1] && !dynamicOnly; i++) {
+        const PointLight& light = staticLights[roomLights[i]];
+        consider(set, scores, light, flickerOf(light), box);
+    }
+
+    auto first = std::lower_bound(dynamicRooms.begin(), dynamicRooms.end(), std::make_pair(room, 0));
+    for (auto it = first; it != dynamicRooms.end() && it->first == room; ++it) {
+        const DynamicLight& dynamic = dynamicLights[it->second];
+        consider(set, scores, dynamic.light, dynamic.intensity * flickerOf(dynamic.light), box);
+    }
+    return &set;
+}
+
+const SceneLight* LightSystem::getSet(int id, int& count) {
+    const RoomSet* set = findSet(id);
+    count = set ? set->count : 0;
+    return set ? set->lights : nullptr;
+}
+
+bool LightSystem::isSameSet(int first, int second) {
+    if (first == second) return true;
+
+    // Found one after the other, since finding the second can move the first
+    const RoomSet* a = findSet(first);
+    int countA = a ? a->count : 0;
+    size_t indexA = a ? (size_t)(a - sets.data()) : 0;
+    const RoomSet* b = findSet(second);
+    int countB = b ? b->count : 0;
+    if (countA != countB) return false;
+    if (countA == 0) return true;
+
+    // Same lights picked the same way come out bit for bit the same
+    return std::memcmp(sets[indexA].lights, b->lights, countA * sizeof(SceneLight)) == 0;
+}
@@ -0,0 +1,177 @@
+#include "LightmapFormat.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const uint32_t RECORD_SIZES[LIGHTMAP_SECTION_COUNT] = {
+        sizeof(LightmapRoom),
+        sizeof(LightmapPage),
+        1 // Texels are counted in bytes
+    };
+
+    size_t alignTo4(size_t value) {
+        return (value + 3) & ~(size_t)3;
+    }
+
+    uint32_t hashBytes(uint32_t hash, const void* bytes, size_t count) {
+        const uint8_t* p = static_cast<const uint8_t*>(bytes);
+        for (size_t i = 0; i < count; i++) {
+            hash = (hash ^ p[i]) * 16777619u;
+        }
+        return hash;
+    }
+}
+
+void getLightmapWalls(const LevelVec3& position, const LevelVec3& size, LightmapWall walls[4]) {
+    float x = position.x, z = position.z;
+    float w = size.x / 2.0f, d = size.z / 2.0f;
+    float y0 = position.y;
+
+    walls[0] = LightmapWall{{x - w, y0, z + d}, {1, 0, 0}, {0, 0, -1}, size.x, size.y};
+    walls[1] = LightmapWall{{x - w, y0, z - d}, {1, 0, 0}, {0, 0, 1}, size.x, size.y};
+    walls[2] = LightmapWall{{x - w, y0, z - d}, {0, 0, 1}, {1, 0, 0}, size.z, size.y};
+    walls[3] = LightmapWall{{x + w, y0, z - d}, {0, 0, 1}, {-1, 0, 0}, size.z, size.y};
+}
+
+uint32_t hashLightmapRoom(uint32_t hash, const LevelVec3& position, const LevelVec3& size) {
+    hash = hashBytes(hash, &position, sizeof(position));
+    return hashBytes(hash, &size, sizeof(size));
+}
+
+std::string getLightmapPath(const std::string& levelPath) {
+    size_t dot = levelPath.rfind('.');
+    size_t slash = levelPath.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return levelPath + ".mhlm";
+    }
+    return levelPath.substr(0, dot) + ".mhlm";
+}
+
+LightmapFile::LightmapFile() {
+}
+
+bool LightmapFile::open(const std::string& path) {
+    close();
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length < (long)sizeof(LightmapHeader)) {
+        fclose(file);
+        std::cerr << "Lightmap file too small: " << path << std::endl;
+        return false;
+    }
+
+    data.resize(length);
+    size_t read = fread(data.data(), 1, length, file);
+    fclose(file);
+    if (read != (size_t)length || !validate()) {
+        std::cerr << "Invalid or incompatible lightmap file: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void LightmapFile::close() {
+    std::vector<uint8_t>().swap(data);
+}
+
+bool LightmapFile::validate() const {
+    const LightmapHeader* h = header();
+    if (h->magic != LIGHTMAP_MAGIC || h->version != LIGHTMAP_VERSION) return false;
+    if (h->fileSize != data.size() || h->sectionCount != LIGHTMAP_SECTION_COUNT) return false;
+
+    for (int i = 0; i < LIGHTMAP_SECTION_COUNT; i++) {
+        const LevelSection& s = h->sections[i];
+        if (s.offset % 4 != 0 || s.offset < sizeof(LightmapHeader)) return false;
+        if ((uint64_t)s.offset + (uint64_t)s.count * RECORD_SIZES[i] > data.size()) return false;
+    }
+
+    // Pages must fit the texel section and rectangles their page, so the
+    // renderer can upload and sample without checking again
+    uint32_t texelBytes = h->sections[LIGHTMAP_SECTION_TEXELS].count;
+    for (uint32_t i = 0; i < getPageCount(); i++) {
+        const LightmapPage& page = getPage(i);
+        if (page.width == 0 || page.height == 0) return false;
+        if ((uint64_t)page.texelOffset + (uint64_t)page.width * page.height * 3 > texelBytes) return false;
+        if (page.doorX < 1 || page.doorY < 1 || page.doorX >= page.width || page.doorY >= page.height) return false;
+    }
+
+    for (uint32_t i = 0; i < getRoomCount(); i++) {
+        const LightmapRoom& room = getRoom(i);
+        if (room.page >= getPageCount()) return false;
+        const LightmapPage& page = getPage(room.page);
+        for (const LightmapRect& rect : room.walls) {
+            if (rect.x + rect.width > page.width || rect.y + rect.height > page.height) return false;
+        }
+    }
+
+    return true;
+}
+
+LightmapBuilder::LightmapBuilder(uint32_t levelHash, float texelsPerUnit, size_t roomCount)
+    : levelHash(levelHash), texelsPerUnit(texelsPerUnit), rooms(roomCount, LightmapRoom{0, {}}) {
+}
+
+uint32_t LightmapBuilder::addPage(uint16_t width, uint16_t height, uint16_t doorX, uint16_t doorY,
+                                  const std::vector<uint8_t>& pageTexels) {
+    pages.push_back(LightmapPage{width, height, doorX, doorY, (uint32_t)texels.size()});
+    texels.insert(texels.end(), pageTexels.begin(), pageTexels.begin() + (size_t)width * height * 3);
+    return (uint32_t)pages.size() - 1;
+}
+
+std::vector<uint8_t> LightmapBuilder::build() const {
+    LightmapHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LIGHTMAP_MAGIC;
+    header.version = LIGHTMAP_VERSION;
+    header.sectionCount = LIGHTMAP_SECTION_COUNT;
+    header.levelHash = levelHash;
+    header.texelsPerUnit = texelsPerUnit;
+
+    const void* sources[LIGHTMAP_SECTION_COUNT] = {rooms.data(), pages.data(), texels.data()};
+    const size_t counts[LIGHTMAP_SECTION_COUNT] = {rooms.size(), pages.size(), texels.size()};
+
+    size_t offset = alignTo4(sizeof(LightmapHeader));
+    for (int i = 0; i < LIGHTMAP_SECTION_COUNT; i++) {
+        header.sections[i].offset = (uint32_t)offset;
+        header.sections[i].count = (uint32_t)counts[i];
+        offset = alignTo4(offset + counts[i] * RECORD_SIZES[i]);
+    }
+    header.fileSize = (uint32_t)offset;
+
+    std::vector<uint8_t> bytes(offset, 0);
+    memcpy(bytes.data(), &header, sizeof(header));
+    for (int i = 0; i < LIGHTMAP_SECTION_COUNT; i++) {
+        if (counts[i] > 0) {
+            memcpy(bytes.data() + header.sections[i].offset, sources[i], counts[i] * RECORD_SIZES[i]);
+        }
+    }
+
+    return bytes;
+}
+
+bool LightmapBuilder::write(const std::string& path) const {
+    std::vector<uint8_t> bytes = build();
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        std::cerr << "Failed writing " << path << std::endl;
+    }
+    return ok;
+}
@@ -1,13 +1,182 @@
 #include "Mansion.h"
 #include <cmath>
+#include <iostream>
 
-Mansion::Mansion() : mansionSize(100.0f, 10.0f, 100.0f) {
+namespace {
+    const float ROOM_GRID_CELL = 16.0f;
+    
+    uint64_t gridKey(int cellX, int cellZ) {
+        return ((uint64_t)(uint32_t)cellX << 32) | (uint32_t)cellZ;
+    }
+    
+    int gridCell(float v) {
+        return (int)std::floor(v / ROOM_GRID_CELL);
+    }
+    
+    Vector3 toVector3(const LevelVec3& v) {
+        return Vector3(v.x, v.y, v.z);
+    }
+
+    LevelVec3 toLevelVec3(const Vector3& v) {
+        return LevelVec3{v.x, v.y, v.z};
+    }
 }
 
-void Mansion::initialize() {
+Mansion::Mansion()
+    : generated(false), playerStart(5.0f, 0.0f, 5.0f), monsterStart(50.0f, 0.0f, 50.0f),
+      navNodes(nullptr), navEdges(nullptr), mansionSize(100.0f, 10.0f, 100.0f) {
+}
+
+void Mansion::initialize(const std::string& levelPath) {
+    if (loadLevel(levelPath)) {
+        return;
+    }
+    
+    std::cout << "No compiled level found, using built-in mansion layout" << std::endl;
     createRooms();
     createDoors();
     createHidingSpots();
+    createPatrolPoints();
+    buildNavGraph();
+    buildRoomGrid();
+}
+
+bool Mansion::loadLevel(const std::string& path) {
+    if (!levelFile.open(path)) {
+        return false;
+    }
+    
+    // Records are already in their final binary layout; this is a straight
+    // copy into the runtime structs with no text parsing
+    const LevelRoom* levelRooms = levelFile.getRooms();
+    rooms.resize(levelFile.getRoomCount());
+    for (uint32_t i = 0; i < levelFile.getRoomCount(); i++) {
+        rooms[i].position = toVector3(levelRooms[i].position);
+        rooms[i].size = toVector3(levelRooms[i].size);
+        rooms[i].name = levelFile.getString(levelRooms[i].nameOffset);
+    }
+    
+    const LevelDoor* levelDoors = levelFile.getDoors();
+    doors.resize(levelFile.getDoorCount());
+    for (uint32_t i = 0; i < levelFile.getDoorCount(); i++) {
+        doors[i].position = toVector3(levelDoors[i].position);
+        doors[i].isOpen = (levelDoors[i].flags & LEVEL_DOOR_OPEN) != 0;
+        doors[i].connectsRooms[0] = levelDoors[i].rooms[0];
+        doors[i].connectsRooms[1] = levelDoors[i].rooms[1];
+    }
+    
+    const LevelHidingSpot* levelSpots = levelFile.getHidingSpots();
+    hidingSpots.resize(levelFile.getHidingSpotCount());
+    for (uint32_t i = 0; i < levelFile.getHidingSpotCount(); i++) {
+        hidingSpots[i].position = toVector3(levelSpots[i].position);
+        hidingSpots[i].radius = levelSpots[i].radius;
+        hidingSpots[i].type = levelFile.getString(levelSpots[i].typeOffset);
+    }
+    
+    const LevelVec3* levelPatrol = levelFile.getPatrolPoints();
+    patrolPoints.resize(levelFile.getPatrolPointCount());
+    for (uint32_t i = 0; i < levelFile.getPatrolPointCount(); i++) {
+        patrolPoints[i] = toVector3(levelPatrol[i]);
+    }
+    
+    // The baked room graph is used straight out of the mapping
+    navNodes = levelFile.getNavNodes();
+    navEdges = levelFile.getNavEdges();
+    builtNavNodes.clear();
+    builtNavEdges.clear();
+    buildRoomGrid();
+    
+    std::cout << "Loaded level " << path << " (" << rooms.size() << " rooms)" << std::endl;
+    return true;
+}
+
+void Mansion::generate(const MansionGenParams& params) {
+    MansionGenerator generator;
+    GeneratedMansion result = generator.generate(params);
+    
+    levelFile.close();
+    rooms = std::move(result.rooms);
+    doors = std::move(result.doors);
+    hidingSpots = std::move(result.hidingSpots);
+    patrolPoints = std::move(result.patrolPoints);
+    generatedTasks = std::move(result.tasks);
+    playerStart = result.playerStart;
+    monsterStart = result.monsterStart;
+    generated = true;
+    
+    buildNavGraph();
+    buildRoomGrid();
+    
+    std::cout << "Generated mansion: seed " << params.seed << ", " << rooms.size() << " rooms, "
+              << doors.size() << " doors, " << hidingSpots.size() << " hiding spots" << std::endl;
+}
+
+void Mansion::buildNavGraph() {
+    std::vector<LevelRoom> levelRooms;
+    for (const auto& room : rooms) {
+        levelRooms.push_back(LevelRoom{toLevelVec3(room.position), toLevelVec3(room.size), 0});
+    }
+    
+    std::vector<LevelDoor> levelDoors;
+    for (const auto& door : doors) {
+        levelDoors.push_back(LevelDoor{toLevelVec3(door.position), door.isOpen ? LEVEL_DOOR_OPEN : 0u,
+                                       {door.connectsRooms[0], door.connectsRooms[1]}});
+    }
+    
+    buildLevelNavGraph(levelRooms, levelDoors, builtNavNodes, builtNavEdges);
+    navNodes = builtNavNodes.data();
+    navEdges = builtNavEdges.data();
+}
+
+void Mansion::buildRoomGrid() {
+    roomGrid.clear();
+    
+    for (int i = 0; i < (int)rooms.size(); i++) {
+        const Room& room = rooms[i];
+        int minX = gridCell(room.position.x - room.size.x / 2.0f);
+        int maxX = gridCell(room.position.x + room.size.x / 2.0f);
+        int minZ = gridCell(room.position.z - room.size.z / 2.0f);
+        int maxZ = gridCell(room.position.z + room.size.z / 2.0f);
+        
+        for (int x = minX; x <= maxX; x++) {
+            for (int z = minZ; z <= maxZ; z++) {
+                roomGrid[gridKey(x, z)].push_back(i);
+            }
+        }
+    }
+}
+
+int Mansion::findRoomAt(const Vector3& pos) const {
+    auto it = roomGrid.find(gridKey(gridCell(pos.x), gridCell(pos.z)));
+    if (it == roomGrid.end()) {
+        return -1;
+    }
+    
+    // Rooms may overlap (hallways run into rooms), so prefer the smallest
+    int best = -1;
+    float bestArea = 0.0f;
+    for (int index : it->second) {
+        const Room& room = rooms[index];
+        if (pos.y < room.position.y - 1.0f || pos.y > room.position.y + room.size.y + 1.0f) continue;
+        if (!checkCollision(pos, room.position, room.size)) continue;
+        
+        float area = room.size.x * room.size.z;
+        if (best < 0 || area < bestArea) {
+            best = index;
+            bestArea = area;
+        }
+    }
+    return best;
+}
+
+const LevelNavEdge* Mansion::getNavEdges(int roomIndex, uint32_t& count) const {
+    if (!navNodes || roomIndex < 0 || roomIndex >= (int)rooms.size()) {
+        count = 0;
+        return nullptr;
+    }
+    
+    count = navNodes[roomIndex].edgeCount;
+    return navEdges + navNodes[roomIndex].firstEdge;
 }
 
 void Mansion::createRooms() {
@@ -214,19 +383,21 @@ Vector3 Mansion::getRandomPatrolPoint() const {
 }
 
 std::vector<Vector3> Mansion::getMonsterPatrolPoints() const {
-    std::vector<Vector3> points;
+    return patrolPoints;
+}
+
+void Mansion::createPatrolPoints() {
+    patrolPoints.clear();
     
     // Create patrol route through mansion
-    points.push_back(Vector3(10.0f, 1.0f, 10.0f));  // Entrance
-    points.push_back(Vector3(18.0f, 1.0f, 20.0f));  // Hallway 1
-    points.push_back(Vector3(25.0f, 1.0f, 30.0f));  // Library
-    points.push_back(Vector3(35.0f, 1.0f, 25.0f));  // Hallway 2
-    points.push_back(Vector3(45.0f, 1.0f, 35.0f));  // Bedroom
-    points.push_back(Vector3(35.0f, 1.0f, 35.0f));  // Back to hallway
-    points.push_back(Vector3(15.0f, 1.0f, 50.0f));  // Dining room
-    points.push_back(Vector3(10.0f, 1.0f, 35.0f));  // Kitchen
-    
-    return points;
+    patrolPoints.push_back(Vector3(10.0f, 1.0f, 10.0f));  // Entrance
+    patrolPoints.push_back(Vector3(18.0f, 1.0f, 20.0f));  // Hallway 1
+    patrolPoints.push_back(Vector3(25.0f, 1.0f, 30.0f));  // Library
+    patrolPoints.push_back(Vector3(35.0f, 1.0f, 25.0f));  // Hallway 2
+    patrolPoints.push_back(Vector3(45.0f, 1.0f, 35.0f));  // Bedroom
+    patrolPoints.push_back(Vector3(35.0f, 1.0f, 35.0f));  // Back to hallway
+    patrolPoints.push_back(Vector3(15.0f, 1.0f, 50.0f));  // Dining room
+    patrolPoints.push_back(Vector3(10.0f, 1.0f, 35.0f));  // Kitchen
 }
 
 bool Mansion::checkCollision(const Vector3& pos, const Vector3& roomPos, const Vector3& roomSize) const {
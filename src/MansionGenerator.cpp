@@ -0,0 +1,286 @@
+#include "MansionGenerator.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+namespace {
+    const float CELL_SIZE = 16.0f;      // Grid spacing, room plus wall gap
+    const float MIN_ROOM_SIZE = 8.0f;
+    const float MAX_ROOM_SIZE = 14.0f;
+    const float ROOM_HEIGHT = 5.0f;
+    const float FLOOR_HEIGHT = 6.0f;
+    const float WING_GAP = 8.0f;
+    const float CORRIDOR_DEPTH = 8.0f;
+    const float DOOR_HEIGHT = 1.5f;
+    const float OPEN_DOOR_CHANCE = 0.85f;
+    const float EXTRA_DOOR_CHANCE = 0.35f;
+    const float HIDING_SPOT_CHANCE = 0.35f;
+    const int MAX_TASKS = 8;
+    const int MAX_PATROL_POINTS = 12;
+
+    const char* WING_NAMES[] = {
+        "East Wing", "West Wing", "North Wing", "South Wing",
+        "Servants' Wing", "Guest Wing", "Old Wing", "Chapel Wing"
+    };
+    const char* ROOM_TYPES[] = {
+        "Bedroom", "Study", "Library", "Parlour", "Bathroom", "Nursery",
+        "Gallery", "Storeroom", "Sitting Room", "Music Room", "Linen Room", "Office"
+    };
+    const char* SPOT_TYPES[] = { "closet", "under_bed", "cabinet", "behind_furniture", "under_desk" };
+    const char* TASK_TEMPLATES[] = {
+        "Find the key in the ", "Search the ", "Read the notes in the ",
+        "Collect the sample from the ", "Unlock the cabinet in the ", "Find the fuse in the "
+    };
+
+    template<typename T, size_t N>
+    size_t countOf(T (&)[N]) { return N; }
+
+    // Wrapper over mt19937 raw output. The engine's sequence is fixed by the
+    // standard but the <random> distributions aren't, so do the mapping here
+    // to keep layouts identical across compilers.
+    class GenRandom {
+    public:
+        explicit GenRandom(uint32_t seed) : engine(seed) {}
+
+        float unit() { return (engine() >> 8) * (1.0f / 16777216.0f); }
+        float range(float lo, float hi) { return lo + (hi - lo) * unit(); }
+        bool chance(float p) { return unit() < p; }
+        uint32_t index(size_t count) { return (uint32_t)(engine() % count); }
+
+    private:
+        std::mt19937 engine;
+    };
+
+    uint32_t mixSeed(uint32_t seed, uint32_t stream) {
+        // splitmix32 style finalizer so neighbouring wings get unrelated streams
+        uint32_t h = seed + 0x9E3779B9u * (stream + 1);
+        h ^= h >> 16;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    int gridColumns(int roomsPerFloor) {
+        return std::max(1, (int)std::ceil(std::sqrt((float)roomsPerFloor)));
+    }
+
+    Door makeDoor(const Room& a, const Room& b, int indexA, int indexB, bool open) {
+        Door door;
+        door.position = Vector3((a.position.x + b.position.x) * 0.5f,
+                                std::min(a.position.y, b.position.y) + DOOR_HEIGHT,
+                                (a.position.z + b.position.z) * 0.5f);
+        door.isOpen = open;
+        door.connectsRooms[0] = indexA;
+        door.connectsRooms[1] = indexB;
+        return door;
+    }
+}
+
+GeneratedMansion MansionGenerator::generate(const MansionGenParams& params) {
+    MansionGenParams p = params;
+    p.wings = std::max(1, p.wings);
+    p.floors = std::max(1, p.floors);
+    p.roomCount = std::max(p.wings * p.floors, p.roomCount);
+
+    // Work out each wing's size and position up front so the wings
+    // themselves can be built independently
+    std::vector<int> wingRooms(p.wings);
+    std::vector<float> wingOrigins(p.wings);
+    float originX = 0.0f;
+    for (int w = 0; w < p.wings; w++) {
+        wingRooms[w] = p.roomCount / p.wings + (w < p.roomCount % p.wings ? 1 : 0);
+        wingOrigins[w] = originX;
+
+        int perFloor = (wingRooms[w] + p.floors - 1) / p.floors;
+        originX += gridColumns(perFloor) * CELL_SIZE + WING_GAP;
+    }
+
+    std::vector<Wing> wings(p.wings);
+    getJobSystem().parallelFor(p.wings, [&](int w) {
+        wings[w] = generateWing(p, w, wingRooms[w], wingOrigins[w]);
+    });
+
+    GeneratedMansion out;
+    stitch(p, wings, out);
+    placeTasksAndPatrol(p, out);
+    return out;
+}
+
+MansionGenerator::Wing MansionGenerator::generateWing(const MansionGenParams& params, int wingIndex,
+                                                      int roomCount, float originX) {
+    GenRandom rng(mixSeed(params.seed, (uint32_t)wingIndex));
+    const char* wingName = WING_NAMES[wingIndex % countOf(WING_NAMES)];
+
+    Wing wing;
+    int perFloor = (roomCount + params.floors - 1) / params.floors;
+    int columns = gridColumns(perFloor);
+    wing.width = columns * CELL_SIZE;
+    wing.entranceRoom = std::min(columns / 2, roomCount - 1);
+    wing.rooms.reserve(roomCount);
+
+    std::vector<int> floorStart;
+    for (int floor = 0; floor < params.floors; floor++) {
+        int first = (int)wing.rooms.size();
+        int count = std::min(perFloor, roomCount - first);
+        if (count <= 0) break;
+        floorStart.push_back(first);
+
+        float floorY = floor * FLOOR_HEIGHT;
+        for (int i = 0; i < count; i++) {
+            int row = i / columns;
+            int col = i % columns;
+
+            Room room;
+            room.size = Vector3(rng.range(MIN_ROOM_SIZE, MAX_ROOM_SIZE), ROOM_HEIGHT,
+                                rng.range(MIN_ROOM_SIZE, MAX_ROOM_SIZE));
+            float slackX = (CELL_SIZE - room.size.x) * 0.5f;
+            float slackZ = (CELL_SIZE - room.size.z) * 0.5f;
+            room.position = Vector3(originX + (col + 0.5f) * CELL_SIZE + rng.range(-slackX, slackX) * 0.5f,
+                                    floorY,
+                                    CORRIDOR_DEPTH + (row + 0.5f) * CELL_SIZE + rng.range(-slackZ, slackZ) * 0.5f);
+            room.name = std::string(wingName) + " " + ROOM_TYPES[rng.index(countOf(ROOM_TYPES))] +
+                        " " + std::to_string(floor + 1) + "-" + std::to_string(i + 1);
+
+            int index = (int)wing.rooms.size();
+            wing.rooms.push_back(room);
+
+            // Every room joins the one to its left; the first column always
+            // joins the row below so the floor stays connected, other columns
+            // only sometimes, which gives loops without a full grid
+            if (col > 0) {
+                wing.doors.push_back(makeDoor(wing.rooms[index - 1], room, index - 1, index,
+                                              rng.chance(OPEN_DOOR_CHANCE)));
+            }
+            if (row > 0 && (col == 0 || rng.chance(EXTRA_DOOR_CHANCE))) {
+                int below = index - columns;
+                wing.doors.push_back(makeDoor(wing.rooms[below], room, below, index,
+                                              rng.chance(OPEN_DOOR_CHANCE)));
+            }
+
+            if (rng.chance(HIDING_SPOT_CHANCE)) {
+                HidingSpot spot;
+                float cornerX = (room.size.x * 0.5f - 1.5f) * (rng.chance(0.5f) ? 1.0f : -1.0f);
+                float cornerZ = (room.size.z * 0.5f - 1.5f) * (rng.chance(0.5f) ? 1.0f : -1.0f);
+                spot.position = Vector3(room.position.x + cornerX, floorY + 1.0f, room.position.z + cornerZ);
+                spot.radius = 1.5f;
+                spot.type = SPOT_TYPES[rng.index(countOf(SPOT_TYPES))];
+                wing.hidingSpots.push_back(spot);
+            }
+        }
+    }
+
+    // Stairwells link the entrance-column room of each floor to the one above
+    for (size_t floor = 1; floor < floorStart.size(); floor++) {
+        int lower = floorStart[floor - 1] + wing.entranceRoom;
+        int upper = std::min(floorStart[floor] + wing.entranceRoom, (int)wing.rooms.size() - 1);
+        wing.doors.push_back(makeDoor(wing.rooms[lower], wing.rooms[upper], lower, upper, true));
+    }
+
+    return wing;
+}
+
+void MansionGenerator::stitch(const MansionGenParams& params, std::vector<Wing>& wings, GeneratedMansion& out) {
+    size_t totalRooms = wings.size();
+    size_t totalDoors = wings.size() * 2;
+    size_t totalSpots = 0;
+    for (const auto& wing : wings) {
+        totalRooms += wing.rooms.size();
+        totalDoors += wing.doors.size();
+        totalSpots += wing.hidingSpots.size();
+    }
+    out.rooms.reserve(totalRooms);
+    out.doors.reserve(totalDoors);
+    out.hidingSpots.reserve(totalSpots);
+
+    // A front corridor segment runs along each wing; segments come first
+    float x = 0.0f;
+    for (size_t w = 0; w < wings.size(); w++) {
+        Room corridor;
+        corridor.name = std::string("Front Corridor ") + std::to_string(w + 1);
+        corridor.size = Vector3(wings[w].width + WING_GAP, ROOM_HEIGHT, CORRIDOR_DEPTH);
+        corridor.position = Vector3(x + corridor.size.x * 0.5f, 0.0f, 0.0f);
+        out.rooms.push_back(corridor);
+        x += corridor.size.x;
+
+        if (w > 0) {
+            out.doors.push_back(makeDoor(out.rooms[w - 1], corridor, (int)w - 1, (int)w, true));
+        }
+    }
+
+    // Append wings in order, shifting their local room indices
+    for (size_t w = 0; w < wings.size(); w++) {
+        Wing& wing = wings[w];
+        int base = (int)out.rooms.size();
+
+        for (auto& door : wing.doors) {
+            door.connectsRooms[0] += base;
+            door.connectsRooms[1] += base;
+            out.doors.push_back(door);
+        }
+
+        out.rooms.insert(out.rooms.end(), std::make_move_iterator(wing.rooms.begin()),
+                         std::make_move_iterator(wing.rooms.end()));
+        out.hidingSpots.insert(out.hidingSpots.end(), std::make_move_iterator(wing.hidingSpots.begin()),
+                               std::make_move_iterator(wing.hidingSpots.end()));
+
+        int entrance = base + wing.entranceRoom;
+        out.doors.push_back(makeDoor(out.rooms[w], out.rooms[entrance], (int)w, entrance, true));
+    }
+
+    out.playerStart = Vector3(out.rooms[0].position.x - out.rooms[0].size.x * 0.5f + 3.0f, 0.0f, 0.0f);
+}
+
+void MansionGenerator::placeTasksAndPatrol(const MansionGenParams& params, GeneratedMansion& out) {
+    GenRandom rng(mixSeed(params.seed, 0xFFFFFFFFu));
+    size_t roomCount = out.rooms.size();
+
+    // Spread tasks across the wings rather than clustering them at the
+    // start; the corridor segments at the front of the list are skipped
+    size_t firstWingRoom = std::min((size_t)params.wings, roomCount - 1);
+    size_t wingRoomCount = roomCount - firstWingRoom;
+    int taskCount = (int)std::min<size_t>(MAX_TASKS - 1, wingRoomCount);
+    for (int k = 0; k < taskCount; k++) {
+        // Each task gets its own stretch of rooms, even when there are only
+        // as many rooms as tasks
+        size_t start = (k * wingRoomCount) / taskCount;
+        size_t span = ((k + 1) * wingRoomCount) / taskCount - start;
+        size_t index = firstWingRoom + start + (span > 1 ? rng.index(span / 2) : 0);
+        index = std::min(index, roomCount - 1);
+        const Room& room = out.rooms[index];
+
+        Task task;
+        task.id = k + 1;
+        task.description = std::string(TASK_TEMPLATES[rng.index(countOf(TASK_TEMPLATES))]) + room.name;
+        task.location = Vector3(room.position.x, room.position.y + 1.0f, room.position.z);
+        task.radius = 2.5f;
+        task.completed = false;
+        out.tasks.push_back(task);
+    }
+
+    Task escape;
+    escape.id = taskCount + 1;
+    escape.description = "Escape through the front door";
+    escape.location = Vector3(out.playerStart.x, 1.0f, out.playerStart.z);
+    escape.radius = 2.5f;
+    escape.completed = false;
+    out.tasks.push_back(escape);
+
+    // Patrol the ground floor, since the monster doesn't change level
+    std::vector<int> groundRooms;
+    for (size_t i = 0; i < roomCount; i++) {
+        if (out.rooms[i].position.y == 0.0f) groundRooms.push_back((int)i);
+    }
+
+    int patrolCount = std::min((int)groundRooms.size(), MAX_PATROL_POINTS);
+    for (int k = 0; k < patrolCount; k++) {
+        const Room& room = out.rooms[groundRooms[(size_t)k * groundRooms.size() / patrolCount]];
+        out.patrolPoints.push_back(Vector3(room.position.x, 1.0f, room.position.z));
+    }
+
+    out.monsterStart = out.patrolPoints.empty() ? out.playerStart : out.patrolPoints.back();
+    out.monsterStart.y = 0.0f;
+}
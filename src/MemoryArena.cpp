@@ -0,0 +1,91 @@
+#include "MemoryArena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+    const size_t FRAME_ARENA_SIZE = 1024 * 1024;   // Per buffer, two buffers
+    const size_t THREAD_SCRATCH_SIZE = 256 * 1024;
+
+    size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+LinearArena::LinearArena(size_t capacity, MemTag tag)
+    : buffer(nullptr), capacity(capacity), offset(0), peak(0), overflowWarned(false), tag(tag) {
+    MemTagScope memScope(tag);
+    buffer = static_cast<uint8_t*>(::operator new(capacity));
+}
+
+LinearArena::~LinearArena() {
+    releaseOverflow();
+    ::operator delete(buffer);
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment) {
+    // Offsets are aligned relative to the block, which operator new already
+    // aligns to max_align_t; larger alignments are handled by the address check
+    uintptr_t base = reinterpret_cast<uintptr_t>(buffer);
+    size_t start = alignUp(base + offset, alignment) - base;
+
+    if (start + size <= capacity) {
+        offset = start + size;
+        peak = std::max(peak, offset);
+        return buffer + start;
+    }
+
+    // Out of space - spill to the heap rather than fail
+    if (!overflowWarned) {
+        std::cerr << "LinearArena: " << capacity << " byte block exhausted, "
+                  << "spilling to heap (consider raising the arena size)" << std::endl;
+        overflowWarned = true;
+    }
+    MemTagScope memScope(tag);
+    void* mem = ::operator new(size + alignment);
+    overflow.push_back(mem);
+    return reinterpret_cast<void*>(alignUp(reinterpret_cast<uintptr_t>(mem), alignment));
+}
+
+void LinearArena::reset() {
+    offset = 0;
+    if (!overflow.empty()) {
+        releaseOverflow();
+    }
+}
+
+void LinearArena::rewind(size_t marker) {
+    offset = std::min(marker, offset);
+    // Spilled blocks aren't ordered relative to markers, so only drop them
+    // once the whole stack has been unwound
+    if (offset == 0 && !overflow.empty()) {
+        releaseOverflow();
+    }
+}
+
+void LinearArena::releaseOverflow() {
+    for (void* mem : overflow) {
+        ::operator delete(mem);
+    }
+    overflow.clear();
+}
+
+FrameArena::FrameArena(size_t capacityPerFrame)
+    : arenas{LinearArena(capacityPerFrame), LinearArena(capacityPerFrame)}, current(0) {
+}
+
+void FrameArena::beginFrame() {
+    // The arena we switch to was last written two frames ago
+    current ^= 1;
+    arenas[current].reset();
+}
+
+LinearArena& getThreadScratch() {
+    thread_local LinearArena scratch(THREAD_SCRATCH_SIZE);
+    return scratch;
+}
+
+FrameArena& getFrameArena() {
+    static FrameArena frameArena(FRAME_ARENA_SIZE);
+    return frameArena;
+}
@@ -0,0 +1,259 @@
+#include "MemoryTracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+namespace {
+    const int TAG_COUNT = static_cast<int>(MemTag::COUNT);
+    const float RATE_WINDOW = 1.0f; // Seconds between allocation rate samples
+
+    // Plain zero-initialized statics so they are usable from operator new
+    // before any constructors have run
+    std::atomic<size_t> liveBytes[TAG_COUNT];
+    std::atomic<size_t> peakBytes[TAG_COUNT];
+    std::atomic<size_t> allocCount[TAG_COUNT];
+    std::atomic<size_t> budgets[TAG_COUNT];
+
+    // Only touched from update() on the main thread
+    size_t lastAllocCount[TAG_COUNT];
+    float allocRate[TAG_COUNT];
+    bool overBudget[TAG_COUNT];
+    float rateTimer = 0.0f;
+
+    thread_local MemTag currentTag = MemTag::GENERAL;
+
+    int tagIndex(MemTag tag) {
+        int index = static_cast<int>(tag);
+        return (index >= 0 && index < TAG_COUNT) ? index : 0;
+    }
+
+    double toKB(size_t bytes) {
+        return bytes / 1024.0;
+    }
+}
+
+const char* getMemTagName(MemTag tag) {
+    switch (tag) {
+        case MemTag::GENERAL: return "General";
+        case MemTag::RENDERER: return "Renderer";
+        case MemTag::MONSTER: return "Monster";
+        case MemTag::MANSION: return "Mansion";
+        case MemTag::AUDIO: return "AudioManager";
+        case MemTag::MENU: return "Menu";
+        case MemTag::TASKS: return "TaskSystem";
+        case MemTag::PLAYER: return "Player";
+        case MemTag::INPUT: return "InputHandler";
+        case MemTag::PARTICLES: return "Particles";
+        case MemTag::ARENA: return "Arenas";
+        default: return "Unknown";
+    }
+}
+
+void MemoryTracker::recordAlloc(MemTag tag, size_t bytes) {
+    int i = tagIndex(tag);
+    size_t live = liveBytes[i].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    allocCount[i].fetch_add(1, std::memory_order_relaxed);
+
+    size_t peak = peakBytes[i].load(std::memory_order_relaxed);
+    while (live > peak && !peakBytes[i].compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+void MemoryTracker::recordFree(MemTag tag, size_t bytes) {
+    liveBytes[tagIndex(tag)].fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void MemoryTracker::setBudget(MemTag tag, size_t bytes) {
+    budgets[tagIndex(tag)].store(bytes, std::memory_order_relaxed);
+}
+
+size_t MemoryTracker::getBudget(MemTag tag) const {
+    return budgets[tagIndex(tag)].load(std::memory_order_relaxed);
+}
+
+size_t MemoryTracker::getLiveBytes(MemTag tag) const {
+    return liveBytes[tagIndex(tag)].load(std::memory_order_relaxed);
+}
+
+size_t MemoryTracker::getPeakBytes(MemTag tag) const {
+    return peakBytes[tagIndex(tag)].load(std::memory_order_relaxed);
+}
+
+size_t MemoryTracker::getTotalLiveBytes() const {
+    size_t total = 0;
+    for (int i = 0; i < TAG_COUNT; i++) {
+        total += liveBytes[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+float MemoryTracker::getAllocRate(MemTag tag) const {
+    return allocRate[tagIndex(tag)];
+}
+
+void MemoryTracker::update(float deltaTime) {
+    rateTimer += deltaTime;
+    if (rateTimer >= RATE_WINDOW) {
+        for (int i = 0; i < TAG_COUNT; i++) {
+            size_t count = allocCount[i].load(std::memory_order_relaxed);
+            allocRate[i] = (count - lastAllocCount[i]) / rateTimer;
+            lastAllocCount[i] = count;
+        }
+        rateTimer = 0.0f;
+    }
+
+    // Warn once when a subsystem goes over budget, and re-arm once it's back under
+    for (int i = 0; i < TAG_COUNT; i++) {
+        size_t budget = budgets[i].load(std::memory_order_relaxed);
+        if (budget == 0) continue;
+
+        size_t live = liveBytes[i].load(std::memory_order_relaxed);
+        if (live > budget && !overBudget[i]) {
+            overBudget[i] = true;
+            std::cerr << "Memory budget exceeded: " << getMemTagName(static_cast<MemTag>(i))
+                      << " using " << std::fixed << std::setprecision(1) << toKB(live)
+                      << " KB of " << toKB(budget) << " KB" << std::endl;
+        } else if (live <= budget) {
+            overBudget[i] = false;
+        }
+    }
+}
+
+void MemoryTracker::dumpReport(std::ostream& out) const {
+    out << "==== Memory report ====" << std::endl;
+    out << std::left << std::setw(14) << "Subsystem"
+        << std::right << std::setw(12) << "Live KB"
+        << std::setw(12) << "Peak KB"
+        << std::setw(12) << "Budget KB"
+        << std::setw(12) << "Allocs/s"
+        << std::setw(12) << "Allocs" << std::endl;
+
+    out << std::fixed << std::setprecision(1);
+    for (int i = 0; i < TAG_COUNT; i++) {
+        size_t budget = budgets[i].load(std::memory_order_relaxed);
+        size_t live = liveBytes[i].load(std::memory_order_relaxed);
+
+        out << std::left << std::setw(14) << getMemTagName(static_cast<MemTag>(i))
+            << std::right << std::setw(12) << toKB(live)
+            << std::setw(12) << toKB(peakBytes[i].load(std::memory_order_relaxed));
+        if (budget > 0) {
+            out << std::setw(12) << toKB(budget);
+        } else {
+            out << std::setw(12) << "-";
+        }
+        out << std::setw(12) << allocRate[i]
+            << std::setw(12) << allocCount[i].load(std::memory_order_relaxed);
+        if (budget > 0 && live > budget) {
+            out << "  OVER BUDGET";
+        }
+        out << std::endl;
+    }
+    out << "Total live: " << toKB(getTotalLiveBytes()) << " KB" << std::endl;
+}
+
+MemoryTracker& getMemoryTracker() {
+    static MemoryTracker tracker;
+    return tracker;
+}
+
+MemTagScope::MemTagScope(MemTag tag) : previous(currentTag) {
+    currentTag = tag;
+}
+
+MemTagScope::~MemTagScope() {
+    currentTag = previous;
+}
+
+MemTag getCurrentMemTag() {
+    return currentTag;
+}
+
+#ifdef MANSION_MEMORY_TRACKING
+
+// Global allocation hooks. Every block carries a 16 byte header in front of
+// the returned pointer recording its size, owning tag and the distance back
+// to the start of the malloc'd block (non-zero padding for over-aligned types).
+namespace {
+    struct AllocHeader {
+        size_t size;
+        uint32_t offset;
+        uint8_t tag;
+        uint8_t pad[3];
+    };
+    static_assert(sizeof(AllocHeader) == 16, "AllocHeader must keep 16 byte alignment");
+
+    const size_t HEADER_SIZE = sizeof(AllocHeader);
+
+    void* trackedAlloc(size_t size, size_t alignment) {
+        if (alignment < HEADER_SIZE) alignment = HEADER_SIZE;
+
+        size_t padding = alignment > HEADER_SIZE ? alignment : 0;
+        // A size this close to SIZE_MAX would wrap to a tiny block; failing
+        // here sends operator new down the new-handler/bad_alloc path instead
+        if (size > SIZE_MAX - HEADER_SIZE - padding) return nullptr;
+        char* raw = static_cast<char*>(std::malloc(size + HEADER_SIZE + padding));
+        if (!raw) return nullptr;
+
+        uintptr_t user = reinterpret_cast<uintptr_t>(raw) + HEADER_SIZE;
+        user = (user + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+        AllocHeader* header = reinterpret_cast<AllocHeader*>(user - HEADER_SIZE);
+        header->size = size;
+        header->offset = static_cast<uint32_t>(user - reinterpret_cast<uintptr_t>(raw));
+        header->tag = static_cast<uint8_t>(currentTag);
+
+        getMemoryTracker().recordAlloc(currentTag, size);
+        return reinterpret_cast<void*>(user);
+    }
+
+    void trackedFree(void* ptr) {
+        if (!ptr) return;
+
+        AllocHeader* header = reinterpret_cast<AllocHeader*>(static_cast<char*>(ptr) - HEADER_SIZE);
+        getMemoryTracker().recordFree(static_cast<MemTag>(header->tag), header->size);
+        std::free(static_cast<char*>(ptr) - header->offset);
+    }
+
+    void* trackedNew(size_t size, size_t alignment) {
+        void* ptr = trackedAlloc(size, alignment);
+        while (!ptr) {
+            std::new_handler handler = std::get_new_handler();
+            if (!handler) throw std::bad_alloc();
+            handler();
+            ptr = trackedAlloc(size, alignment);
+        }
+        return ptr;
+    }
+}
+
+void* operator new(size_t size) { return trackedNew(size, HEADER_SIZE); }
+void* operator new[](size_t size) { return trackedNew(size, HEADER_SIZE); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return trackedAlloc(size, HEADER_SIZE); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return trackedAlloc(size, HEADER_SIZE); }
+
+void* operator new(size_t size, std::align_val_t al) { return trackedNew(size, static_cast<size_t>(al)); }
+void* operator new[](size_t size, std::align_val_t al) { return trackedNew(size, static_cast<size_t>(al)); }
+void* operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return trackedAlloc(size, static_cast<size_t>(al));
+}
+void* operator new[](size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return trackedAlloc(size, static_cast<size_t>(al));
+}
+
+void operator delete(void* ptr) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+
+#endif // MANSION_MEMORY_TRACKING
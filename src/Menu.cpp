@@ -1,18 +1,20 @@
 #include "Menu.h"
 #include "Renderer.h"
 #include "InputHandler.h"
-#include <GL/gl.h>
+#include "TextRenderer.h"
 #include <cmath>
 
 Menu::Menu(Game* game)
     : game(game), currentMenu(MenuType::MAIN_MENU),
-      screenWidth(game->getScreenWidth()), screenHeight(game->getScreenHeight()) {
+      screenWidth(game->getScreenWidth()), screenHeight(game->getScreenHeight()),
+      layoutDirty(true), backdrop{0, 0}, titleText{0, 0} {
     setupMainMenu();
 }
 
 void Menu::setMenuType(MenuType type) {
     currentMenu = type;
     buttons.clear();
+    layoutDirty = true;
     
     switch (type) {
         case MenuType::MAIN_MENU: setupMainMenu(); break;
@@ -189,6 +191,11 @@ void Menu::update(const InputHandler& input) {
 }
 
 void Menu::render(Renderer& renderer) {
+    if (layoutDirty) {
+        batch.clear();
+        buttonFaces.clear();
+    }
+    
     switch (currentMenu) {
         case MenuType::MAIN_MENU: renderMainMenu(renderer); break;
         case MenuType::PAUSE_MENU: renderPauseMenu(renderer); break;
@@ -197,169 +204,114 @@ void Menu::render(Renderer& renderer) {
         case MenuType::VICTORY_MENU: renderVictoryMenu(renderer); break;
         default: break;
     }
+    layoutDirty = false;
+    animateButtons();
+    
+    renderer.drawBatch(batch);
 }
 
-void Menu::renderButton(const MenuButton& btn, float baseR, float baseG, float baseB) {
-    static float animTime = 0.0f;
-    animTime += 0.05f;
-    
+void Menu::cleanup() {
+    batch.release();
+}
+
+void Menu::renderButton(Renderer& renderer, const MenuButton& btn, float baseR, float baseG, float baseB) {
     float hoverBoost = btn.hovered ? 0.3f : 0.0f;
-    float pulse = btn.hovered ? 0.1f * sin(animTime * 3.0f) : 0.0f;
     
     // Button shadow
-    glColor4f(0.0f, 0.0f, 0.0f, 0.5f);
-    glBegin(GL_QUADS);
-    glVertex2f(btn.x + 4, btn.y + 4);
-    glVertex2f(btn.x + btn.width + 4, btn.y + 4);
-    glVertex2f(btn.x + btn.width + 4, btn.y + btn.height + 4);
-    glVertex2f(btn.x + 4, btn.y + btn.height + 4);
-    glEnd();
+    batch.addQuad(btn.x + 4, btn.y + 4, btn.x + btn.width + 4, btn.y + btn.height + 4, Color2D{0.0f, 0.0f, 0.0f, 0.5f});
     
     // Button background
-    glColor3f(baseR + hoverBoost + pulse, baseG + hoverBoost + pulse, baseB + hoverBoost + pulse);
-    glBegin(GL_QUADS);
-    glVertex2f(btn.x, btn.y);
-    glVertex2f(btn.x + btn.width, btn.y);
-    glVertex2f(btn.x + btn.width, btn.y + btn.height);
-    glVertex2f(btn.x, btn.y + btn.height);
-    glEnd();
+    Color2D face = {baseR + hoverBoost, baseG + hoverBoost, baseB + hoverBoost, 1.0f};
+    Batch2D::Range range = batch.addQuad(btn.x, btn.y, btn.x + btn.width, btn.y + btn.height, face);
+    buttonFaces.push_back(ButtonFace{range, face, btn.hovered});
     
     // Button border
-    glColor3f(0.8f, 0.8f, 0.8f);
-    glLineWidth(2.0f);
-    glBegin(GL_LINE_LOOP);
-    glVertex2f(btn.x, btn.y);
-    glVertex2f(btn.x + btn.width, btn.y);
-    glVertex2f(btn.x + btn.width, btn.y + btn.height);
-    glVertex2f(btn.x, btn.y + btn.height);
-    glEnd();
+    batch.addOutline(btn.x, btn.y, btn.x + btn.width, btn.y + btn.height, 2.0f, Color2D{0.8f, 0.8f, 0.8f, 1.0f});
     
     // Button text (centered)
-    int textX = btn.x + (btn.width - btn.text.length() * 8) / 2;
-    int textY = btn.y + (btn.height - 16) / 2;
+    TextRenderer& text = renderer.getTextRenderer();
+    int textX = btn.x + (btn.width - text.measure(btn.text)) / 2;
+    int textY = btn.y + (btn.height - TextRenderer::GLYPH_HEIGHT) / 2;
+    text.addText(batch, btn.text, textX, textY, Color2D{1.0f, 1.0f, 1.0f, 1.0f});
+}
+
+Batch2D::Range Menu::addTitle(Renderer& renderer, const std::string& title, int y, const Color2D& color, int scale) {
+    TextRenderer& text = renderer.getTextRenderer();
+    int x = (screenWidth - text.measure(title, scale)) / 2;
+    return text.addText(batch, title, x, y, color, scale);
+}
+
+void Menu::animateButtons() {
+    static float animTime = 0.0f;
     
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glRasterPos2i(textX, textY + 12);
+    for (const auto& face : buttonFaces) {
+        animTime += 0.05f;
+        if (!face.hovered) continue;
+        
+        float pulse = 0.1f * sin(animTime * 3.0f);
+        batch.setColor(face.range, Color2D{face.color.r + pulse, face.color.g + pulse, face.color.b + pulse, 1.0f});
+    }
 }
 
 void Menu::renderMainMenu(Renderer& renderer) {
     static float titlePulse = 0.0f;
     titlePulse += 0.03f;
     
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, screenWidth, screenHeight, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    if (layoutDirty) {
+        // Background gradient
+        batch.addGradient(0, 0, screenWidth, screenHeight, Color2D{0.1f, 0.0f, 0.0f, 1.0f}, Color2D{0.0f, 0.0f, 0.05f, 1.0f});
+        
+        // Title backdrop; its glow is set below
+        backdrop = batch.addQuad(screenWidth/2 - 350, 80, screenWidth/2 + 350, 220, Color2D{0.1f, 0.0f, 0.0f, 0.6f});
+        
+        // Title text; it pulses with the glow
+        titleText = addTitle(renderer, "MANSION HORROR", 110, Color2D{0.9f, 0.1f, 0.1f, 1.0f}, 3);
+        addTitle(renderer, "- 2003 -", 172, Color2D{0.7f, 0.7f, 0.7f, 1.0f}, 2);
+        
+        for (const auto& btn : buttons) {
+            renderButton(renderer, btn, 0.2f, 0.05f, 0.05f);
+        }
+    }
     
-    // Background gradient
-    glBegin(GL_QUADS);
-    glColor3f(0.1f, 0.0f, 0.0f);
-    glVertex2f(0, 0);
-    glVertex2f(screenWidth, 0);
-    glColor3f(0.0f, 0.0f, 0.05f);
-    glVertex2f(screenWidth, screenHeight);
-    glVertex2f(0, screenHeight);
-    glEnd();
-    
-    // Title backdrop with glow
     float titleGlow = 0.1f + 0.05f * sin(titlePulse);
-    glColor4f(titleGlow, 0.0f, 0.0f, 0.6f);
-    glBegin(GL_QUADS);
-    glVertex2f(screenWidth/2 - 350, 80);
-    glVertex2f(screenWidth/2 + 350, 80);
-    glVertex2f(screenWidth/2 + 350, 220);
-    glVertex2f(screenWidth/2 - 350, 220);
-    glEnd();
-    
-    // Title text
-    float titleR = 0.9f + 0.1f * sin(titlePulse);
-    glColor3f(titleR, 0.1f, 0.1f);
-    glRasterPos2i(screenWidth/2 - 200, 130);
+    batch.setColor(backdrop, Color2D{titleGlow, 0.0f, 0.0f, 0.6f});
     
-    glColor3f(0.7f, 0.7f, 0.7f);
-    glRasterPos2i(screenWidth/2 - 80, 180);
-    
-    // Render buttons
-    for (const auto& btn : buttons) {
-        renderButton(btn, 0.2f, 0.05f, 0.05f);
-    }
+    float titleR = 0.9f + 0.1f * sin(titlePulse);
+    batch.setColor(titleText, Color2D{titleR, 0.1f, 0.1f, 1.0f});
 }
 
 void Menu::renderPauseMenu(Renderer& renderer) {
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, screenWidth, screenHeight, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    if (!layoutDirty) return;
     
     // Semi-transparent overlay
-    glColor4f(0.0f, 0.0f, 0.0f, 0.75f);
-    glBegin(GL_QUADS);
-    glVertex2f(0, 0);
-    glVertex2f(screenWidth, 0);
-    glVertex2f(screenWidth, screenHeight);
-    glVertex2f(0, screenHeight);
-    glEnd();
+    batch.addQuad(0, 0, screenWidth, screenHeight, Color2D{0.0f, 0.0f, 0.0f, 0.75f});
     
     // Pause panel
-    glColor4f(0.1f, 0.1f, 0.15f, 0.9f);
-    glBegin(GL_QUADS);
-    glVertex2f(screenWidth/2 - 300, 100);
-    glVertex2f(screenWidth/2 + 300, 100);
-    glVertex2f(screenWidth/2 + 300, screenHeight - 100);
-    glVertex2f(screenWidth/2 - 300, screenHeight - 100);
-    glEnd();
+    batch.addQuad(screenWidth/2 - 300, 100, screenWidth/2 + 300, screenHeight - 100, Color2D{0.1f, 0.1f, 0.15f, 0.9f});
     
     // Title
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glRasterPos2i(screenWidth/2 - 80, 170);
+    addTitle(renderer, "PAUSED", 150, Color2D{1.0f, 1.0f, 1.0f, 1.0f}, 3);
     
     for (const auto& btn : buttons) {
-        renderButton(btn, 0.15f, 0.15f, 0.25f);
+        renderButton(renderer, btn, 0.15f, 0.15f, 0.25f);
     }
 }
 
 void Menu::renderControlSelect(Renderer& renderer) {
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, screenWidth, screenHeight, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    if (!layoutDirty) return;
     
     // Background gradient
-    glBegin(GL_QUADS);
-    glColor3f(0.05f, 0.05f, 0.08f);
-    glVertex2f(0, 0);
-    glVertex2f(screenWidth, 0);
-    glColor3f(0.02f, 0.02f, 0.05f);
-    glVertex2f(screenWidth, screenHeight);
-    glVertex2f(0, screenHeight);
-    glEnd();
+    batch.addGradient(0, 0, screenWidth, screenHeight, Color2D{0.05f, 0.05f, 0.08f, 1.0f}, Color2D{0.02f, 0.02f, 0.05f, 1.0f});
     
     // Title panel
-    glColor4f(0.15f, 0.1f, 0.1f, 0.8f);
-    glBegin(GL_QUADS);
-    glVertex2f(screenWidth/2 - 300, 80);
-    glVertex2f(screenWidth/2 + 300, 80);
-    glVertex2f(screenWidth/2 + 300, 160);
-    glVertex2f(screenWidth/2 - 300, 160);
-    glEnd();
-    
-    glColor3f(1.0f, 0.9f, 0.5f);
-    glRasterPos2i(screenWidth/2 - 180, 120);
+    batch.addQuad(screenWidth/2 - 300, 80, screenWidth/2 + 300, 160, Color2D{0.15f, 0.1f, 0.1f, 0.8f});
+    addTitle(renderer, "CHOOSE YOUR CONTROLS", 104, Color2D{1.0f, 0.9f, 0.5f, 1.0f}, 2);
     
     for (const auto& btn : buttons) {
         if (btn.text == "BACK") {
-            renderButton(btn, 0.2f, 0.1f, 0.1f);
+            renderButton(renderer, btn, 0.2f, 0.1f, 0.1f);
         } else {
-            renderButton(btn, 0.1f, 0.2f, 0.1f);
+            renderButton(renderer, btn, 0.1f, 0.2f, 0.1f);
         }
     }
 }
@@ -368,82 +320,50 @@ void Menu::renderGameOverMenu(Renderer& renderer) {
     static float deathPulse = 0.0f;
     deathPulse += 0.08f;
     
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, screenWidth, screenHeight, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    const Color2D bottom = {0.05f, 0.0f, 0.0f, 1.0f};
+    if (layoutDirty) {
+        // Red tinted background; the top pulses below
+        backdrop = batch.addGradient(0, 0, screenWidth, screenHeight, Color2D{0.15f, 0.0f, 0.0f, 1.0f}, bottom);
+        
+        // Death message panel
+        batch.addQuad(screenWidth/2 - 350, 120, screenWidth/2 + 350, 280, Color2D{0.2f, 0.0f, 0.0f, 0.8f});
+        titleText = addTitle(renderer, "YOU DIED", 168, Color2D{0.7f, 0.0f, 0.0f, 1.0f}, 4);
+        
+        for (const auto& btn : buttons) {
+            renderButton(renderer, btn, 0.3f, 0.05f, 0.05f);
+        }
+    }
     
-    // Red tinted background
     float redPulse = 0.15f + 0.1f * sin(deathPulse);
-    glBegin(GL_QUADS);
-    glColor3f(redPulse, 0.0f, 0.0f);
-    glVertex2f(0, 0);
-    glVertex2f(screenWidth, 0);
-    glColor3f(0.05f, 0.0f, 0.0f);
-    glVertex2f(screenWidth, screenHeight);
-    glVertex2f(0, screenHeight);
-    glEnd();
-    
-    // Death message panel
-    glColor4f(0.2f, 0.0f, 0.0f, 0.8f);
-    glBegin(GL_QUADS);
-    glVertex2f(screenWidth/2 - 350, 120);
-    glVertex2f(screenWidth/2 + 350, 120);
-    glVertex2f(screenWidth/2 + 350, 280);
-    glVertex2f(screenWidth/2 - 350, 280);
-    glEnd();
+    batch.setGradient(backdrop, Color2D{redPulse, 0.0f, 0.0f, 1.0f}, bottom);
     
     float textIntensity = 0.7f + 0.3f * sin(deathPulse * 2);
-    glColor3f(textIntensity, 0.0f, 0.0f);
-    glRasterPos2i(screenWidth/2 - 120, 180);
-    
-    for (const auto& btn : buttons) {
-        renderButton(btn, 0.3f, 0.05f, 0.05f);
-    }
+    batch.setColor(titleText, Color2D{textIntensity, 0.0f, 0.0f, 1.0f});
 }
 
 void Menu::renderVictoryMenu(Renderer& renderer) {
     static float victoryPulse = 0.0f;
     victoryPulse += 0.04f;
     
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, screenWidth, screenHeight, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    const Color2D bottom = {0.0f, 0.0f, 0.05f, 1.0f};
+    if (layoutDirty) {
+        // Green victory background; the top pulses below
+        backdrop = batch.addGradient(0, 0, screenWidth, screenHeight, Color2D{0.0f, 0.05f, 0.0f, 1.0f}, bottom);
+        
+        // Victory panel
+        batch.addQuad(screenWidth/2 - 400, 100, screenWidth/2 + 400, 320, Color2D{0.0f, 0.2f, 0.0f, 0.85f});
+        titleText = addTitle(renderer, "YOU ESCAPED!", 178, Color2D{0.2f, 0.6f, 0.2f, 1.0f}, 4);
+        
+        for (const auto& btn : buttons) {
+            renderButton(renderer, btn, 0.05f, 0.25f, 0.05f);
+        }
+    }
     
-    // Green victory background
     float greenPulse = 0.05f + 0.03f * sin(victoryPulse);
-    glBegin(GL_QUADS);
-    glColor3f(0.0f, greenPulse, 0.0f);
-    glVertex2f(0, 0);
-    glVertex2f(screenWidth, 0);
-    glColor3f(0.0f, 0.0f, 0.05f);
-    glVertex2f(screenWidth, screenHeight);
-    glVertex2f(0, screenHeight);
-    glEnd();
-    
-    // Victory panel
-    glColor4f(0.0f, 0.2f, 0.0f, 0.85f);
-    glBegin(GL_QUADS);
-    glVertex2f(screenWidth/2 - 400, 100);
-    glVertex2f(screenWidth/2 + 400, 100);
-    glVertex2f(screenWidth/2 + 400, 320);
-    glVertex2f(screenWidth/2 - 400, 320);
-    glEnd();
+    batch.setGradient(backdrop, Color2D{0.0f, greenPulse, 0.0f, 1.0f}, bottom);
     
     float titleGlow = 0.6f + 0.4f * sin(victoryPulse * 2);
-    glColor3f(0.2f, titleGlow, 0.2f);
-    glRasterPos2i(screenWidth/2 - 150, 160);
-    
-    for (const auto& btn : buttons) {
-        renderButton(btn, 0.05f, 0.25f, 0.05f);
-    }
+    batch.setColor(titleText, Color2D{0.2f, titleGlow, 0.2f, 1.0f});
 }
 
 void Menu::handleClick(int x, int y) {
@@ -457,7 +377,11 @@ void Menu::handleClick(int x, int y) {
 
 void Menu::handleMouseMove(int x, int y) {
     for (auto& btn : buttons) {
-        btn.hovered = isPointInButton(x, y, btn);
+        bool hovered = isPointInButton(x, y, btn);
+        if (hovered != btn.hovered) {
+            btn.hovered = hovered;
+            layoutDirty = true;
+        }
     }
 }
 
@@ -11,7 +11,8 @@ Monster::Monster(Vector3 startPos)
       detectionRadius(15.0f), attackRadius(2.0f),
       hearingRadius(20.0f), visionAngle(60.0f),
       searchTimer(0.0f), searchDuration(10.0f), alertness(0.0f),
-      currentPatrolIndex(0), patrolWaitTime(3.0f), patrolWaitTimer(0.0f) {
+      currentPatrolIndex(0), patrolWaitTime(3.0f), patrolWaitTimer(0.0f),
+      coarseAccumulator(0.0f) {
     
     std::random_device rd;
     rng.seed(rd());
@@ -44,6 +45,39 @@ void Monster::update(float deltaTime, const Vector3& playerPos, bool playerHidin
     alertness = std::max(0.0f, alertness - 0.1f * deltaTime);
 }
 
+void Monster::updateCoarse(float deltaTime) {
+    const float COARSE_STEP = 0.5f;
+    
+    coarseAccumulator += deltaTime;
+    if (coarseAccumulator < COARSE_STEP) return;
+    
+    float step = coarseAccumulator;
+    coarseAccumulator = 0.0f;
+    
+    // Out of sight of the player, so hunting gives way to searching
+    if (state == MonsterState::CHASE || state == MonsterState::ATTACK) {
+        state = MonsterState::SEARCH;
+        searchTimer = 0;
+    }
+    
+    if (state == MonsterState::SEARCH) {
+        searchTimer += step;
+        if (searchTimer > searchDuration) {
+            state = MonsterState::PATROL;
+            alertness = 0;
+        }
+    }
+    
+    if (state == MonsterState::PATROL) {
+        patrol(step);
+    } else if (state == MonsterState::SEARCH) {
+        search(step, lastKnownPlayerPos);
+    }
+    
+    position = position + velocity * step;
+    alertness = std::max(0.0f, alertness - 0.1f * step);
+}
+
 void Monster::updateState(const Vector3& playerPos, bool playerHiding, float deltaTime) {
     bool canSee = canSeePlayer(playerPos, playerHiding);
     bool canHear = canHearPlayer(playerPos, 5.0f); // Threshold speed for hearing
@@ -0,0 +1,676 @@
+#include "MonsterAnimation.h"
+#include "JobSystem.h"
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MANSION_ANIMATION_SSE 1
+#endif
+
+namespace {
+    const float PI = 3.14159265f;
+    const int BONES = MONSTER_BONE_COUNT;
+
+    const float KEY_RATE = 30.0f;
+    // int16 steps per unit of quaternion and per metre of rise
+    const float QUAT_SCALE = 32767.0f;
+    const float RISE_SCALE = 8192.0f;
+
+    const float BLEND_TIME = 0.25f;
+    const float ATTACK_BLEND_TIME = 0.1f;
+    const float TURN_RATE = 6.0f;           // Radians per second
+    const float MOVING_SPEED = 0.3f;        // Slower than this stands still
+
+    // Vertices at a joint follow their own bone by this much, the parent by the rest
+    const float JOINT_WEIGHT = 0.6f;
+    // Widest half-extent of any bone's box, added around the posed joints
+    const float BOUNDS_MARGIN = 0.32f;
+
+    const int INSTANCES_PER_JOB = 16;
+
+    enum Bone {
+        PELVIS, SPINE, CHEST, HEAD,
+        ARM_L, FOREARM_L, ARM_R, FOREARM_R,
+        THIGH_L, SHIN_L, THIGH_R, SHIN_R
+    };
+
+    // Bind pose, standing and facing +z with the feet at the origin. Every
+    // bone is a box from its joint to its tail; parents come first.
+    struct BoneDesc {
+        int parent;
+        float joint[3];
+        float tail[3];
+        float halfWidth;
+        float halfDepth;
+        uint8_t color[4];
+    };
+
+    const BoneDesc SKELETON[BONES] = {
+        {-1, {0.0f, 1.05f, 0.0f}, {0.0f, 1.3f, 0.0f}, 0.24f, 0.15f, {20, 20, 20, 255}},
+        {PELVIS, {0.0f, 1.3f, 0.0f}, {0.0f, 1.75f, 0.0f}, 0.2f, 0.13f, {20, 20, 20, 255}},
+        {SPINE, {0.0f, 1.75f, 0.0f}, {0.0f, 2.25f, 0.0f}, 0.32f, 0.2f, {20, 20, 20, 255}},
+        {CHEST, {0.0f, 2.25f, 0.0f}, {0.0f, 2.85f, 0.0f}, 0.3f, 0.3f, {31, 20, 20, 255}},
+        {CHEST, {0.42f, 2.15f, 0.0f}, {0.42f, 1.55f, 0.0f}, 0.09f, 0.09f, {20, 20, 20, 255}},
+        {ARM_L, {0.42f, 1.55f, 0.0f}, {0.42f, 0.85f, 0.0f}, 0.07f, 0.07f, {26, 21, 21, 255}},
+        {CHEST, {-0.42f, 2.15f, 0.0f}, {-0.42f, 1.55f, 0.0f}, 0.09f, 0.09f, {20, 20, 20, 255}},
+        {ARM_R, {-0.42f, 1.55f, 0.0f}, {-0.42f, 0.85f, 0.0f}, 0.07f, 0.07f, {26, 21, 21, 255}},
+        {PELVIS, {0.14f, 1.05f, 0.0f}, {0.14f, 0.55f, 0.0f}, 0.11f, 0.11f, {20, 20, 20, 255}},
+        {THIGH_L, {0.14f, 0.55f, 0.0f}, {0.14f, 0.0f, 0.0f}, 0.09f, 0.09f, {20, 20, 20, 255}},
+        {PELVIS, {-0.14f, 1.05f, 0.0f}, {-0.14f, 0.55f, 0.0f}, 0.11f, 0.11f, {20, 20, 20, 255}},
+        {THIGH_R, {-0.14f, 0.55f, 0.0f}, {-0.14f, 0.0f, 0.0f}, 0.09f, 0.09f, {20, 20, 20, 255}}
+    };
+
+    struct ClipDesc {
+        const char* name;
+        float duration;
+        float stride;
+    };
+
+    // Indexed by MonsterClip; strides match Monster's walking and chasing speeds
+    const ClipDesc CLIPS[(int)MonsterClip::COUNT] = {
+        {"idle", 3.2f, 0.0f},
+        {"walk", 1.2f, 3.6f},
+        {"search", 4.0f, 0.0f},
+        {"run", 0.7f, 4.2f},
+        {"attack", 0.9f, 0.0f}
+    };
+
+    // Local rotation of a bone from the bind pose. Pitch turns about x, so a
+    // positive pitch leans the spine forward and swings a leg back; yaw turns
+    // about y and roll about z.
+    struct Euler {
+        float pitch;
+        float yaw;
+        float roll;
+    };
+
+    float smooth(float t) {
+        t = std::min(1.0f, std::max(0.0f, t));
+        return t * t * (3.0f - 2.0f * t);
+    }
+
+    // Arm pitch through an attack: raised overhead, brought down hard past
+    // the hip, then back to the guard it started from
+    float slash(float phase) {
+        phase -= std::floor(phase);
+        if (phase < 0.45f) return -0.3f - 2.2f * smooth(phase / 0.45f);
+        if (phase < 0.6f) return -2.5f + 2.9f * smooth((phase - 0.45f) / 0.15f);
+        return 0.4f - 0.7f * smooth((phase - 0.6f) / 0.4f);
+    }
+
+    // The authored clips, as functions of the phase through one cycle; every
+    // one is periodic so the baked loop has no seam. Returns how far the
+    // pelvis rises over the bind pose.
+    float pose(MonsterClip clip, float phase, Euler* bones) {
+        for (int b = 0; b < BONES; b++) {
+            bones[b] = {0.0f, 0.0f, 0.0f};
+        }
+        // Arms hang a little away from the body
+        bones[ARM_L].roll = 0.08f;
+        bones[ARM_R].roll = -0.08f;
+
+        float angle = 2.0f * PI * phase;
+        float s = std::sin(angle);
+        float c = std::cos(angle);
+
+        switch (clip) {
+            case MonsterClip::IDLE:
+                // Slow, heavy breathing
+                bones[SPINE].pitch = 0.08f + 0.02f * s;
+                bones[CHEST].pitch = 0.05f + 0.03f * s;
+                bones[HEAD].pitch = 0.1f - 0.04f * s;
+                bones[HEAD].roll = 0.06f * std::sin(angle * 0.5f) * std::sin(angle * 0.5f);
+                bones[ARM_L].pitch = 0.04f * s;
+                bones[ARM_R].pitch = 0.04f * s;
+                bones[FOREARM_L].pitch = -0.15f;
+                bones[FOREARM_R].pitch = -0.15f;
+                return 0.01f * s;
+
+            case MonsterClip::WALK:
+                bones[PELVIS].yaw = -0.08f * s;
+                bones[SPINE].pitch = 0.15f;
+                bones[CHEST].yaw = 0.1f * s;
+                bones[HEAD].pitch = -0.05f;
+                bones[THIGH_L].pitch = -0.45f * s;
+                bones[THIGH_R].pitch = 0.45f * s;
+                bones[SHIN_L].pitch = 0.1f + 0.5f * std::max(0.0f, c);
+                bones[SHIN_R].pitch = 0.1f + 0.5f * std::max(0.0f, -c);
+                bones[ARM_L].pitch = 0.35f * s;
+                bones[ARM_R].pitch = -0.35f * s;
+                bones[FOREARM_L].pitch = -0.25f;
+                bones[FOREARM_R].pitch = -0.25f;
+                // Lowest as each foot passes under the body, twice a cycle
+                return 0.03f * std::cos(2.0f * angle) - 0.03f;
+
+            case MonsterClip::SEARCH:
+                // Crouched, turning the head and shoulders side to side
+                bones[SPINE].pitch = 0.2f;
+                bones[CHEST].yaw = 0.3f * s;
+                bones[HEAD].yaw = 0.8f * s;
+                bones[HEAD].pitch = 0.05f + 0.1f * std::sin(2.0f * angle);
+                bones[ARM_L].pitch = -0.3f;
+                bones[ARM_R].pitch = -0.3f;
+                bones[FOREARM_L].pitch = -0.5f;
+                bones[FOREARM_R].pitch = -0.5f;
+                bones[THIGH_L].pitch = -0.15f;
+                bones[THIGH_R].pitch = -0.15f;
+                bones[SHIN_L].pitch = 0.3f;
+                bones[SHIN_R].pitch = 0.3f;
+                return -0.04f;
+
+            case MonsterClip::RUN:
+                // Bent low with the claws forward
+                bones[PELVIS].yaw = -0.12f * s;
+                bones[SPINE].pitch = 0.35f;
+                bones[CHEST].pitch = 0.1f;
+                bones[HEAD].pitch = -0.3f;
+                bones[THIGH_L].pitch = -0.9f * s;
+                bones[THIGH_R].pitch = 0.9f * s;
+                bones[SHIN_L].pitch = 0.2f + 1.1f * std::max(0.0f, c);
+                bones[SHIN_R].pitch = 0.2f + 1.1f * std::max(0.0f, -c);
+                bones[ARM_L].pitch = 0.8f * s;
+                bones[ARM_R].pitch = -0.8f * s;
+                bones[FOREARM_L].pitch = -1.0f;
+                bones[FOREARM_R].pitch = -1.0f;
+                return 0.06f * std::cos(2.0f * angle) - 0.08f;
+
+            case MonsterClip::ATTACK: {
+                // Right claw leads, the left follows a beat behind
+                float right = slash(phase);
+                float left = slash(phase - 0.1f);
+                bones[SPINE].pitch = 0.2f;
+                bones[CHEST].pitch = 0.1f + 0.08f * right;
+                bones[CHEST].yaw = 0.15f * s;
+                bones[HEAD].pitch = -0.2f;
+                bones[ARM_R].pitch = right;
+                bones[ARM_L].pitch = left;
+                bones[FOREARM_L].pitch = -0.4f;
+                bones[FOREARM_R].pitch = -0.4f;
+                bones[THIGH_L].pitch = -0.3f;
+                bones[SHIN_L].pitch = 0.3f;
+                bones[THIGH_R].pitch = 0.25f;
+                bones[SHIN_R].pitch = 0.2f;
+                return -0.05f;
+            }
+
+            default:
+                return 0.0f;
+        }
+    }
+
+    // Yaw after pitch after roll, as x, y, z, w
+    void toQuaternion(const Euler& euler, float* q) {
+        float sx = std::sin(euler.pitch * 0.5f), cx = std::cos(euler.pitch * 0.5f);
+        float sy = std::sin(euler.yaw * 0.5f), cy = std::cos(euler.yaw * 0.5f);
+        float sz = std::sin(euler.roll * 0.5f), cz = std::cos(euler.roll * 0.5f);
+
+        float mx = sx * cz, my = -sx * sz, mz = cx * sz, mw = cx * cz;
+        q[0] = cy * mx + sy * mz;
+        q[1] = cy * my + sy * mw;
+        q[2] = cy * mz - sy * mx;
+        q[3] = cy * mw - sy * my;
+    }
+
+    float wrapAngle(float angle) {
+        angle = std::fmod(angle + PI, 2.0f * PI);
+        if (angle < 0.0f) angle += 2.0f * PI;
+        return angle - PI;
+    }
+
+    // out = a * [r | t], all column-major 4x4 but for the 3x3 r
+    void mulAffine(const float* a, const float* r, const float* t, float* out) {
+#ifdef MANSION_ANIMATION_SSE
+        __m128 c0 = _mm_loadu_ps(a);
+        __m128 c1 = _mm_loadu_ps(a + 4);
+        __m128 c2 = _mm_loadu_ps(a + 8);
+        __m128 c3 = _mm_loadu_ps(a + 12);
+        for (int j = 0; j < 3; j++) {
+            __m128 column = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(r[j * 3])),
+                                                  _mm_mul_ps(c1, _mm_set1_ps(r[j * 3 + 1]))),
+                                       _mm_mul_ps(c2, _mm_set1_ps(r[j * 3 + 2])));
+            _mm_storeu_ps(out + j * 4, column);
+        }
+        __m128 origin = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(t[0])), _mm_mul_ps(c1, _mm_set1_ps(t[1]))),
+                                   _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(t[2])), c3));
+        _mm_storeu_ps(out + 12, origin);
+#else
+        float result[16];
+        for (int k = 0; k < 4; k++) {
+            for (int j = 0; j < 3; j++) {
+                result[j * 4 + k] = a[k] * r[j * 3] + a[4 + k] * r[j * 3 + 1] + a[8 + k] * r[j * 3 + 2];
+            }
+            result[12 + k] = a[k] * t[0] + a[4 + k] * t[1] + a[8 + k] * t[2] + a[12 + k];
+        }
+        memcpy(out, result, sizeof(result));
+#endif
+    }
+
+    Vector3 transform(const float* m, const Vector3& p) {
+        return Vector3(m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12],
+                       m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+                       m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14]);
+    }
+
+#ifdef MANSION_ANIMATION_SSE
+    // Four int16 keys to floats
+    inline __m128 decodeKeys(const int16_t* keys, __m128 scale) {
+        __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(keys));
+        __m128i wide = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+        return _mm_mul_ps(_mm_cvtepi32_ps(wide), scale);
+    }
+
+    // The dropped component of unit quaternions with w at or above zero
+    inline __m128 recoverW(__m128 x, __m128 y, __m128 z) {
+        __m128 rest = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        return _mm_sqrt_ps(_mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_set1_ps(1.0f), rest)));
+    }
+#endif
+}
+
+MonsterAnimation::MonsterAnimation() {
+    bakeClips();
+    buildMesh();
+}
+
+const char* MonsterAnimation::getClipName(MonsterClip clip) {
+    return CLIPS[(int)clip].name;
+}
+
+void MonsterAnimation::bakeClips() {
+    for (int c = 0; c < (int)MonsterClip::COUNT; c++) {
+        Clip& clip = clips[c];
+        clip.duration = CLIPS[c].duration;
+        clip.stride = CLIPS[c].stride;
+        clip.frames = (uint32_t)std::max(2.0f, std::ceil(clip.duration * KEY_RATE));
+        clip.rotations.assign((size_t)clip.frames * 3 * BONES, 0);
+        clip.rise.assign(clip.frames, 0);
+
+        for (uint32_t f = 0; f < clip.frames; f++) {
+            Euler angles[BONES];
+            float rise = pose((MonsterClip)c, (float)f / clip.frames, angles);
+
+            int16_t* keys = &clip.rotations[(size_t)f * 3 * BONES];
+            for (int b = 0; b < BONES; b++) {
+                float q[4];
+                toQuaternion(angles[b], q);
+                // q and -q are the same rotation; the one with w positive is kept
+                float sign = q[3] < 0.0f ? -QUAT_SCALE : QUAT_SCALE;
+                for (int k = 0; k < 3; k++) {
+                    keys[k * BONES + b] = (int16_t)std::lrint(q[k] * sign);
+                }
+            }
+            clip.rise[f] = (int16_t)std::lrint(std::min(3.9f, std::max(-3.9f, rise)) * RISE_SCALE);
+        }
+    }
+}
+
+void MonsterAnimation::buildMesh() {
+    // Normal axis and sign, then the two axes across the face, ordered so
+    // the corners below wind counter-clockwise seen from outside
+    static const int FACES[6][4] = {{0, 1, 1, 2}, {0, -1, 2, 1}, {1, 1, 2, 0}, {1, -1, 0, 2}, {2, 1, 0, 1}, {2, -1, 1, 0}};
+    static const float CORNERS[6][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, -1}, {1, 1}, {-1, 1}};
+
+    mesh.clear();
+    mesh.reserve(BONES * 36);
+    for (int b = 0; b < BONES; b++) {
+        const BoneDesc& bone = SKELETON[b];
+        float center[3], half[3];
+        for (int k = 0; k < 3; k++) {
+            center[k] = (bone.joint[k] + bone.tail[k]) * 0.5f;
+        }
+        half[0] = bone.halfWidth;
+        half[1] = std::fabs(bone.tail[1] - bone.joint[1]) * 0.5f;
+        half[2] = bone.halfDepth;
+
+        for (const auto& face : FACES) {
+            int axis = face[0], u = face[2], v = face[3];
+            for (const auto& corner : CORNERS) {
+                MeshVertex vertex = {};
+                memcpy(vertex.position, center, sizeof(center));
+                vertex.position[axis] += face[1] * half[axis];
+                vertex.position[u] += corner[0] * half[u];
+                vertex.position[v] += corner[1] * half[v];
+                vertex.position[3] = 1.0f;
+                vertex.normal[axis] = (float)face[1];
+
+                // The end at the joint bends partly with the parent
+                bool atJoint = bone.parent >= 0 && std::fabs(vertex.position[1] - bone.joint[1]) < 1.0e-4f;
+                vertex.matrix = atJoint ? BONES + b : b;
+                memcpy(vertex.color, bone.color, sizeof(vertex.color));
+                mesh.push_back(vertex);
+            }
+        }
+    }
+}
+
+size_t MonsterAnimation::getClipBytes() const {
+    size_t bytes = 0;
+    for (const auto& clip : clips) {
+        bytes += (clip.rotations.size() + clip.rise.size()) * sizeof(int16_t);
+    }
+    return bytes;
+}
+
+int MonsterAnimation::addInstance(const Vector3& position) {
+    Instance instance;
+    instance.state = MonsterState::IDLE;
+    instance.position = position;
+    instance.velocity = Vector3();
+    instance.heading = 0.0f;
+    instance.clip = MonsterClip::IDLE;
+    instance.previous = MonsterClip::IDLE;
+    instance.phase = 0.0f;
+    instance.previousPhase = 0.0f;
+    instance.blend = 1.0f;
+    instance.blendRate = 0.0f;
+    instances.push_back(instance);
+
+    int index = (int)instances.size() - 1;
+    palettes.resize(instances.size() * BONES * 16);
+    bounds.resize(instances.size());
+    evaluate(index);
+    return index;
+}
+
+void MonsterAnimation::clear() {
+    instances.clear();
+    palettes.clear();
+    bounds.clear();
+}
+
+void MonsterAnimation::setTarget(int index, MonsterState state, const Vector3& position, const Vector3& velocity) {
+    Instance& instance = instances[index];
+    instance.state = state;
+    instance.position = position;
+    instance.velocity = velocity;
+}
+
+MonsterClip MonsterAnimation::pickClip(const Instance& instance) const {
+    float speed = std::sqrt(instance.velocity.x * instance.velocity.x + instance.velocity.z * instance.velocity.z);
+    bool moving = speed > MOVING_SPEED;
+
+    switch (instance.state) {
+        case MonsterState::PATROL:
+            return moving ? MonsterClip::WALK : MonsterClip::IDLE;
+        case MonsterState::SEARCH:
+            return moving ? MonsterClip::WALK : MonsterClip::SEARCH;
+        case MonsterState::CHASE:
+            return moving ? MonsterClip::RUN : MonsterClip::SEARCH;
+        case MonsterState::ATTACK:
+            return MonsterClip::ATTACK;
+        default:
+            return MonsterClip::IDLE;
+    }
+}
+
+void MonsterAnimation::advance(Instance& instance, float deltaTime) {
+    float speed = std::sqrt(instance.velocity.x * instance.velocity.x + instance.velocity.z * instance.velocity.z);
+
+    // Turns towards where it's going rather than snapping round
+    if (speed > MOVING_SPEED) {
+        float turn = wrapAngle(std::atan2(instance.velocity.x, instance.velocity.z) - instance.heading);
+        float step = TURN_RATE * deltaTime;
+        instance.heading = wrapAngle(instance.heading + std::min(step, std::max(-step, turn)));
+    }
+
+    MonsterClip wanted = pickClip(instance);
+    if (wanted != instance.clip) {
+        // A change mid-fade drops the older clip; the fade is short enough not to show
+        bool stepping = clips[(int)wanted].stride > 0.0f && clips[(int)instance.clip].stride > 0.0f;
+        instance.previous = instance.clip;
+        instance.previousPhase = instance.phase;
+        instance.clip = wanted;
+        // Walk into run keeps the feet where they were; anything else starts over
+        if (!stepping) instance.phase = 0.0f;
+        instance.blend = 0.0f;
+        instance.blendRate = 1.0f / (wanted == MonsterClip::ATTACK ? ATTACK_BLEND_TIME : BLEND_TIME);
+    }
+
+    // Locomotion plays at the speed the feet are covering ground
+    auto step = [&](MonsterClip clip, float phase) {
+        const Clip& data = clips[(int)clip];
+        float rate = data.stride > 0.0f ? speed / data.stride : 1.0f / data.duration;
+        phase += rate * deltaTime;
+        return phase - std::floor(phase);
+    };
+    instance.phase = step(instance.clip, instance.phase);
+    if (instance.blend < 1.0f) {
+        instance.previousPhase = step(instance.previous, instance.previousPhase);
+        instance.blend = std::min(1.0f, instance.blend + instance.blendRate * deltaTime);
+    }
+}
+
+float MonsterAnimation::sample(const Clip& clip, float phase, float weight, float* x, float* y, float* z,
+                               float* w) const {
+    float position = phase * clip.frames;
+    uint32_t first = std::min((uint32_t)position, clip.frames - 1);
+    float t = std::min(1.0f, position - first);
+    uint32_t second = first + 1 == clip.frames ? 0 : first + 1;
+
+    const int16_t* a = &clip.rotations[(size_t)first * 3 * BONES];
+    const int16_t* b = &clip.rotations[(size_t)second * 3 * BONES];
+    float weightA = weight * (1.0f - t);
+    float weightB = weight * t;
+
+#ifdef MANSION_ANIMATION_SSE
+    const __m128 scale = _mm_set1_ps(1.0f / QUAT_SCALE);
+    const __m128 wa = _mm_set1_ps(weightA);
+    const __m128 wb = _mm_set1_ps(weightB);
+    for (int bone = 0; bone < BONES; bone += 4) {
+        __m128 ax = decodeKeys(a + bone, scale);
+        __m128 ay = decodeKeys(a + BONES + bone, scale);
+        __m128 az = decodeKeys(a + 2 * BONES + bone, scale);
+        __m128 bx = decodeKeys(b + bone, scale);
+        __m128 by = decodeKeys(b + BONES + bone, scale);
+        __m128 bz = decodeKeys(b + 2 * BONES + bone, scale);
+        __m128 aw = recoverW(ax, ay, az);
+        __m128 bw = recoverW(bx, by, bz);
+
+        // Every key has w positive, so they're all in one hemisphere and a
+        // plain weighted sum interpolates the short way
+        _mm_storeu_ps(x + bone, _mm_add_ps(_mm_loadu_ps(x + bone), _mm_add_ps(_mm_mul_ps(ax, wa), _mm_mul_ps(bx, wb))));
+        _mm_storeu_ps(y + bone, _mm_add_ps(_mm_loadu_ps(y + bone), _mm_add_ps(_mm_mul_ps(ay, wa), _mm_mul_ps(by, wb))));
+        _mm_storeu_ps(z + bone, _mm_add_ps(_mm_loadu_ps(z + bone), _mm_add_ps(_mm_mul_ps(az, wa), _mm_mul_ps(bz, wb))));
+        _mm_storeu_ps(w + bone, _mm_add_ps(_mm_loadu_ps(w + bone), _mm_add_ps(_mm_mul_ps(aw, wa), _mm_mul_ps(bw, wb))));
+    }
+#else
+    for (int bone = 0; bone < BONES; bone++) {
+        float key[2][4];
+        for (int k = 0; k < 3; k++) {
+            key[0][k] = a[k * BONES + bone] / QUAT_SCALE;
+            key[1][k] = b[k * BONES + bone] / QUAT_SCALE;
+        }
+        for (auto& q : key) {
+            q[3] = std::sqrt(std::max(0.0f, 1.0f - q[0] * q[0] - q[1] * q[1] - q[2] * q[2]));
+        }
+        x[bone] += key[0][0] * weightA + key[1][0] * weightB;
+        y[bone] += key[0][1] * weightA + key[1][1] * weightB;
+        z[bone] += key[0][2] * weightA + key[1][2] * weightB;
+        w[bone] += key[0][3] * weightA + key[1][3] * weightB;
+    }
+#endif
+
+    return (clip.rise[first] * weightA + clip.rise[second] * weightB) / RISE_SCALE;
+}
+
+void MonsterAnimation::evaluate(int index) {
+    const Instance& instance = instances[index];
+
+    float x[BONES] = {}, y[BONES] = {}, z[BONES] = {}, w[BONES] = {};
+    float rise = sample(clips[(int)instance.clip], instance.phase, instance.blend, x, y, z, w);
+    if (instance.blend < 1.0f) {
+        rise += sample(clips[(int)instance.previous], instance.previousPhase, 1.0f - instance.blend, x, y, z, w);
+    }
+
+    // Normalise the blend and turn it into 3x3 matrices, column-major, each
+    // element MONSTER_BONE_COUNT bones wide
+    float rotation[9][BONES];
+#ifdef MANSION_ANIMATION_SSE
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    for (int bone = 0; bone < BONES; bone += 4) {
+        __m128 qx = _mm_loadu_ps(x + bone);
+        __m128 qy = _mm_loadu_ps(y + bone);
+        __m128 qz = _mm_loadu_ps(z + bone);
+        __m128 qw = _mm_loadu_ps(w + bone);
+        __m128 length = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+                                   _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw)));
+        // Scaled by the square root of two, so the products below come out doubled
+        __m128 inverse = _mm_div_ps(_mm_sqrt_ps(two), _mm_sqrt_ps(length));
+        qx = _mm_mul_ps(qx, inverse);
+        qy = _mm_mul_ps(qy, inverse);
+        qz = _mm_mul_ps(qz, inverse);
+        qw = _mm_mul_ps(qw, inverse);
+
+        __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+        __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+        __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+        _mm_storeu_ps(rotation[0] + bone, _mm_sub_ps(one, _mm_add_ps(yy, zz)));
+        _mm_storeu_ps(rotation[1] + bone, _mm_add_ps(xy, wz));
+        _mm_storeu_ps(rotation[2] + bone, _mm_sub_ps(xz, wy));
+        _mm_storeu_ps(rotation[3] + bone, _mm_sub_ps(xy, wz));
+        _mm_storeu_ps(rotation[4] + bone, _mm_sub_ps(one, _mm_add_ps(xx, zz)));
+        _mm_storeu_ps(rotation[5] + bone, _mm_add_ps(yz, wx));
+        _mm_storeu_ps(rotation[6] + bone, _mm_add_ps(xz, wy));
+        _mm_storeu_ps(rotation[7] + bone, _mm_sub_ps(yz, wx));
+        _mm_storeu_ps(rotation[8] + bone, _mm_sub_ps(one, _mm_add_ps(xx, yy)));
+    }
+#else
+    for (int bone = 0; bone < BONES; bone++) {
+        float inverse = std::sqrt(2.0f / (x[bone] * x[bone] + y[bone] * y[bone] + z[bone] * z[bone] + w[bone] * w[bone]));
+        float qx = x[bone] * inverse, qy = y[bone] * inverse, qz = z[bone] * inverse, qw = w[bone] * inverse;
+        rotation[0][bone] = 1.0f - (qy * qy + qz * qz);
+        rotation[1][bone] = qx * qy + qw * qz;
+        rotation[2][bone] = qx * qz - qw * qy;
+        rotation[3][bone] = qx * qy - qw * qz;
+        rotation[4][bone] = 1.0f - (qx * qx + qz * qz);
+        rotation[5][bone] = qy * qz + qw * qx;
+        rotation[6][bone] = qx * qz + qw * qy;
+        rotation[7][bone] = qy * qz - qw * qx;
+        rotation[8][bone] = 1.0f - (qx * qx + qy * qy);
+    }
+#endif
+
+    // Down the hierarchy from the monster's place in the world
+    float heading = instance.heading;
+    const Vector3& origin = instance.position;
+    float world[16] = {std::cos(heading), 0.0f, -std::sin(heading), 0.0f,
+                       0.0f, 1.0f, 0.0f, 0.0f,
+                       std::sin(heading), 0.0f, std::cos(heading), 0.0f,
+                       origin.x, origin.y, origin.z, 1.0f};
+
+    float model[BONES][16];
+    float* palette = &palettes[(size_t)index * BONES * 16];
+    Vector3 low = origin, high = origin;
+
+    for (int b = 0; b < BONES; b++) {
+        const BoneDesc& bone = SKELETON[b];
+        float local[9];
+        for (int k = 0; k < 9; k++) {
+            local[k] = rotation[k][b];
+        }
+        float offset[3];
+        for (int k = 0; k < 3; k++) {
+            offset[k] = bone.joint[k] - (bone.parent >= 0 ? SKELETON[bone.parent].joint[k] : 0.0f);
+        }
+        if (bone.parent < 0) offset[1] += rise;
+
+        mulAffine(bone.parent >= 0 ? model[bone.parent] : world, local, offset, model[b]);
+
+        // The bind pose has no rotation, so its inverse only moves the joint back to the origin
+        float* skin = palette + b * 16;
+        const float* m = model[b];
+        memcpy(skin, m, 12 * sizeof(float));
+        for (int k = 0; k < 4; k++) {
+            skin[12 + k] = m[12 + k] - (m[k] * bone.joint[0] + m[4 + k] * bone.joint[1] + m[8 + k] * bone.joint[2]);
+        }
+
+        Vector3 joint(m[12], m[13], m[14]);
+        Vector3 tail = transform(skin, Vector3(bone.tail[0], bone.tail[1], bone.tail[2]));
+        for (const Vector3& p : {joint, tail}) {
+            low = Vector3(std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z));
+            high = Vector3(std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z));
+        }
+    }
+
+    Vector3 margin(BOUNDS_MARGIN, BOUNDS_MARGIN, BOUNDS_MARGIN);
+    bounds[index] = {low - margin, high + margin};
+}
+
+void MonsterAnimation::update(float deltaTime) {
+    int count = (int)instances.size();
+    int blocks = (count + INSTANCES_PER_JOB - 1) / INSTANCES_PER_JOB;
+
+    // Instances only touch their own slots, so blocks need no locking
+    getJobSystem().parallelFor(blocks, [this, count, deltaTime](int block) {
+        int end = std::min(count, (block + 1) * INSTANCES_PER_JOB);
+        for (int i = block * INSTANCES_PER_JOB; i < end; i++) {
+            advance(instances[i], deltaTime);
+            evaluate(i);
+        }
+    });
+}
+
+Vector3 MonsterAnimation::transformPoint(int instance, int bone, const Vector3& bindPoint) const {
+    return transform(getPalette(instance) + bone * 16, bindPoint);
+}
+
+void MonsterAnimation::skin(int instance, SkinnedVertex* out) const {
+    // Every vertex follows one bone or one joint's fixed blend of bone and
+    // parent, so the blends are made once here rather than per vertex
+    float matrices[BONES * 2][16];
+    const float* palette = getPalette(instance);
+    memcpy(matrices, palette, BONES * 16 * sizeof(float));
+    memcpy(matrices[BONES], palette, 16 * sizeof(float));
+    for (int b = 1; b < BONES; b++) {
+        const float* own = palette + b * 16;
+        const float* parent = palette + SKELETON[b].parent * 16;
+        for (int k = 0; k < 16; k++) {
+            matrices[BONES + b][k] = own[k] * JOINT_WEIGHT + parent[k] * (1.0f - JOINT_WEIGHT);
+        }
+    }
+
+    const MeshVertex* source = mesh.data();
+    size_t count = mesh.size();
+    for (size_t i = 0; i < count; i++) {
+        const MeshVertex& vertex = source[i];
+        const float* m = matrices[vertex.matrix];
+
+#ifdef MANSION_ANIMATION_SSE
+        __m128 c0 = _mm_loadu_ps(m);
+        __m128 c1 = _mm_loadu_ps(m + 4);
+        __m128 c2 = _mm_loadu_ps(m + 8);
+        __m128 c3 = _mm_loadu_ps(m + 12);
+
+        __m128 p = _mm_loadu_ps(vertex.position);
+        __m128 n = _mm_loadu_ps(vertex.normal);
+        __m128 position = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0))),
+                       _mm_mul_ps(c1, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)))),
+            _mm_add_ps(_mm_mul_ps(c2, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2))), c3));
+        // GL_NORMALIZE and the lit shaders fix the length a blend leaves
+        __m128 normal = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(n, n, _MM_SHUFFLE(0, 0, 0, 0))),
+                       _mm_mul_ps(c1, _mm_shuffle_ps(n, n, _MM_SHUFFLE(1, 1, 1, 1)))),
+            _mm_mul_ps(c2, _mm_shuffle_ps(n, n, _MM_SHUFFLE(2, 2, 2, 2))));
+
+        // The output fields are three floats, so each goes out as two and one
+        _mm_storel_pi((__m64*)out[i].position, position);
+        _mm_store_ss(out[i].position + 2, _mm_movehl_ps(position, position));
+        _mm_storel_pi((__m64*)out[i].normal, normal);
+        _mm_store_ss(out[i].normal + 2, _mm_movehl_ps(normal, normal));
+#else
+        const float* p = vertex.position;
+        const float* n = vertex.normal;
+        for (int k = 0; k < 3; k++) {
+            out[i].position[k] = m[k] * p[0] + m[4 + k] * p[1] + m[8 + k] * p[2] + m[12 + k];
+            out[i].normal[k] = m[k] * n[0] + m[4 + k] * n[1] + m[8 + k] * n[2];
+        }
+#endif
+        memcpy(out[i].color, vertex.color, sizeof(vertex.color));
+    }
+}
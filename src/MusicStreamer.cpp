@@ -0,0 +1,430 @@
+#include "MusicStreamer.h"
+#include "AudioMixer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    // About 1.4 s at 48 kHz per deck
+    const uint32_t RING_FRAMES = 65536;
+    // Source frames decoded per step, and the most a step may write
+    const int DECODE_FRAMES = 4096;
+    // The I/O thread tops the rings up this often; far less than a ring lasts
+    const int FILL_INTERVAL_MS = 5;
+
+    const uint16_t FORMAT_PCM = 1;
+    const uint16_t FORMAT_FLOAT = 3;
+    const uint16_t FORMAT_EXTENSIBLE = 0xFFFE;
+
+    uint16_t readU16(const uint8_t* bytes) {
+        return (uint16_t)(bytes[0] | (bytes[1] << 8));
+    }
+
+    uint32_t readU32(const uint8_t* bytes) {
+        return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    }
+
+    float decodeSample(const uint8_t* bytes, int bits, bool isFloat) {
+        if (isFloat) {
+            uint32_t word = readU32(bytes);
+            float value;
+            std::memcpy(&value, &word, sizeof(value));
+            return value;
+        }
+        switch (bits) {
+        case 8:
+            return ((int)bytes[0] - 128) / 128.0f;
+        case 16:
+            return (int16_t)readU16(bytes) / 32768.0f;
+        case 24:
+            return (int32_t)(((uint32_t)bytes[0] << 8) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 24)) /
+                   2147483648.0f;
+        default:
+            return (int32_t)readU32(bytes) / 2147483648.0f;
+        }
+    }
+}
+
+WavReader::WavReader()
+    : file(nullptr), channels(0), bits(0), isFloat(false), sampleRate(0), blockAlign(0), dataOffset(0),
+      frameCount(0), framesLeft(0) {
+}
+
+WavReader::~WavReader() {
+    close();
+}
+
+bool WavReader::open(const std::string& path) {
+    close();
+    file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    uint8_t header[12];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        std::cerr << path << " isn't a WAVE file" << std::endl;
+        close();
+        return false;
+    }
+
+    // Chunks can come in any order, and anything but fmt and data is skipped
+    bool haveFormat = false;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, sizeof(chunk), file) == sizeof(chunk)) {
+        uint32_t size = readU32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t format[40] = {};
+            uint32_t wanted = std::min<uint32_t>(size, sizeof(format));
+            if (size < 16 || fread(format, 1, wanted, file) != wanted) break;
+            uint16_t tag = readU16(format);
+            if (tag == FORMAT_EXTENSIBLE && size >= 26) tag = readU16(format + 24);
+            channels = readU16(format + 2);
+            sampleRate = (int)readU32(format + 4);
+            blockAlign = readU16(format + 12);
+            bits = readU16(format + 14);
+            isFloat = tag == FORMAT_FLOAT;
+
+            bool supported = (tag == FORMAT_PCM && (bits == 8 || bits == 16 || bits == 24 || bits == 32)) ||
+                             (tag == FORMAT_FLOAT && bits == 32);
+            if (!supported || channels < 1 || sampleRate <= 0 || blockAlign < channels * bits / 8) {
+                std::cerr << path << ": unsupported format " << tag << " with " << bits << " bits" << std::endl;
+                close();
+                return false;
+            }
+            haveFormat = true;
+            size -= wanted;
+        } else if (memcmp(chunk, "data", 4) == 0 && haveFormat) {
+            dataOffset = ftell(file);
+            frameCount = size / blockAlign;
+            framesLeft = frameCount;
+            raw.resize((size_t)DECODE_FRAMES * blockAlign);
+            return true;
+        }
+
+        // Chunks are padded to an even length
+        if (fseek(file, (long)size + (size & 1), SEEK_CUR) != 0) break;
+    }
+
+    std::cerr << path << " has no audio data" << std::endl;
+    close();
+    return false;
+}
+
+void WavReader::close() {
+    if (file) fclose(file);
+    file = nullptr;
+    framesLeft = 0;
+}
+
+bool WavReader::rewind() {
+    if (!file || fseek(file, dataOffset, SEEK_SET) != 0) return false;
+    framesLeft = frameCount;
+    return true;
+}
+
+int WavReader::read(float* out, int frames) {
+    if (!file) return 0;
+
+    int bytesPerSample = bits / 8;
+    int done = 0;
+    while (done < frames && framesLeft > 0) {
+        int count = (int)std::min<uint32_t>(framesLeft, (uint32_t)std::min(frames - done, DECODE_FRAMES));
+        size_t got = fread(raw.data(), blockAlign, count, file);
+        if (got == 0) {
+            // Truncated file; treat what's there as the whole track
+            framesLeft = 0;
+            break;
+        }
+
+        const uint8_t* frame = raw.data();
+        for (size_t i = 0; i < got; i++) {
+            float left = decodeSample(frame, bits, isFloat);
+            float right = channels > 1 ? decodeSample(frame + bytesPerSample, bits, isFloat) : left;
+            out[(done + i) * 2] = left;
+            out[(done + i) * 2 + 1] = right;
+            frame += blockAlign;
+        }
+        done += (int)got;
+        framesLeft -= (uint32_t)got;
+    }
+    return done;
+}
+
+StreamRing::StreamRing() : mask(0), writeIndex(0), readIndex(0) {
+}
+
+void StreamRing::allocate(uint32_t frames) {
+    data.assign((size_t)frames * 2, 0.0f);
+    mask = frames - 1;
+    reset();
+}
+
+void StreamRing::reset() {
+    writeIndex.store(0, std::memory_order_relaxed);
+    readIndex.store(0, std::memory_order_relaxed);
+}
+
+uint32_t StreamRing::getReadable() const {
+    return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_acquire);
+}
+
+uint32_t StreamRing::getWritable() const {
+    return mask + 1 - getReadable();
+}
+
+void StreamRing::write(const float* frames, uint32_t count) {
+    uint32_t position = writeIndex.load(std::memory_order_relaxed);
+    uint32_t start = position & mask;
+    uint32_t first = std::min(count, mask + 1 - start);
+    std::memcpy(&data[start * 2], frames, first * 2 * sizeof(float));
+    std::memcpy(&data[0], frames + first * 2, (count - first) * 2 * sizeof(float));
+    writeIndex.store(position + count, std::memory_order_release);
+}
+
+uint32_t StreamRing::read(float* frames, uint32_t count) {
+    uint32_t position = readIndex.load(std::memory_order_relaxed);
+    count = std::min(count, writeIndex.load(std::memory_order_acquire) - position);
+    uint32_t start = position & mask;
+    uint32_t first = std::min(count, mask + 1 - start);
+    std::memcpy(frames, &data[start * 2], first * 2 * sizeof(float));
+    std::memcpy(frames + first * 2, &data[0], (count - first) * 2 * sizeof(float));
+    readIndex.store(position + count, std::memory_order_release);
+    return count;
+}
+
+MusicStreamer::MusicStreamer()
+    : running(false), sampleRate(AUDIO_SAMPLE_RATE), current(-1), hasPending(false), underruns(0) {
+    // Everything is allocated here, once, so the mixer never sees a buffer
+    // that isn't there and nothing grows with the track
+    for (Deck& deck : decks) {
+        deck.ring.allocate(RING_FRAMES);
+        deck.state.store(DECK_IDLE, std::memory_order_relaxed);
+        deck.fadeSeconds.store(0.0f, std::memory_order_relaxed);
+        deck.ended.store(false, std::memory_order_relaxed);
+        deck.loop = false;
+        deck.phase = 0.0;
+        deck.previous[0] = deck.previous[1] = 0.0f;
+        deck.active = false;
+        deck.gain = 0.0f;
+    }
+    // One frame ahead of the chunk carries the last frame of the one before
+    decoded.resize((DECODE_FRAMES + 1) * 2);
+    resampled.resize(DECODE_FRAMES * 2);
+    block.resize(AUDIO_BLOCK_FRAMES * 2);
+}
+
+MusicStreamer::~MusicStreamer() {
+    stop();
+}
+
+bool MusicStreamer::start(int rate) {
+    stop();
+    sampleRate.store(rate, std::memory_order_relaxed);
+    running.store(true, std::memory_order_release);
+    thread = std::thread(&MusicStreamer::run, this);
+    return true;
+}
+
+void MusicStreamer::stop() {
+    if (thread.joinable()) {
+        running.store(false, std::memory_order_release);
+        thread.join();
+    }
+    for (Deck& deck : decks) {
+        deck.reader.close();
+        deck.ring.reset();
+        deck.state.store(DECK_IDLE, std::memory_order_relaxed);
+        deck.active = false;
+    }
+    current = -1;
+    hasPending = false;
+}
+
+size_t MusicStreamer::getBufferBytes() const {
+    size_t bytes = (decoded.size() + resampled.size() + block.size()) * sizeof(float);
+    bytes += MUSIC_DECKS * (size_t)RING_FRAMES * 2 * sizeof(float);
+    return bytes;
+}
+
+bool MusicStreamer::play(const std::string& path, bool loop, float fadeSeconds) {
+    Command command = {};
+    command.type = CommandType::PLAY;
+    command.loop = loop;
+    command.fadeSeconds = fadeSeconds;
+    strncpy(command.path, path.c_str(), sizeof(command.path) - 1);
+    if (commands.push(command)) return true;
+    std::cerr << "Music command queue full, dropped " << path << std::endl;
+    return false;
+}
+
+bool MusicStreamer::fadeOut(float fadeSeconds) {
+    Command command = {};
+    command.type = CommandType::FADE_OUT;
+    command.fadeSeconds = fadeSeconds;
+    if (commands.push(command)) return true;
+    std::cerr << "Music command queue full, dropped fade out" << std::endl;
+    return false;
+}
+
+void MusicStreamer::run() {
+    while (running.load(std::memory_order_acquire)) {
+        Command command;
+        while (commands.pop(command)) apply(command);
+
+        if (hasPending) openPending();
+
+        for (Deck& deck : decks) {
+            if (deck.state.load(std::memory_order_acquire) != DECK_IDLE) fill(deck);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(FILL_INTERVAL_MS));
+    }
+}
+
+void MusicStreamer::apply(const Command& command) {
+    // A play that hasn't started yet is simply replaced
+    if (hasPending) {
+        hasPending = command.type == CommandType::PLAY;
+        pending = command;
+        if (!hasPending) current = -1;
+        return;
+    }
+
+    // Whatever is playing fades out, and a new track goes on the other deck
+    if (current >= 0) {
+        Deck& deck = decks[current];
+        int playing = DECK_PLAYING;
+        deck.fadeSeconds.store(command.fadeSeconds, std::memory_order_relaxed);
+        deck.state.compare_exchange_strong(playing, DECK_STOPPING, std::memory_order_acq_rel);
+    }
+
+    if (command.type == CommandType::PLAY) {
+        current = current >= 0 ? (current + 1) % MUSIC_DECKS : 0;
+        pending = command;
+        hasPending = true;
+    } else {
+        current = -1;
+    }
+}
+
+void MusicStreamer::openPending() {
+    Deck& deck = decks[current];
+    // Still fading out from an earlier track
+    if (deck.state.load(std::memory_order_acquire) != DECK_IDLE) return;
+    hasPending = false;
+
+    if (!deck.reader.open(pending.path)) {
+        if (missing.insert(pending.path).second) std::cerr << "Couldn't stream music " << pending.path << std::endl;
+        current = -1;
+        return;
+    }
+
+    deck.loop = pending.loop;
+    deck.phase = 1.0;
+    deck.previous[0] = deck.previous[1] = 0.0f;
+    deck.ring.reset();
+    deck.ended.store(false, std::memory_order_relaxed);
+    fill(deck);
+
+    deck.fadeSeconds.store(pending.fadeSeconds, std::memory_order_relaxed);
+    deck.state.store(DECK_PLAYING, std::memory_order_release);
+}
+
+int MusicStreamer::decode(Deck& deck, float* out, int frames) {
+    int done = deck.reader.read(out, frames);
+    while (done < frames && deck.loop) {
+        // Gapless: the start of the track follows straight on in this chunk
+        if (!deck.reader.rewind()) break;
+        int got = deck.reader.read(out + done * 2, frames - done);
+        if (got == 0) break;
+        done += got;
+    }
+    return done;
+}
+
+void MusicStreamer::fill(Deck& deck) {
+    if (!deck.reader.isOpen() || deck.ended.load(std::memory_order_relaxed)) return;
+
+    double step = (double)deck.reader.getSampleRate() / sampleRate.load(std::memory_order_relaxed);
+    while (true) {
+        // Source frames whose output is sure to fit both the ring and the
+        // resample buffer, allowing a frame for rounding either way
+        uint32_t room = std::min<uint32_t>(deck.ring.getWritable(), DECODE_FRAMES);
+        if (room < 2) return;
+        int frames = (int)std::min<double>(DECODE_FRAMES, (room - 2) * step);
+        if (frames < 1) return;
+
+        // Frame 0 is the last frame of the previous chunk
+        decoded[0] = deck.previous[0];
+        decoded[1] = deck.previous[1];
+        int got = decode(deck, &decoded[2], frames);
+
+        // Linear resampling to the device rate, carrying the position over
+        // so chunk edges don't show
+        uint32_t count = 0;
+        double position = deck.phase;
+        while (position < got) {
+            int index = (int)position;
+            float t = (float)(position - index);
+            const float* a = &decoded[index * 2];
+            resampled[count * 2] = a[0] + (a[2] - a[0]) * t;
+            resampled[count * 2 + 1] = a[1] + (a[3] - a[1]) * t;
+            count++;
+            position += step;
+        }
+        deck.phase = position - got;
+        if (got > 0) {
+            deck.previous[0] = decoded[got * 2];
+            deck.previous[1] = decoded[got * 2 + 1];
+        }
+        deck.ring.write(resampled.data(), count);
+
+        if (got < frames) {
+            deck.reader.close();
+            deck.ended.store(true, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+void MusicStreamer::mix(float* left, float* right, int frames, float volume) {
+    for (Deck& deck : decks) {
+        int state = deck.state.load(std::memory_order_acquire);
+        if (state == DECK_IDLE) {
+            deck.active = false;
+            continue;
+        }
+
+        float fade = deck.fadeSeconds.load(std::memory_order_relaxed);
+        float fadeStep = fade > 0.0f ? 1.0f / (fade * sampleRate.load(std::memory_order_relaxed)) : 1.0f;
+        if (!deck.active) {
+            deck.active = true;
+            deck.gain = fade > 0.0f ? 0.0f : 1.0f;
+        }
+        float target = state == DECK_PLAYING ? 1.0f : 0.0f;
+
+        uint32_t got = deck.ring.read(block.data(), (uint32_t)frames);
+        bool ended = deck.ended.load(std::memory_order_acquire);
+        if ((int)got < frames && !ended) underruns.fetch_add(1, std::memory_order_relaxed);
+
+        float gain = deck.gain;
+        for (uint32_t i = 0; i < got; i++) {
+            if (gain < target) {
+                gain = std::min(target, gain + fadeStep);
+            } else if (gain > target) {
+                gain = std::max(target, gain - fadeStep);
+            }
+            left[i] += block[i * 2] * gain * volume;
+            right[i] += block[i * 2 + 1] * gain * volume;
+        }
+        deck.gain = gain;
+
+        // Silent for good: faded out, or played to the end of a one-shot track
+        bool finished = (state == DECK_STOPPING && gain <= 0.0f) ||
+                        (ended && deck.ring.getReadable() == 0);
+        if (finished && deck.state.compare_exchange_strong(state, DECK_IDLE, std::memory_order_acq_rel)) {
+            deck.active = false;
+        }
+    }
+}
@@ -0,0 +1,384 @@
+#include "OcclusionCuller.h"
+#include "Mansion.h"
+#include "LevelStreamer.h"
+#include "PortalCuller.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MANSION_OCCLUSION_SSE 1
+#endif
+
+namespace {
+    const float DEG_TO_RAD = 3.14159265f / 180.0f;
+
+    // Door cubes are 2 x 3, centred on the door position
+    const float DOOR_HALF_WIDTH = 1.0f;
+    const float DOOR_HALF_HEIGHT = 1.5f;
+    // How far inside a room a door can sit and still be in one of its
+    // walls; further in, it's a stairwell
+    const float DOOR_SNAP = 0.5f;
+    // Generated doors sit halfway across the gap between two rooms, which
+    // can put them several metres outside either wall
+    const float DOOR_REACH = 8.0f;
+    // Slivers thinner than this hide next to nothing
+    const float MIN_OCCLUDER_SIZE = 0.5f;
+
+    struct Interval {
+        float lo, hi, top;
+    };
+}
+
+OcclusionCuller::OcclusionCuller()
+    : cosYaw(1.0f), sinYaw(0.0f), cosPitch(1.0f), sinPitch(0.0f), projX(1.0f), projY(1.0f),
+      nearPlane(0.1f), enabled(true), ready(false), rasterised(0), tested(0), culled(0) {
+    depth.assign(WIDTH * HEIGHT, 0.0f);
+}
+
+void OcclusionCuller::build(const Mansion& mansion) {
+    occluders.clear();
+    occluderBounds.clear();
+    occluderRooms.clear();
+    roomFirstOccluder.clear();
+    ready = false;
+
+    const std::vector<Door>& doors = mansion.getDoors();
+    const std::vector<Room>& rooms = mansion.getRooms();
+
+    for (int index = 0; index < (int)rooms.size(); index++) {
+        roomFirstOccluder.push_back((int)occluders.size());
+        const Room& room = rooms[index];
+        float x = room.position.x, z = room.position.z;
+        float w = room.size.x / 2.0f, d = room.size.z / 2.0f;
+        float y0 = room.position.y, y1 = room.position.y + room.size.y;
+
+        // The same four walls LevelStreamer builds, each with its doorways
+        std::vector<Vector3> north, south, west, east;
+        uint32_t doorCount = 0;
+        const LevelNavEdge* edges = mansion.getNavEdges(index, doorCount);
+        for (uint32_t e = 0; e < doorCount; e++) {
+            // The wall the door is furthest out past
+            const Vector3& pos = doors[edges[e].door].position;
+            float outX = std::fabs(pos.x - x) - w;
+            float outZ = std::fabs(pos.z - z) - d;
+            float out = std::max(outX, outZ);
+            if (out < -DOOR_SNAP || out > DOOR_REACH) continue;
+            if (outZ >= outX) (pos.z > z ? north : south).push_back(pos);
+            else (pos.x < x ? west : east).push_back(pos);
+        }
+
+        addWall(Vector3(x - w, 0, z + d), Vector3(x + w, 0, z + d), y0, y1, north, true);
+        addWall(Vector3(x - w, 0, z - d), Vector3(x + w, 0, z - d), y0, y1, south, true);
+        addWall(Vector3(x - w, 0, z - d), Vector3(x - w, 0, z + d), y0, y1, west, false);
+        addWall(Vector3(x + w, 0, z - d), Vector3(x + w, 0, z + d), y0, y1, east, false);
+        occluderRooms.resize(occluders.size(), index);
+    }
+    roomFirstOccluder.push_back((int)occluders.size());
+}
+
+void OcclusionCuller::addWall(const Vector3& start, const Vector3& end, float bottom, float top,
+                              const std::vector<Vector3>& doorways, bool alongX) {
+    float from = alongX ? start.x : start.z;
+    float to = alongX ? end.x : end.z;
+
+    std::vector<Interval> cuts;
+    for (const Vector3& door : doorways) {
+        float center = alongX ? door.x : door.z;
+        cuts.push_back(Interval{center - DOOR_HALF_WIDTH, center + DOOR_HALF_WIDTH, door.y + DOOR_HALF_HEIGHT});
+    }
+    std::sort(cuts.begin(), cuts.end(), [](const Interval& a, const Interval& b) { return a.lo < b.lo; });
+
+    auto addPiece = [&](float lo, float hi, float y0, float y1) {
+        if (hi - lo < MIN_OCCLUDER_SIZE || y1 - y0 < MIN_OCCLUDER_SIZE) return;
+
+        Occluder occluder;
+        if (alongX) {
+            occluder.corners[0] = Vector3(lo, y0, start.z);
+            occluder.corners[1] = Vector3(hi, y0, start.z);
+            occluder.corners[2] = Vector3(hi, y1, start.z);
+            occluder.corners[3] = Vector3(lo, y1, start.z);
+        } else {
+            occluder.corners[0] = Vector3(start.x, y0, lo);
+            occluder.corners[1] = Vector3(start.x, y0, hi);
+            occluder.corners[2] = Vector3(start.x, y1, hi);
+            occluder.corners[3] = Vector3(start.x, y1, lo);
+        }
+        occluders.push_back(occluder);
+
+        Vector3 pad(0.05f, 0.05f, 0.05f);
+        occluderBounds.add(AABB{occluder.corners[0] - pad, occluder.corners[2] + pad});
+    };
+
+    // Full-height pieces between the doorways, lintels over them
+    float cursor = from;
+    for (const Interval& cut : cuts) {
+        addPiece(cursor, std::max(cursor, cut.lo), bottom, top);
+        addPiece(std::max(cursor, cut.lo), std::min(to, cut.hi), std::min(top, cut.top), top);
+        cursor = std::max(cursor, cut.hi);
+    }
+    addPiece(cursor, to, bottom, top);
+}
+
+Vector3 OcclusionCuller::toView(const Vector3& p) const {
+    // Inverse of the camera placement in Renderer::setCamera; -z is forward
+    Vector3 d = p - eye;
+    float x = cosYaw * d.x - sinYaw * d.z;
+    float z = sinYaw * d.x + cosYaw * d.z;
+    float y = cosPitch * d.y + sinPitch * z;
+    z = -sinPitch * d.y + cosPitch * z;
+    return Vector3(x, y, z);
+}
+
+void OcclusionCuller::project(const Vector3& view, float& x, float& y) const {
+    float distance = -view.z;
+    x = (projX * view.x / distance * 0.5f + 0.5f) * WIDTH;
+    y = (0.5f - projY * view.y / distance * 0.5f) * HEIGHT;
+}
+
+void OcclusionCuller::render(const Vector3& eyePos, float yaw, float pitch, float fovY, float aspect,
+                             float nearClip, const Frustum& frustum, const LevelStreamer& streamer,
+                             const PortalCuller& culler) {
+    ready = false;
+    tested = culled = rasterised = 0;
+    if (!enabled || occluders.empty()) return;
+
+    eye = eyePos;
+    cosYaw = cos(yaw * DEG_TO_RAD);
+    sinYaw = sin(yaw * DEG_TO_RAD);
+    cosPitch = cos(pitch * DEG_TO_RAD);
+    sinPitch = sin(pitch * DEG_TO_RAD);
+    projY = 1.0f / tan(fovY * 0.5f * DEG_TO_RAD);
+    projX = projY / aspect;
+    nearPlane = nearClip;
+
+    // Walls in view of the rooms that can be drawn, gathered room by room so
+    // the cost follows the view rather than the level; only the nearest if
+    // there are too many
+    candidates.clear();
+    const auto& chunks = streamer.getChunks();
+    auto addRoom = [&](int room) {
+        for (int i = roomFirstOccluder[room]; i < roomFirstOccluder[room + 1]; i++) {
+            candidates.push_back(i);
+        }
+    };
+    if (culler.isEverythingVisible()) {
+        for (int chunk : streamer.getResidentChunks()) {
+            for (int room : chunks[chunk]->rooms) {
+                addRoom(room);
+            }
+        }
+    } else {
+        for (int room : culler.getVisibleRooms()) {
+            if (chunks[streamer.getRoomChunk(room)]->state.load() == ChunkState::LOADED) addRoom(room);
+        }
+    }
+    candidates.resize(frustum.cull(occluderBounds, candidates.data(), (int)candidates.size(), candidates.data()));
+
+    if ((int)candidates.size() > MAX_OCCLUDERS) {
+        auto distance = [&](int occluder) {
+            const Occluder& wall = occluders[occluder];
+            return ((wall.corners[0] + wall.corners[2]) * 0.5f - eye).length();
+        };
+        std::nth_element(candidates.begin(), candidates.begin() + MAX_OCCLUDERS, candidates.end(),
+                         [&](int a, int b) { return distance(a) < distance(b); });
+        candidates.resize(MAX_OCCLUDERS);
+    }
+
+    triangles.clear();
+    for (auto& bin : bins) {
+        bin.clear();
+    }
+
+    for (int index : candidates) {
+        const Occluder& occluder = occluders[index];
+
+        // Clip the quad to the near plane, then fan it into triangles
+        Vector3 input[4], clipped[5];
+        int clippedCount = 0;
+        for (int i = 0; i < 4; i++) {
+            input[i] = toView(occluder.corners[i]);
+        }
+        for (int i = 0; i < 4; i++) {
+            const Vector3& a = input[i];
+            const Vector3& b = input[(i + 1) % 4];
+            bool aIn = -a.z >= nearPlane;
+            bool bIn = -b.z >= nearPlane;
+            if (aIn) clipped[clippedCount++] = a;
+            if (aIn != bIn) {
+                float t = (-nearPlane - a.z) / (b.z - a.z);
+                clipped[clippedCount++] = a + (b - a) * t;
+            }
+        }
+
+        for (int i = 1; i + 1 < clippedCount; i++) {
+            setupTriangle(clipped[0], clipped[i], clipped[i + 1]);
+        }
+        rasterised++;
+    }
+
+    // Tiles own disjoint rows of the buffer, so they fill without locking
+    getJobSystem().parallelFor(TILES_X * TILES_Y, [this](int tile) { rasteriseTile(tile); });
+    ready = true;
+}
+
+void OcclusionCuller::setupTriangle(const Vector3& viewA, const Vector3& viewB, const Vector3& viewC) {
+    // Already clipped to the near plane
+    float ax, ay, bx, by, cx, cy;
+    project(viewA, ax, ay);
+    project(viewB, bx, by);
+    project(viewC, cx, cy);
+    float wa = -1.0f / viewA.z, wb = -1.0f / viewB.z, wc = -1.0f / viewC.z;
+
+    // Walls face both ways; wind every triangle the same way round
+    float area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+    if (std::fabs(area) < 1e-6f) return;
+    if (area < 0.0f) {
+        std::swap(bx, cx);
+        std::swap(by, cy);
+        std::swap(wb, wc);
+        area = -area;
+    }
+
+    Triangle tri;
+    tri.minX = std::max(0, (int)std::floor(std::min(ax, std::min(bx, cx))));
+    tri.minY = std::max(0, (int)std::floor(std::min(ay, std::min(by, cy))));
+    tri.maxX = std::min(WIDTH - 1, (int)std::ceil(std::max(ax, std::max(bx, cx))));
+    tri.maxY = std::min(HEIGHT - 1, (int)std::ceil(std::max(ay, std::max(by, cy))));
+    if (tri.minX > tri.maxX || tri.minY > tri.maxY) return;
+
+    const float xs[3] = {ax, bx, cx};
+    const float ys[3] = {ay, by, cy};
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+        tri.edgeA[i] = ys[i] - ys[j];
+        tri.edgeB[i] = xs[j] - xs[i];
+        tri.edgeC[i] = xs[i] * ys[j] - ys[i] * xs[j];
+    }
+
+    tri.depthA = ((wb - wa) * (cy - ay) - (wc - wa) * (by - ay)) / area;
+    tri.depthB = ((wc - wa) * (bx - ax) - (wb - wa) * (cx - ax)) / area;
+    tri.depthC = wa - tri.depthA * ax - tri.depthB * ay;
+
+    int index = (int)triangles.size();
+    triangles.push_back(tri);
+    for (int ty = tri.minY / TILE_HEIGHT; ty <= tri.maxY / TILE_HEIGHT; ty++) {
+        for (int tx = tri.minX / TILE_WIDTH; tx <= tri.maxX / TILE_WIDTH; tx++) {
+            bins[ty * TILES_X + tx].push_back(index);
+        }
+    }
+}
+
+void OcclusionCuller::rasteriseTile(int tile) {
+    int tileX = (tile % TILES_X) * TILE_WIDTH;
+    int tileY = (tile / TILES_X) * TILE_HEIGHT;
+
+    for (int y = tileY; y < tileY + TILE_HEIGHT; y++) {
+        std::fill(&depth[y * WIDTH + tileX], &depth[y * WIDTH + tileX] + TILE_WIDTH, 0.0f);
+    }
+
+    for (int index : bins[tile]) {
+        const Triangle& tri = triangles[index];
+        // Whole groups of four; the edge test drops the extra pixels
+        int x0 = std::max(tri.minX, tileX) & ~3;
+        int x1 = std::min(tri.maxX, tileX + TILE_WIDTH - 1);
+        int y0 = std::max(tri.minY, tileY);
+        int y1 = std::min(tri.maxY, tileY + TILE_HEIGHT - 1);
+
+        for (int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            float* row = &depth[y * WIDTH];
+
+#ifdef MANSION_OCCLUSION_SSE
+            __m128 rowEdge[3], stepEdge[3];
+            for (int e = 0; e < 3; e++) {
+                rowEdge[e] = _mm_set1_ps(tri.edgeB[e] * py + tri.edgeC[e]);
+                stepEdge[e] = _mm_set1_ps(tri.edgeA[e]);
+            }
+            __m128 rowDepth = _mm_set1_ps(tri.depthB * py + tri.depthC);
+            __m128 stepDepth = _mm_set1_ps(tri.depthA);
+            const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+            for (int x = x0; x <= x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepEdge[0], px), rowEdge[0]), _mm_setzero_ps());
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepEdge[1], px), rowEdge[1]), _mm_setzero_ps()));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepEdge[2], px), rowEdge[2]), _mm_setzero_ps()));
+                if (_mm_movemask_ps(inside) == 0) continue;
+
+                __m128 z = _mm_add_ps(_mm_mul_ps(stepDepth, px), rowDepth);
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_max_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+            }
+#else
+            for (int x = x0; x < x0 + ((x1 - x0) / 4 + 1) * 4; x++) {
+                float px = x + 0.5f;
+                bool inside = true;
+                for (int e = 0; e < 3; e++) {
+                    inside = inside && tri.edgeA[e] * px + tri.edgeB[e] * py + tri.edgeC[e] >= 0.0f;
+                }
+                if (!inside) continue;
+
+                float z = tri.depthA * px + tri.depthB * py + tri.depthC;
+                row[x] = std::max(row[x], z);
+            }
+#endif
+        }
+    }
+}
+
+bool OcclusionCuller::isVisible(const AABB& box) {
+    if (!ready) return true;
+    tested++;
+
+    float minX = WIDTH, minY = HEIGHT, maxX = 0.0f, maxY = 0.0f;
+    float nearest = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        Vector3 corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+        Vector3 view = toView(corner);
+        if (-view.z < nearPlane) return true;    // Reaches past the near plane
+
+        float x, y;
+        project(view, x, y);
+        minX = std::min(minX, x); maxX = std::max(maxX, x);
+        minY = std::min(minY, y); maxY = std::max(maxY, y);
+        nearest = std::max(nearest, -1.0f / view.z);
+    }
+
+    // A pixel of slack for walls that cover pixel centres but not edges
+    int x0 = std::max(0, (int)std::floor(minX) - 1) & ~3;
+    int x1 = std::min(WIDTH - 1, (int)std::ceil(maxX) + 1);
+    int y0 = std::max(0, (int)std::floor(minY) - 1);
+    int y1 = std::min(HEIGHT - 1, (int)std::ceil(maxY) + 1);
+    if (x0 > x1 || y0 > y1) return true;
+
+    for (int y = y0; y <= y1; y++) {
+        const float* row = &depth[y * WIDTH];
+#ifdef MANSION_OCCLUSION_SSE
+        __m128 boxDepth = _mm_set1_ps(nearest);
+        for (int x = x0; x <= x1; x += 4) {
+            if (_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(row + x), boxDepth))) return true;
+        }
+#else
+        for (int x = x0; x <= x1; x++) {
+            if (row[x] <= nearest) return true;
+        }
+#endif
+    }
+
+    culled++;
+    return false;
+}
+
+int OcclusionCuller::cull(const BoundsSoA& bounds, const int* indices, int count, int* visible) {
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+        int index = indices[i];
+        if (isVisible(bounds.get(index))) {
+            visible[written++] = index;
+        }
+    }
+    return written;
+}
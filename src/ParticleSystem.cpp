@@ -0,0 +1,384 @@
+#include "ParticleSystem.h"
+#include "Frustum.h"
+#include "InstanceRenderer.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MANSION_PARTICLES_SSE 1
+#endif
+
+namespace {
+    const float DEG_TO_RAD = 3.14159265f / 180.0f;
+
+    // Indexed by ParticleType; capacities add up to 100k
+    const ParticleTypeDesc TYPES[(int)ParticleType::COUNT] = {
+        // DUST: barely falls, drifts on what it was given
+        {72000, -0.01f, 0.3f, 6.0f, 12.0f, 0.02f, 0.02f, {200, 190, 170, 90}, 0.2f, 0.3f, false},
+        // MIST: big and faint, so few of them
+        {8000, 0.0f, 0.2f, 5.0f, 9.0f, 0.6f, 1.2f, {150, 160, 175, 18}, 0.3f, 0.4f, false},
+        // BREATH: spreads and slows as it fades
+        {4000, 0.05f, 1.5f, 1.2f, 2.0f, 0.04f, 0.3f, {220, 225, 235, 50}, 0.1f, 0.6f, false},
+        // BLOOD: falls hard and stays on the floor a while
+        {16000, -9.8f, 0.1f, 20.0f, 30.0f, 0.04f, 0.04f, {110, 5, 5, 230}, 0.0f, 0.1f, true}
+    };
+
+    // Ambient dust fills the room within DUST_RADIUS of the eye at this
+    // many per cubic metre, and mist the floor within MIST_RADIUS per square
+    const float DUST_RADIUS = 10.0f;
+    const float DUST_DENSITY = 30.0f;
+    const float MIST_RADIUS = 8.0f;
+    const float MIST_DENSITY = 10.0f;
+    const float MIST_HEIGHT = 0.4f;
+
+    const float BREATH_INTERVAL = 3.2f;
+    const float BREATH_INTERVAL_EXHAUSTED = 1.1f;
+    const int BREATH_PARTICLES = 24;
+
+    // The player's eye over the floor, for breath emitted outside any room
+    const float EYE_HEIGHT = 1.8f;
+
+    // Particles culled at a time; the survivors' indices live on the stack
+    const uint32_t CULL_BLOCK = 1024;
+
+    float meanLife(const ParticleTypeDesc& desc) {
+        return (desc.minLife + desc.maxLife) * 0.5f;
+    }
+
+    // A zero-length fade is a step, which a huge rate gives without 0 * inf
+    float fadeRate(float fraction) {
+        return fraction > 0.0f ? 1.0f / fraction : 1.0e6f;
+    }
+
+    // Far enough out along every plane that a quad of this width can't reach in
+    float cullRadius(const ParticleTypeDesc& desc) {
+        return std::max(desc.startSize, desc.endSize) * 0.7072f;
+    }
+}
+
+ParticleSystem::ParticleSystem()
+    : seed(0x9E3779B9u), dropped(0), dustOwed(0.0f), mistOwed(0.0f), breathTimer(0.0f) {
+    for (int type = 0; type < (int)ParticleType::COUNT; type++) {
+        Pool& pool = pools[type];
+        uint32_t capacity = TYPES[type].capacity;
+        for (auto* stream : {&pool.posX, &pool.posY, &pool.posZ, &pool.velX, &pool.velY, &pool.velZ,
+                             &pool.age, &pool.life, &pool.floor}) {
+            stream->assign(capacity, 0.0f);
+        }
+        pool.count = 0;
+    }
+}
+
+const ParticleTypeDesc& ParticleSystem::getDesc(ParticleType type) {
+    return TYPES[(int)type];
+}
+
+float ParticleSystem::random() {
+    // xorshift32; the top 24 bits make an even float in [0, 1)
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (seed >> 8) * (1.0f / 16777216.0f);
+}
+
+void ParticleSystem::clear() {
+    for (auto& pool : pools) {
+        pool.count = 0;
+    }
+    dropped = 0;
+    dustOwed = mistOwed = 0.0f;
+    breathTimer = 0.0f;
+}
+
+size_t ParticleSystem::getLiveCount() const {
+    size_t live = 0;
+    for (const auto& pool : pools) {
+        live += pool.count;
+    }
+    return live;
+}
+
+size_t ParticleSystem::getCapacity() const {
+    size_t capacity = 0;
+    for (const auto& desc : TYPES) {
+        capacity += desc.capacity;
+    }
+    return capacity;
+}
+
+int ParticleSystem::emit(ParticleType type, const Vector3& position, const Vector3& velocity, float spread,
+                         float jitter, float floorHeight, int count) {
+    const ParticleTypeDesc& desc = TYPES[(int)type];
+    Pool& pool = pools[(int)type];
+
+    int room = std::min(count, (int)(desc.capacity - pool.count));
+    dropped += count - room;
+
+    for (int n = 0; n < room; n++) {
+        uint32_t i = pool.count++;
+        pool.posX[i] = position.x + jitter * (random() * 2.0f - 1.0f);
+        pool.posY[i] = position.y + jitter * (random() * 2.0f - 1.0f);
+        pool.posZ[i] = position.z + jitter * (random() * 2.0f - 1.0f);
+        pool.velX[i] = velocity.x + spread * (random() * 2.0f - 1.0f);
+        pool.velY[i] = velocity.y + spread * (random() * 2.0f - 1.0f);
+        pool.velZ[i] = velocity.z + spread * (random() * 2.0f - 1.0f);
+        pool.age[i] = 0.0f;
+        pool.life[i] = desc.minLife + (desc.maxLife - desc.minLife) * random();
+        pool.floor[i] = floorHeight;
+    }
+    return room;
+}
+
+void ParticleSystem::update(float deltaTime, const Vector3& eye, float yaw, const AABB* room, bool exhausted) {
+    if (room) {
+        emitAmbient(deltaTime, eye, *room);
+    }
+
+    breathTimer -= deltaTime;
+    if (breathTimer <= 0.0f) {
+        breathTimer += exhausted ? BREATH_INTERVAL_EXHAUSTED : BREATH_INTERVAL;
+        breathTimer = std::max(breathTimer, 0.0f);
+
+        // Just below the eye, out along the view
+        Vector3 forward(-std::sin(yaw * DEG_TO_RAD), 0.0f, -std::cos(yaw * DEG_TO_RAD));
+        Vector3 mouth = eye + forward * 0.25f + Vector3(0.0f, -0.15f, 0.0f);
+        float floorHeight = room ? room->min.y : eye.y - EYE_HEIGHT;
+        emit(ParticleType::BREATH, mouth, forward * 0.6f, 0.12f, 0.03f, floorHeight, BREATH_PARTICLES);
+    }
+
+    for (int type = 0; type < (int)ParticleType::COUNT; type++) {
+        integrate(pools[type], TYPES[type], deltaTime);
+        retire(pools[type]);
+    }
+}
+
+void ParticleSystem::emitAmbient(float deltaTime, const Vector3& eye, const AABB& room) {
+    // Topped up at the rate the population dies off, so it settles at the
+    // target instead of appearing all at once on entering a room
+    Vector3 low(std::max(room.min.x, eye.x - DUST_RADIUS), room.min.y, std::max(room.min.z, eye.z - DUST_RADIUS));
+    Vector3 high(std::min(room.max.x, eye.x + DUST_RADIUS), room.max.y, std::min(room.max.z, eye.z + DUST_RADIUS));
+    Vector3 extent = high - low;
+    if (extent.x <= 0.0f || extent.y <= 0.0f || extent.z <= 0.0f) return;
+
+    const ParticleTypeDesc& dust = TYPES[(int)ParticleType::DUST];
+    float dustTarget = std::min((float)dust.capacity, DUST_DENSITY * extent.x * extent.y * extent.z);
+    if (pools[(int)ParticleType::DUST].count < dustTarget) {
+        dustOwed += dustTarget / meanLife(dust) * deltaTime;
+        for (; dustOwed >= 1.0f; dustOwed -= 1.0f) {
+            Vector3 position(low.x + extent.x * random(), low.y + extent.y * random(), low.z + extent.z * random());
+            emit(ParticleType::DUST, position, Vector3(), 0.05f, 0.0f, room.min.y, 1);
+        }
+    } else {
+        dustOwed = 0.0f;
+    }
+
+    low.x = std::max(room.min.x, eye.x - MIST_RADIUS);
+    low.z = std::max(room.min.z, eye.z - MIST_RADIUS);
+    high.x = std::min(room.max.x, eye.x + MIST_RADIUS);
+    high.z = std::min(room.max.z, eye.z + MIST_RADIUS);
+    extent = high - low;
+    if (extent.x <= 0.0f || extent.z <= 0.0f) return;
+
+    const ParticleTypeDesc& mist = TYPES[(int)ParticleType::MIST];
+    float mistTarget = std::min((float)mist.capacity, MIST_DENSITY * extent.x * extent.z);
+    if (pools[(int)ParticleType::MIST].count < mistTarget) {
+        mistOwed += mistTarget / meanLife(mist) * deltaTime;
+        for (; mistOwed >= 1.0f; mistOwed -= 1.0f) {
+            Vector3 position(low.x + extent.x * random(), room.min.y + MIST_HEIGHT * random(),
+                             low.z + extent.z * random());
+            emit(ParticleType::MIST, position, Vector3(0.1f, 0.0f, 0.05f), 0.1f, 0.0f, room.min.y, 1);
+        }
+    } else {
+        mistOwed = 0.0f;
+    }
+}
+
+void ParticleSystem::integrate(Pool& pool, const ParticleTypeDesc& desc, float deltaTime) {
+    float damping = std::exp(-desc.drag * deltaTime);
+    float fall = desc.gravity * deltaTime;
+    uint32_t i = 0;
+
+#ifdef MANSION_PARTICLES_SSE
+    // Pools are a multiple of four long, so the last group can run past
+    // count into lanes nobody reads
+    __m128 damp4 = _mm_set1_ps(damping);
+    __m128 fall4 = _mm_set1_ps(fall);
+    __m128 dt4 = _mm_set1_ps(deltaTime);
+    for (; i < pool.count; i += 4) {
+        __m128 vx = _mm_mul_ps(_mm_loadu_ps(&pool.velX[i]), damp4);
+        __m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&pool.velY[i]), damp4), fall4);
+        __m128 vz = _mm_mul_ps(_mm_loadu_ps(&pool.velZ[i]), damp4);
+        __m128 px = _mm_add_ps(_mm_loadu_ps(&pool.posX[i]), _mm_mul_ps(vx, dt4));
+        __m128 py = _mm_add_ps(_mm_loadu_ps(&pool.posY[i]), _mm_mul_ps(vy, dt4));
+        __m128 pz = _mm_add_ps(_mm_loadu_ps(&pool.posZ[i]), _mm_mul_ps(vz, dt4));
+
+        if (desc.landOnFloor) {
+            // Landed lanes sit on the floor with no velocity left
+            __m128 floor = _mm_loadu_ps(&pool.floor[i]);
+            __m128 landed = _mm_cmplt_ps(py, floor);
+            py = _mm_max_ps(py, floor);
+            vx = _mm_andnot_ps(landed, vx);
+            vy = _mm_andnot_ps(landed, vy);
+            vz = _mm_andnot_ps(landed, vz);
+        }
+
+        _mm_storeu_ps(&pool.velX[i], vx);
+        _mm_storeu_ps(&pool.velY[i], vy);
+        _mm_storeu_ps(&pool.velZ[i], vz);
+        _mm_storeu_ps(&pool.posX[i], px);
+        _mm_storeu_ps(&pool.posY[i], py);
+        _mm_storeu_ps(&pool.posZ[i], pz);
+        _mm_storeu_ps(&pool.age[i], _mm_add_ps(_mm_loadu_ps(&pool.age[i]), dt4));
+    }
+#endif
+
+    for (; i < pool.count; i++) {
+        pool.velX[i] *= damping;
+        pool.velY[i] = pool.velY[i] * damping + fall;
+        pool.velZ[i] *= damping;
+        pool.posX[i] += pool.velX[i] * deltaTime;
+        pool.posY[i] += pool.velY[i] * deltaTime;
+        pool.posZ[i] += pool.velZ[i] * deltaTime;
+        if (desc.landOnFloor && pool.posY[i] < pool.floor[i]) {
+            pool.posY[i] = pool.floor[i];
+            pool.velX[i] = pool.velY[i] = pool.velZ[i] = 0.0f;
+        }
+        pool.age[i] += deltaTime;
+    }
+}
+
+void ParticleSystem::retire(Pool& pool) {
+    // The last live particle takes each dead one's slot, so the pool stays
+    // packed; order within a pool means nothing
+    uint32_t i = 0;
+    while (i < pool.count) {
+#ifdef MANSION_PARTICLES_SSE
+        // Whole groups with nobody dead are the common case; skip them four at a time
+        if ((i & 3) == 0 && i + 4 <= pool.count &&
+            !_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(&pool.age[i]), _mm_loadu_ps(&pool.life[i])))) {
+            i += 4;
+            continue;
+        }
+#endif
+        if (pool.age[i] < pool.life[i]) {
+            i++;
+            continue;
+        }
+
+        uint32_t last = --pool.count;
+        pool.posX[i] = pool.posX[last];
+        pool.posY[i] = pool.posY[last];
+        pool.posZ[i] = pool.posZ[last];
+        pool.velX[i] = pool.velX[last];
+        pool.velY[i] = pool.velY[last];
+        pool.velZ[i] = pool.velZ[last];
+        pool.age[i] = pool.age[last];
+        pool.life[i] = pool.life[last];
+        pool.floor[i] = pool.floor[last];
+    }
+}
+
+size_t ParticleSystem::buildBillboards(const Frustum& frustum, BillboardData* out) const {
+    size_t written = 0;
+    for (int type = 0; type < (int)ParticleType::COUNT; type++) {
+        written += expand(pools[type], TYPES[type], frustum, out + written);
+    }
+    return written;
+}
+
+size_t ParticleSystem::expand(const Pool& pool, const ParticleTypeDesc& desc, const Frustum& frustum,
+                              BillboardData* out) const {
+    float growth = desc.endSize - desc.startSize;
+    float fadeInRate = fadeRate(desc.fadeIn);
+    float fadeOutRate = fadeRate(desc.fadeOut);
+    float alpha = desc.color[3];
+    size_t written = 0;
+
+    // Byte stores may alias anything, pool internals included, so the
+    // streams are read through locals and each billboard is stored whole
+    const float* posX = pool.posX.data();
+    const float* posY = pool.posY.data();
+    const float* posZ = pool.posZ.data();
+    const float* age = pool.age.data();
+    const float* life = pool.life.data();
+
+    // Cull a block into a list of survivors, then do the per-particle work
+    // for those alone; most of a pool is usually behind the camera
+    uint32_t visible[CULL_BLOCK];
+    for (uint32_t first = 0; first < pool.count; first += CULL_BLOCK) {
+        uint32_t end = std::min(pool.count, first + CULL_BLOCK);
+        uint32_t count = cull(pool, first, end, cullRadius(desc), frustum, visible);
+
+        for (uint32_t v = 0; v < count; v++) {
+            uint32_t i = visible[v];
+            float t = age[i] / life[i];
+            float fade = std::min(1.0f, t * fadeInRate) * std::min(1.0f, (1.0f - t) * fadeOutRate);
+
+            BillboardData billboard = {
+                {posX[i], posY[i], posZ[i]}, desc.startSize + growth * t,
+                {desc.color[0], desc.color[1], desc.color[2], (uint8_t)(std::max(0.0f, fade * alpha) + 0.5f)}
+            };
+            out[written++] = billboard;
+        }
+    }
+    return written;
+}
+
+uint32_t ParticleSystem::cull(const Pool& pool, uint32_t first, uint32_t end, float radius, const Frustum& frustum,
+                              uint32_t* visible) const {
+    // The radius goes into each plane's offset, so a particle is in when
+    // none of its distances is negative. The side planes aren't unit
+    // length, so the radius is scaled to match.
+    const Frustum::Plane* planes = frustum.getPlanes();
+    float offsets[6];
+    for (int p = 0; p < 6; p++) {
+        const Frustum::Plane& plane = planes[p];
+        offsets[p] = plane.d + radius * std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+    }
+    uint32_t count = 0;
+    uint32_t i = first;
+
+#ifdef MANSION_PARTICLES_SSE
+    __m128 planeX[6], planeY[6], planeZ[6], planeD[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm_set1_ps(planes[p].x);
+        planeY[p] = _mm_set1_ps(planes[p].y);
+        planeZ[p] = _mm_set1_ps(planes[p].z);
+        planeD[p] = _mm_set1_ps(offsets[p]);
+    }
+
+    for (; i + 4 <= end; i += 4) {
+        __m128 px = _mm_loadu_ps(&pool.posX[i]);
+        __m128 py = _mm_loadu_ps(&pool.posY[i]);
+        __m128 pz = _mm_loadu_ps(&pool.posZ[i]);
+
+        __m128 nearest = _mm_set1_ps(1.0f);
+        for (int p = 0; p < 6; p++) {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, planeX[p]), _mm_mul_ps(py, planeY[p])),
+                                     _mm_add_ps(_mm_mul_ps(pz, planeZ[p]), planeD[p]));
+            nearest = _mm_min_ps(nearest, dist);
+        }
+
+        // Every lane is written and only the visible ones kept, which beats
+        // branching on a mask that's random from one group to the next
+        int mask = _mm_movemask_ps(_mm_cmpge_ps(nearest, _mm_setzero_ps()));
+        for (int lane = 0; lane < 4; lane++) {
+            visible[count] = i + lane;
+            count += (mask >> lane) & 1;
+        }
+    }
+#endif
+
+    for (; i < end; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            const Frustum::Plane& plane = planes[p];
+            inside = plane.x * pool.posX[i] + plane.y * pool.posY[i] + plane.z * pool.posZ[i] + offsets[p] >= 0.0f;
+        }
+        if (inside) {
+            visible[count++] = i;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,165 @@
+#include "PerfOverlay.h"
+#include "TextRenderer.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace {
+    const int MARGIN = 8;
+    const int BAR_WIDTH = 2;
+    const int PANEL_WIDTH = PerfOverlay::HISTORY * BAR_WIDTH + 2 * MARGIN;
+    const int LINE_COUNT = 10;
+    const int VALUE_COLUMN = 72;
+
+    const int GRAPH_TOP = MARGIN * 3 + LINE_COUNT * TextRenderer::GLYPH_HEIGHT;
+    const int GRAPH_HEIGHT = 48;
+    const int GRAPH_BOTTOM = GRAPH_TOP + GRAPH_HEIGHT;
+    const int PANEL_BOTTOM = GRAPH_BOTTOM + MARGIN;
+
+    // The graph tops out at two 60 Hz frames
+    const float FRAME_BUDGET_MS = 1000.0f / 60.0f;
+    const float GRAPH_MAX_MS = 2.0f * FRAME_BUDGET_MS;
+
+    const char* LABELS[LINE_COUNT] = {"CPU", "SIM", "SCALE", "DRAWS", "VERTS", "LIGHTS", "STATE", "PROGRAM", "MATRIX", "TEX"};
+
+    Color2D barColor(float ms) {
+        if (ms <= FRAME_BUDGET_MS) return Color2D{0.2f, 0.9f, 0.3f, 0.9f};
+        if (ms <= GRAPH_MAX_MS) return Color2D{1.0f, 0.8f, 0.1f, 0.9f};
+        return Color2D{1.0f, 0.2f, 0.2f, 0.9f};
+    }
+
+    void accumulate(RenderCounters& sum, const RenderCounters& frame) {
+        sum.frames += frame.frames;
+        sum.materialChanges += frame.materialChanges;
+        sum.lightChanges += frame.lightChanges;
+        sum.drawCalls += frame.drawCalls;
+        sum.instances += frame.instances;
+        sum.stateChanges += frame.stateChanges;
+        sum.programBinds += frame.programBinds;
+        sum.matrixLoads += frame.matrixLoads;
+        sum.textureBinds += frame.textureBinds;
+        sum.indices += frame.indices;
+        sum.vertices += frame.vertices;
+    }
+
+    std::string formatMs(float ms) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2) << ms << " ms";
+        return out.str();
+    }
+
+    std::string formatPercent(float fraction) {
+        return std::to_string((int)(fraction * 100.0f + 0.5f)) + "%";
+    }
+}
+
+PerfOverlay::PerfOverlay()
+    : visible(false), cursor(0), filled(0), pendingFrames(0), cpuSum(0.0f), simSum(0.0f),
+      scaleSum(0.0f), counterSum{}, shownCpu(0.0f), shownSim(0.0f), shownScale(1.0f), shown{}, dirty(true), panelX(0),
+      bars{0, 0}, cursorBar{0, 0} {
+    std::fill(frameTimes, frameTimes + HISTORY, 0.0f);
+}
+
+void PerfOverlay::addFrame(float cpuMs, float simMs, float resolutionScale, const RenderCounters& frame) {
+    frameTimes[cursor] = cpuMs;
+    cursor = (cursor + 1) % HISTORY;
+    if (filled < HISTORY) filled++;
+
+    pendingFrames++;
+    cpuSum += cpuMs;
+    simSum += simMs;
+    scaleSum += resolutionScale;
+    accumulate(counterSum, frame);
+
+    if (pendingFrames < REFRESH_FRAMES) return;
+
+    shownCpu = cpuSum / pendingFrames;
+    shownSim = simSum / pendingFrames;
+    shownScale = scaleSum / pendingFrames;
+    shown = RenderCounters{
+        counterSum.frames / pendingFrames,
+        counterSum.materialChanges / pendingFrames,
+        counterSum.lightChanges / pendingFrames,
+        counterSum.drawCalls / pendingFrames,
+        counterSum.instances / pendingFrames,
+        counterSum.stateChanges / pendingFrames,
+        counterSum.programBinds / pendingFrames,
+        counterSum.matrixLoads / pendingFrames,
+        counterSum.textureBinds / pendingFrames,
+        counterSum.indices / pendingFrames,
+        counterSum.vertices / pendingFrames
+    };
+
+    pendingFrames = 0;
+    cpuSum = simSum = scaleSum = 0.0f;
+    counterSum = RenderCounters{};
+    dirty = true;
+}
+
+void PerfOverlay::update(TextRenderer& text, int screenWidth) {
+    int x = screenWidth - PANEL_WIDTH - MARGIN;
+    if (x != panelX) {
+        panelX = x;
+        dirty = true;
+    }
+
+    if (dirty || batch.isEmpty()) {
+        build(text);
+        dirty = false;
+        return;
+    }
+
+    // Between refreshes only the newest bar and the cursor move
+    placeBar((cursor + HISTORY - 1) % HISTORY);
+    float cursorX = panelX + MARGIN + cursor * BAR_WIDTH;
+    batch.setQuad(cursorBar, cursorX, GRAPH_TOP, cursorX + 1, GRAPH_BOTTOM);
+}
+
+void PerfOverlay::placeBar(int slot) {
+    Batch2D::Range bar = {bars.first + (uint32_t)slot * 6, 6};
+    float ms = frameTimes[slot];
+    float height = slot < filled ? std::min(ms / GRAPH_MAX_MS, 1.0f) * GRAPH_HEIGHT : 0.0f;
+    float x0 = panelX + MARGIN + slot * BAR_WIDTH;
+
+    batch.setQuad(bar, x0, GRAPH_BOTTOM - height, x0 + BAR_WIDTH, GRAPH_BOTTOM);
+    batch.setColor(bar, barColor(ms));
+}
+
+void PerfOverlay::build(TextRenderer& text) {
+    batch.clear();
+
+    const Color2D label = {0.7f, 0.7f, 0.7f, 1.0f};
+    const Color2D value = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    batch.addQuad(panelX, MARGIN, panelX + PANEL_WIDTH, PANEL_BOTTOM, Color2D{0.0f, 0.0f, 0.0f, 0.7f});
+
+    const std::string values[LINE_COUNT] = {
+        formatMs(shownCpu), formatMs(shownSim), formatPercent(shownScale),
+        std::to_string(shown.drawCalls), std::to_string(shown.vertices), std::to_string(shown.lightChanges),
+        std::to_string(shown.stateChanges), std::to_string(shown.programBinds), std::to_string(shown.matrixLoads),
+        std::to_string(shown.textureBinds)
+    };
+    for (int line = 0; line < LINE_COUNT; line++) {
+        float y = MARGIN * 2 + line * TextRenderer::GLYPH_HEIGHT;
+        text.addText(batch, LABELS[line], panelX + MARGIN, y, label);
+        text.addDynamicText(batch, values[line], panelX + MARGIN + VALUE_COLUMN, y, value);
+    }
+
+    // Graph backdrop and the 60 Hz budget line
+    float graphX0 = panelX + MARGIN;
+    float graphX1 = graphX0 + HISTORY * BAR_WIDTH;
+    batch.addQuad(graphX0, GRAPH_TOP, graphX1, GRAPH_BOTTOM, Color2D{0.1f, 0.1f, 0.1f, 0.8f});
+
+    bars = {(uint32_t)batch.getVertexCount(), HISTORY * 6};
+    for (int slot = 0; slot < HISTORY; slot++) {
+        batch.addQuad(0, 0, 0, 0, Color2D{0.0f, 0.0f, 0.0f, 0.0f});
+        placeBar(slot);
+    }
+
+    float budgetY = GRAPH_BOTTOM - FRAME_BUDGET_MS / GRAPH_MAX_MS * GRAPH_HEIGHT;
+    batch.addQuad(graphX0, budgetY, graphX1, budgetY + 1, Color2D{1.0f, 1.0f, 1.0f, 0.4f});
+
+    float cursorX = graphX0 + cursor * BAR_WIDTH;
+    cursorBar = batch.addQuad(cursorX, GRAPH_TOP, cursorX + 1, GRAPH_BOTTOM, Color2D{1.0f, 1.0f, 1.0f, 0.8f});
+}
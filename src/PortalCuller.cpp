@@ -0,0 +1,188 @@
+#include "PortalCuller.h"
+#include "Mansion.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const int MAX_PORTAL_DEPTH = 32;
+    const float PORTAL_HALF_WIDTH = 1.0f;    // Door cubes are 2 x 3
+    const float PORTAL_HALF_HEIGHT = 1.5f;
+    const float DOORWAY_RADIUS = 1.5f;       // Standing in the door sees through all of it
+    const float DEG_TO_RAD = 3.14159265f / 180.0f;
+}
+
+PortalCuller::PortalCuller(const Mansion& mansion)
+    : mansion(mansion), cosYaw(1.0f), sinYaw(0.0f), cosPitch(1.0f), sinPitch(0.0f),
+      projX(1.0f), projY(1.0f), nearPlane(0.1f), farPlane(100.0f), cameraRoom(-1), frame(0), portalsTested(0) {
+}
+
+void PortalCuller::update(const Vector3& eyePos, float yaw, float pitch, float fovY, float aspect,
+                          float nearClip, float farClip) {
+    size_t roomCount = mansion.getRooms().size();
+    size_t doorCount = mansion.getDoors().size();
+    if (roomFrame.size() != roomCount) {
+        roomFrame.assign(roomCount, 0);
+        roomRect.assign(roomCount, ScreenRect{0, 0, 0, 0});
+        onStack.assign(roomCount, 0);
+    }
+    if (doorFrame.size() != doorCount) {
+        doorFrame.assign(doorCount, 0);
+    }
+
+    frame++;
+    visibleRooms.clear();
+    visibleDoors.clear();
+    portalsTested = 0;
+
+    eye = eyePos;
+    cosYaw = cos(yaw * DEG_TO_RAD);
+    sinYaw = sin(yaw * DEG_TO_RAD);
+    cosPitch = cos(pitch * DEG_TO_RAD);
+    sinPitch = sin(pitch * DEG_TO_RAD);
+    projY = 1.0f / tan(fovY * 0.5f * DEG_TO_RAD);
+    projX = projY / aspect;
+    nearPlane = nearClip;
+    farPlane = farClip;
+
+    cameraRoom = mansion.findRoomAt(eye);
+    if (cameraRoom < 0) return;
+
+    visit(cameraRoom, ScreenRect{-1.0f, -1.0f, 1.0f, 1.0f}, 0);
+}
+
+void PortalCuller::markRoom(int room) {
+    if (roomFrame[room] == frame) return;
+    roomFrame[room] = frame;
+    visibleRooms.push_back(room);
+
+    // Every door in a visible room is drawn, open or not
+    uint32_t count = 0;
+    const LevelNavEdge* edges = mansion.getNavEdges(room, count);
+    for (uint32_t e = 0; e < count; e++) {
+        uint32_t door = edges[e].door;
+        if (doorFrame[door] == frame) continue;
+        doorFrame[door] = frame;
+        visibleDoors.push_back((int)door);
+    }
+}
+
+void PortalCuller::visit(int room, const ScreenRect& rect, int depth) {
+    bool seen = roomFrame[room] == frame;
+    if (seen && roomRect[room].contains(rect)) return;
+
+    if (seen) {
+        ScreenRect& merged = roomRect[room];
+        merged.minX = std::min(merged.minX, rect.minX);
+        merged.minY = std::min(merged.minY, rect.minY);
+        merged.maxX = std::max(merged.maxX, rect.maxX);
+        merged.maxY = std::max(merged.maxY, rect.maxY);
+    } else {
+        roomRect[room] = rect;
+        markRoom(room);
+    }
+
+    if (depth >= MAX_PORTAL_DEPTH) return;
+
+    const std::vector<Door>& doors = mansion.getDoors();
+    onStack[room] = 1;
+
+    uint32_t count = 0;
+    const LevelNavEdge* edges = mansion.getNavEdges(room, count);
+    for (uint32_t e = 0; e < count; e++) {
+        int next = (int)edges[e].toRoom;
+        int door = (int)edges[e].door;
+        if (onStack[next] || !doors[door].isOpen) continue;
+
+        portalsTested++;
+        ScreenRect portal;
+        if (!projectPortal(door, room, portal)) continue;
+
+        ScreenRect clipped = {
+            std::max(rect.minX, portal.minX), std::max(rect.minY, portal.minY),
+            std::min(rect.maxX, portal.maxX), std::min(rect.maxY, portal.maxY)
+        };
+        if (clipped.isEmpty()) continue;
+
+        visit(next, clipped, depth + 1);
+    }
+
+    onStack[room] = 0;
+}
+
+Vector3 PortalCuller::toView(const Vector3& p) const {
+    // Inverse of the camera placement in Renderer::setCamera
+    Vector3 d = p - eye;
+    float x = cosYaw * d.x - sinYaw * d.z;
+    float z = sinYaw * d.x + cosYaw * d.z;
+    float y = cosPitch * d.y + sinPitch * z;
+    z = -sinPitch * d.y + cosPitch * z;
+    return Vector3(x, y, z);
+}
+
+bool PortalCuller::projectPortal(int doorIndex, int fromRoom, ScreenRect& out) const {
+    const Door& door = mansion.getDoors()[doorIndex];
+    const Room& room = mansion.getRooms()[fromRoom];
+
+    Vector3 toDoor = door.position - eye;
+    float doorDistance = toDoor.length();
+    if (doorDistance - PORTAL_HALF_HEIGHT > farPlane) {
+        return false;    // Lost in the fog
+    }
+    if (Vector3(toDoor.x, 0.0f, toDoor.z).length() < DOORWAY_RADIUS) {
+        out = ScreenRect{-1.0f, -1.0f, 1.0f, 1.0f};
+        return true;
+    }
+
+    // The portal lies in whichever of the room's walls the door is closest to
+    float dx = fabs(fabs(door.position.x - room.position.x) - room.size.x / 2.0f);
+    float dz = fabs(fabs(door.position.z - room.position.z) - room.size.z / 2.0f);
+    Vector3 tangent = dx < dz ? Vector3(0.0f, 0.0f, PORTAL_HALF_WIDTH) : Vector3(PORTAL_HALF_WIDTH, 0.0f, 0.0f);
+    Vector3 up(0.0f, PORTAL_HALF_HEIGHT, 0.0f);
+
+    Vector3 corners[4] = {
+        toView(door.position - tangent - up),
+        toView(door.position + tangent - up),
+        toView(door.position + tangent + up),
+        toView(door.position - tangent + up)
+    };
+
+    // Clip the quad to the near plane (view space looks down -z)
+    Vector3 clipped[8];
+    int clippedCount = 0;
+    for (int i = 0; i < 4; i++) {
+        const Vector3& a = corners[i];
+        const Vector3& b = corners[(i + 1) % 4];
+        bool aIn = a.z <= -nearPlane;
+        bool bIn = b.z <= -nearPlane;
+
+        if (aIn) clipped[clippedCount++] = a;
+        if (aIn != bIn) {
+            float t = (-nearPlane - a.z) / (b.z - a.z);
+            clipped[clippedCount++] = a + (b - a) * t;
+        }
+    }
+    if (clippedCount == 0) return false;
+
+    out = ScreenRect{1.0f, 1.0f, -1.0f, -1.0f};
+    for (int i = 0; i < clippedCount; i++) {
+        float w = -clipped[i].z;
+        float x = projX * clipped[i].x / w;
+        float y = projY * clipped[i].y / w;
+        out.minX = std::min(out.minX, x);
+        out.minY = std::min(out.minY, y);
+        out.maxX = std::max(out.maxX, x);
+        out.maxY = std::max(out.maxY, y);
+    }
+    return true;
+}
+
+bool PortalCuller::isRoomVisible(int roomIndex) const {
+    if (cameraRoom < 0) return true;
+    return roomIndex >= 0 && roomIndex < (int)roomFrame.size() && roomFrame[roomIndex] == frame;
+}
+
+bool PortalCuller::isPointVisible(const Vector3& pos) const {
+    if (cameraRoom < 0) return true;
+    int room = mansion.findRoomAt(pos);
+    return room < 0 || isRoomVisible(room);
+}
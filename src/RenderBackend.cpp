@@ -0,0 +1,200 @@
+#include "RenderBackend.h"
+#include "Batch2D.h"
+#include <iomanip>
+#include <iostream>
+
+namespace {
+    const char* MATERIAL_NAMES[(int)RenderMaterial::COUNT] = {
+        "GROUND", "WALLS", "SOLID", "EYES", "GLASS", "MARKER_PULSE", "MARKER_STILL", "PARTICLES"
+    };
+
+    const char* MESH_NAMES[(int)InstanceMesh::COUNT] = {
+        "CUBE", "OCTAHEDRON", "QUAD"
+    };
+}
+
+RenderBackend::RenderBackend() {
+    resetCounters();
+}
+
+void RenderBackend::resetCounters() {
+    counters = RenderCounters{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+}
+
+RenderCounters operator-(const RenderCounters& end, const RenderCounters& start) {
+    return RenderCounters{
+        end.frames - start.frames,
+        end.materialChanges - start.materialChanges,
+        end.lightChanges - start.lightChanges,
+        end.drawCalls - start.drawCalls,
+        end.instances - start.instances,
+        end.stateChanges - start.stateChanges,
+        end.programBinds - start.programBinds,
+        end.matrixLoads - start.matrixLoads,
+        end.textureBinds - start.textureBinds,
+        end.indices - start.indices,
+        end.vertices - start.vertices
+    };
+}
+
+void NullRenderBackend::drawGround(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) {
+    counters.drawCalls++;
+    counters.textureBinds++;
+    counters.indices += count;
+    counters.vertices += count;
+}
+
+void NullRenderBackend::drawChunkRange(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) {
+    counters.drawCalls++;
+    counters.indices += count;
+    counters.vertices += count;
+}
+
+void NullRenderBackend::drawInstances(InstanceMesh mesh, const InstanceData* instances, size_t count, bool lit, bool animated) {
+    if (count == 0) return;
+    counters.drawCalls++;
+    counters.instances += (int)count;
+}
+
+void NullRenderBackend::drawPoints(const ScenePoint* points, size_t count, float size) {
+    counters.drawCalls++;
+    counters.instances += (int)count;
+    counters.vertices += count;
+}
+
+void NullRenderBackend::drawBillboards(const BillboardData* billboards, size_t count) {
+    if (count == 0) return;
+    counters.drawCalls++;
+    counters.instances += (int)count;
+    counters.vertices += count * 6;
+}
+
+void NullRenderBackend::drawSkinned(const SkinnedVertex* vertices, size_t count) {
+    if (count == 0) return;
+    counters.drawCalls++;
+    counters.vertices += count;
+}
+
+void NullRenderBackend::drawBatch(Batch2D& batch) {
+    if (batch.isEmpty()) return;
+    counters.drawCalls++;
+    counters.textureBinds++;
+    counters.vertices += batch.getVertexCount();
+}
+
+RecordingRenderBackend::RecordingRenderBackend(const std::string& path, std::unique_ptr<RenderBackend> inner)
+    : out(path), inner(std::move(inner)) {
+    if (!this->inner) {
+        this->inner = std::make_unique<NullRenderBackend>();
+    }
+
+    if (!out.is_open()) {
+        std::cerr << "Failed to open render log " << path << std::endl;
+        return;
+    }
+    out << std::fixed << std::setprecision(2);
+    out << "mansion-render-log 1\n";
+}
+
+void RecordingRenderBackend::initialize(const RenderSettings& settings) {
+    out << "initialize " << settings.screenWidth << "x" << settings.screenHeight
+        << " fog " << settings.fogEnabled << " " << settings.fogDensity << "\n";
+    inner->initialize(settings);
+}
+
+void RecordingRenderBackend::release() {
+    out << "release\n";
+    out.flush();
+    inner->release();
+}
+
+void RecordingRenderBackend::releaseEvicted(const LevelStreamer& streamer) {
+    // Not logged; it runs every frame and only matters once something's evicted
+    inner->releaseEvicted(streamer);
+}
+
+void RecordingRenderBackend::beginFrame(float animationTime) {
+    // The time isn't logged so two runs of the same path compare equal
+    out << "frame " << inner->getCounters().frames << "\n";
+    inner->beginFrame(animationTime);
+}
+
+void RecordingRenderBackend::endFrame() {
+    out << "end_frame\n";
+    inner->endFrame();
+}
+
+void RecordingRenderBackend::setCamera(const CameraSetup& camera) {
+    out << "camera " << camera.position.x << " " << camera.position.y << " " << camera.position.z
+        << " yaw " << camera.yaw << " pitch " << camera.pitch << " far " << camera.farPlane
+        << " flashlight " << camera.flashlight << "\n";
+    inner->setCamera(camera);
+}
+
+void RecordingRenderBackend::beginScene(float scale) {
+    out << "scene scale " << scale << "\n";
+    inner->beginScene(scale);
+}
+
+void RecordingRenderBackend::endScene() {
+    out << "end_scene\n";
+    inner->endScene();
+}
+
+void RecordingRenderBackend::setMaterial(RenderMaterial material, bool lit, bool blended) {
+    out << "material " << MATERIAL_NAMES[(int)material] << " lit " << lit << " blend " << blended << "\n";
+    inner->setMaterial(material, lit, blended);
+}
+
+void RecordingRenderBackend::setLights(const SceneLight* lights, int count) {
+    // Positions only; colours flicker with wall-clock time
+    out << "lights " << count;
+    for (int i = 0; i < count; i++) {
+        out << " " << lights[i].position[0] << "," << lights[i].position[1] << "," << lights[i].position[2];
+    }
+    out << "\n";
+    inner->setLights(lights, count);
+}
+
+void RecordingRenderBackend::drawGround(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) {
+    out << "ground " << chunk << " first " << first << " count " << count << "\n";
+    inner->drawGround(chunk, payload, first, count);
+}
+
+void RecordingRenderBackend::beginChunks() {
+    inner->beginChunks();
+}
+
+void RecordingRenderBackend::drawChunkRange(int chunk, const ChunkPayload& payload, uint32_t first, uint32_t count) {
+    out << "chunk_range " << chunk << " first " << first << " count " << count << "\n";
+    inner->drawChunkRange(chunk, payload, first, count);
+}
+
+void RecordingRenderBackend::endChunks() {
+    inner->endChunks();
+}
+
+void RecordingRenderBackend::drawInstances(InstanceMesh mesh, const InstanceData* instances, size_t count, bool lit, bool animated) {
+    out << "instances " << MESH_NAMES[(int)mesh] << " " << count << " lit " << lit << " animated " << animated << "\n";
+    inner->drawInstances(mesh, instances, count, lit, animated);
+}
+
+void RecordingRenderBackend::drawPoints(const ScenePoint* points, size_t count, float size) {
+    out << "points " << count << " size " << size << "\n";
+    inner->drawPoints(points, count, size);
+}
+
+void RecordingRenderBackend::drawBillboards(const BillboardData* billboards, size_t count) {
+    out << "billboards " << count << "\n";
+    inner->drawBillboards(billboards, count);
+}
+
+void RecordingRenderBackend::drawSkinned(const SkinnedVertex* vertices, size_t count) {
+    out << "skinned " << count << "\n";
+    inner->drawSkinned(vertices, count);
+}
+
+void RecordingRenderBackend::drawBatch(Batch2D& batch) {
+    out << "batch_2d " << batch.getVertexCount() << "\n";
+    inner->drawBatch(batch);
+}
@@ -0,0 +1,64 @@
+#include "RenderQueue.h"
+#include <algorithm>
+
+namespace {
+    const uint32_t DEPTH_BITS = 24;
+    const uint32_t ORDER_BITS = 30;
+    const uint32_t MATERIAL_BITS = 8;
+    const uint32_t DEPTH_MAX = (1u << DEPTH_BITS) - 1;
+    const uint32_t ORDER_MASK = (1u << ORDER_BITS) - 1;
+}
+
+RenderQueue::RenderQueue() : depthScale(1.0f) {
+}
+
+void RenderQueue::clear() {
+    // Capacity stays, so a steady scene stops allocating after a few frames
+    entries.clear();
+    commands.clear();
+}
+
+void RenderQueue::setDepthRange(float farDistance) {
+    depthScale = farDistance > 0.0f ? (float)DEPTH_MAX / farDistance : 1.0f;
+}
+
+uint32_t RenderQueue::quantizeDepth(float depth) const {
+    float scaled = depth * depthScale;
+    if (scaled <= 0.0f) return 0;
+    if (scaled >= (float)DEPTH_MAX) return DEPTH_MAX;
+    return (uint32_t)scaled;
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, RenderMaterial material, uint32_t depth, uint32_t order) {
+    uint64_t key = (uint64_t)pass << 62;
+    uint64_t materialBits = (uint64_t)material;
+    uint64_t orderBits = order & ORDER_MASK;
+
+    if (pass == RenderPass::TRANSPARENT_PASS) {
+        uint64_t farFirst = DEPTH_MAX - depth;
+        key |= farFirst << (MATERIAL_BITS + ORDER_BITS);
+        key |= materialBits << ORDER_BITS;
+    } else {
+        key |= materialBits << (DEPTH_BITS + ORDER_BITS);
+        key |= (uint64_t)depth << ORDER_BITS;
+    }
+    return key | orderBits;
+}
+
+RenderCommand& RenderQueue::push(RenderPass pass, RenderMaterial material, float depth, uint32_t order) {
+    entries.push_back(Entry{makeKey(pass, material, quantizeDepth(depth), order), (uint32_t)commands.size()});
+
+    commands.emplace_back();
+    RenderCommand& command = commands.back();
+    command.material = material;
+    command.lightSet = 0;
+    command.mesh = InstanceMesh::CUBE;
+    return command;
+}
+
+void RenderQueue::sort() {
+    // Recording order settles full ties, so submission is the same every frame
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.key != b.key ? a.key < b.key : a.command < b.command;
+    });
+}
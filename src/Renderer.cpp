@@ -1,290 +1,350 @@
 #include "Renderer.h"
 #include "Player.h"
 #include "Monster.h"
+#include "MonsterAnimation.h"
+#include "JobSystem.h"
 #include "TaskSystem.h"
-#include <GL/gl.h>
-#include <GL/glu.h>
+#include "LevelStreamer.h"
+#include "PortalCuller.h"
+#include "TextRenderer.h"
+#include "Mansion.h"
+#include "ParticleSystem.h"
+#include "MemoryArena.h"
+#include <algorithm>
 #include <cmath>
 #include <string>
 
-Renderer::Renderer(int width, int height)
+namespace {
+    struct MaterialState {
+        RenderPass pass;
+        bool lit;
+        bool animated;
+    };
+    
+    // Indexed by RenderMaterial
+    const MaterialState MATERIALS[(int)RenderMaterial::COUNT] = {
+        {RenderPass::OPAQUE_PASS, true, false},         // GROUND
+        {RenderPass::OPAQUE_PASS, true, false},         // WALLS
+        {RenderPass::OPAQUE_PASS, true, false},         // SOLID
+        {RenderPass::OPAQUE_PASS, false, false},        // EYES
+        {RenderPass::TRANSPARENT_PASS, true, false},    // GLASS
+        {RenderPass::TRANSPARENT_PASS, false, true},    // MARKER_PULSE
+        {RenderPass::TRANSPARENT_PASS, false, false},   // MARKER_STILL
+        {RenderPass::TRANSPARENT_PASS, false, false}    // PARTICLES
+    };
+}
+
+Renderer::Renderer(int width, int height, std::unique_ptr<RenderBackend> backend)
     : screenWidth(width), screenHeight(height),
-      ambientLight(0.3f), fogEnabled(true) {
+      settings{width, height, 0.3f, true, 0.08f, {0.05f, 0.05f, 0.08f}},
+      monsterGlow(-1), flashlight(true), cameraYaw(0.0f), cameraPitch(0.0f), sceneOpen(false), hudLayout{0, 0, false, false}, frameStart{}, lastFrame{}, backend(std::move(backend)) {
+}
+
+Renderer::~Renderer() {
 }
 
 void Renderer::initialize() {
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    
-    setupLighting();
-    
-    // Enhanced fog settings
-    if (fogEnabled) {
-        glEnable(GL_FOG);
-        glFogi(GL_FOG_MODE, GL_EXP2);
-        float fogColor[4] = {0.05f, 0.05f, 0.08f, 1.0f};
-        glFogfv(GL_FOG_COLOR, fogColor);
-        glFogf(GL_FOG_DENSITY, 0.08f);
-        glHint(GL_FOG_HINT, GL_NICEST);
+    textRenderer = std::make_unique<TextRenderer>();
+    backend->initialize(settings);
+}
+
+void Renderer::cleanup() {
+    if (textRenderer) {
+        textRenderer->clear();
     }
+    hudBatch.release();
+    perfOverlay.release();
+    backend->release();
 }
 
-void Renderer::setupLighting() {
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0);
-    glEnable(GL_COLOR_MATERIAL);
-    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+void Renderer::bakeStaticGeometry(const Mansion& mansion) {
+    // Culling bounds: each room grown to take in the doors leading out of it
+    const std::vector<Door>& doors = mansion.getDoors();
+    roomBounds.clear();
+    for (int i = 0; i < (int)mansion.getRooms().size(); i++) {
+        const Room& room = mansion.getRooms()[i];
+        Vector3 half(room.size.x / 2.0f, 0.0f, room.size.z / 2.0f);
+        AABB box = {room.position - half, room.position + half + Vector3(0.0f, room.size.y, 0.0f)};
+        
+        uint32_t doorCount = 0;
+        const LevelNavEdge* edges = mansion.getNavEdges(i, doorCount);
+        for (uint32_t e = 0; e < doorCount; e++) {
+            const Vector3& pos = doors[edges[e].door].position;
+            box.min = Vector3(std::min(box.min.x, pos.x - 1.0f), std::min(box.min.y, pos.y - 1.5f), std::min(box.min.z, pos.z - 0.1f));
+            box.max = Vector3(std::max(box.max.x, pos.x + 1.0f), std::max(box.max.y, pos.y + 1.5f), std::max(box.max.z, pos.z + 0.1f));
+        }
+        roomBounds.add(box);
+    }
     
-    float ambient[] = {ambientLight, ambientLight, ambientLight, 1.0f};
-    float diffuse[] = {0.8f, 0.8f, 0.8f, 1.0f};
-    float specular[] = {0.3f, 0.3f, 0.3f, 1.0f};
+    spotBounds.clear();
+    for (const auto& spot : mansion.getHidingSpots()) {
+        Vector3 half(0.75f, 1.0f, 0.75f);
+        spotBounds.add(AABB{spot.position - half, spot.position + half});
+    }
     
-    glLightfv(GL_LIGHT0, GL_AMBIENT, ambient);
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, diffuse);
-    glLightfv(GL_LIGHT0, GL_SPECULAR, specular);
+    occlusion.build(mansion);
     
-    glEnable(GL_NORMALIZE);
-}
-
-void Renderer::setupPerspective() {
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(75.0, (double)screenWidth / (double)screenHeight, 0.1, 100.0);
-    glMatrixMode(GL_MODELVIEW);
+    // Candles and bulbs by room, plus the red glow that follows the monster
+    lights.build(mansion, roomBounds);
+    monsterGlow = lights.addDynamicLight(PointLight{Vector3(), {0.9f, 0.05f, 0.05f}, 5.0f, LightFlicker::STEADY, 0.0f});
 }
 
-void Renderer::setup2D() {
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, screenWidth, screenHeight, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
+float Renderer::getFarPlane() const {
+    const float MAX_FAR_PLANE = 100.0f;
+    return settings.fogEnabled ? std::min(MAX_FAR_PLANE, getFogOpaqueDistance(settings.fogDensity)) : MAX_FAR_PLANE;
 }
 
 void Renderer::beginFrame() {
-    glClearColor(0.02f, 0.02f, 0.05f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    setupPerspective();
+    const RenderCounters& counters = backend->getCounters();
+    lastFrame = counters - frameStart;
+    frameStart = counters;
+    
+    sceneQueue.clear();
+    sceneQueue.setDepthRange(getFarPlane());
+    
+    // Marker pulse, in radians per second
+    backend->beginFrame(SDL_GetTicks() / 1000.0f * 4.8f);
 }
 
 void Renderer::endFrame() {
-    // Handled by SDL
+    endScene();
+    backend->endFrame();
 }
 
 void Renderer::setCamera(const Vector3& position, float yaw, float pitch) {
-    glLoadIdentity();
-    
-    glRotatef(-pitch, 1.0f, 0.0f, 0.0f);
-    glRotatef(-yaw, 0.0f, 1.0f, 0.0f);
-    glTranslatef(-position.x, -position.y, -position.z);
-    
-    float lightPos[] = {position.x, position.y + 5.0f, position.z, 1.0f};
-    glLightfv(GL_LIGHT0, GL_POSITION, lightPos);
+    cameraPosition = position;
+    cameraYaw = yaw;
+    cameraPitch = pitch;
+    occlusion.invalidate();
+    lights.beginFrame(SDL_GetTicks() / 1000.0f, position, getFarPlane());
+    frustum.update(position, yaw, pitch, getFieldOfView(), getAspect(), getNearPlane(), getFarPlane());
+    
+    if (!sceneOpen) {
+        backend->beginScene(resolution.getScale());
+        sceneOpen = true;
+    }
+    backend->setCamera(CameraSetup{position, yaw, pitch, getFieldOfView(), getAspect(), getNearPlane(), getFarPlane(),
+                                   flashlight});
 }
 
-void Renderer::drawCube(const Vector3& pos, const Vector3& size, float r, float g, float b, float a) {
-    glPushMatrix();
-    glTranslatef(pos.x, pos.y, pos.z);
-    
-    glColor4f(r, g, b, a);
-    
-    float w = size.x / 2.0f;
-    float h = size.y / 2.0f;
-    float d = size.z / 2.0f;
-    
-    glBegin(GL_QUADS);
-    
-    glNormal3f(0.0f, 0.0f, 1.0f);
-    glVertex3f(-w, -h, d); glVertex3f(w, -h, d);
-    glVertex3f(w, h, d); glVertex3f(-w, h, d);
-    
-    glNormal3f(0.0f, 0.0f, -1.0f);
-    glVertex3f(-w, -h, -d); glVertex3f(-w, h, -d);
-    glVertex3f(w, h, -d); glVertex3f(w, -h, -d);
-    
-    glNormal3f(0.0f, 1.0f, 0.0f);
-    glVertex3f(-w, h, -d); glVertex3f(-w, h, d);
-    glVertex3f(w, h, d); glVertex3f(w, h, -d);
-    
-    glNormal3f(0.0f, -1.0f, 0.0f);
-    glVertex3f(-w, -h, -d); glVertex3f(w, -h, -d);
-    glVertex3f(w, -h, d); glVertex3f(-w, -h, d);
-    
-    glNormal3f(1.0f, 0.0f, 0.0f);
-    glVertex3f(w, -h, -d); glVertex3f(w, h, -d);
-    glVertex3f(w, h, d); glVertex3f(w, -h, d);
-    
-    glNormal3f(-1.0f, 0.0f, 0.0f);
-    glVertex3f(-w, -h, -d); glVertex3f(-w, -h, d);
-    glVertex3f(-w, h, d); glVertex3f(-w, h, -d);
-    
-    glEnd();
-    glPopMatrix();
+void Renderer::endScene() {
+    if (!sceneOpen) return;
+    backend->endScene();
+    sceneOpen = false;
 }
 
-void Renderer::drawFloor(float size) {
-    glBegin(GL_QUADS);
-    glNormal3f(0.0f, 1.0f, 0.0f);
-    
-    float step = 5.0f;
-    for (float x = -size; x < size; x += step) {
-        for (float z = -size; z < size; z += step) {
-            bool isDark = ((int)(x/step) + (int)(z/step)) % 2 == 0;
-            float shade = isDark ? 0.15f : 0.18f;
-            glColor3f(shade * 0.8f, shade * 0.7f, shade * 0.6f);
-            
-            glVertex3f(x, 0.0f, z);
-            glVertex3f(x + step, 0.0f, z);
-            glVertex3f(x + step, 0.0f, z + step);
-            glVertex3f(x, 0.0f, z + step);
-        }
-    }
-    glEnd();
+RenderCommand& Renderer::queueCommand(RenderMaterial material, const Vector3& center, uint32_t order, int lightSet) {
+    float depth = (center - cameraPosition).length();
+    RenderCommand& command = sceneQueue.push(MATERIALS[(int)material].pass, material, depth, order);
+    // Unlit draws all share set 0, so a set change never splits them
+    command.lightSet = MATERIALS[(int)material].lit ? (uint32_t)lightSet : 0;
+    return command;
 }
 
-void Renderer::drawWalls(const Room& room) {
-    Vector3 pos = room.position;
-    Vector3 size = room.size;
-    float w = size.x / 2.0f;
-    float h = size.y;
-    float d = size.z / 2.0f;
-    
-    glColor3f(0.35f, 0.28f, 0.22f);
-    
-    glBegin(GL_QUADS);
-    
-    glNormal3f(0.0f, 0.0f, 1.0f);
-    glVertex3f(pos.x - w, 0.0f, pos.z + d);
-    glVertex3f(pos.x + w, 0.0f, pos.z + d);
-    glVertex3f(pos.x + w, h, pos.z + d);
-    glVertex3f(pos.x - w, h, pos.z + d);
-    
-    glNormal3f(0.0f, 0.0f, -1.0f);
-    glVertex3f(pos.x - w, 0.0f, pos.z - d);
-    glVertex3f(pos.x - w, h, pos.z - d);
-    glVertex3f(pos.x + w, h, pos.z - d);
-    glVertex3f(pos.x + w, 0.0f, pos.z - d);
-    
-    glNormal3f(-1.0f, 0.0f, 0.0f);
-    glVertex3f(pos.x - w, 0.0f, pos.z - d);
-    glVertex3f(pos.x - w, 0.0f, pos.z + d);
-    glVertex3f(pos.x - w, h, pos.z + d);
-    glVertex3f(pos.x - w, h, pos.z - d);
-    
-    glNormal3f(1.0f, 0.0f, 0.0f);
-    glVertex3f(pos.x + w, 0.0f, pos.z - d);
-    glVertex3f(pos.x + w, h, pos.z - d);
-    glVertex3f(pos.x + w, h, pos.z + d);
-    glVertex3f(pos.x + w, 0.0f, pos.z + d);
-    
-    glEnd();
+void Renderer::queueInstance(RenderMaterial material, InstanceMesh mesh, const InstanceData& instance, uint32_t order,
+                             int lightSet) {
+    Vector3 center(instance.position[0], instance.position[1], instance.position[2]);
+    RenderCommand& command = queueCommand(material, center, order, lightSet);
+    command.type = RenderCommandType::INSTANCE;
+    command.mesh = mesh;
+    command.instance = instance;
 }
 
-void Renderer::drawDoor(const Door& door) {
-    glColor3f(0.25f, 0.15f, 0.1f);
-    drawCube(door.position, Vector3(2.0f, 3.0f, 0.2f), 0.25f, 0.15f, 0.1f);
+void Renderer::queueMonster(const MonsterAnimation& animation, int instance, const SkinnedVertex* vertices) {
+    // Posed body, lit by whatever is around its middle
+    const AABB& box = animation.getBounds(instance);
+    Vector3 center = (box.min + box.max) * 0.5f;
+    uint32_t order = (uint32_t)instance * 3;
+    RenderCommand& body = queueCommand(RenderMaterial::SOLID, center, order, lights.getSetAt(center));
+    body.type = RenderCommandType::SKINNED;
+    body.skinned = {vertices, (uint32_t)animation.getVertexCount()};
+    
+    // Glowing eyes, carried by the head
+    for (int i = 0; i < 2; i++) {
+        Vector3 eye = animation.transformPoint(instance, MONSTER_HEAD_BONE, Vector3(i == 0 ? -0.2f : 0.2f, 2.6f, 0.34f));
+        RenderCommand& command = queueCommand(RenderMaterial::EYES, eye, order + 1 + i);
+        command.type = RenderCommandType::POINT;
+        command.point = {{eye.x, eye.y, eye.z}, {255, 13, 13, 255}};
+    }
 }
 
-void Renderer::drawMonster(const Vector3& pos, float scale) {
-    glPushMatrix();
-    glTranslatef(pos.x, pos.y + 1.0f, pos.z);
-    
-    // Body
-    drawCube(Vector3(0, 0.5f, 0), Vector3(1.0f, 2.0f, 0.5f), 0.08f, 0.08f, 0.08f);
-    
-    // Head
-    drawCube(Vector3(0, 1.5f, 0), Vector3(0.6f, 0.6f, 0.6f), 0.12f, 0.08f, 0.08f);
-    
-    // Glowing eyes
-    glDisable(GL_LIGHTING);
-    glColor3f(1.0f, 0.05f, 0.05f);
-    glPointSize(12.0f);
-    glBegin(GL_POINTS);
-    glVertex3f(-0.2f, 1.6f, 0.4f);
-    glVertex3f(0.2f, 1.6f, 0.4f);
-    glEnd();
-    glEnable(GL_LIGHTING);
-    
-    glPopMatrix();
+void Renderer::applyMaterial(RenderMaterial material) {
+    const MaterialState& state = MATERIALS[(int)material];
+    backend->setMaterial(material, state.lit, state.pass == RenderPass::TRANSPARENT_PASS);
 }
 
-void Renderer::drawTaskMarker(const Vector3& pos, bool completed) {
-    glPushMatrix();
-    glTranslatef(pos.x, pos.y + 1.5f, pos.z);
-    
-    static float pulse = 0.0f;
-    pulse += 0.08f;
-    
-    if (completed) {
-        glColor4f(0.1f, 0.8f, 0.1f, 0.7f);
-    } else {
-        float intensity = 0.8f + 0.2f * sin(pulse);
-        glColor4f(intensity, intensity, 0.2f, 0.9f);
-        float scale = 1.0f + 0.15f * sin(pulse);
-        glScalef(scale, scale, scale);
+void Renderer::submitScene() {
+    sceneQueue.sort();
+    
+    RenderMaterial material = RenderMaterial::COUNT;
+    int lightSet = -1;
+    size_t count = sceneQueue.size();
+    
+    for (size_t i = 0; i < count;) {
+        const RenderCommand& command = sceneQueue[i];
+        if (command.material != material) {
+            material = command.material;
+            applyMaterial(material);
+        }
+        
+        // Light positions go through the view, so every frame sets them afresh
+        if (MATERIALS[(int)material].lit && (lightSet < 0 || !lights.isSameSet((int)command.lightSet, lightSet))) {
+            lightSet = (int)command.lightSet;
+            int lightCount = 0;
+            const SceneLight* set = lights.getSet(lightSet, lightCount);
+            backend->setLights(set, lightCount);
+        }
+        
+        // Neighbours in sort order that can go out in the same draw. Sets
+        // are told apart by the lights in them, not by room, or no two rooms
+        // would ever share a draw.
+        size_t end = i + 1;
+        while (end < count && sceneQueue[end].type == command.type &&
+               sceneQueue[end].material == material && sceneQueue[end].mesh == command.mesh &&
+               (!MATERIALS[(int)material].lit ||
+                lights.isSameSet((int)sceneQueue[end].lightSet, (int)command.lightSet))) {
+            end++;
+        }
+        
+        switch (command.type) {
+            case RenderCommandType::GROUND:
+                for (size_t r = i; r < end; r++) {
+                    const auto& range = sceneQueue[r].range;
+                    backend->drawGround(range.chunk, *range.payload, range.first, range.count);
+                }
+                break;
+                
+            case RenderCommandType::STATIC_RANGE:
+                // Ranges of one chunk share a depth and sort by first index,
+                // so adjacent rooms lit the same join up into one draw
+                backend->beginChunks();
+                for (size_t r = i; r < end;) {
+                    auto merged = sceneQueue[r++].range;
+                    while (r < end && sceneQueue[r].range.chunk == merged.chunk &&
+                           sceneQueue[r].range.first == merged.first + merged.count) {
+                        merged.count += sceneQueue[r++].range.count;
+                    }
+                    backend->drawChunkRange(merged.chunk, *merged.payload, merged.first, merged.count);
+                }
+                backend->endChunks();
+                break;
+                
+            case RenderCommandType::INSTANCE: {
+                auto batch = makeFrameVector<InstanceData>(end - i);
+                for (size_t r = i; r < end; r++) {
+                    batch.push_back(sceneQueue[r].instance);
+                }
+                const MaterialState& state = MATERIALS[(int)material];
+                backend->drawInstances(command.mesh, batch.data(), batch.size(), state.lit, state.animated);
+                break;
+            }
+                
+            case RenderCommandType::POINT: {
+                auto points = makeFrameVector<ScenePoint>(end - i);
+                for (size_t r = i; r < end; r++) {
+                    points.push_back(sceneQueue[r].point);
+                }
+                backend->drawPoints(points.data(), points.size(), 12.0f);
+                break;
+            }
+                
+            case RenderCommandType::BILLBOARDS:
+                for (size_t r = i; r < end; r++) {
+                    backend->drawBillboards(sceneQueue[r].billboards.data, sceneQueue[r].billboards.count);
+                }
+                break;
+                
+            case RenderCommandType::SKINNED:
+                // Monsters skinned side by side go out as one draw
+                for (size_t r = i; r < end;) {
+                    auto merged = sceneQueue[r++].skinned;
+                    while (r < end && sceneQueue[r].skinned.vertices == merged.vertices + merged.count) {
+                        merged.count += sceneQueue[r++].skinned.count;
+                    }
+                    backend->drawSkinned(merged.vertices, merged.count);
+                }
+                break;
+        }
+        
+        i = end;
     }
     
-    glDisable(GL_LIGHTING);
-    
-    // Draw octahedron marker
-    glBegin(GL_TRIANGLES);
-    float size = 0.4f;
-    
-    // Top pyramid
-    glVertex3f(0, size, 0);
-    glVertex3f(size, 0, 0);
-    glVertex3f(0, 0, size);
-    
-    glVertex3f(0, size, 0);
-    glVertex3f(0, 0, size);
-    glVertex3f(-size, 0, 0);
-    
-    glVertex3f(0, size, 0);
-    glVertex3f(-size, 0, 0);
-    glVertex3f(0, 0, -size);
-    
-    glVertex3f(0, size, 0);
-    glVertex3f(0, 0, -size);
-    glVertex3f(size, 0, 0);
-    
-    // Bottom pyramid
-    glVertex3f(0, -size, 0);
-    glVertex3f(0, 0, size);
-    glVertex3f(size, 0, 0);
-    
-    glVertex3f(0, -size, 0);
-    glVertex3f(-size, 0, 0);
-    glVertex3f(0, 0, size);
-    
-    glVertex3f(0, -size, 0);
-    glVertex3f(0, 0, -size);
-    glVertex3f(-size, 0, 0);
-    
-    glVertex3f(0, -size, 0);
-    glVertex3f(size, 0, 0);
-    glVertex3f(0, 0, -size);
-    
-    glEnd();
-    
-    glEnable(GL_LIGHTING);
-    glPopMatrix();
+    sceneQueue.clear();
+    endScene();
 }
 
-void Renderer::renderMansion(const std::vector<Room>& rooms, const std::vector<Door>& doors) {
-    glEnable(GL_LIGHTING);
-    glEnable(GL_DEPTH_TEST);
-    
-    drawFloor(100.0f);
-    
-    for (const auto& room : rooms) {
-        drawWalls(room);
-    }
-    
-    for (const auto& door : doors) {
-        drawDoor(door);
+void Renderer::renderMansion(const LevelStreamer& streamer, const PortalCuller& culler) {
+    backend->releaseEvicted(streamer);
+    
+    // Depth for this view, which everything queued after this is tested against
+    occlusion.render(cameraPosition, cameraYaw, cameraPitch, getFieldOfView(), getAspect(), getNearPlane(),
+                     frustum, streamer, culler);
+    
+    // Ranges sort by their chunk's centre, front to back
+    const auto& chunks = streamer.getChunks();
+    auto queueRange = [&](int chunk, int room, uint32_t first, uint32_t count) {
+        const LevelChunk& source = *chunks[chunk];
+        RenderCommand& command = queueCommand(RenderMaterial::WALLS, (source.boundsMin + source.boundsMax) * 0.5f, first,
+                                              lights.getRoomSet(room, source.payload->lightmap != nullptr));
+        command.type = RenderCommandType::STATIC_RANGE;
+        command.range = {source.payload.get(), chunk, first, count};
+    };
+    
+    // One floor per chunk with something drawn, all lit by whatever is
+    // around the player
+    int groundSet = lights.getSetAt(cameraPosition);
+    auto queueGround = [&](int chunk) {
+        const ChunkPayload& payload = *chunks[chunk]->payload;
+        if (payload.floorIndexCount == 0) return;
+        RenderCommand& command = queueCommand(RenderMaterial::GROUND, (payload.floorMin + payload.floorMax) * 0.5f,
+                                              (uint32_t)chunk, groundSet);
+        command.type = RenderCommandType::GROUND;
+        command.range = {&payload, chunk, payload.floorFirstIndex, payload.floorIndexCount};
+    };
+    
+    if (culler.isEverythingVisible()) {
+        for (size_t i = 0; i < chunks.size(); i++) {
+            if (chunks[i]->state.load() != ChunkState::LOADED) continue;
+            
+            // Chunk bounds cover rooms and spots; pad for door thickness
+            AABB box = {chunks[i]->boundsMin - Vector3(1, 1, 1), chunks[i]->boundsMax + Vector3(1, 1, 1)};
+            if (!frustum.isVisible(box)) continue;
+            
+            const ChunkPayload& payload = *chunks[i]->payload;
+            if (frustum.isVisible(AABB{payload.floorMin, payload.floorMax})) queueGround((int)i);
+            
+            // Room by room, so walls in front can hide the rest of the chunk;
+            // neighbouring ranges lit the same still merge into one draw
+            for (const ChunkPayload::RoomRange& range : chunks[i]->payload->roomRanges) {
+                AABB roomBox = roomBounds.get(range.room);
+                if (!frustum.isVisible(roomBox) || !occlusion.isVisible(roomBox)) continue;
+                
+                queueRange((int)i, range.room, range.firstIndex, range.indexCount);
+            }
+        }
+    } else {
+        const std::vector<int>& portalRooms = culler.getVisibleRooms();
+        auto rooms = makeFrameVector<int>(portalRooms.size());
+        rooms.resize(portalRooms.size());
+        rooms.resize(frustum.cull(roomBounds, portalRooms.data(), (int)portalRooms.size(), rooms.data()));
+        rooms.resize(occlusion.cull(roomBounds, rooms.data(), (int)rooms.size(), rooms.data()));
+        
+        auto groundChunks = makeFrameVector<int>(rooms.size());
+        for (int room : rooms) {
+            int chunk = streamer.getRoomChunk(room);
+            if (chunks[chunk]->state.load() != ChunkState::LOADED) continue;
+            
+            const ChunkPayload::RoomRange& range = chunks[chunk]->payload->roomRanges[streamer.getRoomSlot(room)];
+            queueRange(chunk, room, range.firstIndex, range.indexCount);
+            groundChunks.push_back(chunk);
+        }
+        
+        // The floor under the visible rooms, once per chunk
+        std::sort(groundChunks.begin(), groundChunks.end());
+        groundChunks.erase(std::unique(groundChunks.begin(), groundChunks.end()), groundChunks.end());
+        for (int chunk : groundChunks) {
+            queueGround(chunk);
+        }
     }
 }
 
@@ -292,191 +352,207 @@ void Renderer::renderPlayer(const Player& player) {
     // First person view
 }
 
-void Renderer::renderMonster(const Monster& monster, const Vector3& playerPos) {
-    float distance = (monster.getPosition() - playerPos).length();
+void Renderer::renderMonsters(const MonsterAnimation& animation) {
+    int count = animation.getInstanceCount();
+    if (count == 0) return;
+    
+    // The glow lights the rooms around the first monster even when it's hidden
+    if (monsterGlow >= 0) {
+        lights.moveDynamicLight(monsterGlow, animation.transformPoint(0, MONSTER_HEAD_BONE, Vector3(0.0f, 2.6f, 0.6f)),
+                                1.0f);
+    }
+    
+    auto visible = makeFrameVector<int>(count);
+    for (int i = 0; i < count; i++) {
+        const AABB& box = animation.getBounds(i);
+        if (frustum.isVisible(box) && occlusion.isVisible(box)) {
+            visible.push_back(i);
+        }
+    }
+    if (visible.empty()) return;
     
-    if (distance < 60.0f) {
-        drawMonster(monster.getPosition());
+    // Skinned into one buffer in visible order, so neighbours merge into one draw
+    size_t stride = animation.getVertexCount();
+    if (monsterVertices.size() < visible.size() * stride) {
+        monsterVertices.resize(visible.size() * stride);
+    }
+    SkinnedVertex* vertices = monsterVertices.data();
+    getJobSystem().parallelFor((int)visible.size(), [&](int v) {
+        animation.skin(visible[v], vertices + v * stride);
+    });
+    
+    for (size_t v = 0; v < visible.size(); v++) {
+        queueMonster(animation, visible[v], vertices + v * stride);
     }
 }
 
 void Renderer::renderTasks(const std::vector<Task>& tasks) {
+    // Pending markers pulse; completed ones sit still
     for (const auto& task : tasks) {
-        drawTaskMarker(task.location, task.completed);
+        // Octahedron at its largest pulse
+        Vector3 center = task.location + Vector3(0.0f, 1.5f, 0.0f);
+        Vector3 half(0.5f, 0.5f, 0.5f);
+        AABB box = {center - half, center + half};
+        if (!frustum.isVisible(box) || !occlusion.isVisible(box)) continue;
+        
+        InstanceData marker = {
+            {center.x, center.y, center.z}, {1.0f, 1.0f, 1.0f},
+            {255, 255, 51, 230}, task.id * 0.9f
+        };
+        RenderMaterial material = RenderMaterial::MARKER_PULSE;
+        if (task.completed) {
+            marker.color[0] = 25; marker.color[1] = 204; marker.color[2] = 25; marker.color[3] = 178;
+            material = RenderMaterial::MARKER_STILL;
+        }
+        queueInstance(material, InstanceMesh::OCTAHEDRON, marker, (uint32_t)task.id);
+    }
+}
+
+void Renderer::renderHidingSpots(const std::vector<HidingSpot>& spots, const LevelStreamer& streamer, const PortalCuller& culler) {
+    auto candidates = makeFrameVector<int>();
+    for (const auto& chunk : streamer.getChunks()) {
+        if (chunk->state.load() != ChunkState::LOADED) continue;
+        
+        for (int spot : chunk->hidingSpots) {
+            if (culler.isPointVisible(spots[spot].position)) {
+                candidates.push_back(spot);
+            }
+        }
+    }
+    candidates.resize(frustum.cull(spotBounds, candidates.data(), (int)candidates.size(), candidates.data()));
+    candidates.resize(occlusion.cull(spotBounds, candidates.data(), (int)candidates.size(), candidates.data()));
+    
+    for (int spot : candidates) {
+        const Vector3& pos = spots[spot].position;
+        queueInstance(RenderMaterial::GLASS, InstanceMesh::CUBE,
+                      InstanceData{{pos.x, pos.y, pos.z}, {1.5f, 2.0f, 1.5f}, {77, 89, 128, 102}, 0.0f}, (uint32_t)spot,
+                      lights.getSetAt(pos));
     }
 }
 
-void Renderer::renderHidingSpots(const std::vector<HidingSpot>& spots) {
-    for (const auto& spot : spots) {
-        drawCube(spot.position, Vector3(1.5f, 2.0f, 1.5f), 0.3f, 0.35f, 0.5f, 0.4f);
+void Renderer::renderParticles(const ParticleSystem& particles) {
+    if (billboards.size() < particles.getCapacity()) {
+        billboards.resize(particles.getCapacity());
     }
+    size_t count = particles.buildBillboards(frustum, billboards.data());
+    if (count == 0) return;
+    
+    // Too many to sort each frame, and faint enough that blending out of
+    // order doesn't show; at the eye's depth they go after everything else
+    RenderCommand& command = queueCommand(RenderMaterial::PARTICLES, cameraPosition, 0);
+    command.type = RenderCommandType::BILLBOARDS;
+    command.billboards = {billboards.data(), (uint32_t)count};
 }
 
 void Renderer::renderHUD(const Player& player, const TaskSystem& taskSystem, const Monster& monster) {
-    setup2D();
-    
-    // Health bar with border
-    glColor3f(0.2f, 0.2f, 0.2f);
-    glBegin(GL_QUADS);
-    glVertex2f(8, 8);
-    glVertex2f(214, 8);
-    glVertex2f(214, 34);
-    glVertex2f(8, 34);
-    glEnd();
+    float distToMonster = monster.getDistanceToPlayer(player.getPosition());
+    HudLayout layout = {
+        taskSystem.getCompletedTaskCount(), taskSystem.getTotalTaskCount(),
+        player.isHiding(), distToMonster < 20.0f && !player.isHiding()
+    };
+    if (hudBatch.isEmpty() || !(layout == hudLayout)) {
+        hudLayout = layout;
+        buildHUD(taskSystem);
+    }
     
+    // Bars move every frame; only a whole-pixel change is uploaded
     float healthPercent = player.getHealth() / 100.0f;
-    glColor3f(1.0f - healthPercent, healthPercent, 0.0f);
-    glBegin(GL_QUADS);
-    glVertex2f(10, 10);
-    glVertex2f(10 + 200 * healthPercent, 10);
-    glVertex2f(10 + 200 * healthPercent, 32);
-    glVertex2f(10, 32);
-    glEnd();
+    hudBatch.setQuad(healthBar, 10, 10, 10 + std::floor(200 * healthPercent), 32);
+    hudBatch.setColor(healthBar, Color2D{1.0f - healthPercent, healthPercent, 0.0f, 1.0f});
     
-    renderText("HEALTH", 12, 16, 1.0f, 1.0f, 1.0f);
+    float staminaPercent = player.getStamina() / 100.0f;
+    hudBatch.setQuad(staminaBar, 10, 40, 10 + std::floor(200 * staminaPercent), 58);
     
-    // Stamina bar with border
-    glColor3f(0.2f, 0.2f, 0.2f);
-    glBegin(GL_QUADS);
-    glVertex2f(8, 38);
-    glVertex2f(214, 38);
-    glVertex2f(214, 60);
-    glVertex2f(8, 60);
-    glEnd();
+    if (layout.danger) {
+        static float warningPulse = 0.0f;
+        warningPulse += 0.15f;
+        float intensity = 0.5f + 0.5f * sin(warningPulse);
+        hudBatch.setColor(dangerText, Color2D{1.0f, intensity * 0.3f, intensity * 0.3f, 1.0f});
+    }
     
-    float staminaPercent = player.getStamina() / 100.0f;
-    glColor3f(0.1f, 0.5f, 0.9f);
-    glBegin(GL_QUADS);
-    glVertex2f(10, 40);
-    glVertex2f(10 + 200 * staminaPercent, 40);
-    glVertex2f(10 + 200 * staminaPercent, 58);
-    glVertex2f(10, 58);
-    glEnd();
+    drawBatch(hudBatch);
+}
+
+void Renderer::renderPerfOverlay(float cpuMs, float simMs) {
+    perfOverlay.addFrame(cpuMs, simMs, resolution.getScale(), lastFrame);
+    if (!perfOverlay.isVisible()) return;
     
-    renderText("STAMINA", 12, 46, 1.0f, 1.0f, 1.0f);
+    perfOverlay.update(*textRenderer, screenWidth);
+    drawBatch(perfOverlay.getBatch());
+}
+
+void Renderer::drawBatch(Batch2D& batch) {
+    // 2D always lands on the window at native size
+    endScene();
+    backend->drawBatch(batch);
+}
+
+void Renderer::buildHUD(const TaskSystem& taskSystem) {
+    hudBatch.clear();
     
-    // Task panel
-    std::string taskText = "TASKS: " + std::to_string(taskSystem.getCompletedTaskCount()) + "/" + 
-                          std::to_string(taskSystem.getTotalTaskCount());
+    const Color2D border = {0.2f, 0.2f, 0.2f, 1.0f};
+    const Color2D white = {1.0f, 1.0f, 1.0f, 1.0f};
     
-    glColor4f(0.0f, 0.0f, 0.0f, 0.7f);
-    glBegin(GL_QUADS);
-    glVertex2f(8, 68);
-    glVertex2f(214, 68);
-    glVertex2f(214, 92);
-    glVertex2f(8, 92);
-    glEnd();
+    // Health bar with border; width and colour are set every frame
+    hudBatch.addQuad(8, 8, 214, 34, border);
+    healthBar = hudBatch.addQuad(10, 10, 210, 32, Color2D{0.0f, 1.0f, 0.0f, 1.0f});
+    renderText(hudBatch, "HEALTH", 12, 16, white);
     
-    renderText(taskText, 12, 76, 1.0f, 1.0f, 0.5f);
+    // Stamina bar with border
+    hudBatch.addQuad(8, 38, 214, 60, border);
+    staminaBar = hudBatch.addQuad(10, 40, 210, 58, Color2D{0.1f, 0.5f, 0.9f, 1.0f});
+    renderText(hudBatch, "STAMINA", 12, 46, white);
+    
+    // Task panel
+    std::string taskText = "TASKS: " + std::to_string(hudLayout.tasksDone) + "/" +
+                          std::to_string(hudLayout.tasksTotal);
+    hudBatch.addQuad(8, 68, 214, 92, Color2D{0.0f, 0.0f, 0.0f, 0.7f});
+    renderText(hudBatch, taskText, 12, 76, Color2D{1.0f, 1.0f, 0.5f, 1.0f});
     
     // Current objective at bottom
     std::string objective = taskSystem.getTaskDescription();
-    int objWidth = objective.length() * 8 + 20;
+    int objWidth = textRenderer->measure(objective) + 20;
     int objX = (screenWidth - objWidth) / 2;
     int objY = screenHeight - 60;
-    
-    glColor4f(0.0f, 0.0f, 0.0f, 0.8f);
-    glBegin(GL_QUADS);
-    glVertex2f(objX - 10, objY - 10);
-    glVertex2f(objX + objWidth, objY - 10);
-    glVertex2f(objX + objWidth, objY + 30);
-    glVertex2f(objX - 10, objY + 30);
-    glEnd();
-    
-    renderText(objective, objX, objY, 0.9f, 0.9f, 0.9f);
+    hudBatch.addQuad(objX - 10, objY - 10, objX + objWidth, objY + 30, Color2D{0.0f, 0.0f, 0.0f, 0.8f});
+    renderText(hudBatch, objective, objX, objY, Color2D{0.9f, 0.9f, 0.9f, 1.0f});
     
     // Hiding indicator
-    if (player.isHiding()) {
+    if (hudLayout.hiding) {
         int hideX = screenWidth / 2 - 60;
-        glColor4f(0.0f, 0.3f, 0.0f, 0.8f);
-        glBegin(GL_QUADS);
-        glVertex2f(hideX - 10, 30);
-        glVertex2f(hideX + 130, 30);
-        glVertex2f(hideX + 130, 65);
-        glVertex2f(hideX - 10, 65);
-        glEnd();
-        
-        renderText("HIDING", hideX, 42, 0.2f, 1.0f, 0.2f);
+        hudBatch.addQuad(hideX - 10, 30, hideX + 130, 65, Color2D{0.0f, 0.3f, 0.0f, 0.8f});
+        renderText(hudBatch, "HIDING", hideX, 42, Color2D{0.2f, 1.0f, 0.2f, 1.0f});
     }
     
-    // Monster proximity warning
-    float distToMonster = monster.getDistanceToPlayer(player.getPosition());
-    if (distToMonster < 20.0f && !player.isHiding()) {
-        static float warningPulse = 0.0f;
-        warningPulse += 0.15f;
-        float intensity = 0.5f + 0.5f * sin(warningPulse);
-        
+    // Monster proximity warning; the text pulses in renderHUD
+    if (hudLayout.danger) {
         int dangerX = screenWidth / 2 - 70;
-        glColor4f(0.5f, 0.0f, 0.0f, 0.7f);
-        glBegin(GL_QUADS);
-        glVertex2f(dangerX - 10, 80);
-        glVertex2f(dangerX + 150, 80);
-        glVertex2f(dangerX + 150, 115);
-        glVertex2f(dangerX - 10, 115);
-        glEnd();
-        
-        renderText("! DANGER !", dangerX, 92, 1.0f, intensity * 0.3f, intensity * 0.3f);
+        hudBatch.addQuad(dangerX - 10, 80, dangerX + 150, 115, Color2D{0.5f, 0.0f, 0.0f, 0.7f});
+        dangerText = renderText(hudBatch, "! DANGER !", dangerX, 92, Color2D{1.0f, 0.3f, 0.3f, 1.0f});
     }
     
     // Controls hint
-    renderText("F: Interact  E: Hide  SHIFT: Sprint  ESC: Pause", 
-               10, screenHeight - 25, 0.7f, 0.7f, 0.7f);
-    
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
-}
-
-void Renderer::renderCrosshair() {
-    setup2D();
-    
-    glColor4f(0.9f, 0.9f, 0.9f, 0.8f);
-    glLineWidth(2.5f);
-    
-    int centerX = screenWidth / 2;
-    int centerY = screenHeight / 2;
-    int size = 12;
-    int gap = 4;
-    
-    glBegin(GL_LINES);
-    glVertex2f(centerX - size, centerY);
-    glVertex2f(centerX - gap, centerY);
-    glVertex2f(centerX + gap, centerY);
-    glVertex2f(centerX + size, centerY);
-    glVertex2f(centerX, centerY - size);
-    glVertex2f(centerX, centerY - gap);
-    glVertex2f(centerX, centerY + gap);
-    glVertex2f(centerX, centerY + size);
-    glEnd();
-    
-    glPointSize(3.0f);
-    glBegin(GL_POINTS);
-    glVertex2f(centerX, centerY);
-    glEnd();
-    
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
+    renderText(hudBatch, "F: Interact  E: Hide  SHIFT: Sprint  ESC: Pause",
+               10, screenHeight - 25, Color2D{0.7f, 0.7f, 0.7f, 1.0f});
+    
+    // Crosshair
+    const Color2D crosshair = {0.9f, 0.9f, 0.9f, 0.8f};
+    float centerX = screenWidth / 2;
+    float centerY = screenHeight / 2;
+    float size = 12;
+    float gap = 4;
+    
+    hudBatch.addLine(centerX - size, centerY, centerX - gap, centerY, 2.5f, crosshair);
+    hudBatch.addLine(centerX + gap, centerY, centerX + size, centerY, 2.5f, crosshair);
+    hudBatch.addLine(centerX, centerY - size, centerX, centerY - gap, 2.5f, crosshair);
+    hudBatch.addLine(centerX, centerY + gap, centerX, centerY + size, 2.5f, crosshair);
+    hudBatch.addQuad(centerX - 1.5f, centerY - 1.5f, centerX + 1.5f, centerY + 1.5f, crosshair);
 }
 
-void Renderer::renderText(const std::string& text, int x, int y, float r, float g, float b) {
-    glDisable(GL_LIGHTING);
-    glColor3f(r, g, b);
-    
-    // Simple bitmap text rendering
-    glRasterPos2i(x, y + 12);
-    
+Batch2D::Range Renderer::renderText(Batch2D& batch, const std::string& text, int x, int y, const Color2D& color) {
     // Draw background rectangle for readability
-    int textWidth = text.length() * 8;
-    glColor4f(0.0f, 0.0f, 0.0f, 0.3f);
-    glBegin(GL_QUADS);
-    glVertex2f(x - 2, y);
-    glVertex2f(x + textWidth + 2, y);
-    glVertex2f(x + textWidth + 2, y + 16);
-    glVertex2f(x - 2, y + 16);
-    glEnd();
-    
-    // Text color
-    glColor3f(r, g, b);
-    for (char c : text) {
-        // Simple character rendering - would use proper font in production
-    }
+    int textWidth = textRenderer->measure(text);
+    batch.addQuad(x - 2, y, x + textWidth + 2, y + TextRenderer::GLYPH_HEIGHT, Color2D{0.0f, 0.0f, 0.0f, 0.3f});
+    
+    return textRenderer->addText(batch, text, x, y, color);
 }
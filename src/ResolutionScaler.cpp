@@ -0,0 +1,82 @@
+#include "ResolutionScaler.h"
+#include <algorithm>
+
+namespace {
+    // Vsync holds an on-budget frame at the budget, so anything clearly
+    // above it is a missed swap
+    const float OVER_BUDGET = 1.15f;
+    const float UNDER_BUDGET = 1.05f;
+    const float SMOOTHING = 0.1f;
+    // A lone hitch, like a level load, shouldn't cost a step by itself
+    const float MAX_SAMPLE = 2.0f;
+
+    const int DROP_FRAMES = 6;
+    const int RAISE_FRAMES = 120;
+    const int MAX_RAISE_FRAMES = 1920;
+    // Lets the smoothed time catch up with a new scale before judging it
+    const int COOLDOWN_FRAMES = 20;
+}
+
+constexpr float ResolutionScaler::MIN_SCALE;
+constexpr float ResolutionScaler::MAX_SCALE;
+constexpr float ResolutionScaler::STEP;
+
+ResolutionScaler::ResolutionScaler(float targetMs)
+    : targetMs(targetMs), smoothedMs(targetMs), scale(MAX_SCALE), enabled(true),
+      overFrames(0), underFrames(0), cooldown(0), raiseDelay(RAISE_FRAMES), justRaised(false) {
+}
+
+void ResolutionScaler::setEnabled(bool enable) {
+    enabled = enable;
+    if (!enabled) {
+        changeScale(MAX_SCALE);
+    }
+}
+
+void ResolutionScaler::setScale(float value) {
+    changeScale(std::min(std::max(value, MIN_SCALE), MAX_SCALE));
+}
+
+void ResolutionScaler::changeScale(float value) {
+    scale = value;
+    overFrames = underFrames = 0;
+    cooldown = COOLDOWN_FRAMES;
+}
+
+void ResolutionScaler::update(float frameMs) {
+    frameMs = std::min(frameMs, targetMs * MAX_SAMPLE);
+    smoothedMs += (frameMs - smoothedMs) * SMOOTHING;
+    if (!enabled) return;
+
+    if (cooldown > 0) {
+        cooldown--;
+        return;
+    }
+
+    if (smoothedMs > targetMs * OVER_BUDGET) {
+        underFrames = 0;
+        if (++overFrames < DROP_FRAMES || scale <= MIN_SCALE) return;
+
+        // The last climb didn't hold, so the next one waits longer
+        if (justRaised) {
+            raiseDelay = std::min(raiseDelay * 2, MAX_RAISE_FRAMES);
+            justRaised = false;
+        }
+        changeScale(std::max(scale - STEP, MIN_SCALE));
+    } else if (smoothedMs < targetMs * UNDER_BUDGET) {
+        overFrames = 0;
+        underFrames = std::min(underFrames + 1, MAX_RAISE_FRAMES);
+
+        // A climb that has held this long has earned the short delay back
+        if (justRaised && underFrames >= RAISE_FRAMES) {
+            justRaised = false;
+            raiseDelay = RAISE_FRAMES;
+        }
+        if (underFrames < raiseDelay || scale >= MAX_SCALE) return;
+
+        changeScale(std::min(scale + STEP, MAX_SCALE));
+        justRaised = true;
+    } else {
+        overFrames = underFrames = 0;
+    }
+}
@@ -0,0 +1,456 @@
+#include "ShaderLibrary.h"
+#include "GLExtensions.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+    const uint32_t BINARY_MAGIC = 0x4253484D; // "MHSB"
+    const uint64_t FNV_OFFSET = 14695981039346656037ull;
+    const uint64_t FNV_PRIME = 1099511628211ull;
+
+    struct FeatureDefine {
+        uint32_t feature;
+        const char* name;
+    };
+
+    const FeatureDefine DEFINES[SHADER_FEATURE_COUNT] = {
+        {SHADER_FOG, "FOG"},
+        {SHADER_LIT, "LIT"},
+        {SHADER_LIGHTMAP, "LIGHTMAP"},
+        {SHADER_FLOOR_TEXTURE, "FLOOR_TEXTURE"},
+        {SHADER_INSTANCED, "INSTANCED"},
+        {SHADER_ANIMATED, "ANIMATED"},
+        {SHADER_BILLBOARD, "BILLBOARD"}
+    };
+
+    struct AttributeName {
+        GLuint slot;
+        const char* name;
+    };
+
+    const AttributeName ATTRIBUTES[] = {
+        {SHADER_ATTRIB_POSITION, "a_position"},
+        {SHADER_ATTRIB_NORMAL, "a_normal"},
+        {SHADER_ATTRIB_OFFSET, "i_offset"},
+        {SHADER_ATTRIB_SCALE, "i_scale"},
+        {SHADER_ATTRIB_COLOR, "i_color"},
+        {SHADER_ATTRIB_PHASE, "i_phase"}
+    };
+
+    // Non-instanced permutations read the built-in arrays, so the same
+    // client-side or buffer pointers work with or without a program. Lights
+    // and fog come from the fixed-function state the backend already sets.
+    const char* VERTEX_SOURCE =
+        "#ifdef INSTANCED\n"
+        "attribute vec3 a_position;\n"
+        "attribute vec3 a_normal;\n"
+        "attribute vec3 i_offset;\n"
+        "attribute vec3 i_scale;\n"
+        "attribute vec4 i_color;\n"
+        "attribute float i_phase;\n"
+        "uniform float u_time;\n"
+        "#endif\n"
+        "#if defined(LIGHTMAP) || defined(FLOOR_TEXTURE)\n"
+        "varying vec2 v_texCoord;\n"
+        "#endif\n"
+        "#ifdef BILLBOARD\n"
+        "varying vec2 v_corner;\n"
+        "#endif\n"
+        "#ifdef FOG\n"
+        "varying float v_fogDepth;\n"
+        "#endif\n"
+        "#ifdef LIT\n"
+        "uniform float u_lights;\n"
+        "vec3 lightSum(vec3 eye, vec3 n) {\n"
+        "    vec3 light = gl_LightModel.ambient.rgb;\n"
+        "    for (int i = 0; i < 8; i++) {\n"
+        "        if (float(i) >= u_lights) break;\n"
+        "        vec3 d = gl_LightSource[i].position.xyz - eye;\n"
+        "        float dist = length(d);\n"
+        "        vec3 l = d / dist;\n"
+        "        float att = 1.0 / (gl_LightSource[i].constantAttenuation +\n"
+        "                           gl_LightSource[i].linearAttenuation * dist +\n"
+        "                           gl_LightSource[i].quadraticAttenuation * dist * dist);\n"
+        "        if (gl_LightSource[i].spotCutoff <= 90.0) {\n"
+        "            float spot = dot(-l, normalize(gl_LightSource[i].spotDirection));\n"
+        "            att *= spot < gl_LightSource[i].spotCosCutoff ? 0.0 : pow(spot, gl_LightSource[i].spotExponent);\n"
+        "        }\n"
+        "        light += att * (gl_LightSource[i].ambient.rgb +\n"
+        "                        gl_LightSource[i].diffuse.rgb * max(dot(n, l), 0.0));\n"
+        "    }\n"
+        "    return light;\n"
+        "}\n"
+        "#endif\n"
+        "void main() {\n"
+        "#ifdef INSTANCED\n"
+        "#ifdef ANIMATED\n"
+        "    float pulse = sin(u_time + i_phase);\n"
+        "    vec3 scale = i_scale * (1.0 + 0.15 * pulse);\n"
+        "    vec4 color = vec4(i_color.rgb * (0.8 + 0.2 * pulse), i_color.a);\n"
+        "#else\n"
+        "    vec3 scale = i_scale;\n"
+        "    vec4 color = i_color;\n"
+        "#endif\n"
+        "    vec4 position = vec4(a_position * scale + i_offset, 1.0);\n"
+        "    vec3 normal = a_normal / scale;\n"
+        "#else\n"
+        "    vec4 position = gl_Vertex;\n"
+        "    vec3 normal = gl_Normal;\n"
+        "    vec4 color = gl_Color;\n"
+        "#endif\n"
+        "    vec4 eye = gl_ModelViewMatrix * position;\n"
+        "#ifdef BILLBOARD\n"
+        // Corners spread in view space, so the quad always faces the camera; the size is one float
+        "    eye = gl_ModelViewMatrix * vec4(i_offset, 1.0) + vec4(a_position.xy * scale.x, 0.0, 0.0);\n"
+        "    v_corner = a_position.xy * 2.0;\n"
+        "#endif\n"
+        "#ifdef LIT\n"
+        "    vec3 n = normalize(gl_NormalMatrix * normal);\n"
+        "    gl_FrontColor = vec4(min(color.rgb * lightSum(eye.xyz, n), 1.0), color.a);\n"
+        // Walls are seen from inside, so the back needs its own light; meshes are closed
+        "#ifdef INSTANCED\n"
+        "    gl_BackColor = gl_FrontColor;\n"
+        "#else\n"
+        "    gl_BackColor = vec4(min(color.rgb * lightSum(eye.xyz, -n), 1.0), color.a);\n"
+        "#endif\n"
+        "#else\n"
+        "    gl_FrontColor = color;\n"
+        "    gl_BackColor = color;\n"
+        "#endif\n"
+        "#ifdef LIGHTMAP\n"
+        "    v_texCoord = (gl_TextureMatrix[0] * gl_MultiTexCoord0).xy;\n"
+        "#endif\n"
+        "#ifdef FLOOR_TEXTURE\n"
+        "    v_texCoord = vec2(dot(position, gl_ObjectPlaneS[0]), dot(position, gl_ObjectPlaneT[0]));\n"
+        "#endif\n"
+        "#ifdef FOG\n"
+        "    v_fogDepth = -eye.z;\n"
+        "#endif\n"
+        "    gl_Position = gl_ProjectionMatrix * eye;\n"
+        "}\n";
+
+    const char* FRAGMENT_SOURCE =
+        "#if defined(LIGHTMAP) || defined(FLOOR_TEXTURE)\n"
+        "uniform sampler2D u_texture;\n"
+        "varying vec2 v_texCoord;\n"
+        "#endif\n"
+        "#ifdef BILLBOARD\n"
+        "varying vec2 v_corner;\n"
+        "#endif\n"
+        "#ifdef FOG\n"
+        "varying float v_fogDepth;\n"
+        "#endif\n"
+        "void main() {\n"
+        "    vec4 color = gl_Color;\n"
+        "#ifdef BILLBOARD\n"
+        "    color.a *= clamp(1.0 - dot(v_corner, v_corner), 0.0, 1.0);\n"
+        "#endif\n"
+        "#ifdef LIGHTMAP\n"
+        "    color.rgb = min(color.rgb + texture2D(u_texture, v_texCoord).rgb, 1.0);\n"
+        "#endif\n"
+        "#ifdef FLOOR_TEXTURE\n"
+        "    color.rgb *= texture2D(u_texture, v_texCoord).rgb;\n"
+        "#endif\n"
+        "#ifdef FOG\n"
+        "    float density = gl_Fog.density * v_fogDepth;\n"
+        "    color.rgb = mix(gl_Fog.color.rgb, color.rgb, clamp(exp(-density * density), 0.0, 1.0));\n"
+        "#endif\n"
+        "    gl_FragColor = color;\n"
+        "}\n";
+
+    std::string buildSource(uint32_t features, const char* body) {
+        std::string source = "#version 120\n";
+        for (const auto& define : DEFINES) {
+            if (features & define.feature) {
+                source += std::string("#define ") + define.name + "\n";
+            }
+        }
+        return source + body;
+    }
+
+    uint64_t hashString(uint64_t hash, const std::string& text) {
+        for (unsigned char c : text) {
+            hash = (hash ^ c) * FNV_PRIME;
+        }
+        return hash;
+    }
+
+    std::string toHex(uint64_t value) {
+        char text[17];
+        snprintf(text, sizeof(text), "%016llx", (unsigned long long)value);
+        return text;
+    }
+
+    std::string glString(GLenum name) {
+        const GLubyte* text = glGetString(name);
+        return text ? reinterpret_cast<const char*>(text) : "";
+    }
+
+    // Header, then the driver's bytes as they came
+    bool readBinary(const std::string& path, GLenum& format, std::vector<uint8_t>& binary) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) return false;
+
+        uint32_t header[3] = {0, 0, 0};
+        bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == BINARY_MAGIC && header[2] > 0;
+        if (ok) {
+            binary.resize(header[2]);
+            ok = fread(binary.data(), binary.size(), 1, file) == 1;
+        }
+        fclose(file);
+
+        if (!ok) {
+            binary.clear();
+            return false;
+        }
+        format = header[1];
+        return true;
+    }
+
+    bool writeBinary(const std::string& path, GLenum format, const std::vector<uint8_t>& binary) {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file) return false;
+
+        const uint32_t header[3] = {BINARY_MAGIC, (uint32_t)format, (uint32_t)binary.size()};
+        bool ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+                  fwrite(binary.data(), binary.size(), 1, file) == 1;
+        ok = fclose(file) == 0 && ok;
+        if (!ok) {
+            remove(path.c_str());
+        }
+        return ok;
+    }
+
+    GLuint startShader(GLenum type, const std::string& source) {
+        const GLExtensions& gl = getGL();
+        const char* text = source.c_str();
+        GLuint shader = gl.createShader(type);
+        gl.shaderSource(shader, 1, &text, nullptr);
+        gl.compileShader(shader);
+        return shader;
+    }
+
+    void reportShader(GLuint shader, const char* stage, uint32_t features) {
+        const GLExtensions& gl = getGL();
+        GLint status = 0;
+        gl.getShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if (status) return;
+
+        char log[1024];
+        gl.getShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cerr << "Shader permutation " << features << " " << stage << " failed to compile: " << log << std::endl;
+    }
+}
+
+ShaderLibrary::ShaderLibrary()
+    : programs{}, baseFeatures(0), boundProgram(0), boundFeatures(0), lightCount(1), time(0.0f),
+      programCount(0), cachedCount(0), programBinds(0) {
+}
+
+void ShaderLibrary::initialize(const std::vector<uint32_t>& permutations, bool fog, const std::string& cacheDirectory) {
+    release();
+
+    const GLExtensions& gl = getGL();
+    if (!gl.shaders) {
+        std::cout << "Shaders unavailable, drawing with fixed function" << std::endl;
+        return;
+    }
+    baseFeatures = fog ? SHADER_FOG : 0;
+
+    std::vector<Build> builds;
+    for (uint32_t features : permutations) {
+        features |= baseFeatures;
+        auto same = [features](const Build& build) { return build.features == features; };
+        if (std::none_of(builds.begin(), builds.end(), same)) {
+            Build build{};
+            build.features = features;
+            builds.push_back(build);
+        }
+    }
+
+    // Anything that changes what the driver would make of the source
+    // changes the key, so an update never loads a stale binary
+    bool useCache = gl.programBinaries && !cacheDirectory.empty();
+    std::string driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION) + "\n";
+
+    // Sources, keys and cache reads need no context
+    getJobSystem().parallelFor((int)builds.size(), [&](int i) {
+        Build& build = builds[i];
+        build.vertexSource = buildSource(build.features, VERTEX_SOURCE);
+        build.fragmentSource = buildSource(build.features, FRAGMENT_SOURCE);
+        if (!useCache) return;
+
+        uint64_t key = hashString(hashString(hashString(FNV_OFFSET, driver), build.vertexSource), build.fragmentSource);
+        build.cachePath = cacheDirectory + toHex(key) + ".bin";
+        readBinary(build.cachePath, build.binaryFormat, build.binary);
+    });
+
+    for (Build& build : builds) {
+        build.cached = !build.binary.empty() && loadBinary(build);
+    }
+
+    // Queue every compile and link before asking after any of them
+    if (gl.parallelCompile) {
+        gl.maxShaderCompilerThreads(0xFFFFFFFFu);
+    }
+    for (Build& build : builds) {
+        if (!build.cached) compile(build);
+    }
+
+    std::vector<Build*> fresh;
+    for (Build& build : builds) {
+        if (build.cached) {
+            setupProgram(build.features, build.program);
+            cachedCount++;
+        } else if (finishCompile(build)) {
+            setupProgram(build.features, build.program);
+            if (useCache) {
+                saveBinary(build);
+                fresh.push_back(&build);
+            }
+        }
+    }
+
+    getJobSystem().parallelFor((int)fresh.size(), [&](int i) {
+        Build& build = *fresh[i];
+        if (!build.binary.empty() && !writeBinary(build.cachePath, build.binaryFormat, build.binary)) {
+            std::cerr << "Couldn't write shader cache " << build.cachePath << std::endl;
+        }
+    });
+
+    std::cout << "Shaders: " << programCount << " of " << builds.size() << " permutations ready, "
+              << cachedCount << " from the cache" << std::endl;
+}
+
+bool ShaderLibrary::loadBinary(Build& build) {
+    const GLExtensions& gl = getGL();
+    build.program = gl.createProgram();
+    gl.programBinary(build.program, build.binaryFormat, build.binary.data(), (GLsizei)build.binary.size());
+
+    // Drivers may turn down their own binaries after an update; build from source
+    GLint status = 0;
+    gl.getProgramiv(build.program, GL_LINK_STATUS, &status);
+    build.binary.clear();
+    if (!status) {
+        gl.deleteProgram(build.program);
+        build.program = 0;
+        return false;
+    }
+    return true;
+}
+
+void ShaderLibrary::compile(Build& build) {
+    const GLExtensions& gl = getGL();
+    build.vertexShader = startShader(GL_VERTEX_SHADER, build.vertexSource);
+    build.fragmentShader = startShader(GL_FRAGMENT_SHADER, build.fragmentSource);
+
+    build.program = gl.createProgram();
+    gl.attachShader(build.program, build.vertexShader);
+    gl.attachShader(build.program, build.fragmentShader);
+    for (const auto& attribute : ATTRIBUTES) {
+        gl.bindAttribLocation(build.program, attribute.slot, attribute.name);
+    }
+    if (gl.programBinaries) {
+        gl.programParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    gl.linkProgram(build.program);
+}
+
+bool ShaderLibrary::finishCompile(Build& build) {
+    const GLExtensions& gl = getGL();
+
+    GLint status = 0;
+    gl.getProgramiv(build.program, GL_LINK_STATUS, &status);
+    if (!status) {
+        reportShader(build.vertexShader, "vertex", build.features);
+        reportShader(build.fragmentShader, "fragment", build.features);
+        char log[1024];
+        gl.getProgramInfoLog(build.program, sizeof(log), nullptr, log);
+        std::cerr << "Shader permutation " << build.features << " failed to link: " << log << std::endl;
+        gl.deleteProgram(build.program);
+        build.program = 0;
+    }
+
+    // The program keeps them alive while it needs them
+    gl.deleteShader(build.vertexShader);
+    gl.deleteShader(build.fragmentShader);
+    build.vertexShader = build.fragmentShader = 0;
+    return status != 0;
+}
+
+void ShaderLibrary::saveBinary(Build& build) {
+    const GLExtensions& gl = getGL();
+
+    GLint length = 0;
+    gl.getProgramiv(build.program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    build.binary.resize(length);
+    gl.getProgramBinary(build.program, length, nullptr, &build.binaryFormat, build.binary.data());
+}
+
+void ShaderLibrary::setupProgram(uint32_t features, GLuint id) {
+    const GLExtensions& gl = getGL();
+    Program& program = programs[features];
+    program.id = id;
+    program.lightsUniform = gl.getUniformLocation(id, "u_lights");
+    program.timeUniform = gl.getUniformLocation(id, "u_time");
+    program.lights = -1.0f;
+    program.time = -1.0f;
+    programCount++;
+}
+
+void ShaderLibrary::release() {
+    const GLExtensions& gl = getGL();
+    unbind();
+    for (auto& program : programs) {
+        if (program.id) {
+            gl.deleteProgram(program.id);
+        }
+        program = Program{};
+    }
+    programCount = 0;
+    cachedCount = 0;
+}
+
+bool ShaderLibrary::has(uint32_t features) const {
+    return programs[features | baseFeatures].id != 0;
+}
+
+bool ShaderLibrary::bind(uint32_t features) {
+    const GLExtensions& gl = getGL();
+    features |= baseFeatures;
+    Program& program = programs[features];
+    if (!program.id) {
+        unbind();
+        return false;
+    }
+
+    if (program.id != boundProgram) {
+        gl.useProgram(program.id);
+        boundProgram = program.id;
+        boundFeatures = features;
+        programBinds++;
+    }
+
+    // Each program keeps its own uniforms, so only changes since it was last bound go out
+    float lights = (float)lightCount;
+    if (program.lightsUniform >= 0 && program.lights != lights) {
+        gl.uniform1f(program.lightsUniform, lights);
+        program.lights = lights;
+    }
+    if (program.timeUniform >= 0 && program.time != time) {
+        gl.uniform1f(program.timeUniform, time);
+        program.time = time;
+    }
+    return true;
+}
+
+void ShaderLibrary::unbind() {
+    if (!boundProgram) return;
+    getGL().useProgram(0);
+    boundProgram = 0;
+    boundFeatures = 0;
+}
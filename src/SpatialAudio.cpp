@@ -0,0 +1,252 @@
+#include "SpatialAudio.h"
+#include "AudioMixer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Full volume inside this, then falling off as 1/distance
+    const float REFERENCE_DISTANCE = 1.5f;
+    const float ROLLOFF = 1.0f;
+    // Past the fog nothing is heard; the last fifth fades out so sources
+    // don't pop at the edge
+    const float MAX_DISTANCE = 30.0f;
+    const float EDGE_FADE = MAX_DISTANCE * 0.2f;
+    // Sources straight behind are this much quieter, a cheap head shadow
+    const float REAR_DAMPING = 0.3f;
+    // Quieter than this isn't worth a voice
+    const float AUDIBLE_THRESHOLD = 0.002f;
+    // A source that already has a voice keeps it until another is clearly
+    // louder, so two similar sources don't trade it back and forth
+    const float REAL_BONUS = 1.25f;
+
+    // Exaggerated doppler: at real scale the monster's 6 m/s bends the pitch
+    // by under a third of a semitone
+    const float SPEED_OF_SOUND = 343.0f;
+    const float DOPPLER_FACTOR = 4.0f;
+    const float MAX_DOPPLER_SPEED = SPEED_OF_SOUND / DOPPLER_FACTOR * 0.5f;
+
+    const uint32_t SLOT_MASK = 0xFFFF;
+}
+
+SpatialAudio::SpatialAudio(AudioMixer& mixer)
+    : mixer(mixer), generation(0), emitterCount(0), realCount(0),
+      listenerRight(1.0f, 0.0f, 0.0f), listenerForward(0.0f, 0.0f, -1.0f) {
+}
+
+SpatialAudio::~SpatialAudio() {
+    clear();
+}
+
+void SpatialAudio::setListener(const Vector3& position, float yaw, const Vector3& velocity) {
+    // Where the camera looks: -Z turned by yaw, as glRotatef(-yaw) in the
+    // render backend has it. Right matches Player::getRight.
+    float yawRad = yaw * (float)M_PI / 180.0f;
+    listenerPosition = position;
+    listenerForward = Vector3(-std::sin(yawRad), 0.0f, -std::cos(yawRad));
+    listenerRight = Vector3(std::cos(yawRad), 0.0f, -std::sin(yawRad));
+    listenerVelocity = velocity;
+}
+
+uint32_t SpatialAudio::allocate() {
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = (uint32_t)emitters.size();
+        emitters.push_back(Emitter());
+    }
+
+    // The generation in the top bits makes stale ids miss a reused slot
+    generation = (generation + 1) & SLOT_MASK;
+    if (generation == 0) generation = 1;
+    emitters[slot].id = (generation << 16) | slot;
+    emitterCount++;
+    return slot;
+}
+
+void SpatialAudio::release(Emitter& emitter) {
+    freeSlots.push_back(emitter.id & SLOT_MASK);
+    emitter.id = 0;
+    emitter.voice = 0;
+    emitterCount--;
+}
+
+SpatialAudio::Emitter* SpatialAudio::find(uint32_t id) {
+    uint32_t slot = id & SLOT_MASK;
+    if (id == 0 || slot >= emitters.size() || emitters[slot].id != id) return nullptr;
+    return &emitters[slot];
+}
+
+uint32_t SpatialAudio::addEmitter(int sound, const Vector3& position, float gain, AudioPriority priority, bool doppler) {
+    float duration = mixer.getSoundSeconds(sound);
+    if (duration <= 0.0f) return 0;
+
+    // Slots have to fit below the generation
+    if (freeSlots.empty() && emitters.size() > SLOT_MASK) return 0;
+
+    uint32_t slot = allocate();
+    Emitter& emitter = emitters[slot];
+    emitter.sound = sound;
+    emitter.position = position;
+    emitter.velocity = Vector3(0.0f, 0.0f, 0.0f);
+    emitter.gain = gain;
+    emitter.priority = priority;
+    emitter.loop = true;
+    emitter.doppler = doppler;
+    emitter.time = 0.0f;
+    emitter.duration = duration;
+    emitter.audible = 0.0f;
+    emitter.pan = 0.0f;
+    emitter.pitch = 1.0f;
+    emitter.voice = 0;
+    return emitter.id;
+}
+
+float SpatialAudio::getAudibleGain(uint32_t id) const {
+    uint32_t slot = id & SLOT_MASK;
+    if (id == 0 || slot >= emitters.size() || emitters[slot].id != id) return 0.0f;
+    return emitters[slot].audible;
+}
+
+void SpatialAudio::moveEmitter(uint32_t id, const Vector3& position, const Vector3& velocity) {
+    if (Emitter* emitter = find(id)) {
+        emitter->position = position;
+        emitter->velocity = velocity;
+    }
+}
+
+void SpatialAudio::removeEmitter(uint32_t id) {
+    if (Emitter* emitter = find(id)) {
+        mixer.stopVoice(emitter->voice);
+        release(*emitter);
+    }
+}
+
+void SpatialAudio::playOneShot(int sound, const Vector3& position, float gain, AudioPriority priority) {
+    uint32_t id = addEmitter(sound, position, gain, priority, false);
+    if (Emitter* emitter = find(id)) emitter->loop = false;
+}
+
+void SpatialAudio::pause() {
+    for (Emitter& emitter : emitters) {
+        if (emitter.id == 0) continue;
+        mixer.stopVoice(emitter.voice);
+        emitter.voice = 0;
+    }
+    realCount = 0;
+}
+
+void SpatialAudio::clear() {
+    for (Emitter& emitter : emitters) {
+        if (emitter.id != 0) mixer.stopVoice(emitter.voice);
+    }
+    emitters.clear();
+    freeSlots.clear();
+    ranked.clear();
+    emitterCount = 0;
+    realCount = 0;
+}
+
+void SpatialAudio::spatialize(Emitter& emitter) const {
+    Vector3 toSource = emitter.position - listenerPosition;
+    float distance = toSource.length();
+
+    float attenuation = 0.0f;
+    if (distance < MAX_DISTANCE) {
+        float clamped = std::max(distance, REFERENCE_DISTANCE);
+        attenuation = REFERENCE_DISTANCE / (REFERENCE_DISTANCE + ROLLOFF * (clamped - REFERENCE_DISTANCE));
+        attenuation *= std::min(1.0f, (MAX_DISTANCE - distance) / EDGE_FADE);
+    }
+
+    // Pan from where the source sits around the listener's head, easing to
+    // the centre when it's right on top of them
+    float side = toSource.dot(listenerRight);
+    float ahead = toSource.dot(listenerForward);
+    float planar = std::sqrt(side * side + ahead * ahead);
+    emitter.pan = 0.0f;
+    if (planar > 0.001f) {
+        emitter.pan = side / planar * std::min(1.0f, planar / REFERENCE_DISTANCE);
+        if (ahead < 0.0f) attenuation *= 1.0f - REAR_DAMPING * (-ahead / planar);
+    }
+    emitter.audible = emitter.gain * attenuation;
+
+    emitter.pitch = 1.0f;
+    if (emitter.doppler && distance > 0.01f) {
+        // Speeds along the line from source to listener: closing in raises
+        // the pitch, pulling away lowers it
+        Vector3 toListener = (listenerPosition - emitter.position) * (1.0f / distance);
+        float listenerSpeed = std::min(listenerVelocity.dot(toListener), MAX_DOPPLER_SPEED);
+        float sourceSpeed = std::min(emitter.velocity.dot(toListener), MAX_DOPPLER_SPEED);
+        emitter.pitch = (SPEED_OF_SOUND - DOPPLER_FACTOR * listenerSpeed) /
+                        (SPEED_OF_SOUND - DOPPLER_FACTOR * sourceSpeed);
+    }
+}
+
+void SpatialAudio::update(float deltaTime) {
+    ranked.clear();
+    for (uint32_t i = 0; i < emitters.size(); i++) {
+        Emitter& emitter = emitters[i];
+        if (emitter.id == 0) continue;
+
+        // The cursor moves whether or not the mixer is playing it, so a
+        // virtual emitter comes back where it would have been
+        emitter.time += deltaTime * emitter.pitch;
+        if (emitter.time >= emitter.duration) {
+            if (!emitter.loop) {
+                // Its voice, if it had one, has run out on the mixer too
+                release(emitter);
+                continue;
+            }
+            emitter.time = std::fmod(emitter.time, emitter.duration);
+        }
+
+        spatialize(emitter);
+        if (emitter.audible > AUDIBLE_THRESHOLD) ranked.push_back(i);
+    }
+
+    // Only the budget's worth at the front needs ordering
+    size_t realLimit = std::min(ranked.size(), (size_t)SPATIAL_VOICE_BUDGET);
+    if (ranked.size() > realLimit) {
+        auto louder = [this](uint32_t a, uint32_t b) {
+            const Emitter& first = emitters[a];
+            const Emitter& second = emitters[b];
+            if (first.priority != second.priority) return first.priority > second.priority;
+            float firstScore = first.audible * (first.voice ? REAL_BONUS : 1.0f);
+            float secondScore = second.audible * (second.voice ? REAL_BONUS : 1.0f);
+            return firstScore > secondScore;
+        };
+        std::nth_element(ranked.begin(), ranked.begin() + realLimit, ranked.end(), louder);
+    }
+
+    // Virtualize the losers first so their voices are free for the winners
+    for (size_t i = realLimit; i < ranked.size(); i++) {
+        Emitter& emitter = emitters[ranked[i]];
+        mixer.stopVoice(emitter.voice);
+        emitter.voice = 0;
+    }
+    for (Emitter& emitter : emitters) {
+        if (emitter.id != 0 && emitter.voice != 0 && emitter.audible <= AUDIBLE_THRESHOLD) {
+            mixer.stopVoice(emitter.voice);
+            emitter.voice = 0;
+        }
+    }
+
+    // Only voices the mixer says it has count as real. One that's gone
+    // without being stopped never got a slot, or ran out early, so it's
+    // asked for again from where the emitter is now; one still queued is
+    // left alone until the mixer gets to it.
+    int real = 0;
+    for (size_t i = 0; i < realLimit; i++) {
+        Emitter& emitter = emitters[ranked[i]];
+        VoiceState state = mixer.getVoiceState(emitter.voice);
+        if (state == VoiceState::GONE) {
+            emitter.voice = mixer.play(emitter.sound, emitter.audible, emitter.pan, emitter.pitch, emitter.loop,
+                                       AudioBus::SOUND, emitter.time);
+        } else {
+            mixer.setVoice(emitter.voice, emitter.audible, emitter.pan, emitter.pitch);
+            if (state == VoiceState::PLAYING) real++;
+        }
+    }
+    realCount = real;
+}
@@ -0,0 +1,264 @@
+#include "StaticGeometry.h"
+#include "GLExtensions.h"
+#include <cstddef>
+
+namespace {
+    const float TILE_SIZE = 5.0f;           // One checker square
+
+    const GLvoid* offsetPointer(const StaticVertex* base, size_t offset) {
+        return reinterpret_cast<const GLvoid*>(reinterpret_cast<const char*>(base) + offset);
+    }
+
+    const GLvoid* indexPointer(const uint32_t* base, uint32_t firstIndex) {
+        return reinterpret_cast<const GLvoid*>(base + firstIndex);
+    }
+}
+
+StaticGeometry::StaticGeometry()
+    : boundChunk(-1), checkerTexture(0), gpuBytes(0) {
+}
+
+void StaticGeometry::createCheckerTexture() {
+    // The two floor shades, one per 5 unit tile
+    const GLubyte texels[2 * 2 * 3] = {
+        31, 27, 23,   37, 32, 28,
+        37, 32, 28,   31, 27, 23
+    };
+
+    glGenTextures(1, &checkerTexture);
+    glBindTexture(GL_TEXTURE_2D, checkerTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 2, 2, 0, GL_RGB, GL_UNSIGNED_BYTE, texels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void StaticGeometry::bindVertices(const StaticVertex* base) {
+    GLsizei stride = sizeof(StaticVertex);
+    glVertexPointer(3, GL_FLOAT, stride, offsetPointer(base, offsetof(StaticVertex, position)));
+    glNormalPointer(GL_BYTE, stride, offsetPointer(base, offsetof(StaticVertex, normal)));
+    glColorPointer(4, GL_UNSIGNED_BYTE, stride, offsetPointer(base, offsetof(StaticVertex, color)));
+    glTexCoordPointer(2, GL_SHORT, stride, offsetPointer(base, offsetof(StaticVertex, lightmapUV)));
+}
+
+void StaticGeometry::bindLightmap(const ChunkBuffers& buffers, const ChunkPayload& payload) {
+    if (!buffers.lightmapTexture) {
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisable(GL_TEXTURE_2D);
+        return;
+    }
+
+    // Coordinates are whole texels, so the texture matrix scales them to 0-1
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, buffers.lightmapTexture);
+    glMatrixMode(GL_TEXTURE);
+    glLoadIdentity();
+    glScalef(1.0f / payload.lightmapWidth, 1.0f / payload.lightmapHeight, 1.0f);
+    glMatrixMode(GL_MODELVIEW);
+}
+
+void StaticGeometry::drawGround(int chunkIndex, const ChunkPayload& payload, uint32_t firstIndex, uint32_t indexCount) {
+    if (indexCount == 0) return;
+    if (!checkerTexture) {
+        createCheckerTexture();
+    }
+
+    const GLExtensions& gl = getGL();
+
+    // Checker squares come from world position, so the cells can be any size
+    const float planeS[4] = {1.0f / (2.0f * TILE_SIZE), 0.0f, 0.0f, 0.0f};
+    const float planeT[4] = {0.0f, 0.0f, 1.0f / (2.0f * TILE_SIZE), 0.0f};
+    glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+    glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+    glTexGenfv(GL_S, GL_OBJECT_PLANE, planeS);
+    glTexGenfv(GL_T, GL_OBJECT_PLANE, planeT);
+    glEnable(GL_TEXTURE_GEN_S);
+    glEnable(GL_TEXTURE_GEN_T);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, checkerTexture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    // The floor shares its chunk's buffers with the walls
+    bindChunk(chunkIndex, payload);
+    const uint32_t* indices = gl.vertexBuffers ? nullptr : payload.indices.data();
+    glDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, indexPointer(indices, firstIndex));
+    if (gl.vertexBuffers) {
+        gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_TEXTURE_GEN_S);
+    glDisable(GL_TEXTURE_GEN_T);
+}
+
+void StaticGeometry::upload(int chunkIndex, const ChunkPayload& payload) {
+    const GLExtensions& gl = getGL();
+    ChunkBuffers& buffers = chunkBuffers[chunkIndex];
+
+    if (buffers.generation == 0) {
+        uploadedChunks.push_back(chunkIndex);
+    }
+    gpuBytes -= buffers.bytes;
+    buffers.bytes = 0;
+
+    if (gl.vertexBuffers) {
+        if (!buffers.vertexBuffer) {
+            gl.genBuffers(1, &buffers.vertexBuffer);
+            gl.genBuffers(1, &buffers.indexBuffer);
+        }
+
+        gl.bindBuffer(GL_ARRAY_BUFFER, buffers.vertexBuffer);
+        gl.bufferData(GL_ARRAY_BUFFER, payload.vertices.size() * sizeof(StaticVertex), payload.vertices.data(), GL_STATIC_DRAW);
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+        gl.bufferData(GL_ELEMENT_ARRAY_BUFFER, payload.indices.size() * sizeof(uint32_t), payload.indices.data(), GL_STATIC_DRAW);
+        buffers.bytes += payload.vertices.size() * sizeof(StaticVertex) + payload.indices.size() * sizeof(uint32_t);
+    }
+
+    if (payload.lightmap) {
+        if (!buffers.lightmapTexture) {
+            glGenTextures(1, &buffers.lightmapTexture);
+        }
+
+        // Charts are padded a texel all round, so filtering never reaches a neighbour
+        glBindTexture(GL_TEXTURE_2D, buffers.lightmapTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, payload.lightmapWidth, payload.lightmapHeight, 0, GL_RGB,
+                     GL_UNSIGNED_BYTE, payload.lightmap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        buffers.bytes += (size_t)payload.lightmapWidth * payload.lightmapHeight * 3;
+    } else if (buffers.lightmapTexture) {
+        glDeleteTextures(1, &buffers.lightmapTexture);
+        buffers.lightmapTexture = 0;
+    }
+
+    gpuBytes += buffers.bytes;
+    buffers.generation = payload.generation;
+}
+
+void StaticGeometry::releaseEvicted(const LevelStreamer& streamer) {
+    const auto& chunks = streamer.getChunks();
+    if (chunkBuffers.size() != chunks.size()) {
+        releaseChunks();
+        chunkBuffers.assign(chunks.size(), ChunkBuffers{0, 0, 0, 0, 0});
+    }
+
+    for (size_t i = 0; i < uploadedChunks.size();) {
+        int index = uploadedChunks[i];
+        if (chunks[index]->state.load() == ChunkState::LOADED) {
+            i++;
+            continue;
+        }
+
+        releaseChunk(chunkBuffers[index]);
+        uploadedChunks[i] = uploadedChunks.back();
+        uploadedChunks.pop_back();
+    }
+}
+
+void StaticGeometry::beginChunks() {
+    boundChunk = -1;
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    // Baked light goes on top of what the runtime lights give the surface
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_ADD);
+}
+
+StaticGeometry::ChunkBuffers& StaticGeometry::bindChunk(int chunkIndex, const ChunkPayload& payload) {
+    const GLExtensions& gl = getGL();
+    ChunkBuffers& buffers = chunkBuffers[chunkIndex];
+    if (buffers.generation != payload.generation) {
+        upload(chunkIndex, payload);
+    }
+
+    if (gl.vertexBuffers) {
+        gl.bindBuffer(GL_ARRAY_BUFFER, buffers.vertexBuffer);
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+        bindVertices(nullptr);
+    } else {
+        bindVertices(payload.vertices.data());
+    }
+    return buffers;
+}
+
+void StaticGeometry::drawChunkRange(int chunkIndex, const ChunkPayload& payload, uint32_t firstIndex, uint32_t indexCount) {
+    const GLExtensions& gl = getGL();
+
+    if (chunkIndex != boundChunk) {
+        bindLightmap(bindChunk(chunkIndex, payload), payload);
+        boundChunk = chunkIndex;
+    }
+
+    const uint32_t* indices = gl.vertexBuffers ? nullptr : payload.indices.data();
+    glDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, indexPointer(indices, firstIndex));
+}
+
+void StaticGeometry::endChunks() {
+    const GLExtensions& gl = getGL();
+    if (gl.vertexBuffers) {
+        gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    boundChunk = -1;
+
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+    glMatrixMode(GL_TEXTURE);
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+}
+
+void StaticGeometry::releaseChunk(ChunkBuffers& buffers) {
+    const GLExtensions& gl = getGL();
+    if (buffers.vertexBuffer) {
+        gl.deleteBuffers(1, &buffers.vertexBuffer);
+        gl.deleteBuffers(1, &buffers.indexBuffer);
+    }
+    if (buffers.lightmapTexture) {
+        glDeleteTextures(1, &buffers.lightmapTexture);
+    }
+    gpuBytes -= buffers.bytes;
+    buffers = ChunkBuffers{0, 0, 0, 0, 0};
+}
+
+void StaticGeometry::releaseChunks() {
+    for (int index : uploadedChunks) {
+        releaseChunk(chunkBuffers[index]);
+    }
+    uploadedChunks.clear();
+}
+
+void StaticGeometry::release() {
+    releaseChunks();
+
+    gpuBytes = 0;
+
+    if (checkerTexture) {
+        glDeleteTextures(1, &checkerTexture);
+        checkerTexture = 0;
+    }
+}
@@ -84,6 +84,29 @@ void TaskSystem::initialize() {
     tasks.push_back(task8);
 }
 
+void TaskSystem::loadFromLevel(const LevelFile& level) {
+    tasks.clear();
+    currentTaskIndex = 0;
+    completedTasks = 0;
+    
+    const LevelTask* levelTasks = level.getTasks();
+    for (uint32_t i = 0; i < level.getTaskCount(); i++) {
+        Task task;
+        task.id = levelTasks[i].id;
+        task.description = level.getString(levelTasks[i].descriptionOffset);
+        task.location = Vector3(levelTasks[i].location.x, levelTasks[i].location.y, levelTasks[i].location.z);
+        task.radius = levelTasks[i].radius;
+        task.completed = false;
+        tasks.push_back(task);
+    }
+}
+
+void TaskSystem::setTasks(const std::vector<Task>& newTasks) {
+    tasks = newTasks;
+    currentTaskIndex = 0;
+    completedTasks = 0;
+}
+
 void TaskSystem::update(const Vector3& playerPos) {
     // Update task states if needed
 }
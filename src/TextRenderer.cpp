@@ -0,0 +1,208 @@
+#include "TextRenderer.h"
+#include <cstdint>
+#include <vector>
+
+namespace {
+    const int FIRST_GLYPH = 32;
+    const int GLYPH_COUNT = 95;             // Printable ASCII
+    const int ATLAS_COLUMNS = 16;
+    const size_t MAX_CACHED_RUNS = 256;
+
+    // 8x16 cells rasterised from DejaVu Sans Mono Bold; one byte per row,
+    // bit 0 is the leftmost pixel
+    const uint8_t GLYPHS[GLYPH_COUNT][TextRenderer::GLYPH_HEIGHT] = {
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // space
+        {0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x10, 0x00, 0x18, 0x10, 0x00, 0x00},   // !
+        {0x00, 0x00, 0x00, 0x00, 0x64, 0x64, 0x64, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // quote
+        {0x00, 0x00, 0x00, 0x00, 0x58, 0x58, 0x78, 0xFE, 0x2C, 0x2C, 0x7F, 0x36, 0x16, 0x12, 0x00, 0x00},   // #
+        {0x00, 0x00, 0x00, 0x00, 0x10, 0x3C, 0x7E, 0x16, 0x1E, 0x7C, 0x70, 0x70, 0x7E, 0x18, 0x10, 0x00},   // $
+        {0x00, 0x00, 0x00, 0x00, 0x04, 0x0E, 0x1B, 0x0E, 0x74, 0x6C, 0xF0, 0x90, 0xF0, 0x60, 0x00, 0x00},   // %
+        {0x00, 0x00, 0x00, 0x00, 0x3C, 0x3C, 0x0C, 0x0C, 0x1E, 0xFE, 0xF3, 0x67, 0xFE, 0xDC, 0x00, 0x00},   // &
+        {0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // apostrophe
+        {0x00, 0x00, 0x00, 0x20, 0x30, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x30, 0x30, 0x00},   // (
+        {0x00, 0x00, 0x00, 0x08, 0x08, 0x18, 0x18, 0x30, 0x30, 0x30, 0x30, 0x18, 0x18, 0x18, 0x0C, 0x00},   // )
+        {0x00, 0x00, 0x00, 0x00, 0x18, 0x7E, 0x3C, 0x7C, 0x5A, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // *
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0xFE, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00},   // +
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x08},   // ,
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00},   // -
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x00, 0x00},   // .
+        {0x00, 0x00, 0x00, 0x00, 0x40, 0x60, 0x20, 0x30, 0x10, 0x18, 0x08, 0x0C, 0x0C, 0x06, 0x06, 0x00},   // /
+        {0x00, 0x00, 0x00, 0x00, 0x3C, 0x7E, 0x66, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x7C, 0x38, 0x00, 0x00},   // 0
+        {0x00, 0x00, 0x00, 0x00, 0x1C, 0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFE, 0x7C, 0x00, 0x00},   // 1
+        {0x00, 0x00, 0x00, 0x00, 0x3E, 0x76, 0x60, 0x60, 0x30, 0x38, 0x1C, 0x0E, 0x7E, 0x7E, 0x00, 0x00},   // 2
+        {0x00, 0x00, 0x00, 0x00, 0x3E, 0x7E, 0x60, 0x78, 0x38, 0x70, 0x60, 0x60, 0x7E, 0x3C, 0x00, 0x00},   // 3
+        {0x00, 0x00, 0x00, 0x00, 0x70, 0x78, 0x78, 0x6C, 0x66, 0x76, 0xFE, 0x70, 0x60, 0x20, 0x00, 0x00},   // 4
+        {0x00, 0x00, 0x00, 0x00, 0x7E, 0x3E, 0x06, 0x3E, 0x7E, 0x60, 0x60, 0x60, 0x7E, 0x1C, 0x00, 0x00},   // 5
+        {0x00, 0x00, 0x00, 0x00, 0x7C, 0x4C, 0x06, 0x3E, 0x7E, 0x66, 0x66, 0x66, 0x7C, 0x38, 0x00, 0x00},   // 6
+        {0x00, 0x00, 0x00, 0x00, 0x7E, 0x7E, 0x60, 0x30, 0x30, 0x38, 0x18, 0x18, 0x0C, 0x0C, 0x00, 0x00},   // 7
+        {0x00, 0x00, 0x00, 0x00, 0x3C, 0x6E, 0x66, 0x6C, 0x3C, 0x6E, 0x66, 0x66, 0x7E, 0x38, 0x00, 0x00},   // 8
+        {0x00, 0x00, 0x00, 0x00, 0x3C, 0x7E, 0x66, 0x66, 0x7E, 0x7C, 0x60, 0x60, 0x3E, 0x1C, 0x00, 0x00},   // 9
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x18, 0x18, 0x18, 0x00, 0x00},   // :
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x08},   // ;
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x78, 0x1E, 0x06, 0x3E, 0xF0, 0x00, 0x00, 0x00, 0x00},   // <
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFE, 0x7E, 0x00, 0xFE, 0x7E, 0x00, 0x00, 0x00, 0x00},   // =
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x1E, 0x78, 0xE0, 0x7C, 0x0E, 0x02, 0x00, 0x00, 0x00},   // >
+        {0x00, 0x00, 0x00, 0x00, 0x3C, 0x64, 0x60, 0x70, 0x38, 0x18, 0x18, 0x00, 0x18, 0x08, 0x00, 0x00},   // ?
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x46, 0xF2, 0xFB, 0xCB, 0xCB, 0xDB, 0xF2, 0x06, 0x7C, 0x78},   // @
+        {0x00, 0x00, 0x00, 0x00, 0x38, 0x38, 0x3C, 0x3C, 0x6C, 0x7E, 0x7E, 0x66, 0xC6, 0xC2, 0x00, 0x00},   // A
+        {0x00, 0x00, 0x00, 0x00, 0x3E, 0x7E, 0x66, 0x66, 0x3E, 0x66, 0xC6, 0xE6, 0x7E, 0x1E, 0x00, 0x00},   // B
+        {0x00, 0x00, 0x00, 0x00, 0x78, 0x7C, 0x0E, 0x06, 0x06, 0x06, 0x0E, 0x0C, 0x7C, 0x78, 0x00, 0x00},   // C
+        {0x00, 0x00, 0x00, 0x00, 0x3E, 0x7E, 0x66, 0xE6, 0xE6, 0xE6, 0x66, 0x76, 0x3E, 0x0E, 0x00, 0x00},   // D
+        {0x00, 0x00, 0x00, 0x00, 0x7E, 0x7E, 0x06, 0x0E, 0x7E, 0x7E, 0x06, 0x0E, 0x7E, 0x7C, 0x00, 0x00},   // E
+        {0x00, 0x00, 0x00, 0x00, 0x7E, 0x7E, 0x06, 0x0E, 0x7E, 0x7E, 0x06, 0x06, 0x06, 0x04, 0x00, 0x00},   // F
+        {0x00, 0x00, 0x00, 0x00, 0x7C, 0x7C, 0x0E, 0x06, 0x66, 0xF6, 0xE6, 0xCE, 0x7C, 0x38, 0x00, 0x00},   // G
+        {0x00, 0x00, 0x00, 0x00, 0x66, 0x66, 0x66, 0x66, 0x7E, 0x7E, 0x66, 0x66, 0x66, 0x46, 0x00, 0x00},   // H
+        {0x00, 0x00, 0x00, 0x00, 0x7E, 0x7E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7E, 0x7C, 0x00, 0x00},   // I
+        {0x00, 0x00, 0x00, 0x00, 0x7C, 0x78, 0x60, 0x60, 0x60, 0x60, 0x60, 0x72, 0x3E, 0x1C, 0x00, 0x00},   // J
+        {0x00, 0x00, 0x00, 0x00, 0xE6, 0x66, 0x36, 0x1E, 0x1E, 0x3E, 0x76, 0x66, 0xE6, 0xC6, 0x00, 0x00},   // K
+        {0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0xFC, 0x7C, 0x00, 0x00},   // L
+        {0x00, 0x00, 0x00, 0x00, 0xE6, 0xEE, 0xFE, 0xFE, 0xDE, 0xDE, 0xC6, 0xC6, 0xC6, 0x42, 0x00, 0x00},   // M
+        {0x00, 0x00, 0x00, 0x00, 0x46, 0x4E, 0x4E, 0x4E, 0x5E, 0x76, 0x76, 0x76, 0x66, 0x62, 0x00, 0x00},   // N
+        {0x00, 0x00, 0x00, 0x00, 0x3C, 0x7E, 0x66, 0xE6, 0xE6, 0xE6, 0x66, 0x66, 0x7C, 0x38, 0x00, 0x00},   // O
+        {0x00, 0x00, 0x00, 0x00, 0x3E, 0x7E, 0xE6, 0xE6, 0x7E, 0x3E, 0x06, 0x06, 0x06, 0x04, 0x00, 0x00},   // P
+        {0x00, 0x00, 0x00, 0x00, 0x3C, 0x7E, 0x66, 0xE6, 0xE6, 0xE6, 0x66, 0x66, 0x7C, 0x38, 0x60, 0x00},   // Q
+        {0x00, 0x00, 0x00, 0x00, 0x3E, 0x7E, 0x66, 0x66, 0x7E, 0x3E, 0x76, 0x66, 0xE6, 0xC6, 0x00, 0x00},   // R
+        {0x00, 0x00, 0x00, 0x00, 0x7C, 0x7E, 0x06, 0x1E, 0x3C, 0x70, 0x60, 0x62, 0x7E, 0x3C, 0x00, 0x00},   // S
+        {0x00, 0x00, 0x00, 0x00, 0xFE, 0x7E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x10, 0x00, 0x00},   // T
+        {0x00, 0x00, 0x00, 0x00, 0xE6, 0xE6, 0xE6, 0xE6, 0xE6, 0xE6, 0x66, 0x66, 0x7E, 0x3C, 0x00, 0x00},   // U
+        {0x00, 0x00, 0x00, 0x00, 0xC6, 0x66, 0x66, 0x66, 0x6C, 0x6C, 0x3C, 0x3C, 0x38, 0x18, 0x00, 0x00},   // V
+        {0x00, 0x00, 0x00, 0x00, 0xC3, 0xC3, 0xD3, 0xDA, 0xDA, 0xFE, 0x7E, 0x6E, 0x66, 0x64, 0x00, 0x00},   // W
+        {0x00, 0x00, 0x00, 0x00, 0xE6, 0x66, 0x3C, 0x3C, 0x18, 0x38, 0x3C, 0x6E, 0x66, 0x42, 0x00, 0x00},   // X
+        {0x00, 0x00, 0x00, 0x00, 0xC7, 0x66, 0x6E, 0x3C, 0x3C, 0x18, 0x18, 0x18, 0x18, 0x10, 0x00, 0x00},   // Y
+        {0x00, 0x00, 0x00, 0x00, 0xFE, 0xFE, 0x60, 0x30, 0x38, 0x18, 0x0C, 0x0E, 0xFE, 0x7E, 0x00, 0x00},   // Z
+        {0x00, 0x00, 0x00, 0x38, 0x38, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x38, 0x00},   // [
+        {0x00, 0x00, 0x00, 0x00, 0x06, 0x04, 0x0C, 0x0C, 0x18, 0x18, 0x10, 0x30, 0x20, 0x60, 0x40, 0x00},   // backslash
+        {0x00, 0x00, 0x00, 0x1C, 0x3C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x38, 0x3C, 0x00},   // ]
+        {0x00, 0x00, 0x00, 0x00, 0x18, 0x3C, 0x66, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // ^
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF},   // _
+        {0x00, 0x00, 0x00, 0x0C, 0x08, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // `
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x7E, 0x60, 0x7E, 0x66, 0x66, 0x7E, 0x5C, 0x00, 0x00},   // a
+        {0x00, 0x00, 0x00, 0x06, 0x06, 0x06, 0x36, 0x7E, 0x66, 0xE6, 0xE6, 0x66, 0x7E, 0x36, 0x00, 0x00},   // b
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x7C, 0x0E, 0x06, 0x06, 0x0E, 0x7C, 0x78, 0x00, 0x00},   // c
+        {0x00, 0x00, 0x00, 0x40, 0x60, 0x60, 0x7C, 0x7E, 0x66, 0x66, 0x66, 0x66, 0x7E, 0x5C, 0x00, 0x00},   // d
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x7E, 0x66, 0xFE, 0x7E, 0x06, 0x7E, 0x78, 0x00, 0x00},   // e
+        {0x00, 0x00, 0x00, 0x60, 0x78, 0x18, 0x7C, 0x7E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00},   // f
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5C, 0x7E, 0x66, 0x66, 0x66, 0x66, 0x7E, 0x68, 0x64, 0x3C},   // g
+        {0x00, 0x00, 0x00, 0x04, 0x06, 0x06, 0x36, 0x7E, 0x66, 0x66, 0x66, 0x66, 0x66, 0x64, 0x00, 0x00},   // h
+        {0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x1C, 0x1C, 0x18, 0x18, 0x18, 0x18, 0xFE, 0x7E, 0x00, 0x00},   // i
+        {0x00, 0x00, 0x00, 0x30, 0x30, 0x00, 0x1C, 0x3C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x38, 0x1E},   // j
+        {0x00, 0x00, 0x00, 0x04, 0x06, 0x06, 0x66, 0x76, 0x3E, 0x1E, 0x3E, 0x76, 0x66, 0x44, 0x00, 0x00},   // k
+        {0x00, 0x00, 0x00, 0x0E, 0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x78, 0x70, 0x00, 0x00},   // l
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6A, 0xFE, 0xDA, 0xDA, 0xDA, 0xDA, 0xDA, 0x52, 0x00, 0x00},   // m
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x34, 0x7E, 0x66, 0x66, 0x66, 0x66, 0x66, 0x64, 0x00, 0x00},   // n
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x7E, 0x66, 0xE6, 0xE6, 0x66, 0x7E, 0x38, 0x00, 0x00},   // o
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x36, 0x7E, 0x66, 0xE6, 0xE6, 0x66, 0x7E, 0x36, 0x06, 0x06},   // p
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5C, 0x7E, 0x66, 0x66, 0x66, 0x66, 0x7E, 0x7C, 0x60, 0x60},   // q
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6C, 0xFC, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x00, 0x00},   // r
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x7E, 0x06, 0x3C, 0x78, 0x60, 0x7E, 0x3C, 0x00, 0x00},   // s
+        {0x00, 0x00, 0x00, 0x00, 0x08, 0x18, 0x7E, 0x7E, 0x18, 0x18, 0x18, 0x18, 0x78, 0x70, 0x00, 0x00},   // t
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x64, 0x66, 0x66, 0x66, 0x66, 0x66, 0x7E, 0x6C, 0x00, 0x00},   // u
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x66, 0x66, 0x6C, 0x3C, 0x3C, 0x38, 0x18, 0x00, 0x00},   // v
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 0xC3, 0xDA, 0xDA, 0x7E, 0x7E, 0x6E, 0x64, 0x00, 0x00},   // w
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x66, 0x6E, 0x3C, 0x38, 0x38, 0x3C, 0x66, 0x46, 0x00, 0x00},   // x
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x66, 0x66, 0x6C, 0x3C, 0x38, 0x38, 0x18, 0x1C, 0x0E},   // y
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x7E, 0x70, 0x30, 0x18, 0x0C, 0x7E, 0x7C, 0x00, 0x00},   // z
+        {0x00, 0x00, 0x00, 0x60, 0x78, 0x18, 0x18, 0x18, 0x18, 0x0E, 0x18, 0x18, 0x18, 0x18, 0x78, 0x60},   // {
+        {0x00, 0x00, 0x00, 0x10, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18},   // |
+        {0x00, 0x00, 0x00, 0x0C, 0x1E, 0x18, 0x18, 0x18, 0x38, 0x70, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x0C},   // }
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0xFE, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00},   // ~
+    };
+}
+
+TextRenderer::TextRenderer() {
+}
+
+void TextRenderer::buildAtlas(std::vector<uint8_t>& texels) {
+    // Cell 0 is solid for untextured quads; glyph c sits in cell c - 31
+    texels.assign(ATLAS_SIZE * ATLAS_SIZE, 0);
+    for (int cell = 0; cell <= GLYPH_COUNT; cell++) {
+        int originX = (cell % ATLAS_COLUMNS) * GLYPH_WIDTH;
+        int originY = (cell / ATLAS_COLUMNS) * GLYPH_HEIGHT;
+
+        for (int row = 0; row < GLYPH_HEIGHT; row++) {
+            uint8_t bits = cell == 0 ? 0xFF : GLYPHS[cell - 1][row];
+            for (int column = 0; column < GLYPH_WIDTH; column++) {
+                if (bits & (1 << column)) {
+                    texels[(originY + row) * ATLAS_SIZE + originX + column] = 255;
+                }
+            }
+        }
+    }
+}
+
+void TextRenderer::clear() {
+    runs.clear();
+}
+
+const std::vector<TextRenderer::GlyphQuad>& TextRenderer::layout(const std::string& text, int scale) {
+    std::string key(1, (char)scale);
+    key += text;
+
+    auto found = runs.find(key);
+    if (found != runs.end()) {
+        return found->second;
+    }
+
+    // Layouts only change with the HUD or menu, so dropping the lot is rare
+    if (runs.size() >= MAX_CACHED_RUNS) {
+        runs.clear();
+    }
+
+    std::vector<GlyphQuad>& quads = runs[key];
+    layoutInto(text, scale, quads);
+    return quads;
+}
+
+void TextRenderer::layoutInto(const std::string& text, int scale, std::vector<GlyphQuad>& quads) const {
+    const float cellU = (float)GLYPH_WIDTH / ATLAS_SIZE;
+    const float cellV = (float)GLYPH_HEIGHT / ATLAS_SIZE;
+    float penX = 0.0f;
+    float penY = 0.0f;
+
+    for (char c : text) {
+        if (c == '\n') {
+            penX = 0.0f;
+            penY += GLYPH_HEIGHT * scale;
+            continue;
+        }
+
+        int glyph = (unsigned char)c - FIRST_GLYPH;
+        if (glyph < 0 || glyph >= GLYPH_COUNT) {
+            glyph = '?' - FIRST_GLYPH;
+        }
+
+        if (glyph != 0) {    // Spaces only advance
+            int cell = glyph + 1;
+            float u0 = (cell % ATLAS_COLUMNS) * cellU;
+            float v0 = (cell / ATLAS_COLUMNS) * cellV;
+            quads.push_back(GlyphQuad{
+                penX, penY, penX + GLYPH_WIDTH * scale, penY + GLYPH_HEIGHT * scale,
+                u0, v0, u0 + cellU, v0 + cellV
+            });
+        }
+        penX += GLYPH_WIDTH * scale;
+    }
+}
+
+Batch2D::Range TextRenderer::emit(Batch2D& batch, const std::vector<GlyphQuad>& quads, float x, float y,
+                                  const Color2D& color) const {
+    Batch2D::Range range = {(uint32_t)batch.getVertexCount(), 0};
+
+    for (const GlyphQuad& quad : quads) {
+        range.count += batch.addTexturedQuad(x + quad.x0, y + quad.y0, x + quad.x1, y + quad.y1,
+                                             quad.u0, quad.v0, quad.u1, quad.v1, color).count;
+    }
+    return range;
+}
+
+Batch2D::Range TextRenderer::addText(Batch2D& batch, const std::string& text, float x, float y,
+                                     const Color2D& color, int scale) {
+    return emit(batch, layout(text, scale), x, y, color);
+}
+
+Batch2D::Range TextRenderer::addDynamicText(Batch2D& batch, const std::string& text, float x, float y,
+                                            const Color2D& color, int scale) {
+    scratch.clear();
+    layoutInto(text, scale, scratch);
+    return emit(batch, scratch, x, y, color);
+}
@@ -1,14 +1,78 @@
 #include "Game.h"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl;
+    std::cout << "  --level <path>     Compiled level to load (default assets/levels/mansion.mhl)" << std::endl;
+    std::cout << "  --generate <rooms> Play a procedurally generated mansion with this many rooms" << std::endl;
+    std::cout << "  --seed <n>         Generator seed (default 1)" << std::endl;
+    std::cout << "  --floors <n>       Generator floor count (default 1)" << std::endl;
+    std::cout << "  --wings <n>        Generator wing count (default 4)" << std::endl;
+    std::cout << "  --lightmaps <path> Baked lighting from mansion_bake (default: beside the level)" << std::endl;
+    std::cout << "  --record-render <path>  Write every render backend call to a text log" << std::endl;
+    std::cout << "  --resolution-scale <auto|0.5-1>  3D render scale (default auto, follows frame time)" << std::endl;
+    std::cout << "  --capture <path>   Record the window to a Y4M video from the start (F10 toggles)" << std::endl;
+    std::cout << "  --audio <sdl|null> Audio output (default sdl; null mixes but stays silent)" << std::endl;
+}
+
+static bool parseArguments(int argc, char* argv[], LaunchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            return false;
+        }
+        if (!value) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        
+        if (strcmp(arg, "--level") == 0) {
+            options.levelPath = value;
+        } else if (strcmp(arg, "--generate") == 0) {
+            options.generateRooms = atoi(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--floors") == 0) {
+            options.floors = atoi(value);
+        } else if (strcmp(arg, "--wings") == 0) {
+            options.wings = atoi(value);
+        } else if (strcmp(arg, "--lightmaps") == 0) {
+            options.lightmapPath = value;
+        } else if (strcmp(arg, "--record-render") == 0) {
+            options.renderRecordPath = value;
+        } else if (strcmp(arg, "--resolution-scale") == 0) {
+            options.resolutionScale = strcmp(value, "auto") == 0 ? 0.0f : (float)atof(value);
+        } else if (strcmp(arg, "--capture") == 0) {
+            options.capturePath = value;
+        } else if (strcmp(arg, "--audio") == 0) {
+            options.audioDevice = value;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+        i++;
+    }
+    return true;
+}
+
 int main(int argc, char* argv[]) {
+    LaunchOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    
     std::cout << "==================================" << std::endl;
     std::cout << "  MANSION HORROR - 2003" << std::endl;
     std::cout << "  First Person Survival Horror" << std::endl;
     std::cout << "==================================" << std::endl;
     std::cout << std::endl;
     
-    Game game;
+    Game game(options);
     
     if (!game.initialize()) {
         std::cerr << "Failed to initialize game!" << std::endl;
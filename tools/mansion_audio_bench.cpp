@@ -0,0 +1,282 @@
+// mansion_audio_bench - times the audio mixer with no sound card: what a
+// command costs the game thread, and what a block costs the mixer thread
+// with every voice busy.
+//
+// Usage: mansion_audio_bench [--voices <n>] [--blocks <n>] [--monsters <n>]
+//
+// Mixing runs on this thread, so the numbers are the mixer's own work; the
+// checksum of everything mixed lets two builds be compared sample for sample.
+// --monsters swaps the fixed voices for a horde circling the listener, each
+// breathing and stepping through SpatialAudio, and times the spatial update
+// per frame as well; the mixer should cost no more than at the voice cap.
+// Either way it first checks that the head shadow faces the right way and
+// that a whole budget of voices can be swapped in one update.
+
+#include "AudioMixer.h"
+#include "SpatialAudio.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+    struct BenchOptions {
+        int voices = AUDIO_MAX_VOICES;
+        int blocks = 2000;
+        int monsters = 0;
+    };
+
+    bool parseArguments(int argc, char* argv[], BenchOptions& options) {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const char* arg = argv[i];
+            const char* value = argv[i + 1];
+
+            if (strcmp(arg, "--voices") == 0) {
+                options.voices = atoi(value);
+            } else if (strcmp(arg, "--blocks") == 0) {
+                options.blocks = atoi(value);
+            } else if (strcmp(arg, "--monsters") == 0) {
+                options.monsters = atoi(value);
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        return argc % 2 == 1 && options.blocks > 0 && options.voices >= 0;
+    }
+
+    // A second of a tone with some grit, at a rate the mixer has to convert
+    SoundData makeTone(float frequency, int sampleRate) {
+        SoundData sound;
+        sound.sampleRate = sampleRate;
+        sound.samples.resize(sampleRate);
+        uint32_t state = (uint32_t)frequency;
+        for (int i = 0; i < sampleRate; i++) {
+            state = state * 1664525u + 1013904223u;
+            float grit = (float)(state >> 8) / 8388608.0f - 1.0f;
+            sound.samples[i] = std::sin(6.2831853f * frequency * i / sampleRate) * 0.3f + grit * 0.05f;
+        }
+        return sound;
+    }
+
+    double elapsedNs(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // The head shadow is only for sources behind the camera: one straight
+    // ahead has to come out at least as loud as the same one behind. It has
+    // its own mixer so the timed runs and their checksums aren't touched.
+    bool checkHeadShadow() {
+        AudioMixer mixer;
+        mixer.addSound(makeTone(110.0f, AUDIO_SAMPLE_RATE));
+        SpatialAudio spatial(mixer);
+        float yaws[] = { 0.0f, 90.0f, 200.0f };
+        for (float yaw : yaws) {
+            float yawRad = yaw * (float)M_PI / 180.0f;
+            Vector3 forward(-std::sin(yawRad), 0.0f, -std::cos(yawRad));
+            spatial.setListener(Vector3(0.0f, 0.0f, 0.0f), yaw, Vector3(0.0f, 0.0f, 0.0f));
+            uint32_t ahead = spatial.addEmitter(0, forward * 5.0f, 1.0f, AudioPriority::NORMAL, false);
+            uint32_t behind = spatial.addEmitter(0, forward * -5.0f, 1.0f, AudioPriority::NORMAL, false);
+            spatial.update(0.0f);
+            float aheadGain = spatial.getAudibleGain(ahead);
+            float behindGain = spatial.getAudibleGain(behind);
+            spatial.clear();
+            if (aheadGain <= 0.0f || aheadGain < behindGain) {
+                std::cerr << "Head shadow check failed at yaw " << yaw << ": ahead " << aheadGain
+                          << ", behind " << behindGain << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Two clusters of a full budget each, far enough apart that only one is
+    // heard: jumping from one to the other swaps every real voice in a
+    // single update, and all of them have to be playing a few frames later
+    bool checkVoiceSwap() {
+        AudioMixer mixer;
+        mixer.addSound(makeTone(110.0f, AUDIO_SAMPLE_RATE));
+        SpatialAudio spatial(mixer);
+        const Vector3 clusters[] = { Vector3(0.0f, 0.0f, 0.0f), Vector3(100.0f, 0.0f, 0.0f) };
+        for (const Vector3& centre : clusters) {
+            for (int i = 0; i < SPATIAL_VOICE_BUDGET; i++) {
+                float angle = 6.2831853f * i / SPATIAL_VOICE_BUDGET;
+                Vector3 offset(std::cos(angle) * 2.0f, 0.0f, std::sin(angle) * 2.0f);
+                spatial.addEmitter(0, centre + offset, 1.0f, AudioPriority::NORMAL, false);
+            }
+        }
+
+        std::vector<float> block(AUDIO_BLOCK_FRAMES * 2);
+        for (const Vector3& centre : clusters) {
+            spatial.setListener(centre, 0.0f, Vector3(0.0f, 0.0f, 0.0f));
+            for (int frame = 0; frame < 4; frame++) {
+                spatial.update(1.0f / 60.0f);
+                mixer.mix(block.data(), AUDIO_BLOCK_FRAMES);
+            }
+            if (spatial.getRealCount() != SPATIAL_VOICE_BUDGET ||
+                mixer.getActiveVoices() != SPATIAL_VOICE_BUDGET) {
+                std::cerr << "Voice swap check failed: " << spatial.getRealCount() << " real, "
+                          << mixer.getActiveVoices() << " mixing, want " << SPATIAL_VOICE_BUDGET << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Game frames at 60 Hz, with the mixer catching up on the audio each
+    // frame covers, as its thread would
+    int runHorde(AudioMixer& mixer, const BenchOptions& options) {
+        const float FRAME_SECONDS = 1.0f / 60.0f;
+        int breath = 0;
+        int footstep = 1;
+
+        struct Walker {
+            Vector3 centre;
+            float angle;
+            float stride;
+            uint32_t emitter;
+        };
+
+        SpatialAudio spatial(mixer);
+        std::vector<Walker> horde(options.monsters);
+        uint32_t state = 12345;
+        for (Walker& walker : horde) {
+            state = state * 1664525u + 1013904223u;
+            float x = (float)(state >> 8) / 16777216.0f * 60.0f - 30.0f;
+            state = state * 1664525u + 1013904223u;
+            float z = (float)(state >> 8) / 16777216.0f * 60.0f - 30.0f;
+            walker.centre = Vector3(x, 0.0f, z);
+            walker.angle = x;
+            walker.stride = z;
+            walker.emitter = spatial.addEmitter(breath, walker.centre, 0.8f, AudioPriority::NORMAL, true);
+        }
+
+        std::vector<float> block(AUDIO_BLOCK_FRAMES * 2);
+        double checksum = 0.0;
+        double spatialNs = 0.0;
+        double mixNs = 0.0;
+        int blocks = 0;
+        int peakReal = 0;
+        int peakMixing = 0;
+        double owed = 0.0;
+        int frames = std::max(1, options.blocks * AUDIO_BLOCK_FRAMES / (mixer.getSampleRate() / 60));
+        for (int frame = 0; frame < frames; frame++) {
+            float yaw = frame * 0.5f;
+            spatial.setListener(Vector3(0.0f, 0.0f, 0.0f), yaw, Vector3(0.0f, 0.0f, 0.0f));
+
+            // Each walks a 3 m circle at 3 m/s, stepping every 1.6 m
+            for (Walker& walker : horde) {
+                walker.angle += FRAME_SECONDS;
+                Vector3 offset(std::cos(walker.angle) * 3.0f, 0.0f, std::sin(walker.angle) * 3.0f);
+                Vector3 velocity(-offset.z, 0.0f, offset.x);
+                spatial.moveEmitter(walker.emitter, walker.centre + offset, velocity);
+                walker.stride += 3.0f * FRAME_SECONDS;
+                if (walker.stride > 1.6f) {
+                    walker.stride -= 1.6f;
+                    spatial.playOneShot(footstep, walker.centre + offset, 1.0f, AudioPriority::NORMAL);
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            spatial.update(FRAME_SECONDS);
+            spatialNs += elapsedNs(start);
+            peakReal = std::max(peakReal, spatial.getRealCount());
+
+            owed += FRAME_SECONDS * mixer.getSampleRate();
+            while (owed >= AUDIO_BLOCK_FRAMES) {
+                start = std::chrono::steady_clock::now();
+                mixer.mix(block.data(), AUDIO_BLOCK_FRAMES);
+                mixNs += elapsedNs(start);
+                peakMixing = std::max(peakMixing, mixer.getActiveVoices());
+                owed -= AUDIO_BLOCK_FRAMES;
+                blocks++;
+                for (float sample : block) checksum += std::fabs(sample);
+            }
+        }
+
+        double blockUs = mixNs / std::max(1, blocks) / 1000.0;
+        double realtimeUs = 1e6 * AUDIO_BLOCK_FRAMES / mixer.getSampleRate();
+
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "Monsters:         " << options.monsters << " (" << spatial.getEmitterCount()
+                  << " emitters at the end)" << std::endl;
+        std::cout << "Real voices:      " << peakReal << " at most, budget " << SPATIAL_VOICE_BUDGET << std::endl;
+        std::cout << "Mixer voices:     " << peakMixing << " at most" << std::endl;
+        std::cout << "Frames:           " << frames << std::endl;
+        std::cout << "Spatial us/frame: " << spatialNs / frames / 1000.0 << std::endl;
+        std::cout << "Mix us/block:     " << blockUs << std::endl;
+        std::cout << "Real-time load:   " << 100.0 * blockUs / realtimeUs << "%" << std::endl;
+        std::cout << "Voices stolen:    " << mixer.getVoicesStolen() << std::endl;
+        std::cout << "Dropped commands: " << mixer.getDroppedCommands() << std::endl;
+        std::cout << "Checksum:         " << std::setprecision(6) << checksum << std::endl;
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--voices <n>] [--blocks <n>] [--monsters <n>]" << std::endl;
+        return 1;
+    }
+
+    if (!checkHeadShadow() || !checkVoiceSwap()) return 1;
+
+    AudioMixer mixer;
+    const int rates[] = { 22050, 44100, 48000 };
+    for (int i = 0; i < 6; i++) {
+        mixer.addSound(makeTone(110.0f * (i + 1), rates[i % 3]));
+    }
+    if (options.monsters > 0) return runHorde(mixer, options);
+
+    std::vector<uint32_t> handles;
+    for (int i = 0; i < options.voices; i++) {
+        float pan = options.voices > 1 ? -1.0f + 2.0f * i / (options.voices - 1) : 0.0f;
+        handles.push_back(mixer.play(i % 6, 0.1f, pan, 0.8f + 0.02f * (i % 20), true, AudioBus::SOUND));
+    }
+
+    std::vector<float> block(AUDIO_BLOCK_FRAMES * 2);
+    double checksum = 0.0;
+    mixer.mix(block.data(), AUDIO_BLOCK_FRAMES);
+
+    // Game thread: a frame's worth of voice updates, drained before the queue fills
+    const int COMMANDS_PER_BATCH = 512;
+    double commandNs = 0.0;
+    int commandCount = 0;
+    double mixNs = 0.0;
+    for (int b = 0; b < options.blocks; b++) {
+        if (b % 8 == 0 && !handles.empty()) {
+            auto start = std::chrono::steady_clock::now();
+            for (int c = 0; c < COMMANDS_PER_BATCH; c++) {
+                float wobble = (float)((b + c) % 64) / 64.0f;
+                mixer.setVoice(handles[c % handles.size()], 0.1f, wobble * 2.0f - 1.0f, 0.9f + wobble * 0.2f);
+            }
+            commandNs += elapsedNs(start);
+            commandCount += COMMANDS_PER_BATCH;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        mixer.mix(block.data(), AUDIO_BLOCK_FRAMES);
+        mixNs += elapsedNs(start);
+
+        for (float sample : block) checksum += std::fabs(sample);
+    }
+
+    double blockUs = mixNs / options.blocks / 1000.0;
+    double realtimeUs = 1e6 * AUDIO_BLOCK_FRAMES / mixer.getSampleRate();
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Voices:           " << mixer.getActiveVoices() << " of " << AUDIO_MAX_VOICES << std::endl;
+    std::cout << "Blocks:           " << options.blocks << " x " << AUDIO_BLOCK_FRAMES << " frames" << std::endl;
+    if (commandCount > 0) {
+        std::cout << "Command ns/call:  " << commandNs / commandCount << std::endl;
+    }
+    std::cout << "Mix us/block:     " << blockUs << std::endl;
+    std::cout << "Real-time load:   " << 100.0 * blockUs / realtimeUs << "%" << std::endl;
+    std::cout << "Dropped commands: " << mixer.getDroppedCommands() << std::endl;
+    std::cout << "Checksum:         " << std::setprecision(6) << checksum << std::endl;
+    return 0;
+}
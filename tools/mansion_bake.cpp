@@ -0,0 +1,547 @@
+// mansion_bake - bakes the static lighting of a level's walls into a
+// lightmap file (.mhlm) that the game picks up beside the level.
+//
+// Usage: mansion_bake [--level <path> | --generate <rooms>] [--seed <n>]
+//                     [--floors <n>] [--wings <n>] [--output <path>]
+//                     [--texels <per unit>] [--samples <n>]
+//
+// Every wall texel gathers the level's candles and bulbs through shadow
+// rays, the ambient term scaled by how open its hemisphere is, and one
+// bounce off the walls and floors around it. Charts are cut into tiles and
+// traced across every core on the JobSystem; the result only depends on the
+// level and the options, never on the thread count.
+
+#include "Game.h"
+#include "Renderer.h"
+#include "RenderBackend.h"
+#include "Mansion.h"
+#include "LevelStreamer.h"
+#include "LightSystem.h"
+#include "LightmapFormat.h"
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+    const int MAX_PAGE_SIZE = 4096;
+    const int MAX_CHART_SIZE = 2048;
+    const int TILE_SIZE = 16;
+    const float SURFACE_OFFSET = 0.02f;   // Keeps rays off the surface they start on
+    const float AO_DISTANCE = 1.5f;       // Hits nearer than this shade the ambient term
+    const float BOUNCE_DISTANCE = 12.0f;
+    const uint8_t FLOOR_COLOR[3] = {34, 30, 25};   // The ground checker's average
+
+    struct BakeOptions {
+        LaunchOptions launch;
+        std::string outputPath;
+        float texelsPerUnit = 4.0f;
+        int samples = 64;
+    };
+
+    bool parseArguments(int argc, char* argv[], BakeOptions& options) {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const char* arg = argv[i];
+            const char* value = argv[i + 1];
+
+            if (strcmp(arg, "--level") == 0) {
+                options.launch.levelPath = value;
+            } else if (strcmp(arg, "--generate") == 0) {
+                options.launch.generateRooms = atoi(value);
+            } else if (strcmp(arg, "--seed") == 0) {
+                options.launch.seed = (uint32_t)strtoul(value, nullptr, 10);
+            } else if (strcmp(arg, "--floors") == 0) {
+                options.launch.floors = atoi(value);
+            } else if (strcmp(arg, "--wings") == 0) {
+                options.launch.wings = atoi(value);
+            } else if (strcmp(arg, "--output") == 0) {
+                options.outputPath = value;
+            } else if (strcmp(arg, "--texels") == 0) {
+                options.texelsPerUnit = (float)atof(value);
+            } else if (strcmp(arg, "--samples") == 0) {
+                options.samples = atoi(value);
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        return argc % 2 == 1 && options.texelsPerUnit > 0.0f && options.samples > 0;
+    }
+
+    uint32_t hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    float toUnit(uint32_t bits) {
+        return (bits >> 8) * (1.0f / 16777216.0f);
+    }
+
+    int nextPowerOfTwo(int value) {
+        int size = 1;
+        while (size < value) size *= 2;
+        return size;
+    }
+
+    // Axis-aligned rectangle the rays can hit: a wall piece or a floor
+    struct Surface {
+        int axis;           // The coordinate that's constant across it
+        float min[3], max[3];
+        float albedo[3];
+    };
+
+    struct Hit {
+        float distance;
+        int surface;
+    };
+
+    struct Scene {
+        std::vector<Surface> surfaces;
+        std::vector<std::vector<int>> roomSurfaces;   // A room's and its neighbours'
+
+        bool trace(int room, const float origin[3], const float dir[3], float maxDistance, Hit& hit) const {
+            hit.distance = maxDistance;
+            hit.surface = -1;
+            for (int index : roomSurfaces[room]) {
+                const Surface& s = surfaces[index];
+                int a = s.axis;
+                if (std::fabs(dir[a]) < 1e-6f) continue;
+
+                float t = (s.min[a] - origin[a]) / dir[a];
+                if (t <= 0.0f || t >= hit.distance) continue;
+
+                int b = (a + 1) % 3, c = (a + 2) % 3;
+                float pb = origin[b] + dir[b] * t;
+                float pc = origin[c] + dir[c] * t;
+                if (pb < s.min[b] || pb > s.max[b] || pc < s.min[c] || pc > s.max[c]) continue;
+
+                hit.distance = t;
+                hit.surface = index;
+            }
+            return hit.surface >= 0;
+        }
+    };
+
+    void buildScene(const Mansion& mansion, const OcclusionCuller& walls, Scene& scene) {
+        const std::vector<Room>& rooms = mansion.getRooms();
+        std::vector<std::vector<int>> owned(rooms.size());
+
+        for (int i = 0; i < walls.getOccluderCount(); i++) {
+            const Vector3* c = walls.getOccluder(i).corners;
+            Surface s;
+            s.axis = std::fabs(c[0].x - c[1].x) < 1e-4f && std::fabs(c[0].x - c[2].x) < 1e-4f ? 0 : 2;
+            s.min[0] = std::min(c[0].x, c[2].x); s.max[0] = std::max(c[0].x, c[2].x);
+            s.min[1] = std::min(c[0].y, c[2].y); s.max[1] = std::max(c[0].y, c[2].y);
+            s.min[2] = std::min(c[0].z, c[2].z); s.max[2] = std::max(c[0].z, c[2].z);
+            for (int k = 0; k < 3; k++) s.albedo[k] = STATIC_WALL_COLOR[k] / 255.0f;
+            owned[walls.getOccluderRoom(i)].push_back((int)scene.surfaces.size());
+            scene.surfaces.push_back(s);
+        }
+
+        for (int r = 0; r < (int)rooms.size(); r++) {
+            const Room& room = rooms[r];
+            Surface s;
+            s.axis = 1;
+            s.min[0] = room.position.x - room.size.x / 2.0f; s.max[0] = room.position.x + room.size.x / 2.0f;
+            s.min[1] = s.max[1] = room.position.y;
+            s.min[2] = room.position.z - room.size.z / 2.0f; s.max[2] = room.position.z + room.size.z / 2.0f;
+            for (int k = 0; k < 3; k++) s.albedo[k] = FLOOR_COLOR[k] / 255.0f;
+            owned[r].push_back((int)scene.surfaces.size());
+            scene.surfaces.push_back(s);
+        }
+
+        scene.roomSurfaces.assign(rooms.size(), std::vector<int>());
+        for (int r = 0; r < (int)rooms.size(); r++) {
+            std::vector<int>& list = scene.roomSurfaces[r];
+            list = owned[r];
+
+            uint32_t edgeCount = 0;
+            const LevelNavEdge* edges = mansion.getNavEdges(r, edgeCount);
+            for (uint32_t e = 0; e < edgeCount; e++) {
+                const std::vector<int>& next = owned[edges[e].toRoom];
+                list.insert(list.end(), next.begin(), next.end());
+            }
+            std::sort(list.begin(), list.end());
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+        }
+    }
+
+    struct Baker {
+        const Scene* scene;
+        LightSystem* lights;
+        float ambient;
+        int samples;
+
+        // Irradiance from the room's static lights; shadowed for the texel
+        // itself, unshadowed at bounce points where it's only an estimate
+        void direct(int room, const float p[3], const float n[3], bool shadows, float out[3]) const {
+            int count = 0;
+            const uint32_t* indices = lights->getRoomLights(room, count);
+            const std::vector<PointLight>& all = lights->getStaticLights();
+
+            for (int i = 0; i < count; i++) {
+                const PointLight& light = all[indices[i]];
+                float l[3] = {light.position.x - p[0], light.position.y - p[1], light.position.z - p[2]};
+                float distance = std::sqrt(l[0] * l[0] + l[1] * l[1] + l[2] * l[2]);
+                if (distance >= light.radius || distance < 1e-4f) continue;
+
+                for (int k = 0; k < 3; k++) l[k] /= distance;
+                float facing = n[0] * l[0] + n[1] * l[1] + n[2] * l[2];
+                if (facing <= 0.0f) continue;
+
+                Hit hit;
+                if (shadows && scene->trace(room, p, l, distance, hit)) continue;
+
+                // The same falloff the runtime gives these lights
+                float attenuation = 1.0f / (1.0f + SCENE_LIGHT_FALLOFF * distance * distance / (light.radius * light.radius));
+                for (int k = 0; k < 3; k++) out[k] += light.color[k] * attenuation * facing;
+            }
+        }
+
+        // Everything arriving at a wall point, in the units the fixed-function
+        // lighting uses, so the texel is albedo times this
+        void irradiance(int room, const float p[3], const float n[3], uint32_t seed, float out[3]) const {
+            out[0] = out[1] = out[2] = 0.0f;
+            direct(room, p, n, true, out);
+
+            // Tangent frame around an axis-aligned wall normal
+            const float up[3] = {0.0f, 1.0f, 0.0f};
+            const float side[3] = {n[2], 0.0f, -n[0]};
+
+            int grid = (int)std::ceil(std::sqrt((float)samples));
+            int open = 0;
+            float bounce[3] = {0.0f, 0.0f, 0.0f};
+            for (int i = 0; i < samples; i++) {
+                // Cosine-weighted, stratified over a grid of the unit square
+                uint32_t bits = hash(seed + (uint32_t)i * 0x9E3779B9u);
+                float u1 = ((i % grid) + toUnit(bits)) / grid;
+                float u2 = ((i / grid) % grid + toUnit(hash(bits))) / grid;
+                float r = std::sqrt(u1);
+                float phi = 6.2831853f * u2;
+                float x = r * std::cos(phi), y = r * std::sin(phi), z = std::sqrt(std::max(0.0f, 1.0f - u1));
+                float dir[3];
+                for (int k = 0; k < 3; k++) dir[k] = side[k] * x + up[k] * y + n[k] * z;
+
+                Hit hit;
+                if (!scene->trace(room, p, dir, BOUNCE_DISTANCE, hit)) {
+                    open++;
+                    continue;
+                }
+                if (hit.distance >= AO_DISTANCE) open++;
+
+                // One bounce: the hit surface reflects the direct light on it
+                const Surface& surface = scene->surfaces[hit.surface];
+                float q[3], m[3] = {0.0f, 0.0f, 0.0f};
+                m[surface.axis] = dir[surface.axis] > 0.0f ? -1.0f : 1.0f;
+                for (int k = 0; k < 3; k++) q[k] = p[k] + dir[k] * hit.distance + m[k] * SURFACE_OFFSET;
+
+                float light[3] = {0.0f, 0.0f, 0.0f};
+                direct(room, q, m, false, light);
+                for (int k = 0; k < 3; k++) bounce[k] += surface.albedo[k] * light[k];
+            }
+
+            float occlusion = (float)open / samples;
+            for (int k = 0; k < 3; k++) {
+                out[k] += ambient * occlusion + bounce[k] / samples;
+            }
+        }
+    };
+
+    // One wall's rectangle on a page; the padded rectangle is a texel bigger
+    // all round
+    struct Chart {
+        int room;
+        int wall;
+        int width, height;
+        int x, y;           // Inner rectangle
+    };
+
+    struct Page {
+        std::vector<Chart> charts;
+        int width, height;
+        int doorX, doorY;   // Top-left of the 2x2 door block
+        std::vector<uint8_t> texels;
+    };
+
+    struct Tile {
+        int page;
+        int chart;
+        int x0, y0, x1, y1;   // Texels within the chart
+    };
+
+    // Shelf packing, tallest first; returns the height used at this width
+    int packShelves(Page& page, const std::vector<int>& order, int width) {
+        // The door block goes first, in the corner
+        int cursorX = 2, cursorY = 0, shelf = 2;
+        page.doorX = 0;
+        page.doorY = 0;
+        for (int index : order) {
+            Chart& chart = page.charts[index];
+            int w = chart.width + 2, h = chart.height + 2;
+            if (cursorX + w > width) {
+                cursorX = 0;
+                cursorY += shelf;
+                shelf = 0;
+            }
+            chart.x = cursorX + 1;
+            chart.y = cursorY + 1;
+            cursorX += w;
+            shelf = std::max(shelf, h);
+        }
+        return cursorY + shelf;
+    }
+
+    // Tries every power-of-two width and keeps the smallest page
+    bool packPage(Page& page) {
+        std::vector<int> order(page.charts.size());
+        int widest = 2;
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = (int)i;
+            widest = std::max(widest, page.charts[i].width + 2);
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return page.charts[a].height > page.charts[b].height;
+        });
+
+        int bestWidth = 0;
+        long bestArea = 0;
+        for (int width = nextPowerOfTwo(widest); width <= MAX_PAGE_SIZE; width *= 2) {
+            int height = nextPowerOfTwo(packShelves(page, order, width));
+            if (height > MAX_PAGE_SIZE) continue;
+            if (bestWidth == 0 || (long)width * height < bestArea) {
+                bestWidth = width;
+                bestArea = (long)width * height;
+            }
+        }
+        if (bestWidth == 0) return false;
+
+        page.width = bestWidth;
+        page.height = nextPowerOfTwo(packShelves(page, order, bestWidth));
+        return true;
+    }
+
+    uint8_t toByte(float value) {
+        return (uint8_t)std::min(255.0f, std::max(0.0f, value * 255.0f + 0.5f));
+    }
+
+    // Copies each chart's edge texels into its padding, so filtering at the
+    // edge never reaches whatever is packed next to it
+    void padChart(Page& page, const Chart& chart) {
+        auto texel = [&](int x, int y) { return &page.texels[((size_t)y * page.width + x) * 3]; };
+        for (int y = chart.y - 1; y <= chart.y + chart.height; y++) {
+            for (int x = chart.x - 1; x <= chart.x + chart.width; x++) {
+                int sx = std::min(std::max(x, chart.x), chart.x + chart.width - 1);
+                int sy = std::min(std::max(y, chart.y), chart.y + chart.height - 1);
+                if (sx != x || sy != y) memcpy(texel(x, y), texel(sx, sy), 3);
+            }
+        }
+    }
+
+    // Doors get one flat colour per page: the door's albedo under the
+    // page's average wall light
+    void fillDoors(Page& page) {
+        double sum[3] = {0.0, 0.0, 0.0};
+        long count = 0;
+        for (const Chart& chart : page.charts) {
+            for (int y = chart.y; y < chart.y + chart.height; y++) {
+                const uint8_t* row = &page.texels[((size_t)y * page.width + chart.x) * 3];
+                for (int x = 0; x < chart.width * 3; x++) sum[x % 3] += row[x];
+                count += chart.width;
+            }
+        }
+
+        uint8_t door[3];
+        for (int k = 0; k < 3; k++) {
+            float light = count > 0 ? (float)(sum[k] / count) / STATIC_WALL_COLOR[k] : 0.0f;
+            door[k] = toByte(light * STATIC_DOOR_COLOR[k] / 255.0f);
+        }
+        for (int y = page.doorY; y < page.doorY + 2; y++) {
+            for (int x = page.doorX; x < page.doorX + 2; x++) {
+                memcpy(&page.texels[((size_t)y * page.width + x) * 3], door, 3);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BakeOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--level <path> | --generate <rooms>] [--seed <n>]"
+                  << " [--floors <n>] [--wings <n>] [--output <path>] [--texels <per unit>] [--samples <n>]"
+                  << std::endl;
+        return 1;
+    }
+
+    bool generated = options.launch.generateRooms > 0;
+    if (options.outputPath.empty()) {
+        if (generated) {
+            std::cerr << "Generated mansions need --output" << std::endl;
+            return 1;
+        }
+        options.outputPath = getLightmapPath(options.launch.levelPath);
+    }
+
+    Mansion mansion;
+    if (generated) {
+        MansionGenParams params;
+        params.seed = options.launch.seed;
+        params.roomCount = options.launch.generateRooms;
+        params.floors = options.launch.floors;
+        params.wings = options.launch.wings;
+        mansion.generate(params);
+    } else {
+        mansion.initialize(options.launch.levelPath);
+    }
+
+    const std::vector<Room>& rooms = mansion.getRooms();
+    if (rooms.empty()) {
+        std::cerr << "Level has no rooms" << std::endl;
+        return 1;
+    }
+
+    // The game's own chunking, lights and wall pieces, so the bake lines up
+    // with what it draws
+    LevelStreamer streamer(mansion);
+    streamer.build();
+
+    Renderer renderer(1280, 720, std::make_unique<NullRenderBackend>());
+    renderer.initialize();
+    renderer.bakeStaticGeometry(mansion);
+
+    Scene scene;
+    buildScene(mansion, renderer.getOcclusionCuller(), scene);
+
+    Baker baker;
+    baker.scene = &scene;
+    baker.lights = &renderer.getLights();
+    baker.ambient = 0.2f + renderer.getSettings().ambientLight;
+    baker.samples = options.samples;
+
+    // A page per chunk with rooms in it
+    const auto& chunks = streamer.getChunks();
+    std::vector<Page> pages;
+    for (const auto& chunk : chunks) {
+        if (chunk->rooms.empty()) continue;
+
+        Page page;
+        for (int room : chunk->rooms) {
+            const Room& source = rooms[room];
+            LightmapWall walls[4];
+            getLightmapWalls(LevelVec3{source.position.x, source.position.y, source.position.z},
+                             LevelVec3{source.size.x, source.size.y, source.size.z}, walls);
+            for (int wall = 0; wall < 4; wall++) {
+                Chart chart;
+                chart.room = room;
+                chart.wall = wall;
+                chart.width = std::min(MAX_CHART_SIZE, std::max(1, (int)std::ceil(walls[wall].length * options.texelsPerUnit)));
+                chart.height = std::min(MAX_CHART_SIZE, std::max(1, (int)std::ceil(walls[wall].height * options.texelsPerUnit)));
+                chart.x = chart.y = 0;
+                page.charts.push_back(chart);
+            }
+        }
+
+        if (!packPage(page)) {
+            std::cerr << "Chunk too big for one lightmap page; try fewer --texels" << std::endl;
+            return 1;
+        }
+        page.texels.assign((size_t)page.width * page.height * 3, 0);
+        pages.push_back(std::move(page));
+    }
+
+    std::vector<Tile> tiles;
+    long texelCount = 0;
+    for (int p = 0; p < (int)pages.size(); p++) {
+        for (int c = 0; c < (int)pages[p].charts.size(); c++) {
+            const Chart& chart = pages[p].charts[c];
+            texelCount += (long)chart.width * chart.height;
+            for (int y = 0; y < chart.height; y += TILE_SIZE) {
+                for (int x = 0; x < chart.width; x += TILE_SIZE) {
+                    tiles.push_back(Tile{p, c, x, y, std::min(x + TILE_SIZE, chart.width), std::min(y + TILE_SIZE, chart.height)});
+                }
+            }
+        }
+    }
+
+    std::cout << "Baking " << texelCount << " texels on " << pages.size() << " pages, "
+              << options.samples << " samples each, " << (getJobSystem().getWorkerCount() + 1) << " threads" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+
+    getJobSystem().parallelFor((int)tiles.size(), [&](int index) {
+        const Tile& tile = tiles[index];
+        Page& page = pages[tile.page];
+        const Chart& chart = page.charts[tile.chart];
+        const Room& room = rooms[chart.room];
+
+        LightmapWall walls[4];
+        getLightmapWalls(LevelVec3{room.position.x, room.position.y, room.position.z},
+                         LevelVec3{room.size.x, room.size.y, room.size.z}, walls);
+        const LightmapWall& wall = walls[chart.wall];
+        const float n[3] = {wall.inward.x, wall.inward.y, wall.inward.z};
+
+        for (int y = tile.y0; y < tile.y1; y++) {
+            for (int x = tile.x0; x < tile.x1; x++) {
+                float along = (x + 0.5f) / chart.width * wall.length;
+                float up = (y + 0.5f) / chart.height * wall.height;
+                float p[3] = {wall.origin.x + wall.along.x * along + n[0] * SURFACE_OFFSET,
+                              wall.origin.y + up,
+                              wall.origin.z + wall.along.z * along + n[2] * SURFACE_OFFSET};
+
+                uint32_t seed = hash((uint32_t)(chart.room * 4 + chart.wall) * 0x10001u ^ hash((uint32_t)(y * 4099 + x)));
+                float light[3];
+                baker.irradiance(chart.room, p, n, seed, light);
+
+                uint8_t* out = &page.texels[((size_t)(chart.y + y) * page.width + chart.x + x) * 3];
+                for (int k = 0; k < 3; k++) out[k] = toByte(STATIC_WALL_COLOR[k] / 255.0f * light[k]);
+            }
+        }
+    });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t levelHash = LIGHTMAP_HASH_SEED;
+    for (const Room& room : rooms) {
+        levelHash = hashLightmapRoom(levelHash, LevelVec3{room.position.x, room.position.y, room.position.z},
+                                     LevelVec3{room.size.x, room.size.y, room.size.z});
+    }
+
+    LightmapBuilder builder(levelHash, options.texelsPerUnit, rooms.size());
+    std::vector<LightmapRoom> records(rooms.size(), LightmapRoom{0, {}});
+    size_t pageBytes = 0;
+    for (Page& page : pages) {
+        for (const Chart& chart : page.charts) padChart(page, chart);
+        fillDoors(page);
+
+        uint32_t index = builder.addPage((uint16_t)page.width, (uint16_t)page.height, (uint16_t)(page.doorX + 1),
+                                         (uint16_t)(page.doorY + 1), page.texels);
+        for (const Chart& chart : page.charts) {
+            records[chart.room].page = index;
+            records[chart.room].walls[chart.wall] = LightmapRect{(uint16_t)chart.x, (uint16_t)chart.y,
+                                                                 (uint16_t)chart.width, (uint16_t)chart.height};
+        }
+        pageBytes += page.texels.size();
+    }
+    for (size_t i = 0; i < records.size(); i++) {
+        builder.setRoom(i, records[i]);
+    }
+
+    std::cout << std::fixed;
+    std::cout.precision(2);
+    std::cout << "Baked in " << seconds << " s (" << (texelCount / std::max(seconds, 1e-6) / 1000.0) << "k texels/s)" << std::endl;
+    std::cout << "Pages: " << pageBytes / 1024 << " KB" << std::endl;
+
+    if (!builder.write(options.outputPath)) {
+        return 1;
+    }
+    std::cout << "Wrote " << options.outputPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,165 @@
+// mansion_levelc - compiles a text level description into the binary .mhl
+// format read by Mansion/TaskSystem at runtime.
+//
+// Usage: mansion_levelc <input.txt> <output.mhl>
+//
+// One record per line, '#' starts a comment, strings may be quoted:
+//   room   "<name>"  px py pz  sx sy sz
+//   door   px py pz  open|locked  roomA roomB
+//   spot   <type>  px py pz  radius
+//   task   <id> "<description>"  px py pz  radius
+//   patrol px py pz
+// Rooms are referenced by their zero-based order in the file.
+
+#include "LevelFormat.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    struct ParseError {
+        std::string message;
+    };
+
+    std::vector<std::string> tokenize(const std::string& line) {
+        std::vector<std::string> tokens;
+        size_t i = 0;
+
+        while (i < line.size()) {
+            char c = line[i];
+            if (c == '#') break;
+            if (c == ' ' || c == '\t' || c == '\r') {
+                i++;
+                continue;
+            }
+
+            std::string token;
+            if (c == '"') {
+                size_t end = line.find('"', i + 1);
+                if (end == std::string::npos) throw ParseError{"unterminated string"};
+                token = line.substr(i + 1, end - i - 1);
+                i = end + 1;
+            } else {
+                while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r' && line[i] != '#') {
+                    token.push_back(line[i++]);
+                }
+            }
+            tokens.push_back(token);
+        }
+
+        return tokens;
+    }
+
+    float toFloat(const std::string& token) {
+        char* end = nullptr;
+        float value = strtof(token.c_str(), &end);
+        if (token.empty() || *end != '\0') throw ParseError{"expected a number, got '" + token + "'"};
+        return value;
+    }
+
+    int toInt(const std::string& token) {
+        char* end = nullptr;
+        long value = strtol(token.c_str(), &end, 10);
+        if (token.empty() || *end != '\0') throw ParseError{"expected an integer, got '" + token + "'"};
+        return (int)value;
+    }
+
+    LevelVec3 toVec3(const std::vector<std::string>& tokens, size_t first) {
+        return LevelVec3{toFloat(tokens[first]), toFloat(tokens[first + 1]), toFloat(tokens[first + 2])};
+    }
+
+    void expectCount(const std::vector<std::string>& tokens, size_t count) {
+        if (tokens.size() != count) {
+            std::ostringstream msg;
+            msg << "'" << tokens[0] << "' takes " << count - 1 << " fields, got " << tokens.size() - 1;
+            throw ParseError{msg.str()};
+        }
+    }
+
+    struct PendingDoor {
+        int line;
+        int rooms[2];
+    };
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.txt> <output.mhl>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream input(argv[1]);
+    if (!input) {
+        std::cerr << "Cannot open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    LevelBuilder builder;
+    std::vector<PendingDoor> pendingDoors;
+    std::string line;
+    int lineNumber = 0;
+    int errors = 0;
+
+    while (std::getline(input, line)) {
+        lineNumber++;
+
+        try {
+            std::vector<std::string> tokens = tokenize(line);
+            if (tokens.empty()) continue;
+
+            const std::string& kind = tokens[0];
+            if (kind == "room") {
+                expectCount(tokens, 8);
+                builder.addRoom(toVec3(tokens, 2), toVec3(tokens, 5), tokens[1]);
+            } else if (kind == "door") {
+                expectCount(tokens, 7);
+                if (tokens[4] != "open" && tokens[4] != "locked") {
+                    throw ParseError{"door state must be 'open' or 'locked'"};
+                }
+                PendingDoor pending = {lineNumber, {toInt(tokens[5]), toInt(tokens[6])}};
+                pendingDoors.push_back(pending);
+                builder.addDoor(toVec3(tokens, 1), tokens[4] == "open", pending.rooms[0], pending.rooms[1]);
+            } else if (kind == "spot") {
+                expectCount(tokens, 6);
+                builder.addHidingSpot(toVec3(tokens, 2), toFloat(tokens[5]), tokens[1]);
+            } else if (kind == "task") {
+                expectCount(tokens, 7);
+                builder.addTask(toInt(tokens[1]), toVec3(tokens, 3), toFloat(tokens[6]), tokens[2]);
+            } else if (kind == "patrol") {
+                expectCount(tokens, 4);
+                builder.addPatrolPoint(toVec3(tokens, 1));
+            } else {
+                throw ParseError{"unknown record '" + kind + "'"};
+            }
+        } catch (const ParseError& error) {
+            std::cerr << argv[1] << ":" << lineNumber << ": " << error.message << std::endl;
+            errors++;
+        }
+    }
+
+    // Doors may be declared before the rooms they join, so check indices at the end
+    for (const auto& door : pendingDoors) {
+        for (int side = 0; side < 2; side++) {
+            if (door.rooms[side] < 0 || door.rooms[side] >= (int)builder.getRoomCount()) {
+                std::cerr << argv[1] << ":" << door.line << ": door references room "
+                          << door.rooms[side] << " but only " << builder.getRoomCount()
+                          << " rooms are defined" << std::endl;
+                errors++;
+            }
+        }
+    }
+
+    if (errors > 0) {
+        std::cerr << errors << " error(s), no output written" << std::endl;
+        return 1;
+    }
+
+    if (!builder.write(argv[2])) {
+        return 1;
+    }
+
+    return 0;
+}
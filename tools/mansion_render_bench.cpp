@@ -0,0 +1,237 @@
+// mansion_render_bench - times the renderer's CPU side (culling, queueing,
+// sorting and submission) with no window or GL context, by walking a camera
+// through every room and drawing into a counting backend.
+//
+// Usage: mansion_render_bench [--level <path> | --generate <rooms>] [--seed <n>]
+//                             [--frames <n>] [--record <log>] [--occlusion on|off]
+//                             [--particles on|off] [--monsters <n>]
+//
+// --record writes the backend call log for the run, the same format the game
+// writes with --record-render, so two builds can be diffed call by call.
+// --particles keeps every particle pool full around the camera, the most the
+// game can ever have live, and times their update on its own.
+// --monsters puts a horde in the rooms, each walking, searching, running or
+// attacking, and times their animation on its own; skinning the ones in view
+// counts towards the renderer.
+
+#include "Game.h"
+#include "Renderer.h"
+#include "RenderBackend.h"
+#include "Mansion.h"
+#include "LevelStreamer.h"
+#include "PortalCuller.h"
+#include "OcclusionCuller.h"
+#include "ParticleSystem.h"
+#include "MonsterAnimation.h"
+#include "MemoryArena.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+    struct BenchOptions {
+        LaunchOptions launch;
+        int frames = 600;
+        std::string recordPath;
+        bool occlusion = true;
+        bool particles = false;
+        int monsters = 0;
+    };
+
+    bool parseArguments(int argc, char* argv[], BenchOptions& options) {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const char* arg = argv[i];
+            const char* value = argv[i + 1];
+
+            if (strcmp(arg, "--level") == 0) {
+                options.launch.levelPath = value;
+            } else if (strcmp(arg, "--generate") == 0) {
+                options.launch.generateRooms = atoi(value);
+            } else if (strcmp(arg, "--seed") == 0) {
+                options.launch.seed = (uint32_t)strtoul(value, nullptr, 10);
+            } else if (strcmp(arg, "--frames") == 0) {
+                options.frames = atoi(value);
+            } else if (strcmp(arg, "--record") == 0) {
+                options.recordPath = value;
+            } else if (strcmp(arg, "--occlusion") == 0) {
+                options.occlusion = strcmp(value, "off") != 0;
+            } else if (strcmp(arg, "--particles") == 0) {
+                options.particles = strcmp(value, "off") != 0;
+            } else if (strcmp(arg, "--monsters") == 0) {
+                options.monsters = atoi(value);
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        return argc % 2 == 1 && options.frames > 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--level <path> | --generate <rooms>] [--seed <n>]"
+                  << " [--frames <n>] [--record <log>] [--occlusion on|off] [--particles on|off]"
+                  << " [--monsters <n>]" << std::endl;
+        return 1;
+    }
+
+    Mansion mansion;
+    if (options.launch.generateRooms > 0) {
+        MansionGenParams params;
+        params.seed = options.launch.seed;
+        params.roomCount = options.launch.generateRooms;
+        mansion.generate(params);
+    } else {
+        mansion.initialize(options.launch.levelPath);
+    }
+
+    const std::vector<Room>& rooms = mansion.getRooms();
+    if (rooms.empty()) {
+        std::cerr << "Level has no rooms" << std::endl;
+        return 1;
+    }
+
+    LevelStreamer streamer(mansion);
+    streamer.build();
+    PortalCuller culler(mansion);
+
+    std::unique_ptr<RenderBackend> backend = std::make_unique<NullRenderBackend>();
+    if (!options.recordPath.empty()) {
+        auto recording = std::make_unique<RecordingRenderBackend>(options.recordPath, std::move(backend));
+        if (!recording->isOpen()) return 1;
+        backend = std::move(recording);
+    }
+
+    Renderer renderer(1280, 720, std::move(backend));
+    renderer.initialize();
+    renderer.bakeStaticGeometry(mansion);
+    OcclusionCuller& occlusion = renderer.getOcclusionCuller();
+    occlusion.setEnabled(options.occlusion);
+
+    const std::vector<Task>& tasks = mansion.getGeneratedTasks();
+    ParticleSystem particles;
+    double submitSeconds = 0.0;
+    double particleSeconds = 0.0;
+    size_t particlesLive = 0;
+
+    // Round-robin over the rooms, spread across each one's floor
+    MonsterAnimation animation;
+    std::vector<Vector3> monsterSpots;
+    for (int i = 0; i < options.monsters; i++) {
+        const Room& room = rooms[i % rooms.size()];
+        float spread = (float)(i / rooms.size() % 8) / 8.0f - 0.5f;
+        monsterSpots.push_back(room.position + Vector3(room.size.x * spread * 0.8f, 0.0f, room.size.z * spread * 0.4f));
+        animation.addInstance(monsterSpots.back());
+    }
+    double animationSeconds = 0.0;
+    long occludersDrawn = 0, boxesTested = 0, boxesCulled = 0;
+
+    for (int frame = 0; frame < options.frames; frame++) {
+        // Stand in each room in turn, turning a full circle over 60 frames
+        const Room& room = rooms[(frame / 60) % rooms.size()];
+        Vector3 eye = room.position + Vector3(0.0f, 1.7f, 0.0f);
+        float yaw = (frame % 60) * 6.0f;
+        float pitch = -10.0f * std::sin(frame * 0.1f);
+
+        // Streaming is the game's cost, not the renderer's; keep it out of the timing
+        streamer.update(eye);
+        streamer.flush();
+
+        getFrameArena().beginFrame();
+
+        if (options.particles) {
+            // Refill what died, scattered through the room; only the update is timed
+            Vector3 half(room.size.x / 2.0f, 0.0f, room.size.z / 2.0f);
+            AABB roomBox = {room.position - half, room.position + half + Vector3(0.0f, room.size.y, 0.0f)};
+            Vector3 center = room.position + Vector3(0.0f, room.size.y / 2.0f, 0.0f);
+            for (int type = 0; type < (int)ParticleType::COUNT; type++) {
+                ParticleType particleType = (ParticleType)type;
+                int missing = (int)(ParticleSystem::getDesc(particleType).capacity - particles.getLiveCount(particleType));
+                particles.emit(particleType, center, Vector3(), 1.0f, std::min(room.size.x, room.size.z) / 2.0f,
+                               room.position.y, missing);
+            }
+
+            auto particleStart = std::chrono::steady_clock::now();
+            particles.update(1.0f / 60.0f, eye, yaw, &roomBox, false);
+            particleSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - particleStart).count();
+            particlesLive += particles.getLiveCount();
+        }
+
+        if (options.monsters > 0) {
+            // Each takes a turn at every state, at the speed the game gives it
+            static const MonsterState STATES[] = {MonsterState::PATROL, MonsterState::SEARCH, MonsterState::CHASE,
+                                                  MonsterState::ATTACK};
+            for (int i = 0; i < options.monsters; i++) {
+                MonsterState state = STATES[(i + frame / 90) % 4];
+                float speed = state == MonsterState::CHASE ? 6.0f : state == MonsterState::PATROL ? 3.0f : 0.0f;
+                float heading = i * 2.4f + frame * 0.01f;
+                // Moving on the spot, so the horde stays where it was put
+                animation.setTarget(i, state, monsterSpots[i], Vector3(std::sin(heading), 0.0f, std::cos(heading)) * speed);
+            }
+
+            auto animationStart = std::chrono::steady_clock::now();
+            animation.update(1.0f / 60.0f);
+            animationSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - animationStart).count();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        renderer.beginFrame();
+        renderer.setCamera(eye, yaw, pitch);
+        culler.update(eye, yaw, pitch, renderer.getFieldOfView(), renderer.getAspect(),
+                      renderer.getNearPlane(), renderer.getFarPlane());
+        renderer.renderMansion(streamer, culler);
+        renderer.renderHidingSpots(mansion.getHidingSpots(), streamer, culler);
+        renderer.renderTasks(tasks);
+        renderer.renderMonsters(animation);
+        if (options.particles) {
+            renderer.renderParticles(particles);
+        }
+        renderer.submitScene();
+        renderer.endFrame();
+
+        submitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        occludersDrawn += occlusion.getRasterisedCount();
+        boxesTested += occlusion.getTestedCount();
+        boxesCulled += occlusion.getCulledCount();
+    }
+
+    const RenderCounters& counters = renderer.getCounters();
+    double frames = counters.frames > 0 ? counters.frames : 1;
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Rooms:            " << rooms.size() << std::endl;
+    std::cout << "Frames:           " << counters.frames << std::endl;
+    std::cout << "CPU ms/frame:     " << submitSeconds * 1000.0 / frames << std::endl;
+    std::cout << std::setprecision(1);
+    std::cout << "Draws/frame:      " << counters.drawCalls / frames << std::endl;
+    std::cout << "Materials/frame:  " << counters.materialChanges / frames << std::endl;
+    std::cout << "Light sets/frame: " << counters.lightChanges / frames << " from "
+              << renderer.getLights().getStaticLightCount() << " lights" << std::endl;
+    std::cout << "Instances/frame:  " << counters.instances / frames << std::endl;
+    std::cout << "Indices/frame:    " << counters.indices / frames << std::endl;
+    std::cout << "Vertices/frame:   " << counters.vertices / frames << std::endl;
+    std::cout << "Matrices/frame:   " << counters.matrixLoads / frames << std::endl;
+    std::cout << "Occluders/frame:  " << occludersDrawn / frames << " of " << occlusion.getOccluderCount() << std::endl;
+    std::cout << "Occluded/frame:   " << boxesCulled / frames << " of " << boxesTested / frames << " tested" << std::endl;
+    if (options.particles) {
+        std::cout << std::setprecision(3);
+        std::cout << "Particle ms/frame: " << particleSeconds * 1000.0 / frames << " for "
+                  << (size_t)(particlesLive / frames) << " live" << std::endl;
+    }
+    if (options.monsters > 0) {
+        std::cout << std::setprecision(3);
+        std::cout << "Animation ms/frame: " << animationSeconds * 1000.0 / frames << " for " << options.monsters
+                  << " monsters, " << animation.getClipBytes() << " bytes of clips" << std::endl;
+    }
+
+    renderer.cleanup();
+    return 0;
+}